@@ -0,0 +1,78 @@
+' CSVREAD and CSVWRITE
+
+tmpfile = "/tmp/sbasic_csv_test.csv"
+
+open tmpfile for output as #1
+csvwrite #1, ["id", "name", "price", "note"]
+csvwrite #1, [1, "apple", 1.25, "red, round"]
+csvwrite #1, [2, "pear", 0.5, "a \"green\" pear"]
+csvwrite #1, [3, "007", -2, " padded "]
+m = {"id": 4, "name": "plum", "price": 3}
+m.note = "line1" + chr(10) + "line2"
+h = ["id", "name", "price", "note"]
+csvwrite #1, m, h
+close #1
+
+open tmpfile for input as #1
+csvread #1, header
+print header
+while not eof(1)
+  csvread #1, row
+  print len(row); ": "; row
+wend
+close #1
+
+open tmpfile for input as #1
+csvread #1, header
+csvread #1, row, header
+print row.name; " "; row.price; " "; row.note
+total = 0
+while not eof(1)
+  csvread #1, row, header
+  total += row.price
+wend
+print total
+close #1
+
+' RFC 4180 quoting, CRLF and a missing final line break
+open tmpfile for output as #1
+print #1, "a,\"b\"\"c\",\"\",,\"x" + chr(10) + "y\"" + chr(13)
+print #1, "1e3,+7,-0.5,0x10,12a" + chr(13)
+print #1, "";
+print #1, "last";
+close #1
+
+open tmpfile for input as #1
+while not eof(1)
+  csvread #1, row
+  print len(row); ": "; row
+wend
+close #1
+
+' numbers are written unquoted, numeric strings quoted
+open tmpfile for output as #1
+csvwrite #1, [42, -1.5e-3, "42", 2E+2]
+csvwrite #1, ["1.5e-3", "b"]
+close #1
+
+open tmpfile for input as #1
+line input #1, s
+print s
+csvread #1, row
+print row
+seek #1, 0
+csvread #1, row
+print row; " "; isnumber(row[1])
+close #1
+
+open tmpfile for output as #1
+print #1, "1.5e-3,2E+2,-1e+2,1e-,e+2"
+close #1
+open tmpfile for input as #1
+csvread #1, row
+for v in row
+  print isnumber(v); " ";
+next
+print
+close #1
+kill tmpfile
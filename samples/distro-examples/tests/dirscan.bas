@@ -0,0 +1,55 @@
+' DIRSCAN returns the files in a directory tree
+
+base = "/tmp/sbasic_dirscan_test"
+
+sub make_file(name, text)
+  open name for output as #1
+  print #1, text;
+  close #1
+end
+
+sub remove_tree(dir)
+  local f
+  for f in dirscan(dir)
+    if not f.dir then kill f.path + "/" + f.name
+  next
+  for f in dirscan(dir)
+    if f.depth == 1 then rmdir f.path + "/" + f.name
+  next
+  for f in dirscan(dir)
+    if f.depth == 0 then rmdir f.path + "/" + f.name
+  next
+  rmdir dir
+end
+
+if exist(base) then remove_tree(base)
+mkdir base
+mkdir base + "/b"
+mkdir base + "/b/c"
+mkdir base + "/a"
+make_file(base + "/z.txt", "12345")
+make_file(base + "/a/one.bas", "1")
+make_file(base + "/b/two.txt", "22")
+make_file(base + "/b/c/three.txt", "333")
+
+for f in dirscan(base)
+  print f.depth; " "; mid(f.path, len(base) + 1); " "; f.name; " "; f.dir; " "; iff(f.dir, "", f.size)
+next
+
+print "*.txt: ";
+for f in dirscan(base, "*.txt")
+  print f.name; " ";
+next
+print
+
+' cached scans see changes to the directory
+print len(dirscan(base, "*", true))
+make_file(base + "/b/four.txt", "4444")
+print len(dirscan(base, "*", true))
+kill base + "/b/four.txt"
+print len(dirscan(base, "*", true))
+
+print len(dirscan(base + "/missing"))
+
+remove_tree(base)
+print exist(base)
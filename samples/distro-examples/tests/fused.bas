@@ -0,0 +1,94 @@
+rem statements compiled to the fused LET, array store, IF and FOR paths
+rem must behave the same when the fast path doesn't apply
+
+rem increments
+i = 1
+i = i + 1
+i += 2
+i++
+i = i - 5
+i--
+? i
+f = 1.5
+f = f + 1
+f += 2
+? f
+s = "ab"
+s = s + 1
+? s
+
+rem array stores
+dim a(3)
+a(0) = 1
+i = 2
+a(i) = "two"
+j = 1.0
+a(j) = 3.5
+? a
+dim b(1 to 3)
+i = 3
+b(i) = 30
+b(1) = 10
+? b
+dim m(2, 2)
+i = 1
+m(i, i) = 5
+? m
+d = {}
+i = "k"
+d(i) = 1
+? d
+try
+  i = 4
+  a(i) = 0
+catch e
+  ? "out of range"
+end try
+k = 0
+a(k) = a(k) + 1
+? a(0)
+
+rem compare and branch
+x = 1
+y = 2
+if x < y then ? "lt"
+if x > y then ? "gt" else ? "not gt"
+if x = 1 then ? "eq"
+if x <> 1 then ? "ne" else ? "not ne"
+if x >= 1 then ? "ge"
+if y <= 1 then ? "le" else ? "not le"
+x = 1.5
+if x < y then ? "num lt"
+x = 2.0
+if x = y then ? "num eq"
+x = "b"
+y = "a"
+if x > y then ? "str gt"
+if x < 3 then ? "str lt"
+
+rem integer FOR
+n = 3
+for i = 1 to n
+  ? i;
+next
+?
+for i = 10 to 1 step -3
+  ? i;
+next
+?
+st = 2
+for i = 1 to 6 step st
+  ? i;
+next
+?
+for i = 1 to 3
+  i = i + 0.5
+  ? i;
+next
+?
+n = 2
+for i = 1 to n
+  n = 4
+  ? i;
+next
+?
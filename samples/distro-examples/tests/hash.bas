@@ -80,3 +80,20 @@ if (a.stringT <> "true") then throw "not true"
 if (a.stringF <> "false") then throw "not false"
 if (a.booleanT <> 1) then throw "not true"
 if (a.booleanF <> 0) then throw "not false"
+
+'
+' runtime counters from SYSINFO
+'
+s1 = sysinfo
+counts = {}
+for i = 1 to 100
+  counts[i] = i
+next
+s2 = sysinfo()
+if (s2.map_inserts - s1.map_inserts < 100) then throw "SYSINFO map_inserts"
+if (s2.map_lookups - s1.map_lookups < 100) then throw "SYSINFO map_lookups"
+if (s2.var_pool_hits + s2.var_pool_misses <= s1.var_pool_hits + s1.var_pool_misses) then throw "SYSINFO var pool"
+if (s2.map_depth_max < 1) then throw "SYSINFO map_depth_max"
+if (s2.prog_stack_max < 1) then throw "SYSINFO prog_stack_max"
+if (s2.heap_bytes <= s1.heap_bytes) then throw "SYSINFO heap_bytes"
+if (isarray(s2.files) == 0) then throw "SYSINFO files"
@@ -0,0 +1,118 @@
+'
+' image buffers shared between variables
+'
+dim px(3, 4)
+for y = 0 to 3
+  for x = 0 to 4
+    px(y, x) = rgb(y * 10, x * 10, 5)
+  next
+next
+
+a = image(px)
+if (a.width != 5 || a.height != 4) then throw "size: " + a.width + "x" + a.height
+
+' copies share the buffer
+b = a
+c = image(a)
+if (b.BID != a.BID || c.BID != a.BID) then throw "shared BID"
+
+' the buffer survives the variable that created it
+a = 0
+dim out
+b.save(out)
+if (ubound(out, 1) != 3 || ubound(out, 2) != 4) then throw "saved size"
+
+' images created inside a function
+func make_image(w, h)
+  local t = image(w, h)
+  return t
+end
+dim images
+for i = 1 to 50
+  images << make_image(i, 2)
+next
+if (images[49].width != 50) then throw "array of images"
+images = 0
+
+' an image created from a temporary image
+d = image(image(px))
+d.save(out)
+if (ubound(out, 2) != 4) then throw "temporary image"
+
+' paste into a blank image
+e = image(5, 4)
+e.paste(c, 0, 0)
+dim out2
+e.save(out2)
+if (out2(2, 3) != out(2, 3)) then throw "paste"
+
+' clip reduces the shared buffer
+c.clip(1, 1, 1, 1)
+if (c.width != 3 || c.height != 2) then throw "clip"
+
+' native filters
+f = image(px)
+f.resize(10, 6)
+if (f.width != 10 || f.height != 6) then throw "resize"
+f.rotate(90)
+if (f.width != 6 || f.height != 10) then throw "rotate"
+
+g = image(px)
+g.rotate(180)
+g.save(out)
+if (out(0, 0) != 0xff1e2805) then throw "rotate 180"
+
+' filters leave a flat image unchanged
+dim fp(19, 19)
+for y = 0 to 19
+  for x = 0 to 19
+    fp(y, x) = rgb(0x33, 0x66, 0x99)
+  next
+next
+flat = image(fp)
+flat.blur(3)
+flat.sharpen(2)
+k = [1,2,1;2,4,2;1,2,1]
+flat.convolve(k)
+flat.save(out)
+if (out(10, 10) != 0xff336699 || out(0, 19) != 0xff336699) then throw "flat"
+flat.edges()
+flat.save(out)
+if (out(5, 5) != 0xff000000) then throw "edges"
+
+' black and white either side of the level
+h = image(px)
+h.threshold(20)
+h.save(out)
+if (out(0, 0) != 0xff000000 || out(3, 4) != 0xffffffff) then throw "threshold"
+
+' inverting lookup table
+h = image(px)
+t = []
+for i = 0 to 255
+  t << 255 - i
+next
+h.lut(t)
+h.save(out)
+if (out(1, 2) != 0xfff5ebfa) then throw "lut"
+
+' swap red and blue
+m = [0,0,1,0; 0,1,0,0; 1,0,0,0]
+h = image(px)
+h.colorMatrix(m)
+h.save(out)
+if (out(3, 1) != 0xff050a1e) then throw "colorMatrix"
+
+' callback with a row of pixels
+func clear_row(x)
+  local i
+  for i = 0 to len(x) - 1
+    x[i] = 0xff010203
+  next
+  return x
+end
+h.filterRows(use clear_row(x))
+h.save(out)
+if (out(3, 4) != 0xff010203) then throw "filterRows"
+
+print "done"
@@ -0,0 +1,35 @@
+'
+' run limits, tested with --limit=ops=100000,heap=1M,stack=200
+'
+
+' memory held beyond the limit
+try
+  dim a(100000)
+  for i = 1 to 20
+  next i
+  print "should never be printed"
+catch e
+  print e
+  a = 0
+end try
+
+' recursion deeper than the program stack limit
+func f(n)
+  f = f(n + 1)
+end
+
+try
+  f(0)
+  print "should never be printed"
+catch e
+  print e
+end try
+
+' the handler may finish after the command limit is reached
+try
+  while 1
+  wend
+catch "LIMIT"
+  print "caught command limit"
+end try
+print "done"
@@ -0,0 +1,34 @@
+rem constant expressions, folded by the -O optimiser, must give the same
+rem results as the executor
+
+? 1 + 2, 7 - 10, 2 * 3, 7 / 2, 7 \ 2, 7 % 3, -7 MOD 3, -7 MDL 3
+? 1.5 + 2, 2 - 0.25, 2 ^ 10, 2 ^ 0.5, (1 + 2) * 3, 2 * (3 + 4)
+? -5, -2.5, - (3), +4, ~5, NOT 0, NOT 7, -(-1)
+? "abc" + "def", "x" + ("y" + "z"), len("ab" + "cd")
+? 1 + 2 * 3 - 4 / 2, (2 + 3) ^ 2, 10 - 2 - 3
+? 1/3, 0.1 + 0.2, 7.5 \ 2, 7.9 % 2.5
+
+rem the folded value keeps the type
+? isnumber(2 + 3), isstring("a" + "b"), frac(7 / 2), int(7 \ 2)
+
+rem x^2 with a variable
+x = 3
+y = 1.5
+z = "4"
+? x ^ 2, y ^ 2, z ^ 2, -x ^ 2, (x + 1) ^ 2, x ^ 2 ^ 2
+
+rem not folded, the errors remain at runtime
+try
+  ? 1 / 0
+catch e
+  ? "caught division by zero"
+end try
+
+rem GOTO chains
+i = 0
+10 i = i + 1
+if i < 3 then goto 20
+goto 40
+20 goto 30
+30 goto 10
+40 ? "i="; i
@@ -0,0 +1,33 @@
+' the profiler reports each procedure with its declaration line and calls
+
+later(2)
+
+sub count_to(n)
+  local i, total
+  for i = 1 to n
+    total += i
+  next
+end
+
+func fib(n)
+  if n < 2 then
+    fib = n
+  else
+    fib = fib(n - 1) + fib(n - 2)
+  endif
+end
+
+sub outer
+  sub inner
+    count_to(3)
+  end
+  inner
+  inner
+end
+
+sub later(n)
+  count_to(n)
+end
+
+print fib(10)
+outer
@@ -0,0 +1,18 @@
+#!../../../src/platform/console/sbasic
+
+' This file (socket-server-client.bas) will be called by socket-server.bas
+' Shebang needs to link to correct sbasic file.
+
+open "SOCL:127.0.0.1:10001" as #1
+
+for i = 1 to 3
+  print #1, "hello " + i
+  lineinput #1, s
+  if s != "HELLO " + i then throw "unexpected reply: " + s
+next
+
+print #1, "big"
+lineinput #1, s
+if len(s) != 100000 then throw "unexpected reply length: " + len(s)
+
+close #1
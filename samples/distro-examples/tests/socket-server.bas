@@ -0,0 +1,45 @@
+' socket-server.bas listens with SSVR: and serves two clients at the same time
+' each client (socket-server-client.bas) sends lines which are echoed in upper case
+
+open "SSVR:10001" as #1
+
+' make socket-server-client.bas executable and start two clients
+chmod "../../../samples/distro-examples/tests/socket-server-client.bas", 0o777
+exec "../../../samples/distro-examples/tests/socket-server-client.bas"
+exec "../../../samples/distro-examples/tests/socket-server-client.bas"
+
+dim seen(256)
+connections = 0
+closed = 0
+lines = 0
+
+while closed < 2
+  ready = netwait(1, 10000)
+  if len(ready) == 0 then throw "NETWAIT: timeout"
+  for h in ready
+    if seen(h) == 0 then
+      seen(h) = 1
+      connections++
+    endif
+    while lof(h) > 0
+      lineinput #h, s
+      if s == "big" then
+        ' larger than the socket buffer, completed by the following netwait calls
+        print #h, string(100000, "x")
+      else
+        print #h, upper(s)
+      endif
+      lines++
+    wend
+    if eof(h) then
+      close #h
+      seen(h) = 0
+      closed++
+    endif
+  next
+wend
+
+close #1
+
+print "connections: "; connections
+print "lines: "; lines
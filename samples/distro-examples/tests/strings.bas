@@ -215,3 +215,53 @@ REM Bug: RTRIM trimed input string on the right side
 s1 = "   test   "
 s2 = rtrim(s1)
 if(s1 != "   test   ") then throw "err: RTRIM changed input string"
+
+REM STRBUILDER
+sb = strbuilder("a")
+for i = 1 to 1000
+  sb.append(",", i)
+next
+s1 = sb.toString()
+if (len(s1) != 3894) then throw "err: STRBUILDER length " + len(s1)
+if (left(s1, 6) != "a,1,2,") then throw "err: STRBUILDER " + left(s1, 6)
+if (right(s1, 9) != ",999,1000") then throw "err: STRBUILDER " + right(s1, 9)
+sb.append(1.5, "x")
+if (right(sb.toString(), 4) != "1.5x") then throw "err: STRBUILDER append number"
+sb = strbuilder()
+if (sb.toString() != "") then throw "err: STRBUILDER empty"
+
+REM TRANSLATE replacements at the start and end of the string
+if (translate("aXbXX", "X", "yy") != "ayybyyyy") then throw "err: TRANSLATE"
+if (translate("XaX", "x", "-", true) != "-a-") then throw "err: TRANSLATE ignore case"
+if (translate("abc", "", "-") != "abc") then throw "err: TRANSLATE empty"
+
+REM JOIN and map_to_str
+dim ar(2)
+ar(0) = "x": ar(1) = 2: ar(2) = [1, 2]
+join ar, "--", s1
+if (s1 != "x--2--[1,2]") then throw "err: JOIN " + s1
+m = {"a": 1, "b": "two"}
+if (str(m) != "{\"a\":1,\"b\":\"two\"}") then throw "err: map_to_str " + str(m)
+
+REM LIKE with compiled wildcard patterns
+if (("abc" like "a*") != 1) then throw "err: LIKE a*"
+if (("abc" like "*c") != 1) then throw "err: LIKE *c"
+if (("abc" like "*x*") != 0) then throw "err: LIKE *x*"
+if (("abc" like "a?c") != 1) then throw "err: LIKE a?c"
+if (("ac" like "a?c") != 0) then throw "err: LIKE a?c short"
+if (("b1" like "[a-c][0-9]") != 1) then throw "err: LIKE set"
+if (("d1" like "[!a-c]?") != 1) then throw "err: LIKE inverted set"
+if (("a1" like "[^a-c]?") != 0) then throw "err: LIKE inverted set match"
+if (("a*b" like "a\\*b") != 1) then throw "err: LIKE escape"
+if (("axb" like "a\\*b") != 0) then throw "err: LIKE escape literal"
+if (("aXbXc" like "*X*X*") != 1) then throw "err: LIKE backtrack"
+if (("aaab" like "*a*ab") != 1) then throw "err: LIKE backtrack repeat"
+if (("a" like "a**") != 0) then throw "err: LIKE trailing stars"
+if (("ab" like "a**") != 1) then throw "err: LIKE trailing stars text"
+if (("a" like "a*") != 1) then throw "err: LIKE trailing star"
+if (("abc" like "a[") != 0) then throw "err: LIKE bad pattern"
+n = 0
+for i = 1 to 1000
+  if ("line " + i + " error" like "*1?? err*") then n++
+next
+if (n != 100) then throw "err: LIKE loop " + n
@@ -0,0 +1,35 @@
+'
+' TIMER handlers run on their own deadlines, not the 50ms event poll
+'
+fast = 0
+sub on_fast
+  fast++
+end
+timer 10, on_fast
+
+t0 = ticks
+while ticks - t0 < 300
+  x = x + 1
+wend
+if (fast < 15) then throw "TIMER 10ms fired " + fast + " times"
+
+'
+' missed intervals are dropped by default, or run with policy 1
+'
+skipped = 0
+sub on_skip
+  skipped++
+end
+caught = 0
+sub on_catchup
+  caught++
+end
+timer 20, on_skip
+timer 20, on_catchup, 1
+delay 200
+t0 = ticks
+while ticks - t0 < 100
+  x = x + 1
+wend
+if (caught <= skipped + 3) then throw "TIMER catch-up " + caught + " skip " + skipped
+print "timers: ok"
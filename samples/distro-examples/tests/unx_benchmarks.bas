@@ -20,3 +20,23 @@ repeat:i=i+1:until i>=1000000
 et=ticks
 ? "REPEAT speed: "; ((et-st)/tickspersec); "sec "; round(1000000/((et-st)/tickspersec));" l/s"
 
+
+st=ticks
+i=0
+for j=1 to 1000000:i=i+1:next
+et=ticks
+? "INCREMENT speed: "; ((et-st)/tickspersec); "sec "; round(1000000/((et-st)/tickspersec));" l/s"
+
+st=ticks
+dim a(1000)
+for j=1 to 1000000:k=j mod 1000:a(k)=j:next
+et=ticks
+? "ARRAY STORE speed: "; ((et-st)/tickspersec); "sec "; round(1000000/((et-st)/tickspersec));" l/s"
+
+st=ticks
+n=500000
+for j=1 to 1000000
+  if j < n then k=1 else k=2
+next
+et=ticks
+? "IF COMPARE speed: "; ((et-st)/tickspersec); "sec "; round(1000000/((et-st)/tickspersec));" l/s"
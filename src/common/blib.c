@@ -11,10 +11,12 @@
 #include "common/pproc.h"
 #include "common/fmt.h"
 #include "common/keymap.h"
+#include "common/profile.h"
 #include "common/messages.h"
 
 #define STR_INIT_SIZE 256
 #define PKG_INIT_SIZE 5
+#define FOR_FLAG_INT 2
 
 /**
  * LET v[(x)] = any
@@ -54,6 +56,73 @@ void cmd_let_opt() {
   }
 }
 
+/**
+ * v = v + int, see comp_optimise_let_inc()
+ *
+ * [VAR v][CMPOPR =][VAR v][EVPUSH][INT n][EVPOP][ADDOPR +|-]
+ */
+void cmd_let_inc() {
+  var_t *var_p = tvar[code_peekaddr(prog_ip + 1)];
+  if (var_p->type == V_INT && !var_p->const_flag) {
+    bcip_t ip = prog_ip + (1 + ADDRSZ) + 2 + (1 + ADDRSZ) + 1;
+    var_int_t value;
+    memcpy(&value, prog_source + ip + 1, OS_INTSZ);
+    ip += 1 + OS_INTSZ + 1;
+    if (prog_source[ip + 1] == '+') {
+      var_p->v.i += value;
+    } else {
+      var_p->v.i -= value;
+    }
+    prog_ip = ip + 2;
+  } else {
+    cmd_let(0);
+  }
+}
+
+/**
+ * v(index) = any, see comp_optimise_let_elem()
+ *
+ * [VAR v][LEVEL_BEGIN][VAR i|INT n][LEVEL_END][CMPOPR =] expr
+ */
+void cmd_let_elem() {
+  var_t *array_p = tvar[code_peekaddr(prog_ip + 1)];
+  var_t *elem_p = NULL;
+  bcip_t ip = prog_ip + (1 + ADDRSZ) + 1;
+  var_int_t index = 0;
+  int is_int = 0;
+
+  if (prog_source[ip] == kwTYPE_INT) {
+    memcpy(&index, prog_source + ip + 1, OS_INTSZ);
+    ip += 1 + OS_INTSZ;
+    is_int = 1;
+  } else {
+    var_t *index_p = tvar[code_peekaddr(ip + 1)];
+    ip += 1 + ADDRSZ;
+    if (index_p->type == V_INT) {
+      index = index_p->v.i;
+      is_int = 1;
+    }
+  }
+  if (is_int && array_p->type == V_ARRAY && v_maxdim(array_p) == 1) {
+    index -= v_lbound(array_p, 0);
+    if (index >= 0 && index < v_asize(array_p)) {
+      elem_p = v_elem(array_p, index);
+    }
+  }
+  if (elem_p != NULL && !elem_p->const_flag) {
+    // skip kwTYPE_LEVEL_END + kwTYPE_CMPOPR + "="
+    prog_ip = ip + 3;
+    var_t v_right;
+    v_init(&v_right);
+    eval(&v_right);
+    v_move(elem_p, &v_right);
+    elem_p->const_flag = 0;
+  } else {
+    // bounds, type and other errors
+    cmd_let(0);
+  }
+}
+
 void cmd_packed_let() {
   if (code_peek() != kwTYPE_LEVEL_BEGIN) {
     err_missing_comma();
@@ -617,6 +686,9 @@ void cmd_print(int output) {
   if (last_op == 0) {
     pv_write(output == PV_FILE ? OS_LINESEPARATOR : "\n", output, handle);
   }
+  if (output == PV_STRING) {
+    v_strshrink((var_t *)handle);
+  }
 }
 
 /**
@@ -1037,6 +1109,9 @@ bcip_t cmd_push_args(int cmd, bcip_t goto_addr, bcip_t rvid) {
     tvar[rvid] = v_new();    // create a temporary variable to store the function's result
                              // value will be restored on udp-return
   }
+  if (opt_profile) {
+    profile_enter(goto_addr);
+  }
   return goto_addr;
 }
 
@@ -1287,6 +1362,10 @@ void cmd_udpret() {
 
   // jump to caller's next address
   prog_ip = ncall.x.vcall.ret_ip;
+
+  if (opt_profile) {
+    profile_return();
+  }
 }
 
 /**
@@ -1425,6 +1504,62 @@ void cmd_if() {
   v_free(&var);
 }
 
+/**
+ * IF v <cmp> v|int, see comp_optimise_if()
+ *
+ * [true-ip][false-ip][VAR v][EVPUSH][VAR v|INT n][EVPOP][CMPOPR op]
+ */
+void cmd_if_cmp() {
+  bcip_t ip = prog_ip + BC_CTRLSZ;
+  var_t *left = tvar[code_peekaddr(ip + 1)];
+  var_t *right;
+  var_t value;
+
+  ip += (1 + ADDRSZ) + 1;
+  if (prog_source[ip] == kwTYPE_INT) {
+    value.type = V_INT;
+    memcpy(&value.v.i, prog_source + ip + 1, OS_INTSZ);
+    right = &value;
+    ip += 1 + OS_INTSZ;
+  } else {
+    right = tvar[code_peekaddr(ip + 1)];
+    ip += 1 + ADDRSZ;
+  }
+
+  if ((left->type == V_INT || left->type == V_NUM) &&
+      (right->type == V_INT || right->type == V_NUM)) {
+    int cmp = v_compare(left, right);
+    int lcond;
+    switch (prog_source[ip + 2]) {
+    case OPLOG_EQ:
+      lcond = (cmp == 0);
+      break;
+    case OPLOG_GT:
+      lcond = (cmp > 0);
+      break;
+    case OPLOG_GE:
+      lcond = (cmp >= 0);
+      break;
+    case OPLOG_LT:
+      lcond = (cmp < 0);
+      break;
+    case OPLOG_LE:
+      lcond = (cmp <= 0);
+      break;
+    default:
+      lcond = (cmp != 0);
+      break;
+    }
+    bcip_t true_ip = code_getaddr();
+    bcip_t false_ip = code_getaddr();
+    stknode_t *node = code_push(kwIF);
+    node->x.vif.lcond = lcond;
+    code_jump(lcond ? true_ip : false_ip);
+  } else {
+    cmd_if();
+  }
+}
+
 /**
  * ELSE
  */
@@ -1597,6 +1732,42 @@ void cmd_for_in(bcip_t true_ip, bcip_t false_ip, var_p_t var_p) {
   }
 }
 
+//
+// whether the expression at ip is only an integer constant or a variable
+//
+int code_is_int_expr(bcip_t ip) {
+  switch (prog_source[ip]) {
+  case kwTYPE_INT:
+    ip += 1 + OS_INTSZ;
+    break;
+  case kwTYPE_VAR:
+    ip += 1 + ADDRSZ;
+    break;
+  default:
+    return 0;
+  }
+  code_t code = prog_source[ip];
+  return (code == kwSTEP || code == kwTYPE_EOC || code == kwTYPE_LINE);
+}
+
+//
+// returns the value of the code_is_int_expr() expression when it's an integer
+//
+int code_peek_int(bcip_t ip, var_int_t *value) {
+  int result = 1;
+  if (prog_source[ip] == kwTYPE_INT) {
+    memcpy(value, prog_source + ip + 1, OS_INTSZ);
+  } else {
+    var_t *var_p = tvar[code_peekaddr(ip + 1)];
+    if (var_p->type == V_INT) {
+      *value = var_p->v.i;
+    } else {
+      result = 0;
+    }
+  }
+  return result;
+}
+
 //
 // FOR v1=exp1 TO exp2 [STEP exp3]
 //
@@ -1613,6 +1784,7 @@ void cmd_for_to(bcip_t true_ip, bcip_t false_ip, var_p_t var_p) {
   node.x.vfor.exit_ip = false_ip + ADDRSZ + ADDRSZ + 1;
   node.x.vfor.jump_ip = true_ip;
   node.x.vfor.var_ptr = var_p;
+  node.x.vfor.flags = 0;
 
   // get the first expression
   eval(&var);
@@ -1627,6 +1799,9 @@ void cmd_for_to(bcip_t true_ip, bcip_t false_ip, var_p_t var_p) {
       // get TO-expression
       //
       node.x.vfor.to_expr_ip = prog_ip;
+      if (code_is_int_expr(prog_ip)) {
+        node.x.vfor.flags = FOR_FLAG_INT;
+      }
       v_init(&var);
       eval(&var);
 
@@ -1638,6 +1813,9 @@ void cmd_for_to(bcip_t true_ip, bcip_t false_ip, var_p_t var_p) {
         if (code == kwSTEP) {
           code_skipnext();
           node.x.vfor.step_expr_ip = prog_ip;
+          if (!code_is_int_expr(prog_ip)) {
+            node.x.vfor.flags = 0;
+          }
           eval(&varstep);
           if (!(varstep.type == V_NUM || varstep.type == V_INT)) {
             if (!prog_error) {
@@ -1847,39 +2025,56 @@ void cmd_next_for_to(stknode_t *node, bcip_t next_ip) {
   bcip_t jump_ip = node->x.vfor.jump_ip;
   var_t *var_p = node->x.vfor.var_ptr;
 
-  prog_ip = node->x.vfor.to_expr_ip;
-  v_init(&var_to);
-  eval(&var_to);
-
-  if (!prog_error && (var_to.type == V_INT || var_to.type == V_NUM)) {
-    // get step val
-    var_t var_step;
-    var_step.const_flag = 0;
-    var_step.type = V_INT;
-    var_step.v.i = 1;
-
-    if (node->x.vfor.step_expr_ip != INVALID_ADDR) {
-      prog_ip = node->x.vfor.step_expr_ip;
-      eval(&var_step);
+  var_int_t to;
+  var_int_t step = 1;
+  if ((node->x.vfor.flags & FOR_FLAG_INT) && var_p->type == V_INT &&
+      code_peek_int(node->x.vfor.to_expr_ip, &to) &&
+      (node->x.vfor.step_expr_ip == INVALID_ADDR ||
+       code_peek_int(node->x.vfor.step_expr_ip, &step))) {
+    // integer counter, see cmd_for_to()
+    v_init(&var_to);
+    var_to.v.i = to;
+    var_p->v.i += step;
+    if (step < 0) {
+      check = (v_compare(var_p, &var_to) >= 0);
+    } else {
+      check = (v_compare(var_p, &var_to) <= 0);
     }
+  } else {
+    prog_ip = node->x.vfor.to_expr_ip;
+    v_init(&var_to);
+    eval(&var_to);
+
+    if (!prog_error && (var_to.type == V_INT || var_to.type == V_NUM)) {
+      // get step val
+      var_t var_step;
+      var_step.const_flag = 0;
+      var_step.type = V_INT;
+      var_step.v.i = 1;
+
+      if (node->x.vfor.step_expr_ip != INVALID_ADDR) {
+        prog_ip = node->x.vfor.step_expr_ip;
+        eval(&var_step);
+      }
 
-    if (!prog_error && (var_step.type == V_INT || var_step.type == V_NUM)) {
-      v_inc(var_p, &var_step);
-      if (v_sign(&var_step) < 0) {
-        check = (v_compare(var_p, &var_to) >= 0);
+      if (!prog_error && (var_step.type == V_INT || var_step.type == V_NUM)) {
+        v_inc(var_p, &var_step);
+        if (v_sign(&var_step) < 0) {
+          check = (v_compare(var_p, &var_to) >= 0);
+        } else {
+          check = (v_compare(var_p, &var_to) <= 0);
+        }
       } else {
-        check = (v_compare(var_p, &var_to) <= 0);
+        if (!prog_error) {
+          err_typemismatch();
+        }
       }
+      v_free(&var_step);
     } else {
       if (!prog_error) {
-        err_typemismatch();
+        rt_raise("FOR-TO: TO v IS NOT A NUMBER");
       }
     }
-    v_free(&var_step);
-  } else {
-    if (!prog_error) {
-      rt_raise("FOR-TO: TO v IS NOT A NUMBER");
-    }
   }
 
   //
@@ -2307,44 +2502,25 @@ void cmd_wjoin() {
   }
 
   var_t *str = code_getvarptr();
-  int size = STR_INIT_SIZE;
-  int len = 0;
   int del_len = v_strlen(&del);
-  int i;
 
   v_free(str);
-  str->type = V_STR;
-  str->v.p.ptr = malloc(size);
-  str->v.p.owner = 1;
-  str->v.p.ptr[0] = '\0';
+  v_init_str(str, 0);
 
-  for (i = 0; i < v_asize(var_p); i++) {
+  for (int i = 0; i < v_asize(var_p); i++) {
     var_t *elem_p = v_elem(var_p, i);
-    var_t e_str;
-
-    v_init(&e_str);
-    v_set(&e_str, elem_p);
-    if (e_str.type != V_STR) {
-      v_tostr(&e_str);
-    }
-
-    int el_len = v_strlen(&e_str);
-    if (el_len + del_len + 1 >= (size - len)) {
-      size += el_len + del_len + STR_INIT_SIZE;
-      str->v.p.ptr = realloc(str->v.p.ptr, size);
+    if (elem_p->type == V_STR) {
+      v_strappend(str, elem_p->v.p.ptr, v_strlen(elem_p));
+    } else {
+      char *value = v_str(elem_p);
+      v_strappend(str, value, strlen(value));
+      free(value);
     }
-
-    len += el_len;
-    strcat(str->v.p.ptr, e_str.v.p.ptr);
-    v_free(&e_str);
-
-    if (i != var_p->v.p.length - 1) {
-      strcat(str->v.p.ptr, del.v.p.ptr);
-      len += del_len;
+    if (i != v_asize(var_p) - 1) {
+      v_strappend(str, del.v.p.ptr, del_len);
     }
   }
-
-  str->v.p.length = len;
+  v_strshrink(str);
 
   // cleanup
   v_free(&del);
@@ -2510,7 +2686,7 @@ int sb_qcmp(var_t *a, var_t *b, bcip_t use_ip) {
 }
 
 // using C's qsort()
-static bcip_t static_qsort_last_use_ip;
+static SB_THREAD bcip_t static_qsort_last_use_ip;
 
 int qs_cmp(const void *a, const void *b) {
   var_t *ea = (var_t *)a;
@@ -2890,6 +3066,8 @@ void cmd_call_vfunc() {
 
 /**
  * Adds a timer
+ *
+ * TIMER interval, handler [, policy]
  */
 void cmd_timer() {
   var_t var;
@@ -2900,10 +3078,21 @@ void cmd_timer() {
   if (!prog_error) {
     par_getcomma();
     if (code_peek() != kwTYPE_CALL_UDF) {
-      err_syntax(kwTIMER, "%F,%G");
+      err_syntax(kwTIMER, "%F,%G[,%I]");
     } else {
-      timer_add(interval, prog_ip);
+      bcip_t ip = prog_ip;
+      int policy = TIMER_SKIP;
       prog_ip += BC_CTRLSZ + 1;
+      if (code_peek() == kwTYPE_SEP) {
+        par_getcomma();
+        policy = par_getint();
+        if (!prog_error && (policy < TIMER_SKIP || policy > TIMER_DELAY)) {
+          err_syntax(kwTIMER, "%F,%G[,%I]");
+        }
+      }
+      if (!prog_error) {
+        timer_add(interval, ip, policy);
+      }
     }
   }
   v_free(&var);
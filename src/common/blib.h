@@ -33,6 +33,8 @@ void cmd_param(void);
 int cmd_exit(void);
 void cmd_let(int);
 void cmd_let_opt();
+void cmd_let_inc();
+void cmd_let_elem();
 void cmd_packed_let();
 void cmd_dim(int);
 void cmd_redim(void);
@@ -44,6 +46,7 @@ void cmd_print(int output);
 void logprint_var(var_t *var);
 void cmd_input(int input);
 void cmd_if(void);
+void cmd_if_cmp(void);
 void cmd_else(void);
 void cmd_elif(void);
 void cmd_endif(void);
@@ -166,6 +169,8 @@ void cmd_dirwalk(void);
 void cmd_bputc(void);
 void cmd_bload(void);
 void cmd_bsave(void);
+void cmd_csvread(void);
+void cmd_csvwrite(void);
 void cmd_definekey(void);
 
 /**
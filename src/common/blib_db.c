@@ -15,12 +15,15 @@
 #include "common/blib.h"
 #include "common/messages.h"
 #include "common/fs_socket_client.h"
+#include "common/hashmap.h"
 
 #include <dirent.h>
+#include <errno.h>
 
 #define LDLN_INC    256
 #define GROW_SIZE   1024
 #define BUFMAX      256
+#define CSV_BUFSIZE 8192
 #define CHK_ERR_CLEANUP(s) if (err_handle_error(s, &file_name)) return;
 #define CHK_ERR(s) if (err_handle_error(s, NULL)) return;
 
@@ -413,6 +416,389 @@ void cmd_flineinput() {
   }
 }
 
+//
+// buffered input for CSVREAD. streams are read in blocks and the file
+// position is restored to the end of the record. the block is kept on the
+// input file for the next record, other devices are read a byte at a time
+//
+typedef struct csv_input_t {
+  byte buffer[CSV_BUFSIZE];
+  int handle;
+  int seekable;
+  uint32_t base;
+  uint32_t end;
+  int len;
+  int pos;
+  int pushback;
+} csv_input_t;
+
+//
+// returns the next byte from the input or -1 at the end of the file
+//
+static int csv_getc(csv_input_t *in) {
+  int result = -1;
+  if (in->pushback != -1) {
+    result = in->pushback;
+    in->pushback = -1;
+  } else if (in->seekable) {
+    uint32_t offset = in->base + in->len;
+    if (in->pos == in->len && offset < in->end) {
+      in->base = offset;
+      in->len = in->end - offset < CSV_BUFSIZE ? in->end - offset : CSV_BUFSIZE;
+      in->pos = 0;
+      if (!dev_fread(in->handle, in->buffer, in->len)) {
+        in->len = 0;
+        in->end = offset;
+      }
+    }
+    if (in->pos < in->len) {
+      result = in->buffer[in->pos++];
+    }
+  } else if (!dev_feof(in->handle)) {
+    byte ch;
+    if (dev_fread(in->handle, &ch, 1)) {
+      result = ch;
+    }
+  }
+  return result;
+}
+
+//
+// returns the input for the file, reusing the block read by the previous
+// record when the file is still positioned where that record ended
+//
+static csv_input_t *csv_get_input(int handle) {
+  dev_file_t *f = dev_getfileptr(handle);
+  csv_input_t *in = f->read_buf;
+  if (in == NULL) {
+    in = malloc(sizeof(csv_input_t));
+    in->handle = handle;
+    in->seekable = (f->type == ft_stream);
+    in->base = 0;
+    in->len = in->pos = 0;
+    if (in->seekable && f->open_flags == DEV_FILE_INPUT) {
+      // the file can't change underneath the buffer
+      f->read_buf = in;
+    }
+  }
+  in->pushback = -1;
+  if (in->seekable) {
+    uint32_t start = dev_ftell(handle);
+    if (start != in->base + in->pos) {
+      in->base = start;
+      in->len = in->pos = 0;
+    }
+    in->end = dev_flength(handle);
+  }
+  return in;
+}
+
+//
+// returns whether the unquoted field is read as a number
+//
+static int csv_is_number(const char *field, int len, var_t *var) {
+  int numeric = len > 0;
+  int integer = numeric;
+  for (int i = 0; numeric && i < len; i++) {
+    char ch = field[i];
+    if (ch == '.' || ch == 'e' || ch == 'E') {
+      integer = 0;
+    } else if (!isdigit((unsigned char)ch) && ((ch != '-' && ch != '+') ||
+               (i != 0 && field[i - 1] != 'e' && field[i - 1] != 'E'))) {
+      numeric = 0;
+    }
+  }
+  if (numeric) {
+    char *end;
+    errno = 0;
+    if (integer) {
+      var_int_t n = strtoll(field, &end, 10);
+      numeric = (end == field + len && errno == 0);
+      if (numeric && var != NULL) {
+        v_setint(var, n);
+      }
+    } else {
+      var_num_t n = strtod(field, &end);
+      numeric = (end == field + len);
+      if (numeric && var != NULL) {
+        v_setreal(var, n);
+      }
+    }
+  }
+  return numeric;
+}
+
+//
+// stores the field value, unquoted numeric fields become V_INT or V_NUM
+//
+static void csv_set_field(var_t *var, const char *field, int len, int quoted) {
+  if (quoted || !csv_is_number(field, len, var)) {
+    v_setstrn(var, field, len);
+  }
+}
+
+//
+// adds the next field to the row
+//
+static void csv_add_field(var_t *row, var_t *header, cstr *field, int quoted, int index) {
+  var_t *elem;
+  if (row->type == V_MAP) {
+    if (index < v_asize(header)) {
+      var_t *key = v_elem(header, index);
+      if (key->type == V_STR) {
+        elem = map_add_var(row, key->v.p.ptr, 0);
+      } else {
+        char *name = v_str(key);
+        elem = map_add_var(row, name, 0);
+        free(name);
+      }
+    } else {
+      // more fields than column names
+      char name[BUFMAX];
+      sprintf(name, "%d", index);
+      elem = map_add_var(row, name, 0);
+    }
+  } else {
+    v_resize_array(row, index + 1);
+    elem = v_elem(row, index);
+  }
+  csv_set_field(elem, field->buf, field->length, quoted);
+  field->length = 0;
+  field->buf[0] = '\0';
+}
+
+//
+// reads a RFC 4180 record into the row
+//
+static void csv_read_row(int handle, var_t *row, var_t *header) {
+  csv_input_t *in = csv_get_input(handle);
+  cstr field;
+  int ch = -1;
+  int quoted = 0;
+  int in_quotes = 0;
+  int fields = 0;
+
+  v_free(row);
+  if (header != NULL) {
+    map_init(row);
+  } else {
+    v_toarray1(row, 0);
+  }
+
+  cstr_init(&field, BUFMAX);
+  while (!prog_error && (ch = csv_getc(in)) != -1) {
+    if (in_quotes) {
+      if (ch == '"') {
+        int next = csv_getc(in);
+        if (next == '"') {
+          cstr_append_i(&field, "\"", 1);
+        } else {
+          in_quotes = 0;
+          if (next == -1) {
+            break;
+          }
+          ch = next;
+        }
+      } else {
+        char c = ch;
+        cstr_append_i(&field, &c, 1);
+      }
+      if (in_quotes) {
+        continue;
+      }
+    }
+    if (ch == ',') {
+      csv_add_field(row, header, &field, quoted, fields++);
+      quoted = 0;
+    } else if (ch == '\n') {
+      break;
+    } else if (ch == '\r') {
+      int next = csv_getc(in);
+      if (next == '\n') {
+        ch = next;
+        break;
+      }
+      in->pushback = next;
+      cstr_append_i(&field, "\r", 1);
+    } else if (ch == '"' && field.length == 0 && !quoted) {
+      quoted = in_quotes = 1;
+    } else if (ch != '"' || !quoted) {
+      char c = ch;
+      cstr_append_i(&field, &c, 1);
+    }
+  }
+
+  if (fields || field.length || quoted || ch == '\n') {
+    csv_add_field(row, header, &field, quoted, fields);
+  }
+  if (in->seekable && !prog_error) {
+    dev_fseek(handle, in->base + in->pos);
+  }
+  free(field.buf);
+  if (dev_getfileptr(handle)->read_buf != in) {
+    free(in);
+  }
+}
+
+//
+// returns the variable or expression argument
+//
+static var_t *csv_get_arg(var_t *value) {
+  var_t *result;
+  if (code_isvar()) {
+    result = par_getvar_ptr();
+  } else {
+    eval(value);
+    result = value;
+  }
+  return result;
+}
+
+//
+// returns the optional column names argument
+//
+static var_t *csv_get_header(var_t *value) {
+  var_t *result = NULL;
+  if (!prog_error && code_peek() == kwTYPE_SEP) {
+    par_getcomma();
+    if (!prog_error) {
+      result = csv_get_arg(value);
+      if (!prog_error && result->type != V_ARRAY) {
+        err_varisnotarray();
+      }
+    }
+  }
+  return result;
+}
+
+/*
+ * CSVREAD #fileN, row [, header]
+ */
+void cmd_csvread() {
+  par_getsharp();
+  if (!prog_error) {
+    int handle = par_getint();
+    if (!prog_error) {
+      par_getsep();
+      if (!prog_error) {
+        if (dev_fstatus(handle)) {
+          var_t value;
+          v_init(&value);
+          var_t *row = par_getvar_ptr();
+          var_t *header = csv_get_header(&value);
+          if (!prog_error) {
+            csv_read_row(handle, row, header);
+          }
+          v_free(&value);
+        } else {
+          rt_raise(ERR_FILE_NOT_OPEN);
+        }
+      }
+    }
+  }
+}
+
+//
+// appends the value to the record, quoting as required
+//
+static void csv_write_field(cstr *record, var_t *var, int index) {
+  if (index) {
+    cstr_append_i(record, ",", 1);
+  }
+  if (var == NULL) {
+    return;
+  } else if (var->type == V_STR) {
+    const char *str = var->v.p.ptr;
+    int len = v_strlen(var);
+    if (strpbrk(str, ",\"\r\n") != NULL || (len && (str[0] == ' ' || str[len - 1] == ' ')) ||
+        csv_is_number(str, len, NULL)) {
+      cstr_append_i(record, "\"", 1);
+      for (const char *q = strchr(str, '"'); q != NULL; q = strchr(str, '"')) {
+        cstr_append_i(record, str, q - str + 1);
+        cstr_append_i(record, "\"", 1);
+        str = q + 1;
+      }
+      cstr_append(record, str);
+      cstr_append_i(record, "\"", 1);
+    } else {
+      cstr_append_i(record, str, len);
+    }
+  } else {
+    var_t tmp;
+    v_init(&tmp);
+    v_set(&tmp, var);
+    v_tostr(&tmp);
+    if (var->type == V_INT || var->type == V_NUM) {
+      // numbers are written unquoted, to be read back as numbers
+      cstr_append_i(record, tmp.v.p.ptr, v_strlen(&tmp));
+    } else {
+      csv_write_field(record, &tmp, 0);
+    }
+    v_free(&tmp);
+  }
+}
+
+//
+// hashmap_foreach callback for CSVWRITE
+//
+static int csv_write_cb(hashmap_cb *cb, var_p_t key, var_p_t value) {
+  csv_write_field(cb->str, value, cb->index++);
+  return 0;
+}
+
+/*
+ * CSVWRITE #fileN, row [, header]
+ */
+void cmd_csvwrite() {
+  par_getsharp();
+  if (!prog_error) {
+    int handle = par_getint();
+    if (!prog_error) {
+      par_getsep();
+      if (!prog_error) {
+        if (dev_fstatus(handle)) {
+          var_t value, names;
+          v_init(&value);
+          v_init(&names);
+          var_t *row = csv_get_arg(&value);
+          var_t *header = csv_get_header(&names);
+          if (!prog_error) {
+            cstr record;
+            cstr_init(&record, BUFMAX);
+            if (row->type == V_MAP && header != NULL) {
+              // values in the order of the column names
+              for (int i = 0; i < v_asize(header); i++) {
+                var_t *key = v_elem(header, i);
+                char *name = v_str(key);
+                csv_write_field(&record, map_get(row, name), i);
+                free(name);
+              }
+            } else if (row->type == V_MAP) {
+              hashmap_cb cb;
+              cb.str = &record;
+              cb.index = 0;
+              hashmap_foreach(row, csv_write_cb, &cb);
+            } else if (row->type == V_ARRAY) {
+              for (int i = 0; i < v_asize(row); i++) {
+                csv_write_field(&record, v_elem(row, i), i);
+              }
+            } else {
+              csv_write_field(&record, row, 0);
+            }
+            cstr_append(&record, OS_LINESEPARATOR);
+            dev_fwrite(handle, (byte *)record.buf, record.length);
+            free(record.buf);
+          }
+          v_free(&value);
+          v_free(&names);
+        } else {
+          rt_raise(ERR_FILE_NOT_OPEN);
+        }
+      }
+    }
+  }
+}
+
 /*
  * KILL filename
  */
@@ -19,10 +19,12 @@
 #include "common/geom.h"
 #include "common/messages.h"
 #include "common/keymap.h"
+#include "common/fs_socket_server.h"
+#include "common/dirscan.h"
 
 // relative coordinates (current x/y) from blib_graph
-extern int gra_x;
-extern int gra_y;
+extern SB_THREAD int gra_x;
+extern SB_THREAD int gra_y;
 
 // date
 static char *date_wd3_table[] = TABLE_WEEKDAYS_3C;
@@ -33,6 +35,67 @@ static char *date_mN_table[] = TABLE_MONTH_FULL;
 #define BUF_LEN 64
 #define BIN_LEN 32  // Number of max bits (digits) kwBIN creates
 
+#define STRBUILDER_BUFFER "buffer"
+
+/*
+ * builder.append(value [, value ...])
+ */
+void cmd_strbuilder_append(var_t *self, var_t *retval) {
+  var_t *buffer = map_get(self, STRBUILDER_BUFFER);
+  if (buffer == NULL) {
+    buffer = map_add_var(self, STRBUILDER_BUFFER, 0);
+    v_setstr(buffer, "");
+  }
+  do {
+    var_t arg;
+    v_init(&arg);
+    eval(&arg);
+    if (!prog_error) {
+      if (arg.type == V_STR) {
+        v_strappend(buffer, arg.v.p.ptr, v_strlen(&arg));
+      } else {
+        char *value = v_str(&arg);
+        v_strappend(buffer, value, strlen(value));
+        free(value);
+      }
+    }
+    v_free(&arg);
+    if (code_peek() == kwTYPE_SEP) {
+      par_getcomma();
+    } else {
+      break;
+    }
+  } while (!prog_error);
+}
+
+/*
+ * s = builder.toString()
+ */
+void cmd_strbuilder_tostring(var_t *self, var_t *retval) {
+  var_t *buffer = map_get(self, STRBUILDER_BUFFER);
+  if (retval != NULL) {
+    if (buffer != NULL && buffer->type == V_STR && buffer->v.p.ptr != NULL) {
+      v_setstrn(retval, buffer->v.p.ptr, v_strlen(buffer));
+    } else {
+      v_setstr(retval, "");
+    }
+  }
+}
+
+/*
+ * builder = STRBUILDER([value])
+ */
+void v_create_strbuilder(var_p_t var) {
+  map_init(var);
+  var_t *buffer = map_add_var(var, STRBUILDER_BUFFER, 0);
+  v_setstr(buffer, "");
+  if (code_peek() != kwTYPE_LEVEL_END) {
+    cmd_strbuilder_append(var, NULL);
+  }
+  v_create_func(var, "append", cmd_strbuilder_append);
+  v_create_func(var, "toString", cmd_strbuilder_tostring);
+}
+
 /*
  * Clamp floating point number and convert to integer
  * x: number, l: lower bound, h: upper bound
@@ -2944,6 +3007,45 @@ void cmd_genfunc(long funcCode, var_t *r) {
     v_create_window(r);
     break;
 
+  case kwSTRBUILDER:
+    v_create_strbuilder(r);
+    break;
+
+    //
+    // array <- DIRSCAN(dir [, wildcards [, cache]])
+    //
+  case kwDIRSCAN: {
+    char *dir = NULL, *wc = NULL;
+    var_int_t use_cache = 0;
+    par_massget("Ssi", &dir, &wc, &use_cache);
+    if (!prog_error) {
+      if (!opt_file_permitted) {
+        rt_raise(ERR_FILE_PERM);
+      } else {
+        dirscan(dir, wc, use_cache, r);
+      }
+    }
+    pfree2(dir, wc);
+  }
+    break;
+
+    //
+    // array <- NETWAIT(fileN [, timeout])
+    //
+  case kwNETWAIT: {
+    int timeout = -1;
+    handle = par_getint();
+    IF_ERR_RETURN;
+    if (code_peek() == kwTYPE_SEP) {
+      par_getcomma();
+      IF_ERR_RETURN;
+      timeout = par_getint();
+      IF_ERR_RETURN;
+    }
+    socksv_wait(handle, timeout, r);
+  }
+    break;
+
   default:
     rt_raise("Unsupported built-in function call %ld", funcCode);
   };
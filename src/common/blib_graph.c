@@ -11,8 +11,8 @@
 #include "common/messages.h"
 
 // graphics - relative coordinates
-int gra_x;
-int gra_y;
+SB_THREAD int gra_x;
+SB_THREAD int gra_y;
 
 void graph_reset() {
   gra_x = gra_y = 0;
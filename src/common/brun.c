@@ -25,19 +25,95 @@
 #include "common/device.h"
 #include "common/pproc.h"
 #include "common/keymap.h"
+#include "common/profile.h"
+#include "common/stats.h"
+#include "common/sbapp.h"
 
 int brun_create_task(const char *filename, byte *preloaded_bc, int libf);
 int exec_close_task();
 void sys_before_comp();
 
-static char fileName[OS_FILENAME_SIZE + 1];
-static stknode_t err_node;
+static SB_THREAD char fileName[OS_FILENAME_SIZE + 1];
+static SB_THREAD stknode_t err_node;
+
+// the resources used by the current run, see opt_max_ops etc
+typedef struct limits_s {
+  uint64_t ops;
+  uint64_t max_ops;
+  uint64_t max_heap;
+  uint32_t max_stack;
+  uint32_t max_time;
+  uint32_t start;
+  byte ops_exceeded;
+  byte heap_exceeded;
+  byte stack_exceeded;
+  byte time_exceeded;
+} limits_t;
+
+static SB_THREAD limits_t limits = {0, 0, UINT64_MAX};
 
 #define EVT_CHECK_EVERY 50
+
+// resources given to a CATCH handling a LIMIT error
+#define LIMIT_GRACE_OPS 1024
+#define LIMIT_GRACE_TIME 100
+#define LIMIT_GRACE_STACK 32
+#define LIMIT_GRACE_HEAP(max) ((max) / 8)
+
+// readable bytes following the loaded bytecode
+#define BC_PAD_SIZE 4
+
+// whether a table in the bytecode can be used without copying
+#define BC_ALIGNED(p) (((uintptr_t)(p) & (sizeof(bcip_t) - 1)) == 0)
+
+// commands executed between checking the run limits
+#define EVT_CHECK_OPS 16
 #define IF_ERR_BREAK if (prog_error) { \
   if (prog_error == errThrow)       \
       prog_error = errNone; else break;}
 
+/**
+ * returns whether the table is used in place within the task's bytecode
+ */
+static int brun_in_image(const void *table) {
+  const byte *p = (const byte *)table;
+  return p >= ctask->bytecode && p < prog_source;
+}
+
+/**
+ * the first time a limit is exceeded the error may be caught, after which
+ * the handler is given a little more of the resource before the limit
+ * becomes fatal
+ */
+static void brun_limit_error(byte *exceeded, const char *err) {
+  if (*exceeded) {
+    rt_raise(err);
+  } else {
+    *exceeded = 1;
+    err_throw(err);
+  }
+}
+
+/**
+ * raises an error once the run has exceeded one of its limits
+ */
+static void brun_check_limits(uint32_t now, int ops) {
+  limits.ops += ops;
+  if (opt_max_ops && limits.ops > limits.max_ops) {
+    limits.max_ops = limits.ops + LIMIT_GRACE_OPS;
+    brun_limit_error(&limits.ops_exceeded, ERR_LIMIT_OPS);
+  } else if (opt_max_time && now - limits.start > limits.max_time) {
+    limits.max_time = now - limits.start + LIMIT_GRACE_TIME;
+    brun_limit_error(&limits.time_exceeded, ERR_LIMIT_TIME);
+  } else if (opt_max_heap && sb_stats.heap_bytes > limits.max_heap) {
+    limits.max_heap = sb_stats.heap_bytes + LIMIT_GRACE_HEAP(opt_max_heap);
+    brun_limit_error(&limits.heap_exceeded, ERR_LIMIT_HEAP);
+  } else if (opt_max_stack && prog_stack_count > limits.max_stack) {
+    limits.max_stack = prog_stack_count + LIMIT_GRACE_STACK;
+    brun_limit_error(&limits.stack_exceeded, ERR_LIMIT_STACK);
+  }
+}
+
 /**
  * jump to label
  */
@@ -57,6 +133,9 @@ stknode_t *code_push(code_t type) {
     result = &prog_stack[prog_stack_count++];
     result->type = type;
     result->line = prog_line;
+    if (prog_stack_count > sb_stats.prog_stack_max) {
+      sb_stats.prog_stack_max = prog_stack_count;
+    }
   }
   return result;
 }
@@ -643,6 +722,12 @@ static inline void bc_loop_call_proc() {
   case kwBLOAD:
     cmd_bload();
     break;
+  case kwCSVREAD:
+    cmd_csvread();
+    break;
+  case kwCSVWRITE:
+    cmd_csvwrite();
+    break;
   case kwEXPRSEQ:
     cmd_exprseq();
     break;
@@ -718,10 +803,13 @@ void bc_loop(int isf) {
   int i;
   int proc_level = 0;
   byte code = 0;
+  // the last dispatched code, not the trailing EOC or LINE
+  byte cmd = 0;
 
   // setup event checker time = 50ms
   uint32_t now = dev_get_millisecond_count();
   uint32_t next_check = now + EVT_CHECK_EVERY;
+  int ops = 0;
 
   /**
    * For commands that change the IP use
@@ -734,40 +822,63 @@ void bc_loop(int isf) {
   if (isf == 2) {
     proc_level++;
   }
+
+  // recursive calls may return before the next periodic check
+  if (!prog_error) {
+    brun_check_limits(now, 0);
+  }
+
   while (prog_ip < prog_length) {
-    switch (code) {
+    switch (cmd) {
     case kwLABEL:
     case kwREM:
     case kwTYPE_EOC:
     case kwTYPE_LINE:
       break;
     default:
+      // read the clock after each command, since any command can block
       now = dev_get_millisecond_count();
-      break;
-    }
 
-    // check events every ~50ms
-    if (now >= next_check) {
-      next_check = now + EVT_CHECK_EVERY;
+      // check events every ~50ms
+      if (now >= next_check) {
+        next_check = now + EVT_CHECK_EVERY;
 
-      switch (dev_events(0)) {
-      case -1:
-        // break event
-        break;
-      case -2:
-        prog_error = errBreak;
-        inf_break(prog_line);
-        break;
-      default:
-        if (prog_timer) {
-          timer_run(now);
+        switch (dev_events(0)) {
+        case -1:
+          // break event
+          break;
+        case -2:
+          prog_error = errBreak;
+          inf_break(prog_line);
+          break;
+        default:
+          break;
+        };
+      }
+
+      // timers are checked independently of the event poll
+      if (prog_timer && !prog_error && timer_due(now)) {
+        timer_run(now);
+      }
+      if (!prog_error) {
+        if (++ops == EVT_CHECK_OPS) {
+          ops = 0;
+          brun_check_limits(now, EVT_CHECK_OPS);
+        } else if (sb_stats.heap_bytes > limits.max_heap) {
+          // the heap is checked after every command
+          brun_check_limits(now, 0);
         }
-      };
+      }
+      break;
     }
 
     // proceed to the next command
     if (!prog_error) {
       code = prog_source[prog_ip++];
+      cmd = code;
+      if (opt_profile) {
+        profile_ops++;
+      }
       switch (code) {
       case kwLABEL:
       case kwREM:
@@ -778,6 +889,9 @@ void bc_loop(int isf) {
         if (opt_trace_on) {
           dev_trace_line(prog_line);
         }
+        if (opt_profile) {
+          profile_line(prog_line);
+        }
         continue;
       case kwLET:
         cmd_let(0);
@@ -785,6 +899,12 @@ void bc_loop(int isf) {
       case kwLET_OPT:
         cmd_let_opt();
         break;
+      case kwLET_INC:
+        cmd_let_inc();
+        break;
+      case kwLET_ELEM:
+        cmd_let_elem();
+        break;
       case kwCONST:
         cmd_let(1);
         break;
@@ -816,6 +936,10 @@ void bc_loop(int isf) {
         cmd_if();
         IF_ERR_BREAK;
         continue;
+      case kwIF_CMP:
+        cmd_if_cmp();
+        IF_ERR_BREAK;
+        continue;
       case kwELIF:
         cmd_elif();
         IF_ERR_BREAK;
@@ -926,6 +1050,7 @@ void bc_loop(int isf) {
         if (isf) {
           proc_level--;
           if (proc_level == 0) {
+            limits.ops += ops;
             return;
           }
         }
@@ -942,6 +1067,7 @@ void bc_loop(int isf) {
         if (isf && pops) {
           proc_level--;
           if (proc_level == 0) {
+            limits.ops += ops;
             return;
           }
         }
@@ -1037,6 +1163,9 @@ void bc_loop(int isf) {
         if (opt_trace_on) {
           dev_trace_line(prog_line);
         }
+        if (opt_profile) {
+          profile_line(prog_line);
+        }
       } else if (code != kwTYPE_EOC) {
         if (!opt_quiet) {
           hex_dump(prog_source, prog_length);
@@ -1052,6 +1181,7 @@ void bc_loop(int isf) {
     // quit on error
     IF_ERR_BREAK;
   }
+  limits.ops += ops;
 }
 
 /**
@@ -1104,6 +1234,7 @@ void brun_load_libraries(int tid) {
       prog_libtable[i].tid = lib_tid;
 
       // update lib-symbols's task-id field (in this code; not in lib's code)
+      int index = unit_export_index(lib_tid);
       for (int j = 0; j < prog_symcount; j++) {
         char *pname = strrchr(prog_symtable[j].symbol, '.') + 1;
         // the name without the 'class'
@@ -1111,14 +1242,11 @@ void brun_load_libraries(int tid) {
           // find symbol by name (for sure) and update it
           // this is required because lib may be newer than
           // parent
-          for (int k = 0; k < taskinfo(lib_tid)->sbe.exec.expcount; k++) {
-            if (strcmp(pname, taskinfo(lib_tid)->sbe.exec.exptable[k].symbol) == 0) {
-              prog_symtable[j].exp_idx = k;
-              // adjust sid (sid is <-> exp_idx in lib)
-              prog_symtable[j].task_id = lib_tid;
-              // connect the library
-              break;
-            }
+          int k = unit_export_find(index, lib_tid, pname);
+          if (k != -1) {
+            prog_symtable[j].exp_idx = k;
+            // adjust sid (sid is <-> exp_idx in lib)
+            prog_symtable[j].task_id = lib_tid;
           }
         }
       }
@@ -1162,10 +1290,63 @@ void brun_load_libraries(int tid) {
  * exec_close()
  * ...exec_close_task()
  */
+/**
+ * returns the .sbx file name for the program
+ */
+static void brun_exe_name(const char *filename, char *fname, size_t size) {
+  strlcpy(fname, filename, size);
+  char *p = strrchr(fname, '.');
+  if (p) {
+    *p = '\0';
+  }
+  strlcat(fname, ".sbx", size);
+}
+
+/**
+ * loads the .sbx or .sbu file, mapping it when possible
+ *
+ * @param fname the file name
+ * @param libf whether the file is a unit
+ * @param mapped receives the mapped size, or 0 when the image was allocated
+ * @return the bytecode image
+ */
+static byte *brun_load_file(const char *fname, int libf, uint32_t *mapped) {
+  bc_head_t hdr;
+  unit_file_t uft;
+  byte *source;
+
+  // open & load
+  int h = open(fname, O_RDONLY | O_BINARY);
+  if (h == -1) {
+    panic("File '%s' not found", fname);
+  }
+  // load it
+  if (libf) {
+    read(h, &uft, sizeof(unit_file_t));
+    lseek(h, sizeof(unit_sym_t) * uft.sym_count, SEEK_CUR);
+  }
+  read(h, &hdr, sizeof(bc_head_t));
+  if (hdr.sbver != SB_DWORD_VER) {
+    panic("File '%s' version incorrect", fname);
+  }
+  source = sys_map_file(h, hdr.size, BC_PAD_SIZE);
+  if (source != NULL) {
+    *mapped = hdr.size;
+  } else {
+    *mapped = 0;
+    source = malloc(hdr.size + BC_PAD_SIZE);
+    lseek(h, 0, SEEK_SET);
+    read(h, source, hdr.size);
+  }
+  close(h);
+  return source;
+}
+
 int brun_create_task(const char *filename, byte *preloaded_bc, int libf) {
   bc_head_t hdr;
   unit_file_t uft;
   byte *source;
+  uint32_t mapped = 0;
   char fname[OS_PATHNAME_SIZE + 1];
 
   if (preloaded_bc) {
@@ -1175,13 +1356,7 @@ int brun_create_task(const char *filename, byte *preloaded_bc, int libf) {
   } else {
     // prepare filename
     if (!libf) {
-      char *p;
-      strlcpy(fname, filename, sizeof(fname));
-      p = strrchr(fname, '.');
-      if (p) {
-        *p = '\0';
-      }
-      strlcat(fname, ".sbx", sizeof(fname));
+      brun_exe_name(filename, fname, sizeof(fname));
     } else {
       find_unit(filename, fname);
     }
@@ -1192,30 +1367,14 @@ int brun_create_task(const char *filename, byte *preloaded_bc, int libf) {
     if (search_task(fname) != -1) {
       return search_task(fname);
     }
-    // open & load
-    int h = open(fname, O_RDWR | O_BINARY);
-    if (h == -1) {
-      panic("File '%s' not found", fname);
-    }
-    // load it
-    if (libf) {
-      read(h, &uft, sizeof(unit_file_t));
-      lseek(h, sizeof(unit_sym_t) * uft.sym_count, SEEK_CUR);
-    }
-    read(h, &hdr, sizeof(bc_head_t));
-    if (hdr.sbver != SB_DWORD_VER) {
-      panic("File '%s' version incorrect", fname);
-    }
-    source = malloc(hdr.size + 4);
-    lseek(h, 0, SEEK_SET);
-    read(h, source, hdr.size);
-    close(h);
+    source = brun_load_file(fname, libf, &mapped);
   }
 
   // create task
   int tid = create_task(fname); // create a task
   activate_task(tid);           // make it active
   ctask->bytecode = source;
+  ctask->bc_mapped = mapped;
   byte *cp = source;
 
   if (memcmp(source, "SBUn", 4) == 0) { // load a unit
@@ -1223,13 +1382,15 @@ int brun_create_task(const char *filename, byte *preloaded_bc, int libf) {
     cp += sizeof(unit_file_t);
     prog_expcount = uft.sym_count;
 
-    // copy export-symbols from BC
+    // export-symbols are used in place when aligned, otherwise copied from BC
     if (prog_expcount) {
-      prog_exptable = (unit_sym_t *)malloc(prog_expcount * sizeof(unit_sym_t));
-      for (int i = 0; i < prog_expcount; i++) {
-        memcpy(&prog_exptable[i], cp, sizeof(unit_sym_t));
-        cp += sizeof(unit_sym_t);
+      if (BC_ALIGNED(cp)) {
+        prog_exptable = (unit_sym_t *)cp;
+      } else {
+        prog_exptable = (unit_sym_t *)malloc(prog_expcount * sizeof(unit_sym_t));
+        memcpy(prog_exptable, cp, prog_expcount * sizeof(unit_sym_t));
       }
+      cp += prog_expcount * sizeof(unit_sym_t);
     }
   } else if (memcmp(source, "SBEx", 4) == 0) {
     // load an executable
@@ -1257,14 +1418,19 @@ int brun_create_task(const char *filename, byte *preloaded_bc, int libf) {
   }
   // create label-table
   if (prog_labcount) {
-    tlab = malloc(sizeof(lab_t) * prog_labcount);
-    for (int i = 0; i < prog_labcount; i++) {
-      // copy labels from BC
-      memcpy(&tlab[i].ip, cp, ADDRSZ);
-      cp += ADDRSZ;
+    if (BC_ALIGNED(cp) && sizeof(lab_t) == ADDRSZ) {
+      tlab = (lab_t *)cp;
+      cp += ADDRSZ * prog_labcount;
+    } else {
+      tlab = malloc(sizeof(lab_t) * prog_labcount);
+      for (int i = 0; i < prog_labcount; i++) {
+        // copy labels from BC
+        memcpy(&tlab[i].ip, cp, ADDRSZ);
+        cp += ADDRSZ;
+      }
     }
   }
-  // build import-lib table
+  // build import-lib table (copied, the task-ids are updated when linked)
   if (prog_libcount) {
     prog_libtable = (bc_lib_rec_t *)malloc(prog_libcount * sizeof(bc_lib_rec_t));
     for (int i = 0; i < prog_libcount; i++) {
@@ -1273,7 +1439,7 @@ int brun_create_task(const char *filename, byte *preloaded_bc, int libf) {
     }
   }
 
-  // build import-symbol table
+  // build import-symbol table (copied, the task-ids are updated when linked)
   if (prog_symcount) {
     prog_symtable = (bc_symbol_rec_t *)malloc(prog_symcount * sizeof(bc_symbol_rec_t));
     for (int i = 0; i < prog_symcount; i++) {
@@ -1351,7 +1517,7 @@ int exec_close_task() {
     ctask->has_sysvars = 0;
 
     // clean up - rest tables
-    if (prog_expcount) {
+    if (prog_expcount && !brun_in_image(prog_exptable)) {
       free(prog_exptable);
     }
     if (prog_libcount) {
@@ -1360,12 +1526,20 @@ int exec_close_task() {
     if (prog_symcount) {
       free(prog_symtable);
     }
-    if (prog_labcount) {
+    if (prog_labcount && !brun_in_image(tlab)) {
       free(tlab);
     }
 
     // clean up - the rest
-    free(ctask->bytecode);
+    if (ctask->bc_shared) {
+      // owned by the sbasic_context_t
+      ctask->bc_shared = 0;
+    } else if (ctask->bc_mapped) {
+      sys_unmap_file(ctask->bytecode, ctask->bc_mapped);
+      ctask->bc_mapped = 0;
+    } else {
+      free(ctask->bytecode);
+    }
     ctask->bytecode = NULL;
 
     // cleanup the keyboard map
@@ -1521,6 +1695,9 @@ int sbasic_compile(const char *file) {
   int comp_rq = 0;              // compilation required = 0
   int success = 1;
 
+  // OPTION PREDEF PROFILE only applies to the program declaring it
+  opt_profile = opt_host_profile;
+
   if (strstr(file, ".sbx") == file + strlen(file) - 4) {
     return success;             // file is an executable
   }
@@ -1588,6 +1765,41 @@ int sbasic_exec_prepare(const char *filename) {
   return taskId;
 }
 
+/**
+ * runs the prepared task then cleans up the executor
+ */
+static void sbasic_exec_run(const char *file, int exec_tid) {
+  dev_init(opt_graphics, 0);  // initialize output device for graphics
+  srand(clock());             // randomize
+
+  // run
+  stats_reset();
+  memset(&limits, 0, sizeof(limits));
+  limits.max_ops = opt_max_ops;
+  limits.max_heap = opt_max_heap ? opt_max_heap : UINT64_MAX;
+  limits.max_stack = opt_max_stack;
+  limits.max_time = opt_max_time;
+  limits.start = dev_get_millisecond_count();
+  if (opt_profile) {
+    profile_start(file, exec_tid);
+  }
+  sbasic_recursive_exec(exec_tid);
+  if (opt_profile) {
+    profile_end();
+  }
+  if (opt_stats) {
+    stats_write(opt_stats_file);
+  }
+
+  // normal exit
+  if (!opt_quiet) {
+    inf_done();
+  }
+
+  exec_close(exec_tid);       // clean up executor's garbages
+  dev_restore();              // restore device
+}
+
 /*
  * remember the directory location of the running program
  */
@@ -1626,6 +1838,19 @@ void sbasic_set_bas_dir(const char *bas_file) {
   }
 }
 
+/**
+ * resets the options which may have been set by the previous program
+ */
+static void sbasic_reset_options() {
+  opt_pref_width = 0;
+  opt_pref_height = 0;
+  opt_show_page = 0;
+  opt_base = 0;
+  opt_usepcre = 0;
+  opt_autolocal = 0;
+  opt_profile = opt_host_profile;
+}
+
 /**
  * this is the main 'execute' routine; its work depended on opt_xxx flags
  * use it instead of sbasic_main if managers are already initialized
@@ -1638,9 +1863,7 @@ int sbasic_exec(const char *file) {
   int exec_rq = 1;
 
   // init compile-time options
-  opt_pref_width = 0;
-  opt_pref_height = 0;
-  opt_show_page = 0;
+  sbasic_reset_options();
 
   // setup global values
   gsb_last_line = gsb_last_error = 0;
@@ -1661,20 +1884,7 @@ int sbasic_exec(const char *file) {
   if (exec_rq) {                // we will run it
     // load everything
     int exec_tid = sbasic_exec_prepare(file);
-
-    dev_init(opt_graphics, 0);  // initialize output device for graphics
-    srand(clock());             // randomize
-
-    // run
-    sbasic_recursive_exec(exec_tid);
-
-    // normal exit
-    if (!opt_quiet) {
-      inf_done();
-    }
-
-    exec_close(exec_tid);       // clean up executor's garbages
-    dev_restore();              // restore device
+    sbasic_exec_run(file, exec_tid);
   }
 
   // return compilation errors as failure
@@ -1705,7 +1915,126 @@ int sbasic_main(const char *file) {
   plugin_close();
   unit_mgr_close();
   destroy_tasks();
+  v_close_pool();
 
   return success;
 }
 
+/**
+ * the program held by sbasic_create
+ */
+struct sbasic_context_s {
+  char file[OS_PATHNAME_SIZE + 1];
+  char bas_dir[OS_PATHNAME_SIZE + 1];
+  byte *bytecode;
+  uint32_t mapped;
+  int tid;
+};
+
+// the managers support one context for each thread
+static SB_THREAD sbasic_context_t *sb_context = NULL;
+
+/**
+ * compiles or loads the program, ready to run with sbasic_run
+ *
+ * @param file the source or .sbx file
+ * @return the context, or NULL when the program could not be loaded
+ */
+sbasic_context_t *sbasic_create(const char *file) {
+  if (sb_context != NULL) {
+    return NULL;
+  }
+
+  sbasic_context_t *context = (sbasic_context_t *)calloc(1, sizeof(sbasic_context_t));
+  if (context == NULL) {
+    return NULL;
+  }
+
+  // initialize managers, these stay resident until sbasic_destroy
+  context->tid = init_tasks();
+  unit_mgr_init();
+  plugin_init();
+  v_init_pool();
+
+  // init compile-time options
+  sbasic_reset_options();
+
+  gsb_last_line = gsb_last_error = 0;
+  strlcpy(gsb_last_file, file, sizeof(gsb_last_file));
+  strcpy(gsb_last_errmsg, "");
+  sbasic_set_bas_dir(file);
+
+  int success = !prog_error && sbasic_compile(file) && ctask->bc_type != 2;
+  if (success) {
+    strlcpy(context->file, file, sizeof(context->file));
+    strlcpy(context->bas_dir, gsb_bas_dir, sizeof(context->bas_dir));
+    if (opt_nosave && ctask->bytecode != NULL) {
+      // take the compiled bytecode from the main task
+      context->bytecode = ctask->bytecode;
+      ctask->bytecode = NULL;
+    } else {
+      char fname[OS_PATHNAME_SIZE + 1];
+      brun_exe_name(file, fname, sizeof(fname));
+      context->bytecode = brun_load_file(fname, 0, &context->mapped);
+    }
+  } else {
+    gsb_last_error = 1;
+    plugin_close();
+    unit_mgr_close();
+    destroy_tasks();
+    v_close_pool();
+    free(context);
+    context = NULL;
+  }
+  sb_context = context;
+  return context;
+}
+
+/**
+ * runs the program with fresh variables. the bytecode, units, modules and
+ * the variable pool are kept for the next run.
+ *
+ * @param context the context from sbasic_create
+ * @return true on success
+ */
+int sbasic_run(sbasic_context_t *context) {
+  gsb_last_line = gsb_last_error = 0;
+  strlcpy(gsb_last_file, context->file, sizeof(gsb_last_file));
+  strlcpy(gsb_bas_dir, context->bas_dir, sizeof(gsb_bas_dir));
+  strcpy(gsb_last_errmsg, "");
+
+  // the program's task is a child of the main task
+  activate_task(context->tid);
+  prog_error = errNone;
+
+  int exec_tid = brun_create_task(context->file, context->bytecode, 0);
+  taskinfo(exec_tid)->bc_shared = 1;
+  cmd_play_reset();
+  graph_reset();
+  sbasic_exec_run(context->file, exec_tid);
+
+  // finish any module jobs started by this run
+  plugin_reset();
+  return !gsb_last_error;
+}
+
+/**
+ * releases the program and the managers
+ *
+ * @param context the context from sbasic_create
+ */
+void sbasic_destroy(sbasic_context_t *context) {
+  if (context != NULL) {
+    if (context->mapped) {
+      sys_unmap_file(context->bytecode, context->mapped);
+    } else {
+      free(context->bytecode);
+    }
+    plugin_close();
+    unit_mgr_close();
+    destroy_tasks();
+    v_close_pool();
+    free(context);
+    sb_context = NULL;
+  }
+}
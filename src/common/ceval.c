@@ -10,8 +10,8 @@
 #include "common/smbas.h"
 #include "common/bc.h"
 
-static bc_t *bc_in;
-static bc_t *bc_out;
+static SB_THREAD bc_t *bc_in;
+static SB_THREAD bc_t *bc_out;
 
 #define cev_add1(x)     bc_add_code(bc_out, (x))
 #define cev_add2(x, y)  { bc_add1(bc_out, (x)); bc_add1(bc_out, (y)); }
@@ -232,6 +232,176 @@ void cev_parenth() {
   }
 }
 
+/*
+ * literal operand, see cev_fold_binary()
+ */
+typedef struct cev_const_s {
+  byte type;
+  var_int_t i;
+  var_num_t n;
+  const char *str;
+  bcip_t size;
+} cev_const_t;
+
+/*
+ * reads the literal, optionally inside parenthesis, from the output
+ * returns the size of the literal code or 0 when there is no literal
+ */
+bcip_t cev_read_const(bcip_t ip, cev_const_t *c) {
+  uint32_t len;
+
+  c->size = 0;
+  if (ip >= bc_out->count) {
+    return 0;
+  }
+  c->type = bc_out->ptr[ip];
+  switch (c->type) {
+  case kwTYPE_INT:
+    memcpy(&c->i, bc_out->ptr + ip + 1, OS_INTSZ);
+    c->n = c->i;
+    c->size = 1 + OS_INTSZ;
+    break;
+  case kwTYPE_NUM:
+    memcpy(&c->n, bc_out->ptr + ip + 1, OS_REALSZ);
+    c->size = 1 + OS_REALSZ;
+    break;
+  case kwTYPE_STR:
+    memcpy(&len, bc_out->ptr + ip + 1, OS_STRLEN);
+    c->str = (const char *)bc_out->ptr + ip + 1 + OS_STRLEN;
+    c->size = 1 + OS_STRLEN + len;
+    break;
+  case kwTYPE_LEVEL_BEGIN:
+    if (cev_read_const(ip + 1, c) && bc_out->ptr[ip + 1 + c->size] == kwTYPE_LEVEL_END) {
+      c->size += 2;
+    } else {
+      c->size = 0;
+    }
+    break;
+  default:
+    break;
+  }
+  if (ip + c->size > bc_out->count) {
+    c->size = 0;
+  }
+  return c->size;
+}
+
+/*
+ * replaces "<literal> EVPUSH <literal> EVPOP <opr> <op>" with the result,
+ * which is calculated the same way as the executor (see eval.c)
+ */
+void cev_fold_binary(bcip_t start) {
+  cev_const_t left;
+  cev_const_t right;
+  bcip_t ip = start;
+
+  if (!opt_optimise || !cev_read_const(ip, &left)) {
+    return;
+  }
+  ip += left.size;
+  if (bc_out->ptr[ip] != kwTYPE_EVPUSH || !cev_read_const(ip + 1, &right)) {
+    return;
+  }
+  ip += 1 + right.size;
+  if (ip + 3 != bc_out->count || bc_out->ptr[ip] != kwTYPE_EVPOP) {
+    return;
+  }
+
+  byte opr = bc_out->ptr[ip + 1];
+  byte op = bc_out->ptr[ip + 2];
+  int numeric = (left.type != kwTYPE_STR && right.type != kwTYPE_STR);
+  var_num_t lf = left.n;
+  var_num_t rf = right.n;
+  var_int_t li;
+  var_int_t ri;
+
+  if (opr == kwTYPE_ADDOPR && left.type == kwTYPE_STR && right.type == kwTYPE_STR && op == '+') {
+    // the strings are joined up to the first nul (see v_add)
+    int llen = strlen(left.str);
+    int rlen = strlen(right.str);
+    char *str = malloc(llen + rlen + 1);
+    memcpy(str, left.str, llen);
+    memcpy(str + llen, right.str, rlen);
+    bc_out->count = start;
+    bc_add_strn(bc_out, str, llen + rlen);
+    free(str);
+  } else if (!numeric) {
+    return;
+  } else if (opr == kwTYPE_ADDOPR) {
+    if (left.type == kwTYPE_INT && right.type == kwTYPE_INT) {
+      bc_out->count = start;
+      bc_add_cint(bc_out, op == '+' ? left.i + right.i : left.i - right.i);
+    } else {
+      bc_out->count = start;
+      bc_add_creal(bc_out, op == '+' ? lf + rf : lf - rf);
+    }
+  } else if (opr == kwTYPE_MULOPR) {
+    switch (op) {
+    case '*':
+      bc_out->count = start;
+      bc_add_creal(bc_out, lf * rf);
+      break;
+    case '/':
+      if (rf != 0) {
+        bc_out->count = start;
+        bc_add_creal(bc_out, lf / rf);
+      }
+      break;
+    case '\\':
+      li = lf;
+      ri = rf;
+      if (ri != 0) {
+        bc_out->count = start;
+        bc_add_cint(bc_out, li / ri);
+      }
+      break;
+    case '%':
+    case OPLOG_MOD:
+      ri = rf;
+      if (ri != 0) {
+        li = (lf < 0.0) ? -floor(-lf) : floor(lf);
+        bc_out->count = start;
+        bc_add_cint(bc_out, li - ri * (li / ri));
+      }
+      break;
+    case OPLOG_MDL:
+      if (rf != 0) {
+        bc_out->count = start;
+        bc_add_creal(bc_out, fmod(lf, rf) + rf * (SGN(lf) != SGN(rf)));
+      }
+      break;
+    default:
+      break;
+    }
+  } else if (opr == kwTYPE_POWOPR) {
+    bc_out->count = start;
+    bc_add_creal(bc_out, pow(lf, rf));
+  }
+}
+
+/*
+ * replaces "<literal> UNROPR <op>" with the result
+ */
+void cev_fold_unary(bcip_t start, byte op) {
+  cev_const_t value;
+
+  if (cev_read_const(start, &value) && start + value.size + 2 == bc_out->count) {
+    if (op == '-' && value.type == kwTYPE_INT) {
+      bc_out->count = start;
+      bc_add_cint(bc_out, -value.i);
+    } else if (op == '-' && value.type == kwTYPE_NUM) {
+      bc_out->count = start;
+      bc_add_creal(bc_out, -value.n);
+    } else if (op == OPLOG_INV && value.type == kwTYPE_INT) {
+      bc_out->count = start;
+      bc_add_cint(bc_out, ~value.i);
+    } else if (op == OPLOG_NOT && value.type == kwTYPE_INT) {
+      bc_out->count = start;
+      bc_add_cint(bc_out, !value.i);
+    }
+  }
+}
+
 /*
  * unary
  */
@@ -245,10 +415,15 @@ void cev_unary() {
   } else {
     op = 0;
   }
+  bcip_t start = bc_out->count;
   cev_parenth();        // R = cev_parenth
-  if (op) {
+  // when optimising, unary plus is dropped as a no-op
+  if (op && (op != '+' || !opt_optimise)) {
     cev_add1(kwTYPE_UNROPR);
     cev_add1(op);       // R = op R
+    if (opt_optimise) {
+      cev_fold_unary(start, op);
+    }
   }
 }
 
@@ -256,17 +431,30 @@ void cev_unary() {
  * pow
  */
 void cev_pow() {
+  bcip_t start = bc_out->count;
   cev_unary();                  // R = cev_unary
 
   IF_ERR_RTN;
   while (CODE(IP) == kwTYPE_POWOPR) {
     IP += 2;
 
+    bcip_t push = bc_out->count;
     cev_add1(kwTYPE_EVPUSH);    // PUSH R
     cev_unary();                // R = cev_unary
     IF_ERR_RTN;
     cev_add1(kwTYPE_EVPOP);     // POP LEFT
     cev_add2(kwTYPE_POWOPR, '^'); // R = LEFT op R
+    cev_fold_binary(start);
+    if (opt_optimise && bc_out->count == push + 1 + 1 + OS_INTSZ + 3 &&
+        bc_out->ptr[push + 1] == kwTYPE_INT) {
+      // R ^ 2 = R * R
+      var_int_t power;
+      memcpy(&power, bc_out->ptr + push + 2, OS_INTSZ);
+      if (power == 2) {
+        bc_out->count = push;
+        cev_add2(kwTYPE_UNROPR, OPLOG_SQR);
+      }
+    }
   }
 }
 
@@ -274,6 +462,7 @@ void cev_pow() {
  * mul | div | mod
  */
 void cev_mul() {
+  bcip_t start = bc_out->count;
   cev_pow();                    // R = cev_pow()
 
   IF_ERR_RTN;
@@ -288,6 +477,7 @@ void cev_mul() {
     IF_ERR_RTN;
     cev_add1(kwTYPE_EVPOP);      // POP LEFT
     cev_add2(kwTYPE_MULOPR, op); // R = LEFT op R
+    cev_fold_binary(start);
   }
 }
 
@@ -295,6 +485,7 @@ void cev_mul() {
  * add | sub
  */
 void cev_add() {
+  bcip_t start = bc_out->count;
   cev_mul();                    // R = cev_mul()
 
   IF_ERR_RTN;
@@ -311,6 +502,7 @@ void cev_add() {
 
     cev_add1(kwTYPE_EVPOP);    // POP LEFT
     cev_add2(kwTYPE_ADDOPR, op); // R = LEFT op R
+    cev_fold_binary(start);
   }
 }
 
@@ -127,30 +127,30 @@ extern byte os_charset;
 
 extern byte os_color;         // true if the output has real colors (256+ colors)
 extern byte os_graphics;      // non-zero if the driver supports graphics
-extern int os_graf_mx;        // graphic mode: maximum x
-extern int os_graf_my;        // graphic mode: maximum y
+extern SB_THREAD int os_graf_mx;        // graphic mode: maximum x
+extern SB_THREAD int os_graf_my;        // graphic mode: maximum y
 
 // graphics - viewport
-extern int32_t dev_Vx1;
-extern int32_t dev_Vy1;
-extern int32_t dev_Vx2;
-extern int32_t dev_Vy2;
+extern SB_THREAD int32_t dev_Vx1;
+extern SB_THREAD int32_t dev_Vy1;
+extern SB_THREAD int32_t dev_Vx2;
+extern SB_THREAD int32_t dev_Vy2;
 
-extern int32_t dev_Vdx;
-extern int32_t dev_Vdy;
+extern SB_THREAD int32_t dev_Vdx;
+extern SB_THREAD int32_t dev_Vdy;
 
 // graphics - window world coordinates
-extern int32_t dev_Wx1;
-extern int32_t dev_Wy1;
-extern int32_t dev_Wx2;
-extern int32_t dev_Wy2;
+extern SB_THREAD int32_t dev_Wx1;
+extern SB_THREAD int32_t dev_Wy1;
+extern SB_THREAD int32_t dev_Wx2;
+extern SB_THREAD int32_t dev_Wy2;
 
-extern int32_t dev_Wdx;
-extern int32_t dev_Wdy;
+extern SB_THREAD int32_t dev_Wdx;
+extern SB_THREAD int32_t dev_Wdy;
 
 // graphics - current colors
-extern long dev_fgcolor;
-extern long dev_bgcolor;
+extern SB_THREAD long dev_fgcolor;
+extern SB_THREAD long dev_bgcolor;
 
 #endif
 
@@ -594,6 +594,29 @@ void dev_arc(int xc, int yc, double r, double as, double ae, double aspect);
  */
 void dev_ffill(uint16_t x0, uint16_t y0, long fill_color, long border_color);
 
+/**
+ * @ingroup dev_g
+ *
+ * floodfill working directly on the rows of a 32-bit pixel surface,
+ * for drivers implementing osd_ffill()
+ *
+ * @param pixels the first row of the surface
+ * @param stride the number of pixels in each row
+ * @param x1 the inclusive clip rectangle
+ * @param y1 the inclusive clip rectangle
+ * @param x2 the inclusive clip rectangle
+ * @param y2 the inclusive clip rectangle
+ * @param x the point to start
+ * @param y the point to start
+ * @param fill_color the pixel value to use for fill
+ * @param border_color the pixel value of the border, ignored for scan-while
+ * @param mask the bits compared when matching pixels
+ * @param scan_while non-zero to fill the area having the colour of the start point
+ */
+void dev_ffill_pixels(uint32_t *pixels, int stride, int x1, int y1, int x2, int y2,
+                      int x, int y, uint32_t fill_color, uint32_t border_color,
+                      uint32_t mask, int scan_while);
+
 /**
  * @ingroup dev_g
  *
@@ -780,8 +803,9 @@ typedef enum {
   ft_stream,          /**< simple file */
   ft_serial_port,     /**< COMx:speed, serial port */
   ft_socket_client,   /**< SCLT:address:port, socket client */
-  ft_socket_server,   // SSVR:address:port
-  ft_http_client
+  ft_socket_server,   /**< SSVR:[address:]port, socket server */
+  ft_http_client,
+  ft_socket_conn      /**< connection accepted by a socket server */
 } dev_ftype_t;
 
 /**
@@ -803,6 +827,9 @@ typedef struct {
   int handle;         /**< the file handle */
   int last_error;     /**< the last error-code */
   int open_flags;     /**< the open()'s flags */
+  uint64_t bytes_read;    /**< bytes read since the file was opened */
+  uint64_t bytes_written; /**< bytes written since the file was opened */
+  void *read_buf;     /**< CSVREAD's buffered input, kept between records */
 } dev_file_t;
 
 // flags for dev_fopen()
@@ -820,6 +847,15 @@ typedef struct {
  */
 int dev_freefilehandle(void);
 
+/**
+ * @ingroup dev_f
+ *
+ * returns a free file handle without raising an error
+ *
+ * @return a free file handle; or -1 when all are in use
+ */
+int dev_findfreehandle(void);
+
 /**
  * @ingroup dev_f
  *
@@ -829,6 +865,15 @@ int dev_freefilehandle(void);
  */
 dev_file_t *dev_getfileptr(int handle);
 
+/**
+ * @ingroup dev_f
+ *
+ * returns the file info for an open handle, without allocating unused slots
+ *
+ * @return the file info; or NULL when the handle isn't open
+ */
+dev_file_t *dev_getopenfile(int handle);
+
 /**
  * @ingroup dev_f
  *
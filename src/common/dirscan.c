@@ -0,0 +1,420 @@
+// This file is part of SmallBASIC
+//
+// Directory tree scanner
+//
+// The tree is read by a small pool of worker threads, each taking the
+// next pending directory and queueing its sub-directories. The results
+// are then collected on the main thread in depth first order, with the
+// entries of each directory sorted by name.
+//
+// With the cache enabled, the entries of each directory are kept and
+// reused while the modification time of the directory is unchanged.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#include "common/sys.h"
+#include "common/pproc.h"
+#include "common/dirscan.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#if defined(_UnixOS) && !defined(_Win32) && !defined(__EMSCRIPTEN__)
+#define USE_DIRSCAN_THREADS 1
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(_Win32)
+#define STAT_NOFOLLOW stat
+#else
+#define STAT_NOFOLLOW lstat
+#endif
+
+// directory time stamps, with nanoseconds where available
+#if defined(__linux__)
+#define STAMP(t) ((int64_t)(t).tv_sec * 1000000000 + (t).tv_nsec)
+#define MTIME_STAMP(st) STAMP((st)->st_mtim)
+#define CTIME_STAMP(st) STAMP((st)->st_ctim)
+#else
+#define MTIME_STAMP(st) ((int64_t)(st)->st_mtime)
+#define CTIME_STAMP(st) ((int64_t)(st)->st_ctime)
+#endif
+
+#if defined(USE_DIRSCAN_THREADS)
+#define LOCK(m) pthread_mutex_lock(m)
+#define UNLOCK(m) pthread_mutex_unlock(m)
+#else
+#define LOCK(m)
+#define UNLOCK(m)
+#endif
+
+#define DIRSCAN_MAX_THREADS 8
+#define DIRSCAN_CACHE_SIZE 1024
+#define DIRSCAN_GROW_SIZE 64
+
+typedef struct dirscan_entry_t {
+  char *name;
+  var_int_t size;
+  var_int_t mtime;
+  int is_dir;
+} dirscan_entry_t;
+
+typedef struct dirscan_node_t {
+  char *path;
+  int depth;
+  int count;
+  dirscan_entry_t *entries;
+  struct dirscan_node_t **children;
+} dirscan_node_t;
+
+typedef struct dirscan_cache_t {
+  char *path;
+  int64_t mtime;
+  int64_t ctime;
+  int count;
+  dirscan_entry_t *entries;
+  struct dirscan_cache_t *next;
+} dirscan_cache_t;
+
+typedef struct dirscan_t {
+  dirscan_node_t **queue;
+  int queue_len;
+  int queue_size;
+  int active;
+  int use_cache;
+  int abort;
+#if defined(USE_DIRSCAN_THREADS)
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+#endif
+} dirscan_t;
+
+static dirscan_cache_t *cache[DIRSCAN_CACHE_SIZE];
+#if defined(USE_DIRSCAN_THREADS)
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+//
+// returns a copy of the entries
+//
+static dirscan_entry_t *entries_copy(const dirscan_entry_t *entries, int count) {
+  dirscan_entry_t *result = malloc(sizeof(dirscan_entry_t) * (count ? count : 1));
+  for (int i = 0; i < count; i++) {
+    result[i] = entries[i];
+    result[i].name = strdup(entries[i].name);
+  }
+  return result;
+}
+
+static void entries_free(dirscan_entry_t *entries, int count) {
+  for (int i = 0; i < count; i++) {
+    free(entries[i].name);
+  }
+  free(entries);
+}
+
+static int entries_cmp(const void *a, const void *b) {
+  return strcmp(((const dirscan_entry_t *)a)->name, ((const dirscan_entry_t *)b)->name);
+}
+
+static unsigned cache_hash(const char *path) {
+  unsigned result = 5381;
+  for (const char *p = path; *p; p++) {
+    result = ((result << 5) + result) + (unsigned char)*p;
+  }
+  return result % DIRSCAN_CACHE_SIZE;
+}
+
+//
+// returns a copy of the cached entries when the directory is unchanged
+//
+static dirscan_entry_t *cache_get(const char *path, struct stat *st, int *count) {
+  dirscan_entry_t *result = NULL;
+  LOCK(&cache_mutex);
+  for (dirscan_cache_t *item = cache[cache_hash(path)]; item != NULL; item = item->next) {
+    if (strcmp(item->path, path) == 0) {
+      if (item->mtime == MTIME_STAMP(st) && item->ctime == CTIME_STAMP(st)) {
+        result = entries_copy(item->entries, item->count);
+        *count = item->count;
+      }
+      break;
+    }
+  }
+  UNLOCK(&cache_mutex);
+  return result;
+}
+
+static void cache_put(const char *path, struct stat *st, const dirscan_entry_t *entries, int count) {
+  unsigned index = cache_hash(path);
+  LOCK(&cache_mutex);
+  dirscan_cache_t *item = cache[index];
+  while (item != NULL && strcmp(item->path, path) != 0) {
+    item = item->next;
+  }
+  if (item == NULL) {
+    item = malloc(sizeof(dirscan_cache_t));
+    item->path = strdup(path);
+    item->next = cache[index];
+    cache[index] = item;
+  } else {
+    entries_free(item->entries, item->count);
+  }
+  item->mtime = MTIME_STAMP(st);
+  item->ctime = CTIME_STAMP(st);
+  item->entries = entries_copy(entries, count);
+  item->count = count;
+  UNLOCK(&cache_mutex);
+}
+
+static dirscan_node_t *node_create(const char *parent, const char *name, int depth) {
+  dirscan_node_t *result = malloc(sizeof(dirscan_node_t));
+  if (name == NULL) {
+    result->path = strdup(parent);
+  } else {
+    int len = strlen(parent);
+    int sep = (len && parent[len - 1] == OS_DIRSEP) ? 0 : 1;
+    result->path = malloc(len + sep + strlen(name) + 1);
+    strcpy(result->path, parent);
+    if (sep) {
+      result->path[len] = OS_DIRSEP;
+    }
+    strcpy(result->path + len + sep, name);
+  }
+  result->depth = depth;
+  result->count = 0;
+  result->entries = NULL;
+  result->children = NULL;
+  return result;
+}
+
+static void node_free(dirscan_node_t *node) {
+  for (int i = 0; i < node->count; i++) {
+    if (node->children[i] != NULL) {
+      node_free(node->children[i]);
+    }
+  }
+  entries_free(node->entries, node->count);
+  free(node->children);
+  free(node->path);
+  free(node);
+}
+
+//
+// reads the directory entries
+//
+static void node_read(dirscan_t *scan, dirscan_node_t *node) {
+  struct stat st;
+  int have_stat = (scan->use_cache && stat(node->path, &st) == 0);
+  if (have_stat) {
+    node->entries = cache_get(node->path, &st, &node->count);
+  }
+  if (node->entries == NULL) {
+    int size = DIRSCAN_GROW_SIZE;
+    int path_len = strlen(node->path);
+    char *path = malloc(path_len + OS_FILENAME_SIZE + 2);
+    DIR *dfd = opendir(node->path);
+
+    strcpy(path, node->path);
+    if (path_len && path[path_len - 1] != OS_DIRSEP) {
+      path[path_len++] = OS_DIRSEP;
+    }
+    node->count = 0;
+    node->entries = malloc(sizeof(dirscan_entry_t) * size);
+    if (dfd != NULL) {
+      struct dirent *dp;
+      while ((dp = readdir(dfd)) != NULL) {
+        if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0) {
+          continue;
+        }
+        if (node->count == size) {
+          size *= 2;
+          node->entries = realloc(node->entries, sizeof(dirscan_entry_t) * size);
+        }
+        dirscan_entry_t *entry = &node->entries[node->count++];
+        struct stat est;
+        strlcpy(path + path_len, dp->d_name, OS_FILENAME_SIZE + 1);
+        entry->name = strdup(dp->d_name);
+        if (STAT_NOFOLLOW(path, &est) == 0) {
+          entry->size = est.st_size;
+          entry->mtime = est.st_mtime;
+          entry->is_dir = S_ISDIR(est.st_mode) ? 1 : 0;
+        } else {
+          entry->size = 0;
+          entry->mtime = 0;
+          entry->is_dir = 0;
+        }
+      }
+      closedir(dfd);
+    }
+    free(path);
+    qsort(node->entries, node->count, sizeof(dirscan_entry_t), entries_cmp);
+    if (have_stat && dfd != NULL) {
+      cache_put(node->path, &st, node->entries, node->count);
+    }
+  }
+  node->children = calloc(node->count ? node->count : 1, sizeof(dirscan_node_t *));
+  for (int i = 0; i < node->count; i++) {
+    if (node->entries[i].is_dir) {
+      node->children[i] = node_create(node->path, node->entries[i].name, node->depth + 1);
+    }
+  }
+}
+
+//
+// takes pending directories until the whole tree has been read
+//
+static void dirscan_work(dirscan_t *scan, int main_thread) {
+  LOCK(&scan->mutex);
+  while (1) {
+#if defined(USE_DIRSCAN_THREADS)
+    while (scan->queue_len == 0 && scan->active > 0 && !scan->abort) {
+      pthread_cond_wait(&scan->cond, &scan->mutex);
+    }
+#endif
+    if (scan->queue_len == 0 || scan->abort) {
+      break;
+    }
+    dirscan_node_t *node = scan->queue[--scan->queue_len];
+    scan->active++;
+    UNLOCK(&scan->mutex);
+
+    node_read(scan, node);
+    int stop = (main_thread && dev_events(0) == -2);
+
+    LOCK(&scan->mutex);
+    if (stop) {
+      // the user pressed break, the workers stop at their next node
+      scan->abort = 1;
+      brun_break();
+    }
+    for (int i = 0; i < node->count; i++) {
+      if (node->children[i] != NULL) {
+        if (scan->queue_len == scan->queue_size) {
+          scan->queue_size *= 2;
+          scan->queue = realloc(scan->queue, sizeof(dirscan_node_t *) * scan->queue_size);
+        }
+        scan->queue[scan->queue_len++] = node->children[i];
+      }
+    }
+    scan->active--;
+#if defined(USE_DIRSCAN_THREADS)
+    pthread_cond_broadcast(&scan->cond);
+#endif
+  }
+#if defined(USE_DIRSCAN_THREADS)
+  pthread_cond_broadcast(&scan->cond);
+#endif
+  UNLOCK(&scan->mutex);
+}
+
+#if defined(USE_DIRSCAN_THREADS)
+static void *dirscan_thread(void *arg) {
+  dirscan_work((dirscan_t *)arg, 0);
+  return NULL;
+}
+#endif
+
+//
+// appends the matching entries of the node and its children
+//
+static void dirscan_collect(dirscan_node_t *node, const char *wc, var_t *result, uint32_t *size) {
+  for (int i = 0; i < node->count; i++) {
+    dirscan_entry_t *entry = &node->entries[i];
+    if (wc_match(wc, entry->name)) {
+      if (*size == v_asize(result)) {
+        v_resize_array(result, *size * 2);
+      }
+      var_t *var = v_elem(result, (*size)++);
+      map_init(var);
+      v_setstr(map_add_var(var, "path", 0), node->path);
+      v_setstr(map_add_var(var, "name", 0), entry->name);
+      map_add_var(var, "depth", node->depth);
+      map_add_var(var, "mtime", entry->mtime);
+      map_add_var(var, "size", entry->size);
+      map_add_var(var, "dir", entry->is_dir);
+    }
+    if (node->children[i] != NULL) {
+      dirscan_collect(node->children[i], wc, result, size);
+    }
+  }
+}
+
+void dirscan(const char *dir, const char *wc, int use_cache, var_t *result) {
+  char path[OS_PATHNAME_SIZE + 1];
+  const char *home = getenv("HOME");
+  if (dir[0] == '~' && home != NULL) {
+    strlcpy(path, home, sizeof(path));
+    strlcat(path, dir + 1, sizeof(path));
+  } else {
+    strlcpy(path, dir, sizeof(path));
+  }
+  int len = strlen(path);
+  while (len > 1 && path[len - 1] == OS_DIRSEP) {
+    path[--len] = '\0';
+  }
+
+  dirscan_t scan;
+  scan.queue_size = DIRSCAN_GROW_SIZE;
+  scan.queue = malloc(sizeof(dirscan_node_t *) * scan.queue_size);
+  scan.queue[0] = node_create(path, NULL, 0);
+  scan.queue_len = 1;
+  scan.active = 0;
+  scan.use_cache = use_cache;
+  scan.abort = 0;
+  dirscan_node_t *root = scan.queue[0];
+
+#if defined(USE_DIRSCAN_THREADS)
+  pthread_t threads[DIRSCAN_MAX_THREADS];
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int num_threads = 0;
+  int max_threads = (cpus < 1) ? 0 : (cpus > DIRSCAN_MAX_THREADS ? DIRSCAN_MAX_THREADS : cpus) - 1;
+
+  pthread_mutex_init(&scan.mutex, NULL);
+  pthread_cond_init(&scan.cond, NULL);
+  for (int i = 0; i < max_threads; i++) {
+    if (pthread_create(&threads[num_threads], NULL, dirscan_thread, &scan) == 0) {
+      num_threads++;
+    }
+  }
+#endif
+
+  dirscan_work(&scan, 1);
+
+#if defined(USE_DIRSCAN_THREADS)
+  for (int i = 0; i < num_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  pthread_cond_destroy(&scan.cond);
+  pthread_mutex_destroy(&scan.mutex);
+#endif
+
+  uint32_t size = 0;
+  v_toarray1(result, DIRSCAN_GROW_SIZE);
+  if (!scan.abort) {
+    dirscan_collect(root, wc, result, &size);
+  }
+  v_resize_array(result, size);
+
+  node_free(root);
+  free(scan.queue);
+}
+
+void dirscan_clear() {
+  LOCK(&cache_mutex);
+  for (int i = 0; i < DIRSCAN_CACHE_SIZE; i++) {
+    dirscan_cache_t *item = cache[i];
+    while (item != NULL) {
+      dirscan_cache_t *next = item->next;
+      entries_free(item->entries, item->count);
+      free(item->path);
+      free(item);
+      item = next;
+    }
+    cache[i] = NULL;
+  }
+  UNLOCK(&cache_mutex);
+}
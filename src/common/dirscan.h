@@ -0,0 +1,42 @@
+// This file is part of SmallBASIC
+//
+// Directory tree scanner
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#if !defined(DIRSCAN_H)
+#define DIRSCAN_H
+
+#include "common/var.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * @ingroup dev_f
+ *
+ * scans the directory tree into an array of file records
+ *
+ * @param dir the root directory
+ * @param wc the wildcards, or NULL for all names
+ * @param use_cache whether to reuse the entries of unchanged directories
+ * @param result receives the array
+ */
+void dirscan(const char *dir, const char *wc, int use_cache, var_t *result);
+
+/**
+ * @ingroup dev_f
+ *
+ * releases the directory cache
+ */
+void dirscan_clear(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -15,6 +15,7 @@
 #include "common/device.h"
 #include "common/plugins.h"
 #include "common/var_eval.h"
+#include "common/stats.h"
 
 #define IP           prog_ip
 #define CODE(x)      prog_source[(x)]
@@ -498,6 +499,13 @@ static inline void oper_unary(var_t *r) {
     r->type = V_INT;
     r->v.i = !ri;
     break;
+  case OPLOG_SQR:
+    // x^2 rewritten by the optimiser, the result of ^ is always real
+    rf = v_getval(r);
+    V_FREE(r);
+    r->type = V_NUM;
+    r->v.n = rf * rf;
+    break;
   }
 }
 
@@ -811,7 +819,8 @@ static inline void eval_push(var_t *r) {
     len = r->v.p.length;
     eval_stk[eval_sp].type = V_STR;
     eval_stk[eval_sp].v.p.ptr = malloc(len + 1);
-    eval_stk[eval_sp].v.p.owner = 1;
+    eval_stk[eval_sp].v.p.owner = 1 | STR_OWNER_HEAP;
+    stats_heap_alloc(len);
     strcpy(eval_stk[eval_sp].v.p.ptr, r->v.p.ptr);
     eval_stk[eval_sp].v.p.length = len;
     break;
@@ -821,6 +830,9 @@ static inline void eval_push(var_t *r) {
 
   // expression-stack resize
   eval_sp++;
+  if (eval_sp > sb_stats.eval_stack_max) {
+    sb_stats.eval_stack_max = eval_sp;
+  }
   if (eval_sp == eval_size) {
     eval_size += SB_EVAL_STACK_SIZE;
     eval_stk = realloc(eval_stk, sizeof(var_t) * eval_size);
@@ -871,6 +883,7 @@ static inline void eval_callf_str1(long fcode, var_t *r) {
         r->v.p.ptr = NULL;
         r->v.p.owner = 1;
         cmd_str1(fcode, &vtmp, r);
+        v_heap_str(r);
         v_free(&vtmp);
       }
     }
@@ -887,6 +900,7 @@ static inline void eval_callf_strn(long fcode, var_t *r) {
     r->v.p.ptr = NULL;
     IP++;                 // '('
     cmd_strN(fcode, r);
+    v_heap_str(r);
     if (!prog_error) {
       if (CODE_PEEK() == kwTYPE_SEP) {
         IP++;             // ','
@@ -1052,6 +1066,21 @@ static inline void eval_callf_free(var_t *r) {
   r->v.i = dev_freefilehandle();
 }
 
+static inline void eval_callf_sysinfo(var_t *r) {
+  // map SYSINFO(void)
+  if (CODE_PEEK() == kwTYPE_LEVEL_BEGIN) {
+    IP++;
+    if (CODE_PEEK() != kwTYPE_LEVEL_END) {
+      err_noargs();
+    } else {
+      IP++;
+    }
+  }
+  if (!prog_error) {
+    stats_get(r);
+  }
+}
+
 static inline void eval_callf(var_t *r) {
   long fcode = code_getaddr();
   V_FREE(r);
@@ -1217,6 +1246,9 @@ static inline void eval_callf(var_t *r) {
   case kwIMAGE:
   case kwFORM:
   case kwWINDOW:
+  case kwNETWAIT:
+  case kwSTRBUILDER:
+  case kwDIRSCAN:
     eval_callf_genfunc(fcode, r);
     break;
   case kwTICKS:
@@ -1227,6 +1259,9 @@ static inline void eval_callf(var_t *r) {
   case kwFREEFILE:
     eval_callf_free(r);
     break;
+  case kwSYSINFO:
+    eval_callf_sysinfo(r);
+    break;
   case kwARRAY:
     map_from_str(r);
     break;
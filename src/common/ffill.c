@@ -1,7 +1,8 @@
 // This file is part of SmallBASIC
 //
-// FloodFill - Source code is based on:
-//   "Programmer's guide to PC & PS/2 Video Systems"
+// FloodFill - span based scanline fill. Each stack entry holds a run of
+// pixels [xl..xr] on row y that was filled from the row y - dy, so only
+// the pixels overhanging the parent run need to be rescanned backwards.
 //
 // This program is distributed under the terms of the GPL v2.0 or later
 // Download the GNU Public License (GPL) from www.gnu.org
@@ -10,395 +11,319 @@
 
 #include "common/sys.h"
 #include "common/device.h"
-
-#define QUEUESIZE   2048
-#define UP          1
-#define DN          -1
-#define FILLED      1
-#define NOT_FILLED  0
-#define SCAN_UNTIL  0
-#define SCAN_WHILE  1
-
-struct tagParams {
-  uint16_t xl;  // leftmost pixel in run
-  uint16_t xr;  // rightmost pixel in run
-  int16_t y;  // y-coordinate of run
-  byte f;  // TRUE if run is filled (blocked)
-};
-
-struct tagQUEUE {
-  struct tagQUEUE *pQ;  // pointer to opposite queue
-  int d;  // direction (UP or DN)
-  int n;  // number of unfilled runs in queue
-  int h;  // index of head of queue
-  int t;  // index of tail of queue
-  struct tagParams *run;
+#include "include/osd.h"
+
+#define STACK_INIT  256
+#define EVENT_RUNS  256
+
+typedef struct ff_run_s {
+  int xl;
+  int xr;
+  int y;
+  int dy;
+} ff_run_t;
+
+typedef struct ff_fill_s ff_fill_t;
+
+struct ff_fill_s {
+  // returns the first pixel from x in the direction dir that is not inside
+  int (*scan)(ff_fill_t *ff, int x, int y, int dir, int limit);
+  // returns the first pixel from x up to limit that is inside
+  int (*skip)(ff_fill_t *ff, int x, int y, int limit);
+  // fills the pixels from xl to xr
+  void (*fill)(ff_fill_t *ff, int xl, int xr, int y);
+
+  // inclusive clip rectangle
+  int x1, y1, x2, y2;
+
+  // the colour that stops the fill, or the colour being replaced
+  long border;
+  int scan_while;
+
+  // pixel surface
+  uint32_t *pixels;
+  int stride;
+  uint32_t key;
+  uint32_t mask;
+  uint32_t color;
+
+  // pixels already filled when the fill colour is still inside
+  uint8_t *visited;
+
+  ff_run_t *stack;
+  int count;
+  int size;
 };
-typedef struct tagQUEUE QUEUE;
-
-// Global variables of the module.
-static struct tagParams ff_buf1[QUEUESIZE];
-static struct tagParams ff_buf2[QUEUESIZE];
-static long ucBorder;
-static QUEUE Qup;
-static QUEUE Qdn;
-static int scan_type;
-
-uint16_t ff_scan_left(uint16_t, uint16_t, long, int);
-uint16_t ff_scan_right(uint16_t, uint16_t, long, int);
-uint16_t ff_next_branch(uint16_t, uint16_t, int);
-void ff_add_queue(QUEUE *, uint16_t, uint16_t, int, int);
-int ff_in_queue(QUEUE *, uint16_t, uint16_t, int);
 
-void dev_ffill(uint16_t x0, uint16_t y0, long fill_color, long border_color) {
-  int y = y0, qp;
-  int bChangeDirection;
-  uint16_t x, xl = x0, xr = x0, xln, xrn;
-  QUEUE *Q;
-  long pcolor;
-
-  // reset all globals
-  memset(ff_buf1, 0, sizeof(ff_buf1));
-  memset(ff_buf2, 0, sizeof(ff_buf2));
-  memset(&Qup, 0, sizeof(QUEUE));
-  memset(&Qdn, 0, sizeof(QUEUE));
-  ucBorder = 0;
-  scan_type = 0;
-
-  pcolor = dev_fgcolor;
-  dev_setcolor(fill_color);
-
-  // do nothing if the seed pixel is a border pixel
-  if (border_color == -1) {
-    border_color = dev_getpixel(x0, y0);
-    scan_type = SCAN_WHILE;
-  } else {
-    scan_type = SCAN_UNTIL;
-  }
-  if (scan_type == SCAN_UNTIL) {
-    if (dev_getpixel(x0, y0) == border_color) {
-      return;
-    }
-  } else {
-    if (dev_getpixel(x0, y0) == fill_color) {
-      return;
+//
+// adds a run to the stack when the row is inside the clip rectangle
+//
+static void ff_push(ff_fill_t *ff, int xl, int xr, int y, int dy) {
+  if (y >= ff->y1 && y <= ff->y2) {
+    if (ff->count == ff->size) {
+      int size = ff->size ? ff->size * 2 : STACK_INIT;
+      ff_run_t *stack = (ff_run_t *)realloc(ff->stack, size * sizeof(ff_run_t));
+      if (stack == NULL) {
+        return;
+      }
+      ff->stack = stack;
+      ff->size = size;
     }
+    ff_run_t *run = &ff->stack[ff->count++];
+    run->xl = xl;
+    run->xr = xr;
+    run->y = y;
+    run->dy = dy;
   }
+}
 
-  Qup.run = ff_buf1;
-  Qdn.run = ff_buf2;
-
-  // save the border and fill values in global variables
-  ucBorder = border_color;
-
-  // initialize the queues
-  Qup.pQ = &Qdn;  // pointer to opposite queue
-  Qup.d = UP;  // direction for queue
-  Qup.h = -1;
-  Qup.t = 0;
-
-  Qdn.pQ = &Qup;
-  Qdn.d = DN;
-  Qdn.h = -1;
-  Qdn.t = 0;
-
-  // put the seed run in the up queue
-  Q = &Qup;
-  ff_add_queue(Q, ff_scan_left(x0, y0, ucBorder, scan_type),
-               ff_scan_right(x0, y0, ucBorder, scan_type), y0, NOT_FILLED);
+//
+// returns whether the pixel has already been filled
+//
+static inline int ff_visited(ff_fill_t *ff, int x, int y) {
+  int i = (y - ff->y1) * (ff->x2 - ff->x1 + 1) + (x - ff->x1);
+  return ff->visited[i >> 3] & (1 << (i & 7));
+}
 
-  // main loop
-  for (;;) {
-    if (dev_events(0) < 0) {
-      break;
+//
+// records the pixels from xl to xr as filled
+//
+static void ff_visit(ff_fill_t *ff, int xl, int xr, int y) {
+  if (ff->visited) {
+    int i = (y - ff->y1) * (ff->x2 - ff->x1 + 1) + (xl - ff->x1);
+    for (int x = xl; x <= xr; x++, i++) {
+      ff->visited[i >> 3] |= (1 << (i & 7));
     }
+  }
+}
 
-    // if the queue is empty, switch queues
-    if (Q->n == 0) {
-      Q = Q->pQ;
-
-      // exit if the other queue is empty
-      if (Q->n == 0) {
-        break;
-      }
-    }
+//
+// allocates the bitmap of filled pixels, used when the filled pixels
+// could otherwise be mistaken for the unfilled area
+//
+static int ff_init_visited(ff_fill_t *ff) {
+  size_t bits = (size_t)(ff->x2 - ff->x1 + 1) * (ff->y2 - ff->y1 + 1);
+  ff->visited = (uint8_t *)calloc((bits + 7) / 8, 1);
+  return ff->visited != NULL;
+}
 
-    // get the first non-filled run from the head of the queue
-    qp = Q->h;
-    while (qp >= Q->t) {
-      if (!Q->run[qp].f) {
-        y = Q->run[qp].y;
-        xl = Q->run[qp].xl;
-        xr = Q->run[qp].xr;
-
-        // fill the run
-        dev_line(xl, y, xr, y);
-        Q->run[qp].f = FILLED;
-        Q->n--;
+//
+// the main loop, pops runs and extends them along each row
+//
+static void ff_run(ff_fill_t *ff, int x, int y, int events) {
+  ff_push(ff, x, x, y, 1);
+  ff_push(ff, x, x, y - 1, -1);
+
+  int runs = 0;
+  while (ff->count) {
+    if (events && ++runs == EVENT_RUNS) {
+      runs = 0;
+      if (dev_events(0) < 0) {
         break;
-      } else {
-        qp--;
-      }
-    }
-
-    // remove previously-filled runs from the current queue
-    if (Q->d == UP) {
-      while ((Q->h > qp) && (Q->run[Q->h].y < (y - 1))) {
-        Q->h--;
-      }
-    } else {
-      while ((Q->h > qp) && (Q->run[Q->h].y > (y + 1))) {
-        Q->h--;
       }
     }
-
-    // branch in the current direction
-    xln = ff_next_branch(xl, xr, y + Q->d);
-    while (xln != 0xFFFF) {
-      // determine the starting point for ScanRight
-      x = (xln > xl) ? xln : xl;
-
-      // add the new branch if it's not already in the queue
-      xrn = ff_scan_right(x, y + Q->d, ucBorder, scan_type);
-      if (!ff_in_queue(Q, xln, xrn, y + Q->d)) {
-        ff_add_queue(Q, xln, xrn, y + Q->d, NOT_FILLED);
-      }
-
-      // if the new branch does not extend beyond the current run,
-      // look for another branch
-      if (xrn > (xr - 2)) {
-        break;
-      }
-      else {
-        x = xrn + 2;
-        xln = ff_next_branch(x, xr, y + Q->d);
-      }
+    ff_run_t run = ff->stack[--ff->count];
+    int x1 = run.xl;
+    int x2 = run.xr;
+    y = run.y;
+
+    // extend to the left of the parent run
+    x = ff->scan(ff, x1, y, -1, ff->x1) + 1;
+    if (x < x1) {
+      ff->fill(ff, x, x1 - 1, y);
+      ff_push(ff, x, x1 - 1, y - run.dy, -run.dy);
     }
 
-    // branch in the opposite direction
-    bChangeDirection = 0;
-    xln = ff_next_branch(xl, xr, y - Q->d);
-    while (xln != 0xFFFF) {
-      // determine the starting point for ScanRight
-      x = (xln > xl) ? xln : xl;
-
-      // add the new branch to the opposite queue if it is not
-      // already in the current queue
-      xrn = ff_scan_right(x, y - Q->d, ucBorder, scan_type);
-      if (!ff_in_queue(Q, xln, xrn, y - Q->d)) {
-        ff_add_queue(Q->pQ, xln, xrn, y - Q->d, NOT_FILLED);
-        bChangeDirection = 1;
+    while (x1 <= x2) {
+      int xe = ff->scan(ff, x1, y, 1, ff->x2);
+      if (xe > x1) {
+        ff->fill(ff, x1, xe - 1, y);
       }
-
-      // if the new branch does not extend beyond the current run,
-      // look for another branch
-      if (xrn > (xr - 2)) {
-        break;
+      if (xe > x) {
+        ff_push(ff, x, xe - 1, y + run.dy, run.dy);
       }
-      else {
-        x = xrn + 2;
-        xln = ff_next_branch(x, xr, y - Q->d);
+      if (xe - 1 > x2) {
+        // overhangs the parent run
+        ff_push(ff, x2 + 1, xe - 1, y - run.dy, -run.dy);
       }
+      x = x1 = ff->skip(ff, xe + 1, y, x2);
     }
+  }
+}
 
-    // change direction if any turns were detected
-    if (bChangeDirection) {
-      // select the opposite queue
-      Q = Q->pQ;
-
-      // copy the current run to the opposite queue
-      ff_add_queue(Q, xl, xr, y, FILLED);
-    }
+//
+// returns whether the device pixel is inside the fill area
+//
+static int ff_dev_inside(ff_fill_t *ff, int x, int y) {
+  int result;
+  if (ff_visited(ff, x, y)) {
+    result = 0;
+  } else {
+    long c = osd_getpixel(x, y);
+    result = ff->scan_while ? c == ff->border : c != ff->border;
   }
+  return result;
+}
 
-  // cleanup
-  dev_setcolor(pcolor);
+static int ff_dev_scan(ff_fill_t *ff, int x, int y, int dir, int limit) {
+  while ((dir < 0 ? x >= limit : x <= limit) && ff_dev_inside(ff, x, y)) {
+    x += dir;
+  }
+  return x;
 }
 
-uint16_t ff_scan_left(uint16_t xl, uint16_t y, long ucPixel, int f) {
-  long v;
+static int ff_dev_skip(ff_fill_t *ff, int x, int y, int limit) {
+  while (x <= limit && !ff_dev_inside(ff, x, y)) {
+    x++;
+  }
+  return x;
+}
 
-  if (f == SCAN_UNTIL) {
-    // return 0xFFFF if starting pixel is a border pixel
-    if (dev_getpixel(xl, y) == ucPixel) {
-      return 0xFFFF;
-    }
+static void ff_dev_fill(ff_fill_t *ff, int xl, int xr, int y) {
+  osd_line(xl, y, xr, y);
+  ff_visit(ff, xl, xr, y);
+}
 
-    do {
-      xl--;
-      // clip
-      if (xl == 0xFFFF || xl < dev_Vx1) {
-        break;
-      }
-      v = dev_getpixel(xl, y);
-    } while (v != ucPixel);
+//
+// returns whether the surface pixel is inside the fill area
+//
+static inline int ff_px_inside(ff_fill_t *ff, const uint32_t *line, int x, int y) {
+  int result;
+  if (ff->scan_while) {
+    result = (line[x] & ff->mask) == ff->key;
   } else {
-    // f == SCAN_WHILE
-    // return 0xFFFF if starting pixel is not a border pixel
-    if (dev_getpixel(xl, y) != ucPixel) {
-      return 0xFFFF;
+    result = (line[x] & ff->mask) != ff->key;
+    if (result && ff->visited) {
+      result = !ff_visited(ff, x, y);
     }
-
-    do {
-      xl--;
-      // clip
-      if (xl == 0xFFFF || xl < dev_Vx1) {
-        break;
-      }
-      v = dev_getpixel(xl, y);
-    } while (v == ucPixel);
   }
-  return ++xl;
+  return result;
 }
 
-uint16_t ff_scan_right(uint16_t xr, uint16_t y, long ucPixel, int f) {
-  long v;
-
-  if (f == SCAN_UNTIL) {
-    // return 0xFFFF if starting pixel is a border pixel
-    if (dev_getpixel(xr, y) == ucPixel) {
-      return 0xFFFF;
+static int ff_px_scan(ff_fill_t *ff, int x, int y, int dir, int limit) {
+  const uint32_t *line = ff->pixels + (y * ff->stride);
+  if (ff->scan_while && dir > 0) {
+    while (x <= limit && (line[x] & ff->mask) == ff->key) {
+      x++;
+    }
+  } else if (!ff->visited && !ff->scan_while && dir > 0) {
+    while (x <= limit && (line[x] & ff->mask) != ff->key) {
+      x++;
     }
-
-    do {
-      xr++;
-
-      // clip
-      if (xr > dev_Vx2) {
-        break;
-      }
-      v = dev_getpixel(xr, y);
-    } while (v != ucPixel);
   } else {
-    // f == SCAN_WHILE
-    // return 0xFFFF if starting pixel is not a border pixel
-    if (dev_getpixel(xr, y) != ucPixel) {
-      return 0xFFFF;
+    while ((dir < 0 ? x >= limit : x <= limit) && ff_px_inside(ff, line, x, y)) {
+      x += dir;
     }
-
-    do {
-      xr++;
-      // clip
-      if (xr > dev_Vx2) {
-        break;
-      }
-      v = dev_getpixel(xr, y);
-    } while (v == ucPixel);
   }
-
-  return --xr;
+  return x;
 }
 
-uint16_t ff_next_branch(uint16_t xl, uint16_t xr, int y) {
-  uint16_t xln;
-
-  // clip y
-  if ((y < dev_Vy1) || (y > dev_Vy2)) {
-    return 0xFFFF;
+static int ff_px_skip(ff_fill_t *ff, int x, int y, int limit) {
+  const uint32_t *line = ff->pixels + (y * ff->stride);
+  while (x <= limit && !ff_px_inside(ff, line, x, y)) {
+    x++;
   }
+  return x;
+}
 
-  // look for a branch adjacent to the first pixel in the run
-  xln = ff_scan_left(xl, y, ucBorder, scan_type);
-
-  // if the adjacent pixel is on the border, scan for the
-  // first non-border pixel
-  if (xln == 0xFFFF) {
-    xln = ff_scan_right(xl, y, ucBorder, (scan_type == SCAN_WHILE) ? SCAN_UNTIL : SCAN_WHILE);
-    if (xln < xr) {
-      xln++;
-    } else {
-      xln = 0xFFFF;
-    }
+static void ff_px_fill(ff_fill_t *ff, int xl, int xr, int y) {
+  uint32_t *line = ff->pixels + (y * ff->stride);
+  for (int x = xl; x <= xr; x++) {
+    line[x] = ff->color;
   }
-
-  return xln;
+  ff_visit(ff, xl, xr, y);
 }
 
-void ff_add_queue(QUEUE *Q, uint16_t xl, uint16_t xr, int y, int f) {
-  int qp;
-  int i;
+void dev_ffill_pixels(uint32_t *pixels, int stride, int x1, int y1, int x2, int y2,
+                      int x, int y, uint32_t fill_color, uint32_t border_color,
+                      uint32_t mask, int scan_while) {
+  ff_fill_t ff;
+  memset(&ff, 0, sizeof(ff));
+  ff.scan = ff_px_scan;
+  ff.skip = ff_px_skip;
+  ff.fill = ff_px_fill;
+  ff.x1 = x1;
+  ff.y1 = y1;
+  ff.x2 = x2;
+  ff.y2 = y2;
+  ff.pixels = pixels;
+  ff.stride = stride;
+  ff.mask = mask;
+  ff.color = fill_color;
+  ff.scan_while = scan_while;
+
+  if (x < x1 || x > x2 || y < y1 || y > y2) {
+    return;
+  }
 
-  if (Q->d == UP) {
-    // find the last larger queue y-value
-    for (qp = Q->t; qp <= Q->h; qp++) {
-      if (Q->run[qp].y <= y) {
-        break;
-      }
+  uint32_t seed = pixels[y * stride + x] & mask;
+  if (scan_while) {
+    // fill the area having the same colour as the seed
+    ff.key = seed;
+    if (seed == (fill_color & mask)) {
+      return;
     }
   } else {
-    // find the last smaller queue y-value
-    for (qp = Q->t; qp <= Q->h; qp++) {
-      if (Q->run[qp].y >= y) {
-        break;
-      }
+    // fill until reaching the border colour
+    ff.key = border_color & mask;
+    if (seed == ff.key) {
+      return;
     }
-  }
-
-  // expand the queue if necessary
-  if (qp <= Q->h) {
-    // update the head pointer
-    Q->h++;
-
-    // expand up
-    for (i = Q->h; i > qp; --i) {
-      Q->run[i].xl = Q->run[i - 1].xl;
-      Q->run[i].xr = Q->run[i - 1].xr;
-      Q->run[i].y = Q->run[i - 1].y;
-      Q->run[i].f = Q->run[i - 1].f;
+    if ((fill_color & mask) != ff.key && !ff_init_visited(&ff)) {
+      return;
     }
-  } else {
-    // can't insert in queue; add to head
-    Q->h++;
   }
 
-  // enter the data in the queue
-  Q->run[qp].xl = xl;
-  Q->run[qp].xr = xr;
-  Q->run[qp].y = y;
-  Q->run[qp].f = f;
-
-  // update the number of unfilled runs in the queue
-  if (!f) {
-    Q->n++;
-  }
+  ff_run(&ff, x, y, 0);
+  free(ff.visited);
+  free(ff.stack);
 }
 
-int ff_in_queue(QUEUE *Q, uint16_t xl, uint16_t xr, int y) {
-  int qp;
-  int bRVal = 0;
+void dev_ffill(uint16_t x0, uint16_t y0, long fill_color, long border_color) {
+  int x = x0;
+  int y = y0;
+  dev_map_point(&x, &y);
+  if (x < dev_Vx1 || x > dev_Vx2 || y < dev_Vy1 || y > dev_Vy2) {
+    return;
+  }
 
-  if (Q->d == UP) {
-    // search from head to tail
-    for (qp = Q->h; qp >= 0; --qp) {
-      // quit searching if y is not in the ordered list
-      if (Q->run[qp].y > y) {
-        break;
+  if (!osd_ffill(x, y, fill_color, border_color)) {
+    // fallback using the driver pixel access
+    ff_fill_t ff;
+    memset(&ff, 0, sizeof(ff));
+    ff.scan = ff_dev_scan;
+    ff.skip = ff_dev_skip;
+    ff.fill = ff_dev_fill;
+    ff.x1 = dev_Vx1;
+    ff.y1 = dev_Vy1;
+    ff.x2 = dev_Vx2;
+    ff.y2 = dev_Vy2;
+
+    long seed = osd_getpixel(x, y);
+    if (border_color == -1) {
+      ff.border = seed;
+      ff.scan_while = 1;
+      if (seed == fill_color) {
+        return;
       }
-
-      // quit searching if the specified run is in the list
-      if ((Q->run[qp].y == y) && (Q->run[qp].xl == xl) && (Q->run[qp].xr == xr)) {
-        bRVal = 1;
-        break;
+    } else {
+      ff.border = border_color;
+      if (seed == border_color) {
+        return;
       }
     }
-  }
-
-  else {
-    // search from head to tail
-    for (qp = Q->h; qp >= 0; --qp) {
-      // quit searching if y is not in the ordered list
-      if (Q->run[qp].y < y) {
-        break;
-      }
 
-      // quit searching if the specified run is in the list
-      if ((Q->run[qp].y == y) && (Q->run[qp].xl == xl) && (Q->run[qp].xr == xr)) {
-        bRVal = 1;
-        break;
-      }
+    // palette and RGB values may describe the same colour, so the
+    // filled pixels are always tracked to ensure the fill terminates
+    if (!ff_init_visited(&ff)) {
+      return;
     }
-  }
 
-  return bRVal;
+    long pcolor = dev_fgcolor;
+    dev_setcolor(fill_color);
+    ff_run(&ff, x, y, 1);
+    dev_setcolor(pcolor);
+    free(ff.visited);
+    free(ff.stack);
+  }
 }
-
@@ -25,10 +25,13 @@
 #include "common/fs_stream.h"
 #include "common/fs_serial.h"
 #include "common/fs_socket_client.h"
+#include "common/fs_socket_server.h"
+#include "common/dirscan.h"
+#include "common/stats.h"
 #include "lib/match.h"
 
-// FILE TABLE
-static dev_file_t file_table[OS_FILEHANDLES];
+// FILE TABLE, the entries are allocated when the handle is first used
+static SB_THREAD dev_file_t *file_table[OS_FILEHANDLES];
 
 /**
  * Basic wild-cards
@@ -51,7 +54,9 @@ int wc_match(const char *mask, char *name) {
  */
 int dev_initfs() {
   for (int i = 0; i < OS_FILEHANDLES; i++) {
-    file_table[i].handle = -1;
+    if (file_table[i] != NULL) {
+      file_table[i]->handle = -1;
+    }
   }
 
   return 1;
@@ -62,24 +67,39 @@ int dev_initfs() {
  */
 void dev_closefs() {
   for (int i = 0; i < OS_FILEHANDLES; i++) {
-    if (file_table[i].handle != -1) {
-      dev_fclose(i + 1);
+    if (file_table[i] != NULL) {
+      if (file_table[i]->handle != -1) {
+        dev_fclose(i + 1);
+      }
+      free(file_table[i]);
+      file_table[i] = NULL;
     }
   }
+  dirscan_clear();
+  reg_match_clear();
 }
 
 /**
  * returns a free file handle for user's commands
  */
 int dev_freefilehandle() {
+  int result = dev_findfreehandle();
+  if (result == -1) {
+    rt_raise(FSERR_TOO_MANY_FILES);
+  }
+  return result;
+}
+
+/**
+ * returns a free file handle, or -1 when all are in use
+ */
+int dev_findfreehandle() {
   for (int i = 0; i < OS_FILEHANDLES; i++) {
-    if (file_table[i].handle == -1) {
+    if (file_table[i] == NULL || file_table[i]->handle == -1) {
       // Note: BASIC's handles starting from 1
       return i + 1;
     }
   }
-
-  rt_raise(FSERR_TOO_MANY_FILES);
   return -1;
 }
 
@@ -94,7 +114,28 @@ dev_file_t *dev_getfileptr(const int handle) {
     rt_raise(FSERR_HANDLE);
     result = NULL;
   } else {
-    result = &file_table[hnd];
+    if (file_table[hnd] == NULL) {
+      file_table[hnd] = (dev_file_t *)calloc(1, sizeof(dev_file_t));
+      if (file_table[hnd] != NULL) {
+        file_table[hnd]->handle = -1;
+      } else {
+        err_memory();
+      }
+    }
+    result = file_table[hnd];
+  }
+  return result;
+}
+
+/**
+ * returns the file pointer for an open BASIC handle, or NULL
+ */
+dev_file_t *dev_getopenfile(int handle) {
+  int hnd = handle - 1;
+  dev_file_t *result = NULL;
+  if (hnd >= 0 && hnd < OS_FILEHANDLES &&
+      file_table[hnd] != NULL && file_table[hnd]->handle != -1) {
+    result = file_table[hnd];
   }
   return result;
 }
@@ -165,6 +206,8 @@ int dev_fopen(int sb_handle, const char *name, int flags) {
         }
       } else if (strncmp(f->name, "SOCL:", 5) == 0) {
         f->type = ft_socket_client;
+      } else if (strncmp(f->name, "SSVR:", 5) == 0) {
+        f->type = ft_socket_server;
       } else if (strncasecmp(f->name, "HTTP:", 5) == 0) {
         f->type = ft_http_client;
       } else if (strncmp(f->name, "SOUT:", 5) == 0 ||
@@ -226,6 +269,8 @@ int dev_fopen(int sb_handle, const char *name, int flags) {
     return stream_open(f);
   case ft_socket_client:
     return sockcl_open(f);
+  case ft_socket_server:
+    return socksv_open(f);
   case ft_http_client:
     return http_open(f);
   case ft_serial_port:
@@ -247,6 +292,9 @@ int dev_fclose(int sb_handle) {
     return 0;
   }
 
+  free(f->read_buf);
+  f->read_buf = NULL;
+
   switch (f->type) {
   case ft_stream:
     return stream_close(f);
@@ -255,6 +303,10 @@ int dev_fclose(int sb_handle) {
   case ft_socket_client:
   case ft_http_client:
     return sockcl_close(f);
+  case ft_socket_server:
+    return socksv_close(f);
+  case ft_socket_conn:
+    return sockconn_close(f);
   default:
     err_unsup();
   }
@@ -266,6 +318,8 @@ int dev_fclose(int sb_handle) {
  */
 int dev_fwrite(int sb_handle, byte *data, uint32_t size) {
   dev_file_t *f;
+  int result;
+  int count;
 
   if ((f = dev_getfileptr(sb_handle)) == NULL) {
     return 0;
@@ -273,16 +327,27 @@ int dev_fwrite(int sb_handle, byte *data, uint32_t size) {
 
   switch (f->type) {
   case ft_stream:
-    return stream_write(f, data, size);
+    count = stream_write(f, data, size);
+    break;
   case ft_serial_port:
-    return serial_write(f, data, size);
+    count = serial_write(f, data, size);
+    break;
   case ft_socket_client:
   case ft_http_client:
-    return sockcl_write(f, data, size);
+    count = sockcl_write(f, data, size);
+    break;
+  case ft_socket_conn:
+    count = sockconn_write(f, data, size);
+    break;
   default:
     err_unsup();
+    count = 0;
   };
-  return 0;
+  // streams succeed only when the whole block is written
+  result = (f->type == ft_stream) ? (count == (int)size) : count;
+  f->bytes_written += count;
+  sb_stats.bytes_written += count;
+  return result;
 }
 
 /**
@@ -290,6 +355,8 @@ int dev_fwrite(int sb_handle, byte *data, uint32_t size) {
  */
 int dev_fread(int sb_handle, byte *data, uint32_t size) {
   dev_file_t *f;
+  int result;
+  int count;
 
   if ((f = dev_getfileptr(sb_handle)) == NULL) {
     return 0;
@@ -297,16 +364,27 @@ int dev_fread(int sb_handle, byte *data, uint32_t size) {
 
   switch (f->type) {
   case ft_stream:
-    return stream_read(f, data, size);
+    count = stream_read(f, data, size);
+    break;
   case ft_serial_port:
-    return serial_read(f, data, size);
+    count = serial_read(f, data, size);
+    break;
   case ft_socket_client:
   case ft_http_client:
-    return sockcl_read(f, data, size);
+    count = sockcl_read(f, data, size);
+    break;
+  case ft_socket_conn:
+    count = sockconn_read(f, data, size);
+    break;
   default:
     err_unsup();
+    count = 0;
   }
-  return 0;
+  // streams succeed only when the whole block is read
+  result = (f->type == ft_stream) ? (count == (int)size) : count;
+  f->bytes_read += count;
+  sb_stats.bytes_read += count;
+  return result;
 }
 
 /**
@@ -346,6 +424,8 @@ uint32_t dev_flength(int sb_handle) {
   case ft_socket_client:
   case ft_http_client:
     return sockcl_length(f);
+  case ft_socket_conn:
+    return sockconn_length(f);
   default:
     err_unsup();
   };
@@ -389,6 +469,8 @@ int dev_feof(int sb_handle) {
   case ft_socket_client:
   case ft_http_client:
     return sockcl_eof(f);
+  case ft_socket_conn:
+    return sockconn_eof(f);
   default:
     err_unsup();
   };
@@ -660,7 +742,7 @@ void dev_destroy_file_list(char_p_t *list, int count) {
  * BUG: no drivers supported
  */
 char *dev_getcwd() {
-  static char retbuf[OS_PATHNAME_SIZE + 1];
+  static SB_THREAD char retbuf[OS_PATHNAME_SIZE + 1];
   getcwd(retbuf, OS_PATHNAME_SIZE);
   int l = strlen(retbuf);
   if (retbuf[l - 1] != OS_DIRSEP) {
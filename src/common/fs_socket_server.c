@@ -0,0 +1,511 @@
+// This file is part of SmallBASIC
+//
+// BSD sockets driver (multi-connection server)
+//
+// open "SSVR:8080" as #1
+// while 1
+//   for h in netwait(1, 1000)
+//     if eof(h) then close #h else lineinput #h, s: print #h, s
+//   next
+// wend
+//
+// The listener is non-blocking and all of its connections are multiplexed
+// through a single epoll (Linux) or poll (other unix) instance. Accepted
+// connections are assigned free BASIC file handles. Input is buffered per
+// connection while waiting, output is buffered whenever the peer can't
+// keep up and is flushed by the next call to NETWAIT.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#include "common/sys.h"
+#include "common/inet.h"
+#include "common/device.h"
+#include "common/messages.h"
+#include "common/fs_socket_server.h"
+#include "common/sberr.h"
+
+#if defined(_Win32) || defined(INET_UNSUP)
+
+int socksv_open(dev_file_t *f) { err_unsup(); return 0; }
+int socksv_close(dev_file_t *f) { return 0; }
+int socksv_wait(int sb_handle, int timeout, var_t *result) { err_unsup(); return 0; }
+int sockconn_close(dev_file_t *f) { return 0; }
+int sockconn_write(dev_file_t *f, byte *data, uint32_t size) { return 0; }
+int sockconn_read(dev_file_t *f, byte *data, uint32_t size) { return 0; }
+int sockconn_eof(dev_file_t *f) { return 1; }
+int sockconn_length(dev_file_t *f) { return 0; }
+
+#else
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+
+#if defined(__linux__)
+#define USE_EPOLL 1
+#include <sys/epoll.h>
+#endif
+
+// the length of time (ms) to block before checking for a program break
+#define BLOCK_INTERVAL 250
+// the length of time (ms) to spend delivering output when closing
+#define CLOSE_TIMEOUT 1000
+#define MAX_EVENTS 64
+#define BUFFER_INIT_SIZE 1024
+#define RECV_SIZE 4096
+#define POLL_FD(f) (f)->drv_dw[0]
+
+typedef struct {
+  char *data;
+  uint32_t start;
+  uint32_t size;
+  uint32_t capacity;
+} sockbuf_t;
+
+typedef struct {
+  // the owning SSVR: listener
+  dev_file_t *server;
+  // the BASIC file handle of this connection
+  int sb_handle;
+  sockbuf_t in;
+  sockbuf_t out;
+  int closed;
+} sockconn_t;
+
+static void sockbuf_free(sockbuf_t *buf) {
+  free(buf->data);
+  buf->data = NULL;
+  buf->start = buf->size = buf->capacity = 0;
+}
+
+//
+// returns a pointer to a region of at least 'len' bytes at the end of the buffer
+//
+static char *sockbuf_reserve(sockbuf_t *buf, uint32_t len) {
+  if (buf->start > 0 && buf->start + buf->size + len > buf->capacity) {
+    // reclaim the consumed space at the front of the buffer
+    memmove(buf->data, buf->data + buf->start, buf->size);
+    buf->start = 0;
+  }
+  if (buf->start + buf->size + len > buf->capacity) {
+    uint32_t capacity = buf->capacity ? buf->capacity : BUFFER_INIT_SIZE;
+    while (capacity < buf->size + len) {
+      capacity *= 2;
+    }
+    buf->data = realloc(buf->data, capacity);
+    buf->capacity = capacity;
+  }
+  return buf->data + buf->start + buf->size;
+}
+
+static void sockbuf_consume(sockbuf_t *buf, uint32_t len) {
+  buf->start += len;
+  buf->size -= len;
+  if (buf->size == 0) {
+    buf->start = 0;
+  }
+}
+
+static int set_nonblocking(int fd, int enable) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags != -1) {
+    flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    flags = fcntl(fd, F_SETFL, flags);
+  }
+  return flags != -1;
+}
+
+static inline sockconn_t *get_conn(dev_file_t *f) {
+  return (sockconn_t *)f->drv_data;
+}
+
+//
+// update whether the connection is waiting to flush its output
+//
+static void sockconn_watch(dev_file_t *f) {
+#if USE_EPOLL
+  sockconn_t *conn = get_conn(f);
+  struct epoll_event ev;
+  ev.events = EPOLLIN | (conn->out.size ? EPOLLOUT : 0);
+  ev.data.u32 = conn->sb_handle;
+  epoll_ctl(POLL_FD(conn->server), EPOLL_CTL_MOD, f->handle, &ev);
+#endif
+}
+
+//
+// reads everything that is currently available without blocking
+//
+static void sockconn_fill(sockconn_t *conn, int fd) {
+  while (!conn->closed) {
+    char *buf = sockbuf_reserve(&conn->in, RECV_SIZE);
+    ssize_t bytes = recv(fd, buf, RECV_SIZE, 0);
+    if (bytes > 0) {
+      conn->in.size += bytes;
+    } else if (bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      conn->closed = 1;
+    } else {
+      break;
+    }
+  }
+}
+
+//
+// writes as much of the pending output as the socket will accept
+//
+static void sockconn_flush(sockconn_t *conn, int fd) {
+  while (conn->out.size && !conn->closed) {
+    ssize_t bytes = send(fd, conn->out.data + conn->out.start, conn->out.size, 0);
+    if (bytes > 0) {
+      sockbuf_consume(&conn->out, bytes);
+    } else if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      break;
+    } else {
+      conn->closed = 1;
+      sockbuf_free(&conn->out);
+    }
+  }
+}
+
+//
+// delivers the remaining output, waiting no longer than CLOSE_TIMEOUT
+//
+static void sockconn_drain(sockconn_t *conn, int fd) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLOUT;
+  uint32_t start = dev_get_millisecond_count();
+  sockconn_flush(conn, fd);
+  while (conn->out.size && !conn->closed) {
+    int remaining = CLOSE_TIMEOUT - (int)(dev_get_millisecond_count() - start);
+    if (remaining <= 0 || (poll(&pfd, 1, remaining) == -1 && errno != EINTR)) {
+      break;
+    }
+    sockconn_flush(conn, fd);
+  }
+}
+
+//
+// blocks until the connection has input or the program is interrupted
+//
+static int sockconn_block(sockconn_t *conn, int fd) {
+  struct pollfd pfd;
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  while (!conn->in.size && !conn->closed) {
+    int rv = poll(&pfd, 1, BLOCK_INTERVAL);
+    if (rv == -1 && errno != EINTR) {
+      conn->closed = 1;
+    } else if (rv > 0) {
+      sockconn_fill(conn, fd);
+    } else if (dev_events(0) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void socksv_accept(dev_file_t *f, uint8_t *ready) {
+  while (1) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd = accept(f->handle, (struct sockaddr *)&addr, &addr_len);
+    if (fd == -1) {
+      break;
+    }
+    // refuse the connection when all of the file handles are in use
+    int sb_handle = dev_findfreehandle();
+    if (sb_handle == -1 || !set_nonblocking(fd, 1)) {
+      close(fd);
+      continue;
+    }
+    dev_file_t *cf = dev_getfileptr(sb_handle);
+    memset(cf, 0, sizeof(dev_file_t));
+    snprintf(cf->name, sizeof(cf->name), "SSVR:%s:%d", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+    cf->type = ft_socket_conn;
+    cf->handle = fd;
+    cf->port = ntohs(addr.sin_port);
+    cf->open_flags = f->open_flags;
+
+    sockconn_t *conn = (sockconn_t *)calloc(1, sizeof(sockconn_t));
+    conn->server = f;
+    conn->sb_handle = sb_handle;
+    cf->drv_data = (byte *)conn;
+
+#if USE_EPOLL
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = sb_handle;
+    epoll_ctl(POLL_FD(f), EPOLL_CTL_ADD, fd, &ev);
+#endif
+    ready[sb_handle] = 1;
+  }
+}
+
+static void socksv_event(dev_file_t *f, int sb_handle, int readable, int writable, uint8_t *ready) {
+  if (sb_handle == 0) {
+    socksv_accept(f, ready);
+  } else {
+    dev_file_t *cf = dev_getfileptr(sb_handle);
+    sockconn_t *conn = get_conn(cf);
+    if (cf->type == ft_socket_conn && conn != NULL && conn->server == f) {
+      if (readable) {
+        sockconn_fill(conn, cf->handle);
+      }
+      if (writable) {
+        sockconn_flush(conn, cf->handle);
+        sockconn_watch(cf);
+      }
+      if (conn->in.size || conn->closed) {
+        ready[sb_handle] = 1;
+      }
+    }
+  }
+}
+
+//
+// poll the listener and its connections, returns -1 on error
+//
+static int socksv_poll(dev_file_t *f, int timeout, uint8_t *ready) {
+  int result;
+#if USE_EPOLL
+  struct epoll_event events[MAX_EVENTS];
+  result = epoll_wait(POLL_FD(f), events, MAX_EVENTS, timeout);
+  for (int i = 0; i < result; i++) {
+    int readable = (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0;
+    int writable = (events[i].events & EPOLLOUT) != 0;
+    socksv_event(f, events[i].data.u32, readable, writable, ready);
+  }
+#else
+  struct pollfd fds[OS_FILEHANDLES + 1];
+  int handles[OS_FILEHANDLES + 1];
+  int count = 0;
+  fds[count].fd = f->handle;
+  fds[count].events = POLLIN;
+  handles[count++] = 0;
+  for (int i = 1; i <= OS_FILEHANDLES; i++) {
+    dev_file_t *cf = dev_getopenfile(i);
+    if (cf != NULL && cf->type == ft_socket_conn && get_conn(cf)->server == f) {
+      fds[count].fd = cf->handle;
+      fds[count].events = POLLIN | (get_conn(cf)->out.size ? POLLOUT : 0);
+      handles[count++] = i;
+    }
+  }
+  result = poll(fds, count, timeout);
+  for (int i = 0; i < count && result > 0; i++) {
+    if (fds[i].revents) {
+      int readable = (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+      int writable = (fds[i].revents & POLLOUT) != 0;
+      socksv_event(f, handles[i], readable, writable, ready);
+    }
+  }
+#endif
+  return result;
+}
+
+int socksv_open(dev_file_t *f) {
+  // open "SSVR:8080" as #1
+  // open "SSVR:127.0.0.1:8080" as #1
+  struct sockaddr_in addr;
+  int yes = 1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+
+  char *p = strchr(f->name + 5, ':');
+  if (p) {
+    *p = '\0';
+    addr.sin_addr.s_addr = inet_addr(f->name + 5);
+    *p = ':';
+    addr.sin_port = htons(xstrtol(p + 1));
+  } else {
+    addr.sin_port = htons(xstrtol(f->name + 5));
+  }
+
+  net_init();
+  f->handle = socket(PF_INET, SOCK_STREAM, 0);
+  if (f->handle < 0 ||
+      setsockopt(f->handle, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) == -1 ||
+      bind(f->handle, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      listen(f->handle, SOMAXCONN) == -1 ||
+      !set_nonblocking(f->handle, 1)) {
+    net_disconnect(f->handle);
+    f->handle = -1;
+    err_network();
+    return 0;
+  }
+
+#if USE_EPOLL
+  int poll_fd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u32 = 0;
+  if (poll_fd == -1 || epoll_ctl(poll_fd, EPOLL_CTL_ADD, f->handle, &ev) == -1) {
+    net_disconnect(f->handle);
+    f->handle = -1;
+    err_network();
+    return 0;
+  }
+  POLL_FD(f) = poll_fd;
+#endif
+  return 1;
+}
+
+int socksv_close(dev_file_t *f) {
+  // connections can't outlive their listener
+  for (int i = 1; i <= OS_FILEHANDLES; i++) {
+    dev_file_t *cf = dev_getopenfile(i);
+    if (cf != NULL && cf->type == ft_socket_conn && get_conn(cf)->server == f) {
+      sockconn_close(cf);
+    }
+  }
+#if USE_EPOLL
+  close(POLL_FD(f));
+  POLL_FD(f) = 0;
+#endif
+  net_disconnect(f->handle);
+  f->handle = -1;
+  return 1;
+}
+
+//
+// array <- NETWAIT(fileN [, timeout])
+//
+// returns the handles of new connections and of connections with input or
+// that have been closed by the peer. timeout is in milliseconds, -1 waits
+// until there is an event.
+//
+int socksv_wait(int sb_handle, int timeout, var_t *result) {
+  dev_file_t *f = dev_getfileptr(sb_handle);
+  if (f == NULL) {
+    return 0;
+  }
+  if (f->type != ft_socket_server || f->handle == -1) {
+    rt_raise(ERR_SOCKET_SERVER, sb_handle);
+    return 0;
+  }
+
+  uint8_t ready[OS_FILEHANDLES + 1];
+  memset(ready, 0, sizeof(ready));
+
+  // input that remains unread from a previous wait
+  int count = 0;
+  for (int i = 1; i <= OS_FILEHANDLES; i++) {
+    dev_file_t *cf = dev_getopenfile(i);
+    if (cf != NULL && cf->type == ft_socket_conn) {
+      sockconn_t *conn = get_conn(cf);
+      if (conn->server == f && (conn->in.size || conn->closed)) {
+        ready[i] = 1;
+        count++;
+      }
+    }
+  }
+
+  uint32_t start = dev_get_millisecond_count();
+  while (1) {
+    int interval = BLOCK_INTERVAL;
+    if (count || timeout == 0) {
+      interval = 0;
+    } else if (timeout > 0) {
+      int remaining = timeout - (int)(dev_get_millisecond_count() - start);
+      interval = remaining < 0 ? 0 : remaining < BLOCK_INTERVAL ? remaining : BLOCK_INTERVAL;
+    }
+    if (socksv_poll(f, interval, ready) == -1 && errno != EINTR) {
+      err_network();
+      break;
+    }
+    count = 0;
+    for (int i = 1; i <= OS_FILEHANDLES; i++) {
+      count += ready[i];
+    }
+    if (count || interval == 0 || dev_events(0) != 0) {
+      break;
+    }
+  }
+
+  v_toarray1(result, count);
+  for (int i = 1, j = 0; i <= OS_FILEHANDLES && j < count; i++) {
+    if (ready[i]) {
+      v_setint(v_elem(result, j++), i);
+    }
+  }
+  return count;
+}
+
+int sockconn_close(dev_file_t *f) {
+  sockconn_t *conn = get_conn(f);
+  if (conn != NULL) {
+    if (conn->out.size && !conn->closed) {
+      // deliver any remaining output before hanging up
+      sockconn_drain(conn, f->handle);
+    }
+    sockbuf_free(&conn->in);
+    sockbuf_free(&conn->out);
+    free(conn);
+    f->drv_data = NULL;
+  }
+  net_disconnect(f->handle);
+  f->handle = -1;
+  return 1;
+}
+
+//
+// non-blocking write, anything the socket can't take now is sent by NETWAIT
+//
+int sockconn_write(dev_file_t *f, byte *data, uint32_t size) {
+  sockconn_t *conn = get_conn(f);
+  uint32_t sent = 0;
+  if (conn->closed) {
+    return 0;
+  }
+  if (!conn->out.size) {
+    ssize_t bytes = send(f->handle, data, size, 0);
+    if (bytes > 0) {
+      sent = bytes;
+    } else if (bytes == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      conn->closed = 1;
+      return 0;
+    }
+  }
+  if (sent < size) {
+    memcpy(sockbuf_reserve(&conn->out, size - sent), data + sent, size - sent);
+    conn->out.size += size - sent;
+    if (conn->out.size == size - sent) {
+      // first pending block, wait for the socket to become writable
+      sockconn_watch(f);
+    }
+  }
+  return size;
+}
+
+int sockconn_read(dev_file_t *f, byte *data, uint32_t size) {
+  sockconn_t *conn = get_conn(f);
+  uint32_t count = 0;
+  while (count < size && sockconn_block(conn, f->handle) && conn->in.size) {
+    uint32_t len = size - count < conn->in.size ? size - count : conn->in.size;
+    memcpy(data + count, conn->in.data + conn->in.start, len);
+    sockbuf_consume(&conn->in, len);
+    count += len;
+  }
+  return count;
+}
+
+int sockconn_eof(dev_file_t *f) {
+  sockconn_t *conn = get_conn(f);
+  if (!conn->in.size && !conn->closed) {
+    // detect a hang-up that hasn't yet been reported by NETWAIT
+    sockconn_fill(conn, f->handle);
+  }
+  return conn->closed && !conn->in.size;
+}
+
+int sockconn_length(dev_file_t *f) {
+  sockconn_t *conn = get_conn(f);
+  return conn->in.size + net_peek(f->handle);
+}
+
+#endif
@@ -0,0 +1,30 @@
+// This file is part of SmallBASIC
+//
+// BSD sockets driver (multi-connection server)
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#if !defined(FS_SOCKET_SERVER_H)
+#define FS_SOCKET_SERVER_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+int socksv_open(dev_file_t *f);
+int socksv_close(dev_file_t *f);
+int socksv_wait(int sb_handle, int timeout, var_t *result);
+int sockconn_close(dev_file_t *f);
+int sockconn_write(dev_file_t *f, byte *data, uint32_t size);
+int sockconn_read(dev_file_t *f, byte *data, uint32_t size);
+int sockconn_eof(dev_file_t *f);
+int sockconn_length(dev_file_t *f);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -107,10 +107,11 @@ int stream_write(dev_file_t *f, byte *data, uint32_t size) {
   if (r != (int) size) {
     err_file((f->last_error = errno));
   }
-  return (r == (int) size);
+  return r < 0 ? 0 : r;
 }
 
 /*
+ * returns the number of bytes read
  */
 int stream_read(dev_file_t *f, byte *data, uint32_t size) {
   int r;
@@ -119,7 +120,7 @@ int stream_read(dev_file_t *f, byte *data, uint32_t size) {
   if (r != (int) size) {
     err_file((f->last_error = errno));
   }
-  return (r == (int) size);
+  return r < 0 ? 0 : r;
 }
 
 /*
@@ -13,6 +13,7 @@
 #include "common/var.h"
 #include "common/smbas.h"
 #include "common/hashmap.h"
+#include "common/stats.h"
 
 #define MAP_SIZE 32
 
@@ -30,6 +31,7 @@ typedef struct Node {
  */
 Node *tree_create_node(var_p_t key) {
   Node *node = (Node *)malloc(sizeof(Node));
+  stats_heap_alloc(sizeof(Node));
   node->key = key;
   node->value = NULL;
   node->left = NULL;
@@ -53,6 +55,7 @@ void tree_delete_node(Node *node) {
 
   // cleanup the node
   free(node);
+  stats_heap_free(sizeof(Node));
 }
 
 static inline int tree_compare(const char *key, int length, var_p_t vkey) {
@@ -78,26 +81,34 @@ void tree_destroy(Node *node) {
 }
 
 Node *tree_search(Node **rootp, const char *key, int length) {
+  uint32_t depth = 1;
   while (*rootp != NULL) {
     int r = tree_compare(key, length, (*rootp)->key);
+    depth++;
     if (r == 0) {
+      stats_map_probe(depth);
       return *rootp;
     }
     rootp = (r < 0) ? &(*rootp)->left : &(*rootp)->right;
   }
+  stats_map_probe(depth);
   Node *result = tree_create_node(NULL);
   *rootp = result;
   return result;
 }
 
 Node *tree_find(Node **rootp, const char *key, int length) {
+  uint32_t depth = 1;
   while (*rootp != NULL) {
     int r = tree_compare(key, length, (*rootp)->key);
+    depth++;
     if (r == 0) {
+      stats_map_probe(depth);
       return *rootp;
     }
     rootp = (r < 0) ? &(*rootp)->left : &(*rootp)->right;
   }
+  stats_map_probe(depth);
   return NULL;
 }
 
@@ -134,6 +145,7 @@ void hashmap_create(var_p_t map, int size) {
     map->v.m.size = (size * 100) / 75;
   }
   map->v.m.map = calloc(map->v.m.size, sizeof(Node *));
+  stats_heap_alloc(map->v.m.size * sizeof(Node *));
 }
 
 int hashmap_destroy(var_p_t var_p) {
@@ -145,6 +157,7 @@ int hashmap_destroy(var_p_t var_p) {
       }
     }
     free(var_p->v.m.map);
+    stats_heap_free(var_p->v.m.size * sizeof(Node *));
   }
   return 0;
 }
@@ -163,6 +176,7 @@ static inline Node *hashmap_search(var_p_t map, const char *key, int length) {
   int index = hashmap_get_hash(key, length) % map->v.m.size;
   Node **table = (Node **)map->v.m.map;
   Node *result = table[index];
+  sb_stats.map_lookups++;
   if (result == NULL) {
     // new entry
     result = table[index] = tree_create_node(NULL);
@@ -172,6 +186,8 @@ static inline Node *hashmap_search(var_p_t map, const char *key, int length) {
       result = tree_search(&result->left, key, length);
     } else if (r > 0) {
       result = tree_search(&result->right, key, length);
+    } else {
+      stats_map_probe(1);
     }
   }
   return result;
@@ -182,8 +198,12 @@ static inline Node *hashmap_find(var_p_t map, const char *key) {
   int index = hashmap_get_hash(key, length) % map->v.m.size;
   Node **table = (Node **)map->v.m.map;
   Node *result = table[index];
+  sb_stats.map_lookups++;
   if (result != NULL) {
     int r = tree_compare(key, length, result->key);
+    if (r == 0) {
+      stats_map_probe(1);
+    }
     if (r < 0 && result->left != NULL) {
       result = tree_find(&result->left, key, length);
     } else if (r > 0 && result->right != NULL) {
@@ -202,6 +222,7 @@ var_p_t hashmap_put(var_p_t map, const char *key, int length) {
     node->value = v_new();
     v_setstrn(node->key, key, length);
     map->v.m.count++;
+    sb_stats.map_inserts++;
   }
   return node->value;
 }
@@ -217,6 +238,7 @@ var_p_t hashmap_putc(var_p_t map, const char *key, int length) {
     node->key = var_key;
     node->value = v_new();
     map->v.m.count++;
+    sb_stats.map_inserts++;
   }
   return node->value;
 }
@@ -233,6 +255,7 @@ var_p_t hashmap_putv(var_p_t map, const var_p_t key) {
     node->key = key;
     node->value = v_new();
     map->v.m.count++;
+    sb_stats.map_inserts++;
   } else {
     // discard unused key
     v_free(key);
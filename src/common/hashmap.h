@@ -18,7 +18,7 @@
 typedef struct hashmap_cb {
   var_p_t var;
   var_p_t parent;
-  char *buffer;
+  struct cstr *str;
   int count;
   int index;
   int start;
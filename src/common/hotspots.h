@@ -9,6 +9,7 @@
 
 #include "include/var_map.h"
 #include "common/var_eval.h"
+#include "common/stats.h"
 
 void err_evsyntax(void);
 void err_varisarray(void);
@@ -177,6 +178,7 @@ static inline void v_init(var_t *v) {
  * frees the var or releases it back into the pool
  */
 static inline void v_detach(var_t *v) {
+  stats_heap_free(sizeof(var_t));
   if (v->pooled) {
     v_pool_free(v);
   } else {
@@ -197,6 +199,9 @@ static inline void v_free(var_t *v) {
   switch (v->type) {
   case V_STR:
     if (v->v.p.owner) {
+      if (v->v.p.owner & STR_OWNER_HEAP) {
+        stats_heap_free(v->v.p.length);
+      }
       free(v->v.p.ptr);
     }
     break;
@@ -0,0 +1,332 @@
+// This file is part of SmallBASIC
+//
+// Module functions running as background jobs
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#include "common/sys.h"
+#include "common/pproc.h"
+#include "common/plugins.h"
+#include "common/jobs.h"
+#include "common/stats.h"
+#include "include/var_map.h"
+
+#if defined(_UnixOS) && !defined(_Win32) && !defined(__EMSCRIPTEN__)
+#define USE_JOB_THREADS 1
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#define JOB_ID "id"
+#define JOB_VALUE "value"
+#define JOB_MAX_THREADS 4
+#define JOB_WAIT_MS 10
+
+enum {
+  job_queued,
+  job_running,
+  job_done
+};
+
+// submitted jobs by id, only used on the interpreter thread
+static SB_THREAD job_t **jobs = NULL;
+static SB_THREAD int job_count = 0;
+
+#if defined(USE_JOB_THREADS)
+// the workers of one interpreter thread
+typedef struct job_pool_s {
+  pthread_mutex_t mutex;
+  pthread_cond_t queued_cond;
+  pthread_cond_t done_cond;
+  pthread_t threads[JOB_MAX_THREADS];
+  job_t *head;
+  job_t *tail;
+  int thread_count;
+  int idle;
+  int stop;
+} job_pool_t;
+
+static SB_THREAD job_pool_t job_pool = {
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
+#endif
+
+//
+// calls the module function
+//
+static void job_run(job_t *job) {
+  job->success = job->exec(job->index, job->pcount, job->ptable, &job->ret);
+}
+
+#if defined(USE_JOB_THREADS)
+//
+// runs the queued jobs until job_close
+//
+static void *job_worker(void *arg) {
+  job_pool_t *pool = (job_pool_t *)arg;
+  pthread_mutex_lock(&pool->mutex);
+  while (!pool->stop) {
+    job_t *job = pool->head;
+    if (job == NULL) {
+      pool->idle++;
+      pthread_cond_wait(&pool->queued_cond, &pool->mutex);
+      pool->idle--;
+    } else {
+      pool->head = job->next;
+      if (pool->head == NULL) {
+        pool->tail = NULL;
+      }
+      job->next = NULL;
+      job->state = job_running;
+      pthread_mutex_unlock(&pool->mutex);
+
+      // sb_stats belongs to this thread, the growth is the result's heap
+      uint64_t heap = sb_stats.heap_bytes;
+      job_run(job);
+      job->heap = sb_stats.heap_bytes > heap ? sb_stats.heap_bytes - heap : 0;
+      sb_stats.heap_bytes = heap;
+
+      pthread_mutex_lock(&pool->mutex);
+      job->state = job_done;
+      pthread_cond_broadcast(&pool->done_cond);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return NULL;
+}
+#endif
+
+//
+// returns whether the job has finished, waiting up to ms for it to finish
+//
+static int job_finished(job_t *job, int ms) {
+#if defined(USE_JOB_THREADS)
+  pthread_mutex_lock(&job_pool.mutex);
+  if (job->state != job_done && ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += ms * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&job_pool.done_cond, &job_pool.mutex, &ts);
+  }
+  int result = (job->state == job_done);
+  pthread_mutex_unlock(&job_pool.mutex);
+  if (result && job->heap) {
+    // the result is now released against the interpreter's heap count
+    stats_heap_alloc(job->heap);
+    job->heap = 0;
+  }
+  return result;
+#else
+  return job->state == job_done;
+#endif
+}
+
+//
+// releases the job and the values it owns
+//
+static void job_release(job_t *job) {
+  for (int i = 0; i < job->pcount; i++) {
+    v_free(&job->args[i]);
+  }
+  v_free(&job->ret);
+  free(job);
+}
+
+//
+// returns the job for the job object
+//
+static job_t *job_get(var_t *self) {
+  int id = map_get_int(self, JOB_ID, -1);
+  return (id >= 0 && id < job_count) ? jobs[id] : NULL;
+}
+
+//
+// releases the finished jobs no longer held by any variable
+//
+static void job_reap() {
+  for (int i = 0; i < job_count; i++) {
+    job_t *job = jobs[i];
+    if (job != NULL && job->refs == 0 && job_finished(job, 0)) {
+      jobs[i] = NULL;
+      job_release(job);
+    }
+  }
+}
+
+//
+// copies the result of the finished job into the job object
+//
+static void job_collect(var_t *self, job_t *job) {
+  var_t *value = map_add_var(self, JOB_VALUE, 0);
+  v_set(value, &job->ret);
+  if (!job->success) {
+    if (value->type == V_STR) {
+      err_throw("LIB:%s: %s\n", job->lib_name, value->v.p.ptr);
+    } else {
+      err_throw("LIB:%s: Unspecified error calling FUNC\n", job->lib_name);
+    }
+  }
+}
+
+/*
+ * done = job.ready()
+ */
+static void job_ready(var_t *self, var_t *retval) {
+  job_t *job = job_get(self);
+  int done = (job == NULL || job_finished(job, 0));
+  if (retval != NULL) {
+    v_setint(retval, done);
+  }
+}
+
+/*
+ * value = job.wait()
+ */
+static void job_wait(var_t *self, var_t *retval) {
+  job_t *job = job_get(self);
+  if (job != NULL) {
+    // keep handling events while the job runs
+    while (!job_finished(job, JOB_WAIT_MS)) {
+      if (dev_events(0) < 0 || prog_error) {
+        return;
+      }
+    }
+    job_collect(self, job);
+  }
+  var_t *value = map_get(self, JOB_VALUE);
+  if (retval != NULL && value != NULL && !prog_error) {
+    v_set(retval, value);
+  }
+}
+
+job_t *job_new(job_exec_fn exec, const char *lib_name, int index) {
+  job_t *job = (job_t *)calloc(1, sizeof(job_t));
+  if (job != NULL) {
+    job->exec = exec;
+    job->lib_name = lib_name;
+    job->index = index;
+    job->state = job_queued;
+    v_init(&job->ret);
+  }
+  return job;
+}
+
+void job_submit(job_t *job, int pcount, var_t *result) {
+  // the worker can't share the program's variables
+  for (int i = 0; i < pcount; i++) {
+    if (job->ptable[i].byref) {
+      v_init(&job->args[i]);
+      v_set(&job->args[i], job->ptable[i].var_p);
+      job->ptable[i].var_p = &job->args[i];
+      job->ptable[i].byref = 0;
+    }
+  }
+  job->pcount = pcount;
+
+  // reuse the slots of the dropped jobs that have since finished
+  job_reap();
+
+  int id = 0;
+  while (id < job_count && jobs[id] != NULL) {
+    id++;
+  }
+  if (id == job_count) {
+    job_t **list = (job_t **)realloc(jobs, sizeof(job_t *) * (job_count + 1));
+    if (list == NULL) {
+      err_throw("JOB: out of memory");
+      job_discard(job, pcount);
+      return;
+    }
+    jobs = list;
+    jobs[job_count++] = NULL;
+  }
+  jobs[id] = job;
+  job->id = id;
+
+  job->refs = 1;
+
+  map_init(result);
+  result->v.m.cls_id = MAP_CLS_JOB;
+  map_add_var(result, JOB_ID, id);
+  v_create_func(result, "ready", job_ready);
+  v_create_func(result, "wait", job_wait);
+
+  int run_now = 1;
+#if defined(USE_JOB_THREADS)
+  job_pool_t *pool = &job_pool;
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->idle == 0 && pool->thread_count < JOB_MAX_THREADS &&
+      pthread_create(&pool->threads[pool->thread_count], NULL, job_worker, pool) == 0) {
+    pool->thread_count++;
+  }
+  if (pool->thread_count) {
+    if (pool->tail != NULL) {
+      pool->tail->next = job;
+    } else {
+      pool->head = job;
+    }
+    pool->tail = job;
+    pthread_cond_signal(&pool->queued_cond);
+    run_now = 0;
+  }
+  pthread_mutex_unlock(&pool->mutex);
+#endif
+  if (run_now) {
+    job_run(job);
+    job->state = job_done;
+  }
+}
+
+void job_discard(job_t *job, int pcount) {
+  plugin_free_ptable(job->ptable, pcount);
+  v_free(&job->ret);
+  free(job);
+}
+
+void job_retain_handle(var_t *handle) {
+  job_t *job = job_get(handle);
+  if (job != NULL) {
+    job->refs++;
+  }
+}
+
+void job_release_handle(var_t *handle) {
+  job_t *job = job_get(handle);
+  if (job != NULL && --job->refs == 0 && job_finished(job, 0)) {
+    jobs[job->id] = NULL;
+    job_release(job);
+  }
+}
+
+void job_close() {
+#if defined(USE_JOB_THREADS)
+  job_pool_t *pool = &job_pool;
+  pthread_mutex_lock(&pool->mutex);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->queued_cond);
+  pthread_mutex_unlock(&pool->mutex);
+  for (int i = 0; i < pool->thread_count; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+  pool->thread_count = 0;
+  pool->idle = 0;
+  pool->stop = 0;
+  pool->head = pool->tail = NULL;
+#endif
+  for (int i = 0; i < job_count; i++) {
+    if (jobs[i] != NULL) {
+      job_finished(jobs[i], 0);
+      job_release(jobs[i]);
+    }
+  }
+  free(jobs);
+  jobs = NULL;
+  job_count = 0;
+}
@@ -0,0 +1,85 @@
+// This file is part of SmallBASIC
+//
+// Module functions running as background jobs
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#if !defined(SB_JOBS)
+#define SB_JOBS
+
+#include "common/sys.h"
+#include "common/var.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define JOB_MAX_PARAM 16
+
+typedef int (*job_exec_fn)(int, int, slib_par_t *, var_t *);
+
+typedef struct job_s job_t;
+
+//
+// a call to a module function made on a worker thread. the arguments and
+// the result belong to the job, and are only created or released on the
+// interpreter thread. the worker has no variable pool, so the variables
+// it creates for the result are allocated with malloc, and the memory they
+// use is added to the interpreter's heap count once the job has finished.
+//
+struct job_s {
+  job_exec_fn exec;
+  const char *lib_name;
+  int index;
+  int pcount;
+  slib_par_t ptable[JOB_MAX_PARAM];
+  var_t args[JOB_MAX_PARAM];
+  var_t ret;
+  int success;
+  int state;
+  int id;
+  int refs;
+  uint64_t heap;      // heap counted by the worker, charged on collection
+  job_t *next;
+};
+
+//
+// returns a new job for the module function
+//
+job_t *job_new(job_exec_fn exec, const char *lib_name, int index);
+
+//
+// queues the job, the parameters were built into the job's ptable and args.
+// result is set to the job object having ready() and wait() methods.
+//
+void job_submit(job_t *job, int pcount, var_t *result);
+
+//
+// releases a job that was not submitted
+//
+void job_discard(job_t *job, int pcount);
+
+//
+// records another variable sharing the job object
+//
+void job_retain_handle(var_t *handle);
+
+//
+// releases the job once no variable holds it, a running job is released
+// after it finishes
+//
+void job_release_handle(var_t *handle);
+
+//
+// waits for the running jobs and releases them
+//
+void job_close();
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -15,9 +15,9 @@
 #include "common/keymap.h"
 
 //  Keyboard buffer
-uint32_t keybuff[PCKBSIZE];
-int keyhead;
-int keytail;
+SB_THREAD uint32_t keybuff[PCKBSIZE];
+SB_THREAD int keyhead;
+SB_THREAD int keytail;
 
 typedef struct key_map_s key_map_s;
 
@@ -30,7 +30,7 @@ struct key_map_s {
   int key;         // key definition
 };
 
-key_map_s *keymap = 0;
+SB_THREAD key_map_s *keymap = 0;
 
 /**
  * Prepare task_t exec.keymap for keymap handling at program init
@@ -193,51 +193,127 @@ long int dev_getch() {
   return ch;
 }
 
-void timer_free(timer_s *timer) {
-  if (timer) {
-    timer_free(timer->next);
-    free(timer);
+// missed intervals beyond this many are dropped by TIMER_CATCHUP
+#define TIMER_CATCHUP_LIMIT 16
+
+// wrap safe comparison of millisecond times
+#define TIMER_BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
+static void timer_swap(timer_s **timers, int i, int j) {
+  timer_s *t = timers[i];
+  timers[i] = timers[j];
+  timers[j] = t;
+}
+
+//
+// moves the timer at index i up to its place in the heap
+//
+static void timer_sift_up(timer_heap_s *heap, int i) {
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!TIMER_BEFORE(heap->timers[i]->value, heap->timers[parent]->value)) {
+      break;
+    }
+    timer_swap(heap->timers, i, parent);
+    i = parent;
   }
 }
 
-void timer_add(var_num_t interval, bcip_t ip) {
-  timer_s *timer = (timer_s *)malloc(sizeof (timer_s));
-  timer->next = NULL;
-  timer->ip = ip;
-  timer->interval = interval;
-  timer->value = 0;
-  timer->active = 0;
+//
+// moves the timer at index i down to its place in the heap
+//
+static void timer_sift_down(timer_heap_s *heap, int i) {
+  for (;;) {
+    int left = i * 2 + 1;
+    int right = left + 1;
+    int next = i;
+    if (left < heap->count && TIMER_BEFORE(heap->timers[left]->value, heap->timers[next]->value)) {
+      next = left;
+    }
+    if (right < heap->count && TIMER_BEFORE(heap->timers[right]->value, heap->timers[next]->value)) {
+      next = right;
+    }
+    if (next == i) {
+      break;
+    }
+    timer_swap(heap->timers, i, next);
+    i = next;
+  }
+}
 
-  // add the new timer onto the linked list
-  timer_s* head = prog_timer;
-  if (!head) {
-    prog_timer = timer;
+static void timer_push(timer_heap_s *heap, timer_s *timer) {
+  if (heap->count == heap->size) {
+    heap->size = heap->size ? heap->size * 2 : 8;
+    heap->timers = realloc(heap->timers, sizeof(timer_s *) * heap->size);
+  }
+  heap->timers[heap->count] = timer;
+  timer_sift_up(heap, heap->count++);
+}
+
+static timer_s *timer_pop(timer_heap_s *heap) {
+  timer_s *result = heap->timers[0];
+  heap->timers[0] = heap->timers[--heap->count];
+  timer_sift_down(heap, 0);
+  return result;
+}
+
+//
+// advances the timer beyond the given time according to its policy
+//
+static void timer_schedule(timer_s *timer, uint32_t now) {
+  if (timer->policy == TIMER_DELAY) {
+    // next interval starts when the handler completes
+    timer->value = dev_get_millisecond_count() + timer->interval;
   } else {
-    while (head->next) {
-      head = head->next;
+    timer->value += timer->interval;
+    if (!TIMER_BEFORE(now, timer->value) &&
+        (timer->policy != TIMER_CATCHUP || now - timer->value > timer->interval * TIMER_CATCHUP_LIMIT)) {
+      // keep the phase, dropping the missed intervals
+      timer->value += ((now - timer->value) / timer->interval + 1) * timer->interval;
     }
-    head->next = timer;
   }
 }
 
-void timer_run(uint32_t now) {
-  timer_s *timer = prog_timer;
-  while (timer) {
-    if (timer->value == 0) {
-      // start timer
-      timer->value = now + timer->interval;
-    } else if (now > timer->value && !timer->active) {
-      // timer expired
-      timer->active = 1;
-      bcip_t ip = prog_ip;
-      prog_ip = timer->ip;
-      bc_loop(1);
-      prog_ip = ip;
-
-      // reset for next interval
-      timer->value = now + timer->interval;
-      timer->active = 0;
+void timer_free(timer_heap_s *heap) {
+  if (heap) {
+    for (int i = 0; i < heap->count; i++) {
+      free(heap->timers[i]);
     }
-    timer = timer->next;
+    free(heap->timers);
+    free(heap);
+  }
+}
+
+void timer_add(var_num_t interval, bcip_t ip, int policy) {
+  timer_s *timer = (timer_s *)malloc(sizeof (timer_s));
+  timer->ip = ip;
+  timer->interval = interval < 1 ? 1 : (uint32_t)interval;
+  timer->policy = policy;
+  timer->value = dev_get_millisecond_count() + timer->interval;
+
+  if (!prog_timer) {
+    prog_timer = (timer_heap_s *)calloc(1, sizeof(timer_heap_s));
+  }
+  timer_push(prog_timer, timer);
+}
+
+int timer_due(uint32_t now) {
+  return prog_timer->count && !TIMER_BEFORE(now, prog_timer->timers[0]->value);
+}
+
+void timer_run(uint32_t now) {
+  timer_heap_s *heap = prog_timer;
+  while (heap->count && !TIMER_BEFORE(now, heap->timers[0]->value) && !prog_error) {
+    // the timer leaves the heap while its handler runs, so it is not
+    // invoked again from any nested bc_loop()
+    timer_s *timer = timer_pop(heap);
+    bcip_t ip = prog_ip;
+    prog_ip = timer->ip;
+    bc_loop(1);
+    prog_ip = ip;
+
+    now = dev_get_millisecond_count();
+    timer_schedule(timer, now);
+    timer_push(heap, timer);
   }
 }
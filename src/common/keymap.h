@@ -92,8 +92,14 @@ int keymap_invoke(uint32_t key);
 int keymap_kbhit();
 int keymap_kbpeek();
 
-void timer_free(timer_s *timer);
-void timer_add(var_num_t timer, bcip_t ip);
+// TIMER policies for missed intervals
+#define TIMER_SKIP    0
+#define TIMER_CATCHUP 1
+#define TIMER_DELAY   2
+
+void timer_free(timer_heap_s *heap);
+void timer_add(var_num_t interval, bcip_t ip, int policy);
+int timer_due(uint32_t now);
 void timer_run(uint32_t now);
 
 #if defined(__cplusplus)
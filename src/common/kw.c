@@ -24,6 +24,7 @@ bid_t kw_noarg_func_table[] = {
   kwXPOS,
   kwYPOS,
   kwRND,
+  kwSYSINFO,
   0
 };
 
@@ -44,6 +44,7 @@ extern "C" {
 #define OPLOG_LIKE      'W'     // LIKE wc
 #define OPLOG_LSHIFT    'X'     // LSHIFT
 #define OPLOG_RSHIFT    'Y'     // RSHIFT
+#define OPLOG_SQR       'Q'     // x^2 (optimiser)
 
 /**
  * @ingroup sys
@@ -176,6 +177,9 @@ enum keyword {
   kwCATCH,
   kwENDTRY,
   kwFUNC_RETURN,
+  kwLET_INC, /* v = v + int */
+  kwLET_ELEM, /* v(index) = any */
+  kwIF_CMP, /* IF v <cmp> v|int */
   kwNULL
 };
 
@@ -246,6 +250,8 @@ enum proc_keywords {
   kwDEFINEKEY,
   kwSHOWPAGE,
   kwTHROW,
+  kwCSVREAD,
+  kwCSVWRITE,
   kwNULLPROC
 };
 
@@ -403,6 +409,10 @@ enum func_keywords {
   kwIMAGE,
   kwFORM,
   kwTIMESTAMP,
+  kwNETWAIT,
+  kwSTRBUILDER,
+  kwDIRSCAN,
+  kwSYSINFO,
   kwNULLFUNC
 };
 
@@ -27,6 +27,8 @@
 #if defined(LNX_EXTLIB) || defined(WIN_EXTLIB)
 #include "common/plugins.h"
 #include "common/pproc.h"
+#include "common/symindex.h"
+#include "common/jobs.h"
 #include <dirent.h>
 
 #define MAX_SLIBS 64
@@ -41,6 +43,14 @@ typedef int (*sblib_count_fn) (void);
 typedef int (*sblib_init_fn) (const char *);
 typedef int (*sblib_free_fn) (int, int);
 typedef void (*sblib_close_fn) (void);
+typedef sblib_fast_fn (*sblib_getfast_fn) (int, int *);
+typedef int (*sblib_async_fn) (int);
+
+// a function using the fast calling convention
+typedef struct {
+  sblib_fast_fn _fn;
+  int _arity;
+} slib_fast_t;
 
 typedef struct {
   char _fullname[PATH_SIZE];
@@ -51,6 +61,10 @@ typedef struct {
   sblib_free_fn _sblib_free;
   ext_func_node_t *_func_list;
   ext_proc_node_t *_proc_list;
+  slib_fast_t *_fast_list;
+  uint8_t *_async_list;
+  sym_index_t _func_index;
+  sym_index_t _proc_index;
   uint32_t _id;
   uint32_t _flags;
   uint32_t _proc_count;
@@ -60,7 +74,7 @@ typedef struct {
   uint8_t  _imported;
 } slib_t;
 
-static slib_t *plugins[MAX_SLIBS];
+static SB_THREAD slib_t *plugins[MAX_SLIBS];
 
 #if defined(LNX_EXTLIB)
 int slib_llopen(slib_t *lib) {
@@ -355,25 +369,133 @@ static void slib_import_routines(slib_t *lib, int comp) {
 
   if (!total) {
     log_printf("LIB: module '%s' has no exports\n", lib->_name);
+  } else if (!lib->_imported) {
+    // index the names for linking
+    if (lib->_proc_count) {
+      sym_index_build(&lib->_proc_index, lib->_proc_list[0].name,
+                      sizeof(ext_proc_node_t), lib->_proc_count);
+    }
+    if (lib->_func_count) {
+      sym_index_build(&lib->_func_index, lib->_func_list[0].name,
+                      sizeof(ext_func_node_t), lib->_func_count);
+    }
+    // functions using the fast calling convention
+    sblib_getfast_fn getfast = slib_getoptptr(lib, "sblib_func_fast");
+    if (getfast && lib->_func_count) {
+      lib->_fast_list = (slib_fast_t *)calloc(lib->_func_count, sizeof(slib_fast_t));
+      for (int i = 0; lib->_fast_list && i < lib->_func_count; i++) {
+        int arity = 0;
+        sblib_fast_fn fn = getfast(i, &arity);
+        if (fn && arity >= 0 && arity <= SBLIB_FAST_ARGS) {
+          lib->_fast_list[i]._fn = fn;
+          lib->_fast_list[i]._arity = arity;
+        }
+      }
+    }
+    // functions able to run as background jobs
+    sblib_async_fn isasync = slib_getoptptr(lib, "sblib_func_async");
+    if (isasync && lib->_func_count) {
+      lib->_async_list = (uint8_t *)calloc(lib->_func_count, sizeof(uint8_t));
+      for (int i = 0; lib->_async_list && i < lib->_func_count; i++) {
+        lib->_async_list[i] = isasync(i) ? 1 : 0;
+      }
+    }
   }
 }
 
+//
+// execute a function using the fast calling convention, the arguments
+// are evaluated directly into numbers
+//
+static int slib_exec_fast(slib_t *lib, slib_fast_t *fast, var_t *ret) {
+  double args[SBLIB_FAST_ARGS];
+  int argc = 0;
+
+  if (code_peek() == kwTYPE_LEVEL_BEGIN) {
+    code_skipnext();
+    byte ready = 0;
+    var_t arg;
+    v_init(&arg);
+    do {
+      switch (code_peek()) {
+      case kwTYPE_EOC:
+        code_skipnext();
+        break;
+      case kwTYPE_SEP:
+        code_skipsep();
+        break;
+      case kwTYPE_LEVEL_END:
+        ready = 1;
+        break;
+      default:
+        if (argc == SBLIB_FAST_ARGS) {
+          err_parm_limit(SBLIB_FAST_ARGS);
+        } else {
+          eval(&arg);
+          args[argc++] = v_getval(&arg);
+          v_free(&arg);
+        }
+      }
+    } while (!ready && !prog_error);
+    // kwTYPE_LEVEL_END
+    code_skipnext();
+  }
+
+  if (!prog_error && argc != fast->_arity) {
+    err_parm_num(argc, fast->_arity);
+  }
+  if (prog_error) {
+    return 0;
+  }
+  v_setreal(ret, fast->_fn(args));
+  return 1;
+}
+
+//
+// start a function as a background job, the result is the job object
+//
+static int slib_exec_async(slib_t *lib, var_t *ret, int index) {
+  job_t *job = job_new(lib->_sblib_func_exec, lib->_name, index);
+  if (job == NULL) {
+    err_throw("LIB:%s: failed to create job\n", lib->_name);
+    return 0;
+  }
+  int pcount = 0;
+  if (code_peek() == kwTYPE_LEVEL_BEGIN) {
+    pcount = plugin_build_ptable(job->ptable, job->args, JOB_MAX_PARAM);
+  }
+  if (prog_error) {
+    job_discard(job, pcount);
+    return 0;
+  }
+  v_init(ret);
+  job_submit(job, pcount, ret);
+  return !prog_error;
+}
+
 //
 // execute a function or procedure
 //
 static int slib_exec(slib_t *lib, var_t *ret, int index, int proc) {
-  slib_par_t *ptable;
+  if (!proc && lib->_async_list && lib->_async_list[index]) {
+    return slib_exec_async(lib, ret, index);
+  }
+  if (!proc && lib->_fast_list && lib->_fast_list[index]._fn) {
+    v_init(ret);
+    return slib_exec_fast(lib, &lib->_fast_list[index], ret);
+  }
+
+  // the parameters and the by-value arguments live on the stack
+  slib_par_t ptable[MAX_PARAM];
+  var_t args[MAX_PARAM];
   int pcount;
   if (code_peek() == kwTYPE_LEVEL_BEGIN) {
-    ptable = (slib_par_t *)malloc(sizeof(slib_par_t) * MAX_PARAM);
-    pcount = plugin_build_ptable(ptable, MAX_PARAM);
+    pcount = plugin_build_ptable(ptable, args, MAX_PARAM);
   } else {
-    ptable = NULL;
     pcount = 0;
   }
   if (prog_error) {
     plugin_free_ptable(ptable, pcount);
-    free(ptable);
     return 0;
   }
 
@@ -395,10 +517,7 @@ static int slib_exec(slib_t *lib, var_t *ret, int index, int proc) {
   }
 
   // clean-up
-  if (ptable) {
-    plugin_free_ptable(ptable, pcount);
-    free(ptable);
-  }
+  plugin_free_ptable(ptable, pcount);
 
   if (success && v_is_type(ret, V_MAP)) {
     map_set_lib_id(ret, lib->_id);
@@ -477,17 +596,16 @@ int plugin_get_kid(int lib_id, const char *name) {
   if (lib != NULL) {
     const char *dot = strchr(name, '.');
     const char *field = (dot != NULL ? dot + 1 : name);
-    for (int i = 0; i < lib->_proc_count; i++) {
-      if (lib->_proc_list[i].lib_id == lib_id &&
-          strcmp(lib->_proc_list[i].name, field) == 0) {
+    if (lib->_proc_count) {
+      int i = sym_index_find(&lib->_proc_index, lib->_proc_list[0].name,
+                             sizeof(ext_proc_node_t), field);
+      if (i != -1) {
         return i;
       }
     }
-    for (int i = 0; i < lib->_func_count; i++) {
-      if (lib->_func_list[i].lib_id == lib_id &&
-          strcmp(lib->_func_list[i].name, field) == 0) {
-        return i;
-      }
+    if (lib->_func_count) {
+      return sym_index_find(&lib->_func_index, lib->_func_list[0].name,
+                            sizeof(ext_func_node_t), field);
     }
   }
   return -1;
@@ -538,7 +656,13 @@ void plugin_free(int lib_id, int cls_id, int id) {
   }
 }
 
+void plugin_reset() {
+  job_close();
+}
+
 void plugin_close() {
+  // finish with the module functions before unloading
+  job_close();
   for (int i = 0; i < MAX_SLIBS; i++) {
     if (plugins[i]) {
       slib_t *lib = plugins[i];
@@ -551,6 +675,10 @@ void plugin_close() {
       }
       free(lib->_proc_list);
       free(lib->_func_list);
+      free(lib->_fast_list);
+      free(lib->_async_list);
+      sym_index_free(&lib->_proc_index);
+      sym_index_free(&lib->_func_index);
       free(lib);
     }
     plugins[i] = NULL;
@@ -567,10 +695,11 @@ void *plugin_get_func(const char *name) { return 0; }
 int plugin_procexec(int lib_id, int index) { return -1; }
 int plugin_funcexec(int lib_id, int index, var_t *ret) { return -1; }
 void plugin_free(int lib_id, int cls_id, int id) {}
+void plugin_reset() {}
 void plugin_close() {}
 #endif
 
-int plugin_build_ptable(slib_par_t *ptable, int size) {
+int plugin_build_ptable(slib_par_t *ptable, var_t *args, int size) {
   int pcount = 0;
   var_t *arg;
   bcip_t ofs;
@@ -606,7 +735,8 @@ int plugin_build_ptable(slib_par_t *ptable, int size) {
         // no 'break' here
       default:
         // default --- expression (BYVAL ONLY)
-        arg = v_new();
+        arg = &args[pcount];
+        v_init(arg);
         eval(arg);
         if (!prog_error) {
           // push parameter
@@ -615,7 +745,6 @@ int plugin_build_ptable(slib_par_t *ptable, int size) {
           pcount++;
         } else {
           v_free(arg);
-          v_detach(arg);
           return pcount;
         }
       }
@@ -633,7 +762,6 @@ void plugin_free_ptable(slib_par_t *ptable, int pcount) {
   for (int i = 0; i < pcount; i++) {
     if (ptable[i].byref == 0) {
       v_free(ptable[i].var_p);
-      v_detach(ptable[i].var_p);
     }
   }
 }
@@ -60,15 +60,20 @@ int plugin_funcexec(int lib_id, int index, var_t *ret);
 //
 void plugin_free(int lib_id, int cls_id, int id);
 
+//
+// finishes the jobs started by the program, keeping the modules loaded
+//
+void plugin_reset();
+
 //
 // closes the plugin system
 //
 void plugin_close();
 
 //
-// build parameter table
+// build parameter table, the by-value arguments are evaluated into args
 //
-int plugin_build_ptable(slib_par_t *ptable, int size);
+int plugin_build_ptable(slib_par_t *ptable, var_t *args, int size);
 
 //
 // free parameter table
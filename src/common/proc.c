@@ -15,6 +15,11 @@
 #include <limits.h>
 #include <dirent.h>
 
+#if defined(_UnixOS) && !defined(_Win32) && !defined(__EMSCRIPTEN__)
+#define USE_MAP_FILE 1
+#include <sys/mman.h>
+#endif
+
 /*
  * returns the last-modified time of the file
  *
@@ -29,6 +34,39 @@ time_t sys_filetime(const char *file) {
   return 0L;
 }
 
+/*
+ * maps the first size bytes of the open file read-only. the pages come
+ * from the page cache so they are shared by every task and process using
+ * the same file. at least pad readable bytes must follow the image.
+ *
+ * returns NULL when the file could not be mapped
+ */
+byte *sys_map_file(int h, uint32_t size, uint32_t pad) {
+  byte *result = NULL;
+#if defined(USE_MAP_FILE)
+  struct stat st;
+  long page = sysconf(_SC_PAGESIZE);
+  if (size && page > 0 && fstat(h, &st) == 0 && st.st_size >= (off_t)size &&
+      (pad == 0 || (size % page && page - (size % page) >= pad))) {
+    // the padding is read from the zero-filled end of the last page
+    void *image = mmap(NULL, size, PROT_READ, MAP_PRIVATE, h, 0);
+    if (image != MAP_FAILED) {
+      result = (byte *)image;
+    }
+  }
+#endif
+  return result;
+}
+
+/*
+ * releases an image returned by sys_map_file
+ */
+void sys_unmap_file(byte *image, uint32_t size) {
+#if defined(USE_MAP_FILE)
+  munmap(image, size);
+#endif
+}
+
 /*
  * search a set of directories for the given file
  * directories on path must be separated with symbol ':' (unix) or ';' (dos/win)
@@ -151,16 +189,8 @@ void exec_usefunc2(var_t *var1, var_t *var2, bcip_t ip) {
   v_detach(old_y);
 }
 
-void pv_write_str(char *str, var_t *vp) {
-  vp->v.p.length += strlen(str);
-  if (vp->v.p.ptr == NULL) {
-    vp->v.p.ptr = malloc(vp->v.p.length + 1);
-    vp->v.p.owner = 1;
-    strcpy(vp->v.p.ptr, str);
-  } else {
-    vp->v.p.ptr = realloc(vp->v.p.ptr, vp->v.p.length + 1);
-    strcat(vp->v.p.ptr, str);
-  }
+void pv_write_str(const char *str, int len, var_t *vp) {
+  v_strappend(vp, str, len);
 }
 
 void pv_write_str_var(var_t *var, int method, intptr_t handle) {
@@ -172,7 +202,7 @@ void pv_write_str_var(var_t *var, int method, intptr_t handle) {
     lwrite(var->v.p.ptr);
     break;
   case PV_STRING:
-    pv_write_str(var->v.p.ptr, (var_t *)handle);
+    pv_write_str(var->v.p.ptr, v_strlen(var), (var_t *)handle);
     break;
   case PV_NET:
     net_send((socket_t)handle, (const char *)var->v.p.ptr, var->v.p.length - 1);
@@ -194,7 +224,7 @@ void pv_write(char *str, int method, intptr_t handle) {
     lwrite(str);
     break;
   case PV_STRING:
-    pv_write_str(str, (var_t *)handle);
+    pv_write_str(str, strlen(str), (var_t *)handle);
     break;
   case PV_NET:
     net_print((socket_t)handle, (const char *)str);
@@ -0,0 +1,525 @@
+// This file is part of SmallBASIC
+//
+// Line and procedure profiler
+//
+// Time, commands and variable allocations are charged to the current
+// source line and to the innermost user-defined procedure or function
+// whenever the line changes or a procedure is entered or left. Each
+// procedure also accumulates its inclusive time, counted once for
+// recursive calls, and each distinct call path keeps its own exclusive
+// time for the folded stack output.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#include "common/sys.h"
+#include "common/pproc.h"
+#include "common/profile.h"
+
+#include <time.h>
+
+#define PROFILE_HASH_SIZE 1024
+#define PROFILE_TOP_LINES 100
+#define PROFILE_NAME_SIZE 64
+
+// a source line or a user-defined procedure
+typedef struct profile_entry_s {
+  struct profile_entry_s *next;
+  int tid;
+  bcip_t addr;                  // source line, or the procedure address
+  int line;                     // procedure: the line of the declaration
+  uint32_t count;               // line executions or procedure calls
+  uint32_t active;              // procedure: frames on the call stack
+  uint64_t time;                // exclusive time in nanoseconds
+  uint64_t inclusive;
+  uint64_t ops;
+  uint64_t allocs;
+  char name[PROFILE_NAME_SIZE];
+} profile_entry_t;
+
+// a node in the tree of call paths
+typedef struct profile_node_s {
+  struct profile_node_s *parent;
+  struct profile_node_s *child;
+  struct profile_node_s *next;
+  profile_entry_t *proc;
+  uint64_t time;
+} profile_node_t;
+
+// a procedure on the call stack
+typedef struct profile_frame_s {
+  profile_entry_t *proc;
+  profile_node_t *node;
+  int tid;
+  int stack_pos;                // prog_stack_count after the call node was pushed
+  bcip_t ret_ip;
+  uint64_t start;
+} profile_frame_t;
+
+typedef struct profile_s {
+  profile_entry_t *lines[PROFILE_HASH_SIZE];
+  profile_entry_t *procs[PROFILE_HASH_SIZE];
+  profile_entry_t *line;
+  profile_node_t *root;
+  profile_frame_t *frames;
+  int frame_count;
+  int frame_size;
+  int line_count;
+  int proc_count;
+  int tid;                      // the main program task
+  uint64_t start;
+  uint64_t last_time;
+  uint64_t last_ops;
+  uint64_t last_allocs;
+  char file[OS_PATHNAME_SIZE + 1];
+  char output[OS_PATHNAME_SIZE + 1];
+  char name[OS_PATHNAME_SIZE + 1];
+} profile_t;
+
+// a procedure recorded by the compiler
+typedef struct profile_proc_s {
+  char name[PROFILE_NAME_SIZE];
+  bcip_t addr;
+  int line;
+} profile_proc_t;
+
+SB_THREAD uint64_t profile_ops = 0;
+SB_THREAD uint64_t profile_allocs = 0;
+static SB_THREAD profile_t *profile = NULL;
+static SB_THREAD profile_proc_t *profile_procs = NULL;
+static SB_THREAD int profile_proc_count = 0;
+
+//
+// returns the monotonic time in nanoseconds
+//
+static uint64_t profile_clock(void) {
+#if defined(_Win32)
+  return (uint64_t)dev_get_millisecond_count() * 1000000;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+//
+// returns the entry for the task and address, creating it when not found
+//
+static profile_entry_t *profile_get(profile_entry_t **table, int *count, int tid, bcip_t addr) {
+  unsigned index = ((unsigned)addr * 31 + tid) % PROFILE_HASH_SIZE;
+  profile_entry_t *entry = table[index];
+  while (entry != NULL && (entry->addr != addr || entry->tid != tid)) {
+    entry = entry->next;
+  }
+  if (entry == NULL) {
+    entry = calloc(1, sizeof(profile_entry_t));
+    entry->tid = tid;
+    entry->addr = addr;
+    entry->next = table[index];
+    table[index] = entry;
+    (*count)++;
+  }
+  return entry;
+}
+
+//
+// returns the child node of the call path for the given procedure
+//
+static profile_node_t *profile_child(profile_node_t *parent, profile_entry_t *proc) {
+  profile_node_t *node = parent->child;
+  while (node != NULL && node->proc != proc) {
+    node = node->next;
+  }
+  if (node == NULL) {
+    node = calloc(1, sizeof(profile_node_t));
+    node->parent = parent;
+    node->proc = proc;
+    node->next = parent->child;
+    parent->child = node;
+  }
+  return node;
+}
+
+static void profile_free_nodes(profile_node_t *node) {
+  while (node != NULL) {
+    profile_node_t *next = node->next;
+    profile_free_nodes(node->child);
+    free(node);
+    node = next;
+  }
+}
+
+static void profile_free_table(profile_entry_t **table) {
+  for (int i = 0; i < PROFILE_HASH_SIZE; i++) {
+    profile_entry_t *entry = table[i];
+    while (entry != NULL) {
+      profile_entry_t *next = entry->next;
+      free(entry);
+      entry = next;
+    }
+  }
+}
+
+//
+// charges the time, commands and allocations since the last event
+//
+static uint64_t profile_charge(void) {
+  uint64_t now = profile_clock();
+  uint64_t time = now - profile->last_time;
+  uint64_t ops = profile_ops - profile->last_ops;
+  uint64_t allocs = profile_allocs - profile->last_allocs;
+
+  if (profile->line != NULL) {
+    profile->line->time += time;
+    profile->line->ops += ops;
+    profile->line->allocs += allocs;
+  }
+  if (profile->frame_count) {
+    profile_frame_t *frame = &profile->frames[profile->frame_count - 1];
+    frame->proc->time += time;
+    frame->proc->ops += ops;
+    frame->proc->allocs += allocs;
+    frame->node->time += time;
+  } else {
+    profile->root->time += time;
+  }
+  profile->last_time = now;
+  profile->last_ops = profile_ops;
+  profile->last_allocs = profile_allocs;
+  return now;
+}
+
+//
+// whether the call node for the frame has left the stack
+//
+static int profile_is_stale(profile_frame_t *frame) {
+  int result;
+  if (frame->tid != ctask->tid) {
+    result = 0;
+  } else if (frame->stack_pos > prog_stack_count) {
+    result = 1;
+  } else {
+    stknode_t *node = &prog_stack[frame->stack_pos - 1];
+    result = ((node->type != kwPROC && node->type != kwFUNC) ||
+              node->x.vcall.ret_ip != frame->ret_ip);
+  }
+  return result;
+}
+
+//
+// pops the frames of the procedures that have returned
+//
+static void profile_unwind(uint64_t now) {
+  while (profile->frame_count && profile_is_stale(&profile->frames[profile->frame_count - 1])) {
+    profile_frame_t *frame = &profile->frames[--profile->frame_count];
+    if (--frame->proc->active == 0) {
+      frame->proc->inclusive += now - frame->start;
+    }
+  }
+}
+
+//
+// returns the source file as an array of lines
+//
+static char **profile_load_source(const char *file, int *count, char **buffer) {
+  char **result = NULL;
+  int len = strlen(file);
+  *count = 0;
+  *buffer = NULL;
+  if (len > 4 && strcasecmp(file + len - 4, ".bas") == 0) {
+    FILE *fp = fopen(file, "rb");
+    if (fp != NULL) {
+      fseek(fp, 0, SEEK_END);
+      long size = ftell(fp);
+      fseek(fp, 0, SEEK_SET);
+      *buffer = malloc(size + 1);
+      size = fread(*buffer, 1, size, fp);
+      (*buffer)[size] = '\0';
+      fclose(fp);
+
+      int lines = 1;
+      for (char *p = *buffer; *p; p++) {
+        if (*p == '\n') {
+          lines++;
+        }
+      }
+      result = malloc(sizeof(char *) * lines);
+      char *p = *buffer;
+      while (p != NULL) {
+        result[(*count)++] = p;
+        p = strchr(p, '\n');
+        if (p != NULL) {
+          *p++ = '\0';
+        }
+      }
+      for (int i = 0; i < *count; i++) {
+        int end = strlen(result[i]);
+        while (end && (result[i][end - 1] == '\r' || result[i][end - 1] == ' ' || result[i][end - 1] == '\t')) {
+          result[i][--end] = '\0';
+        }
+      }
+    }
+  }
+  return result;
+}
+
+//
+// returns the source text for the line, skipping leading spaces
+//
+static const char *profile_source_line(char **source, int count, int line) {
+  const char *result = "";
+  if (source != NULL && line > 0 && line <= count) {
+    result = source[line - 1];
+    while (*result == ' ' || *result == '\t') {
+      result++;
+    }
+  }
+  return result;
+}
+
+//
+// names the procedure from those recorded by the compiler
+//
+static void profile_set_name(profile_entry_t *proc) {
+  proc->name[0] = '\0';
+  if (proc->tid == profile->tid) {
+    for (int i = 0; i < profile_proc_count; i++) {
+      if (profile_procs[i].addr == proc->addr) {
+        strlcpy(proc->name, profile_procs[i].name, PROFILE_NAME_SIZE);
+        proc->line = profile_procs[i].line;
+        break;
+      }
+    }
+  }
+  if (!proc->name[0]) {
+    snprintf(proc->name, PROFILE_NAME_SIZE, "proc_%u", (unsigned)proc->addr);
+  }
+}
+
+static int profile_cmp_time(const void *a, const void *b) {
+  const profile_entry_t *e1 = *(const profile_entry_t **)a;
+  const profile_entry_t *e2 = *(const profile_entry_t **)b;
+  return e1->time < e2->time ? 1 : e1->time > e2->time ? -1 : 0;
+}
+
+//
+// returns the table entries sorted by exclusive time
+//
+static profile_entry_t **profile_sort(profile_entry_t **table, int count) {
+  profile_entry_t **result = malloc(sizeof(profile_entry_t *) * (count + 1));
+  int n = 0;
+  for (int i = 0; i < PROFILE_HASH_SIZE; i++) {
+    for (profile_entry_t *entry = table[i]; entry != NULL; entry = entry->next) {
+      result[n++] = entry;
+    }
+  }
+  qsort(result, n, sizeof(profile_entry_t *), profile_cmp_time);
+  return result;
+}
+
+//
+// writes the path of the node as a semicolon separated list of names
+//
+static void profile_write_path(FILE *fp, profile_node_t *node, const char *root) {
+  if (node->parent != NULL) {
+    profile_write_path(fp, node->parent, root);
+    fprintf(fp, ";%s", node->proc->name);
+  } else {
+    fputs(root, fp);
+  }
+}
+
+//
+// writes each call path with its exclusive time in microseconds
+//
+static void profile_write_folded(FILE *fp, profile_node_t *node, const char *root) {
+  for (; node != NULL; node = node->next) {
+    uint64_t usec = node->time / 1000;
+    if (usec) {
+      profile_write_path(fp, node, root);
+      fprintf(fp, " %llu\n", (unsigned long long)usec);
+    }
+    profile_write_folded(fp, node->child, root);
+  }
+}
+
+//
+// sets the path to the given file, relative to the current directory
+//
+static void profile_set_path(char *path, const char *file) {
+  path[0] = '\0';
+  if (file[0] != '/' && file[0] != OS_DIRSEP && !(file[0] && file[1] == ':')) {
+    if (getcwd(path, OS_PATHNAME_SIZE - 1) != NULL) {
+      strlcat(path, "/", OS_PATHNAME_SIZE);
+    } else {
+      path[0] = '\0';
+    }
+  }
+  strlcat(path, file, OS_PATHNAME_SIZE);
+}
+
+static void profile_write_report(FILE *fp, const char *name, char **source, int count) {
+  uint64_t total = profile->last_time - profile->start;
+  fprintf(fp, "SmallBASIC profile: %s\n", profile->file);
+  fprintf(fp, "total: %.3f ms, commands: %llu, allocations: %llu\n",
+          total / 1e6, (unsigned long long)profile_ops, (unsigned long long)profile_allocs);
+
+  profile_entry_t **procs = profile_sort(profile->procs, profile->proc_count);
+  fprintf(fp, "\nprocedures by exclusive time\n");
+  fprintf(fp, "%10s %12s %12s %12s %10s  %s\n", "calls", "incl ms", "excl ms", "commands", "allocs", "name");
+  fprintf(fp, "%10s %12s %12.3f %12s %10s  %s\n", "1", "", profile->root->time / 1e6, "", "", name);
+  for (int i = 0; i < profile->proc_count; i++) {
+    profile_entry_t *proc = procs[i];
+    fprintf(fp, "%10u %12.3f %12.3f %12llu %10llu  %s (line %d)\n", proc->count,
+            proc->inclusive / 1e6, proc->time / 1e6, (unsigned long long)proc->ops,
+            (unsigned long long)proc->allocs, proc->name, proc->line);
+  }
+  free(procs);
+
+  profile_entry_t **lines = profile_sort(profile->lines, profile->line_count);
+  int top = profile->line_count < PROFILE_TOP_LINES ? profile->line_count : PROFILE_TOP_LINES;
+  fprintf(fp, "\nlines by time (top %d of %d)\n", top, profile->line_count);
+  fprintf(fp, "%10s %12s %12s %10s %6s  %s\n", "hits", "ms", "commands", "allocs", "line", "source");
+  for (int i = 0; i < top; i++) {
+    profile_entry_t *line = lines[i];
+    fprintf(fp, "%10u %12.3f %12llu %10llu %6d  %s\n", line->count, line->time / 1e6,
+            (unsigned long long)line->ops, (unsigned long long)line->allocs, (int)line->addr,
+            line->tid == profile->tid ? profile_source_line(source, count, line->addr) : "");
+  }
+  free(lines);
+}
+
+void profile_start(const char *file, int tid) {
+  profile_end();
+  profile = calloc(1, sizeof(profile_t));
+  profile->root = calloc(1, sizeof(profile_node_t));
+  profile->frame_size = 64;
+  profile->frames = malloc(sizeof(profile_frame_t) * profile->frame_size);
+  profile->tid = tid;
+
+  // resolve the paths now in case the program changes directory
+  profile_set_path(profile->file, file);
+  const char *base = strrchr(file, OS_DIRSEP);
+  strlcpy(profile->name, base != NULL ? base + 1 : file, sizeof(profile->name));
+  char *dot = strrchr(profile->name, '.');
+  if (dot != NULL) {
+    *dot = '\0';
+  }
+  if (opt_profile_file[0]) {
+    profile_set_path(profile->output, opt_profile_file);
+  } else {
+    profile_set_path(profile->output, profile->name);
+    strlcat(profile->output, ".prof", sizeof(profile->output));
+  }
+  profile_ops = 0;
+  profile_allocs = 0;
+  profile->start = profile->last_time = profile_clock();
+  profile->last_ops = 0;
+  profile->last_allocs = 0;
+}
+
+void profile_end() {
+  if (profile == NULL) {
+    return;
+  }
+  profile_charge();
+
+  for (int i = 0; i < PROFILE_HASH_SIZE; i++) {
+    for (profile_entry_t *proc = profile->procs[i]; proc != NULL; proc = proc->next) {
+      profile_set_name(proc);
+    }
+  }
+  profile_reset_procs();
+
+  // the report lists the source text of the main program's lines
+  int count;
+  char *buffer;
+  char **source = profile_load_source(profile->file, &count, &buffer);
+
+  char path[OS_PATHNAME_SIZE + 1];
+  strlcpy(path, profile->output, sizeof(path));
+  const char *name = profile->name;
+
+  FILE *fp = fopen(path, "w");
+  if (fp != NULL) {
+    profile_write_report(fp, name, source, count);
+    fclose(fp);
+  } else {
+    log_printf("PROFILE: failed to create %s\n", path);
+  }
+
+  strlcat(path, ".folded", sizeof(path));
+  fp = fopen(path, "w");
+  if (fp != NULL) {
+    if (profile->root->time >= 1000) {
+      fprintf(fp, "%s %llu\n", name, (unsigned long long)(profile->root->time / 1000));
+    }
+    profile_write_folded(fp, profile->root->child, name);
+    fclose(fp);
+  }
+
+  free(source);
+  free(buffer);
+  profile_free_table(profile->lines);
+  profile_free_table(profile->procs);
+  profile_free_nodes(profile->root);
+  free(profile->frames);
+  free(profile);
+  profile = NULL;
+}
+
+void profile_line(int line) {
+  if (profile != NULL) {
+    uint64_t now = profile_charge();
+    profile_unwind(now);
+    profile->line = profile_get(profile->lines, &profile->line_count, ctask->tid, line);
+    profile->line->count++;
+  }
+}
+
+void profile_enter(bcip_t addr) {
+  if (profile == NULL) {
+    return;
+  }
+  uint64_t now = profile_charge();
+  profile_unwind(now);
+
+  profile_entry_t *proc = profile_get(profile->procs, &profile->proc_count, ctask->tid, addr);
+  proc->count++;
+
+  if (profile->frame_count == profile->frame_size) {
+    profile->frame_size *= 2;
+    profile->frames = realloc(profile->frames, sizeof(profile_frame_t) * profile->frame_size);
+  }
+  profile_frame_t *parent = profile->frame_count ? &profile->frames[profile->frame_count - 1] : NULL;
+  profile_frame_t *frame = &profile->frames[profile->frame_count++];
+  frame->proc = proc;
+  frame->node = profile_child(parent != NULL ? parent->node : profile->root, proc);
+  frame->tid = ctask->tid;
+  frame->stack_pos = prog_stack_count;
+  frame->ret_ip = prog_stack[prog_stack_count - 1].x.vcall.ret_ip;
+  frame->start = now;
+  proc->active++;
+}
+
+void profile_return() {
+  if (profile != NULL) {
+    profile_unwind(profile_charge());
+  }
+}
+
+void profile_reset_procs() {
+  free(profile_procs);
+  profile_procs = NULL;
+  profile_proc_count = 0;
+}
+
+void profile_add_proc(const char *name, bcip_t addr, int line) {
+  profile_procs = realloc(profile_procs, sizeof(profile_proc_t) * (profile_proc_count + 1));
+  profile_proc_t *proc = &profile_procs[profile_proc_count++];
+  strlcpy(proc->name, name, sizeof(proc->name));
+  proc->addr = addr;
+  proc->line = line;
+}
@@ -0,0 +1,97 @@
+// This file is part of SmallBASIC
+//
+// Line and procedure profiler
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#if !defined(PROFILE_H)
+#define PROFILE_H
+
+#include "common/sys.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * @ingroup exec
+ *
+ * commands executed while profiling
+ */
+extern SB_THREAD uint64_t profile_ops;
+
+/**
+ * @ingroup exec
+ *
+ * variables allocated while profiling
+ */
+extern SB_THREAD uint64_t profile_allocs;
+
+/**
+ * @ingroup exec
+ *
+ * starts collecting the profile
+ *
+ * @param file the program file
+ * @param tid the task of the main program
+ */
+void profile_start(const char *file, int tid);
+
+/**
+ * @ingroup exec
+ *
+ * writes the report and the folded stacks, then releases the profile
+ */
+void profile_end(void);
+
+/**
+ * @ingroup exec
+ *
+ * called when execution reaches a new source line
+ *
+ * @param line the source line number
+ */
+void profile_line(int line);
+
+/**
+ * @ingroup exec
+ *
+ * called when a user-defined procedure or function is entered
+ *
+ * @param addr the address of the procedure
+ */
+void profile_enter(bcip_t addr);
+
+/**
+ * @ingroup exec
+ *
+ * called after a user-defined procedure or function has returned
+ */
+void profile_return(void);
+
+/**
+ * @ingroup exec
+ *
+ * forgets the procedures recorded by the compiler
+ */
+void profile_reset_procs(void);
+
+/**
+ * @ingroup exec
+ *
+ * records a procedure of the main program for the report
+ *
+ * @param name the procedure name
+ * @param addr the address called to enter the procedure
+ * @param line the line of the declaration
+ */
+void profile_add_proc(const char *name, bcip_t addr, int line);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
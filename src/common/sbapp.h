@@ -24,6 +24,18 @@ extern "C" {
 
 int sbasic_main(const char *file);
 
+//
+// embedding: compile or load the program once then run it many times.
+// each run starts with fresh variables, while the bytecode, units and
+// modules stay resident. each thread may hold one context, which is only
+// used by that thread, so separate threads can run programs at the same time.
+//
+typedef struct sbasic_context_s sbasic_context_t;
+
+sbasic_context_t *sbasic_create(const char *file);
+int sbasic_run(sbasic_context_t *context);
+void sbasic_destroy(sbasic_context_t *context);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -17,6 +17,7 @@
 #include "common/plugins.h"
 #include "common/units.h"
 #include "common/messages.h"
+#include "common/profile.h"
 #include "languages/keywords.en.c"
 
 char *comp_array_uds_field(char *p, bc_t *bc);
@@ -43,6 +44,7 @@ const int LEN_TEXTMODE   = STRLEN(LCN_TEXTMODE);
 const int LEN_COMMAND    = STRLEN(LCN_COMMAND);
 const int LEN_SHOWPAGE   = STRLEN(LCN_SHOWPAGE);
 const int LEN_ANTIALIAS  = STRLEN(LCN_ANTIALIAS);
+const int LEN_PROFILE    = STRLEN(LCN_PROFILE);
 const int LEN_LDMODULES  = STRLEN(LCN_LOAD_MODULES);
 const int LEN_AUTOLOCAL  = STRLEN(LCN_AUTOLOCAL);
 const int LEN_AS_WRS     = STRLEN(LCN_AS_WRS);
@@ -459,6 +461,7 @@ bid_t comp_udp_setip(const char *proc_name) {
     comp_udptable[idx].ip = comp_prog.count;
     comp_udptable[idx].level = comp_block_level;
     comp_udptable[idx].block_id = comp_block_id;
+    comp_udptable[idx].pline = comp_line;
   }
   return idx;
 }
@@ -3074,6 +3077,7 @@ bcip_t comp_next_bc_cmd(bc_t *bc, bcip_t ip) {
     ip += (ADDRSZ + 1);
     break;
   case kwIF:
+  case kwIF_CMP:
   case kwFOR:
   case kwWHILE:
   case kwREPEAT:
@@ -3772,6 +3776,120 @@ bcip_t comp_optimise_let(bcip_t ip) {
   return ip;
 }
 
+// whether the byte-code at ip ends the statement
+int comp_is_eoc(bcip_t ip) {
+  return (ip >= comp_prog.count ||
+          comp_prog.ptr[ip] == kwTYPE_EOC ||
+          comp_prog.ptr[ip] == kwTYPE_LINE);
+}
+
+// whether the byte-code at ip is the variable "var" without array or field access
+int comp_is_plain_var(bcip_t ip, bcip_t var) {
+  bcip_t addr;
+  if (ip + 1 + sizeof(bcip_t) > comp_prog.count || comp_prog.ptr[ip] != kwTYPE_VAR) {
+    return 0;
+  }
+  memcpy(&addr, comp_prog.ptr + ip + 1, sizeof(bcip_t));
+  return (var == INVALID_ADDR || var == addr);
+}
+
+// v = v + n, v = v - n, v += n, v++ to kwLET_INC (see cmd_let_inc)
+int comp_optimise_let_inc(bcip_t ip) {
+  const bcip_t var_sz = 1 + sizeof(bcip_t);
+  bcip_t var;
+  bcip_t ip_next = ip + 1;
+  int result = 0;
+
+  if (ip_next + var_sz * 2 + 2 < comp_prog.count &&
+      comp_is_plain_var(ip_next, INVALID_ADDR) &&
+      comp_prog.ptr[ip_next + var_sz] == kwTYPE_CMPOPR &&
+      comp_prog.ptr[ip_next + var_sz + 1] == '=') {
+    memcpy(&var, comp_prog.ptr + ip_next + 1, sizeof(bcip_t));
+    ip_next += var_sz + 2;
+    if (comp_is_plain_var(ip_next, var)) {
+      ip_next += var_sz;
+      if (ip_next + 1 + 1 + OS_INTSZ + 3 <= comp_prog.count &&
+          comp_prog.ptr[ip_next] == kwTYPE_EVPUSH &&
+          comp_prog.ptr[ip_next + 1] == kwTYPE_INT) {
+        ip_next += 1 + 1 + OS_INTSZ;
+        if (comp_prog.ptr[ip_next] == kwTYPE_EVPOP &&
+            comp_prog.ptr[ip_next + 1] == kwTYPE_ADDOPR &&
+            (comp_prog.ptr[ip_next + 2] == '+' || comp_prog.ptr[ip_next + 2] == '-') &&
+            comp_is_eoc(ip_next + 3)) {
+          comp_prog.ptr[ip] = kwLET_INC;
+          result = 1;
+        }
+      }
+    }
+  }
+  return result;
+}
+
+// v(i) = expr, v(n) = expr to kwLET_ELEM (see cmd_let_elem)
+int comp_optimise_let_elem(bcip_t ip) {
+  const bcip_t var_sz = 1 + sizeof(bcip_t);
+  bcip_t ip_next = ip + 1;
+  int result = 0;
+
+  if (ip_next + var_sz + 1 < comp_prog.count &&
+      comp_is_plain_var(ip_next, INVALID_ADDR) &&
+      comp_prog.ptr[ip_next + var_sz] == kwTYPE_LEVEL_BEGIN) {
+    ip_next += var_sz + 1;
+    if (comp_prog.ptr[ip_next] == kwTYPE_INT) {
+      ip_next += 1 + OS_INTSZ;
+    } else if (comp_is_plain_var(ip_next, INVALID_ADDR)) {
+      ip_next += var_sz;
+    } else {
+      return 0;
+    }
+    if (ip_next + 3 < comp_prog.count &&
+        comp_prog.ptr[ip_next] == kwTYPE_LEVEL_END &&
+        comp_prog.ptr[ip_next + 1] == kwTYPE_CMPOPR &&
+        comp_prog.ptr[ip_next + 2] == '=') {
+      comp_prog.ptr[ip] = kwLET_ELEM;
+      result = 1;
+    }
+  }
+  return result;
+}
+
+// IF v <cmp> v, IF v <cmp> n to kwIF_CMP (see cmd_if_cmp)
+void comp_optimise_if(bcip_t ip) {
+  const bcip_t var_sz = 1 + sizeof(bcip_t);
+  bcip_t ip_next = ip + 1 + BC_CTRLSZ;
+
+  if (ip_next + var_sz + 1 < comp_prog.count &&
+      comp_is_plain_var(ip_next, INVALID_ADDR) &&
+      comp_prog.ptr[ip_next + var_sz] == kwTYPE_EVPUSH) {
+    ip_next += var_sz + 1;
+    if (comp_prog.ptr[ip_next] == kwTYPE_INT) {
+      ip_next += 1 + OS_INTSZ;
+    } else if (comp_is_plain_var(ip_next, INVALID_ADDR)) {
+      ip_next += var_sz;
+    } else {
+      return;
+    }
+    if (ip_next + 3 <= comp_prog.count &&
+        comp_prog.ptr[ip_next] == kwTYPE_EVPOP &&
+        comp_prog.ptr[ip_next + 1] == kwTYPE_CMPOPR) {
+      switch (comp_prog.ptr[ip_next + 2]) {
+      case OPLOG_EQ:
+      case OPLOG_GT:
+      case OPLOG_GE:
+      case OPLOG_LT:
+      case OPLOG_LE:
+      case OPLOG_NE:
+        if (comp_is_eoc(ip_next + 3) || comp_prog.ptr[ip_next + 3] == kwTHEN) {
+          comp_prog.ptr[ip] = kwIF_CMP;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+}
+
 void comp_optimise() {
   for (bcip_t ip = 0; !comp_error && ip < comp_prog.count;
        ip = comp_next_bc_cmd(&comp_prog, ip)) {
@@ -3781,8 +3899,19 @@ void comp_optimise() {
         ip = comp_optimise_line_goto(ip + 1 + sizeof(bcip_t));
       }
       break;
+    case kwGOTO:
+      if (opt_optimise) {
+        // thread the remaining GOTOs, eg IF x THEN GOTO
+        comp_optimise_line_goto(ip);
+      }
+      break;
     case kwLET:
-      ip = comp_optimise_let(ip);
+      if (!comp_optimise_let_inc(ip) && !comp_optimise_let_elem(ip)) {
+        ip = comp_optimise_let(ip);
+      }
+      break;
+    case kwIF:
+      comp_optimise_if(ip);
       break;
     case kwTYPE_EOC:
       if (!opt_autolocal &&
@@ -4436,6 +4565,11 @@ char *comp_preproc_options(char *p) {
     } else if (strncmp(LCN_AUTOLOCAL, p, LEN_AUTOLOCAL) == 0) {
       p += LEN_AUTOLOCAL;
       opt_autolocal = 1;
+    } else if (strncmp(LCN_PROFILE, p, LEN_PROFILE) == 0) {
+      p += LEN_PROFILE;
+      SKIP_SPACES(p);
+      // OFF does not cancel the host's --profile
+      opt_profile = opt_host_profile || (strncmp("OFF", p, 3) != 0);
     } else if (strncmp(LCN_COMMAND, p, LEN_COMMAND) == 0) {
       p += LEN_COMMAND;
       SKIP_SPACES(p);
@@ -4955,12 +5089,30 @@ int comp_save_bin(byte_code bc) {
   }
   strcat(fname, comp_unit_flag ? ".sbu" : ".sbx");
 
-  int h = open(fname, O_BINARY | O_RDWR | O_TRUNC | O_CREAT, 0660);
+  // a running program may have the previous file mapped, so the new code is
+  // written beside it and renamed over it rather than rewriting the file in
+  // place. The stack address keeps the name apart from other threads.
+  char tmp[OS_PATHNAME_SIZE + 1];
+  snprintf(tmp, sizeof(tmp), "%s.%d.%lx", fname, (int)getpid(),
+           (unsigned long)(uintptr_t)tmp);
+
+  int h = open(tmp, O_BINARY | O_RDWR | O_TRUNC | O_CREAT, 0660);
   if (h != -1) {
-    write(h, (char *)bc.code, bc.size);
+    int written = write(h, (char *)bc.code, bc.size) == (ssize_t)bc.size;
     close(h);
-    if (!opt_quiet) {
-      log_printf(MSG_BC_FILE_CREATED, fname);
+#if defined(_Win32)
+    if (written) {
+      remove(fname);
+    }
+#endif
+    if (written && rename(tmp, fname) == 0) {
+      if (!opt_quiet) {
+        log_printf(MSG_BC_FILE_CREATED, fname);
+      }
+    } else {
+      // non-fatal error
+      remove(tmp);
+      result = 0;
     }
   } else {
     // non-fatal error
@@ -4970,6 +5122,20 @@ int comp_save_bin(byte_code bc) {
   return result;
 }
 
+/*
+ * records the main program's procedures for the profiler report
+ */
+void comp_profile_procs() {
+  profile_reset_procs();
+  for (int i = 0; i < comp_udpcount; i++) {
+    if (comp_udptable[i].ip != INVALID_ADDR) {
+      // the address called by kwTYPE_CALL_UDP, see comp_pass2_scan
+      profile_add_proc(comp_udptable[i].name, comp_udptable[i].ip + (ADDRSZ + 3),
+                       comp_udptable[i].pline);
+    }
+  }
+}
+
 /**
  * compiler - main
  *
@@ -5005,6 +5171,9 @@ int comp_compile(const char *sb_file_name) {
       bc = comp_create_bin();
       success = comp_save_bin(bc);
     }
+    if (success && opt_profile && !comp_unit_flag) {
+      comp_profile_procs();
+    }
   }
 
   int is_unit = comp_unit_flag;
@@ -100,35 +100,49 @@ typedef struct {
 #define OPT_CMD_SZ  1024
 #define OPT_MOD_SZ  1024
 
+// the host settings are shared by all threads, while the options set
+// by the program (SB_THREAD) belong to the thread running it
 EXTERN byte opt_graphics; /**< command-line option: start in graphics mode   */
 EXTERN byte opt_quiet; /**< command-line option: quiet                       */
 EXTERN char opt_command[OPT_CMD_SZ]; /**< command-line parameters (COMMAND$) */
-EXTERN int opt_base; /**< OPTION BASE x                                      */
+EXTERN SB_THREAD int opt_base; /**< OPTION BASE x                                      */
 EXTERN char opt_modpath[OPT_MOD_SZ]; /**< Modules path                       */
 EXTERN int opt_verbose; /**< print some additional infos                     */
 EXTERN int opt_ide; /**< 0=no IDE, 1=IDE is linked, 2=IDE is external exe)   */
 EXTERN byte os_charset; /**< use charset encoding                            */
-EXTERN int opt_pref_width; /**< prefered graphics mode width (0 = undefined) */
-EXTERN int opt_pref_height; /**< prefered graphics mode height               */
+EXTERN SB_THREAD int opt_pref_width; /**< prefered graphics mode width (0 = undefined) */
+EXTERN SB_THREAD int opt_pref_height; /**< prefered graphics mode height               */
 EXTERN byte opt_nosave; /**< do not create .sbx files                        */
-EXTERN byte opt_usepcre; /**< OPTION PREDEF PCRE                             */
+EXTERN SB_THREAD byte opt_usepcre; /**< OPTION PREDEF PCRE                             */
 EXTERN byte opt_file_permitted; /**< file system permission                  */
-EXTERN byte opt_show_page; /**< SHOWPAGE graphics flush mode                 */
+EXTERN SB_THREAD byte opt_show_page; /**< SHOWPAGE graphics flush mode                 */
 EXTERN byte opt_mute_audio; /**< whether to mute sounds                      */
-EXTERN byte opt_antialias; /**< OPTION ANTIALIAS OFF                         */
-EXTERN byte opt_autolocal; /**< OPTION AUTOLOCAL                             */
-EXTERN byte opt_trace_on; /**< initial value for the TRON command            */
+EXTERN SB_THREAD byte opt_antialias; /**< OPTION ANTIALIAS OFF                         */
+EXTERN SB_THREAD byte opt_autolocal; /**< OPTION AUTOLOCAL                             */
+EXTERN SB_THREAD byte opt_trace_on; /**< initial value for the TRON command            */
+EXTERN SB_THREAD byte opt_profile; /**< OPTION PREDEF PROFILE                          */
+EXTERN byte opt_host_profile; /**< command-line option: profile every program */
+EXTERN char opt_profile_file[OS_PATHNAME_SIZE + 1]; /**< profile report file */
+EXTERN byte opt_stats; /**< write the runtime counters on exit               */
+EXTERN char opt_stats_file[OS_PATHNAME_SIZE + 1]; /**< runtime counters file */
+EXTERN int opt_image_budget; /**< decoded image budget in MB (0 = default)   */
+EXTERN char opt_image_cache[OS_PATHNAME_SIZE + 1]; /**< decoded image cache dir */
+EXTERN uint64_t opt_max_ops; /**< commands executed per run (0 = unlimited)   */
+EXTERN uint64_t opt_max_heap; /**< heap bytes used by a run (0 = unlimited)    */
+EXTERN uint32_t opt_max_stack; /**< program stack depth (0 = unlimited)        */
+EXTERN uint32_t opt_max_time; /**< run time in milliseconds (0 = unlimited)    */
+EXTERN byte opt_optimise; /**< optimise the byte-code when compiling          */
 
 #define IDE_NONE        0
 #define IDE_INTERNAL    1
 #define IDE_EXTERNAL    2
 
 // globals
-EXTERN int gsb_last_line; /**< source code line of the last error            */
-EXTERN int gsb_last_error; /**< error code, 0 = no error,  < 0 = local messages (i.e. break), > 0 = error       */
-EXTERN char gsb_last_file[OS_PATHNAME_SIZE + 1]; /**< source code file-name of the last error     */
-EXTERN char gsb_bas_dir[OS_PATHNAME_SIZE + 1]; /**< source code home dir     */
-EXTERN char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
+EXTERN SB_THREAD int gsb_last_line; /**< source code line of the last error            */
+EXTERN SB_THREAD int gsb_last_error; /**< error code, 0 = no error,  < 0 = local messages (i.e. break), > 0 = error       */
+EXTERN SB_THREAD char gsb_last_file[OS_PATHNAME_SIZE + 1]; /**< source code file-name of the last error     */
+EXTERN SB_THREAD char gsb_bas_dir[OS_PATHNAME_SIZE + 1]; /**< source code home dir     */
+EXTERN SB_THREAD char gsb_last_errmsg[SB_ERRMSG_SIZE + 1]; /**< last error message     */
 
 #include "common/units.h"
 #include "common/tasks.h"
@@ -247,6 +261,24 @@ int brun_status(void);
  */
 time_t sys_filetime(const char *file);
 
+/**
+ * maps the first size bytes of the open file read-only
+ *
+ * @param h the file handle
+ * @param size the number of bytes to map
+ * @param pad the number of readable bytes required past the end
+ * @return the image, or NULL when the file could not be mapped
+ */
+byte *sys_map_file(int h, uint32_t size, uint32_t pad);
+
+/**
+ * releases an image returned by sys_map_file
+ *
+ * @param image the mapped image
+ * @param size the mapped size
+ */
+void sys_unmap_file(byte *image, uint32_t size);
+
 /**
  * search a set of directories for the given file
  * directories on path must be separated with symbol ':'
@@ -0,0 +1,81 @@
+// This file is part of SmallBASIC
+//
+// Runtime counters
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#include "common/sys.h"
+#include "common/pproc.h"
+#include "common/stats.h"
+
+SB_THREAD sb_stats_t sb_stats;
+
+//
+// adds the counter to the map
+//
+static void stats_add(var_t *map, const char *name, uint64_t value) {
+  v_setint(map_add_var(map, name, 0), (var_int_t)value);
+}
+
+void stats_reset() {
+  memset(&sb_stats, 0, sizeof(sb_stats));
+}
+
+void stats_get(var_t *result) {
+  // take a copy since building the map updates the counters
+  sb_stats_t stats = sb_stats;
+
+  map_init(result);
+  stats_add(result, "var_pool_hits", stats.var_pool_hits);
+  stats_add(result, "var_pool_misses", stats.var_pool_misses);
+  stats_add(result, "var_pool_returns", stats.var_pool_returns);
+  stats_add(result, "map_lookups", stats.map_lookups);
+  stats_add(result, "map_inserts", stats.map_inserts);
+  stats_add(result, "map_probes", stats.map_probes);
+  stats_add(result, "map_depth_max", stats.map_depth_max);
+  stats_add(result, "eval_stack_max", stats.eval_stack_max);
+  stats_add(result, "prog_stack_max", stats.prog_stack_max);
+  stats_add(result, "prog_stack_depth", ctask != NULL ? prog_stack_count : 0);
+  stats_add(result, "string_bytes", stats.string_bytes);
+  stats_add(result, "heap_bytes", stats.heap_bytes);
+  stats_add(result, "heap_max", stats.heap_max);
+  stats_add(result, "bytes_read", stats.bytes_read);
+  stats_add(result, "bytes_written", stats.bytes_written);
+
+  var_t *files = map_add_var(result, "files", 0);
+  v_toarray1(files, 0);
+  uint32_t size = 0;
+  for (int handle = 1; handle <= OS_FILEHANDLES; handle++) {
+    dev_file_t *f = dev_getfileptr(handle);
+    if (f != NULL && f->handle != -1) {
+      v_resize_array(files, size + 1);
+      var_t *elem = v_elem(files, size++);
+      map_init(elem);
+      map_add_var(elem, "handle", handle);
+      v_setstr(map_add_var(elem, "name", 0), f->name);
+      stats_add(elem, "read", f->bytes_read);
+      stats_add(elem, "written", f->bytes_written);
+    }
+  }
+}
+
+void stats_write(const char *file) {
+  var_t map;
+  v_init(&map);
+  stats_get(&map);
+  char *json = map_to_str(&map);
+  FILE *fp = file[0] ? fopen(file, "w") : stderr;
+  if (fp != NULL) {
+    fprintf(fp, "%s\n", json);
+    if (fp != stderr) {
+      fclose(fp);
+    }
+  } else {
+    log_printf("STATS: failed to create %s\n", file);
+  }
+  free(json);
+  v_free(&map);
+}
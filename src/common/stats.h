@@ -0,0 +1,112 @@
+// This file is part of SmallBASIC
+//
+// Runtime counters
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#if !defined(STATS_H)
+#define STATS_H
+
+#include "common/var.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * @ingroup exec
+ * @typedef sb_stats_t
+ * interpreter counters, reset when a program starts
+ */
+typedef struct sb_stats_s {
+  uint64_t var_pool_hits;    /**< v_new() served from the pool */
+  uint64_t var_pool_misses;  /**< v_new() falling back to malloc */
+  uint64_t var_pool_returns; /**< variables released back into the pool */
+  uint64_t map_lookups;      /**< hashmap searches */
+  uint64_t map_inserts;      /**< hashmap entries created */
+  uint64_t map_probes;       /**< nodes visited by the hashmap searches */
+  uint32_t map_depth_max;    /**< the deepest node visited in a bucket */
+  uint32_t eval_stack_max;   /**< the eval stack high-water mark */
+  uint32_t prog_stack_max;   /**< the program stack high-water mark */
+  uint64_t string_bytes;     /**< bytes allocated for string values */
+  uint64_t heap_bytes;       /**< bytes held by variables, strings, arrays and maps */
+  uint64_t heap_max;         /**< the heap_bytes high-water mark */
+  uint64_t bytes_read;       /**< bytes read from all files and devices */
+  uint64_t bytes_written;    /**< bytes written to all files and devices */
+} sb_stats_t;
+
+extern SB_THREAD sb_stats_t sb_stats;
+
+/**
+ * @ingroup exec
+ *
+ * records the number of nodes visited by a hashmap search
+ *
+ * @param depth the number of nodes visited
+ */
+static inline void stats_map_probe(uint32_t depth) {
+  sb_stats.map_probes += depth;
+  if (depth > sb_stats.map_depth_max) {
+    sb_stats.map_depth_max = depth;
+  }
+}
+
+/**
+ * @ingroup exec
+ *
+ * records memory taken by a variable, string, array or map
+ *
+ * @param size the number of bytes
+ */
+static inline void stats_heap_alloc(uint64_t size) {
+  sb_stats.heap_bytes += size;
+  if (sb_stats.heap_bytes > sb_stats.heap_max) {
+    sb_stats.heap_max = sb_stats.heap_bytes;
+  }
+}
+
+/**
+ * @ingroup exec
+ *
+ * records memory released by a variable, string, array or map. memory
+ * allocated before the counters were reset is not counted.
+ *
+ * @param size the number of bytes
+ */
+static inline void stats_heap_free(uint64_t size) {
+  sb_stats.heap_bytes = size < sb_stats.heap_bytes ? sb_stats.heap_bytes - size : 0;
+}
+
+/**
+ * @ingroup exec
+ *
+ * resets the counters
+ */
+void stats_reset(void);
+
+/**
+ * @ingroup exec
+ *
+ * returns the counters and the open files as a map
+ *
+ * @param result receives the map
+ */
+void stats_get(var_t *result);
+
+/**
+ * @ingroup exec
+ *
+ * writes the counters as JSON
+ *
+ * @param file the output file, or an empty string for stderr
+ */
+void stats_write(const char *file);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -100,13 +100,11 @@ int strcaselessn(const char *s1, int s1n, const char *s2, int s2n) {
 char *transdup(const char *src, const char *what, const char *with, int ignore_case) {
   int lwhat = strlen(what);
   int lwith = strlen(with);
-  int size = BUF_SIZE;
-  char *p = (char *)src;
-  char *dest = malloc(size);
-  char *d = dest;
-
-  *d = '\0';
+  const char *p = src;
+  const char *base = src;
+  cstr dest;
 
+  cstr_init(&dest, BUF_SIZE);
   while (*p) {
     int eq;
     if (ignore_case) {
@@ -115,31 +113,18 @@ char *transdup(const char *src, const char *what, const char *with, int ignore_c
     else {
       eq = strncmp(p, what, lwhat);
     }
-    if (eq == 0) {
-      if ((d - dest) + lwith >= size - 1) {
-        int len = d - dest;
-        size += BUF_SIZE;
-        dest = realloc(dest, size);
-        d = dest + len;
-      }
-      memcpy(d, with, lwith);
-      d += lwith;
-      p += (lwhat - 1);
+    if (eq == 0 && lwhat > 0) {
+      cstr_append_i(&dest, base, p - base);
+      cstr_append_i(&dest, with, lwith);
+      p += lwhat;
+      base = p;
     } else {
-      if ((d - dest) + 1 >= size - 1) {
-        int len = d - dest;
-        size += BUF_SIZE;
-        dest = realloc(dest, size);
-        d = dest + len;
-      }
-      *d = *p;
-      d++;
+      p++;
     }
-    p++;
   }
-
-  *d = '\0';
-  return dest;
+  cstr_append_i(&dest, base, p - base);
+  cstr_shrink(&dest);
+  return dest.buf;
 }
 
 /**
@@ -1093,7 +1078,7 @@ void hex_dump(const unsigned char *block, int size) {
 void cstr_init(cstr *cs, int size) {
   cs->length = 0;
   cs->size = size < 1 ? 1 : size;
-  cs->buf = malloc(size);
+  cs->buf = malloc(cs->size);
   cs->buf[0] = '\0';
 }
 
@@ -1103,12 +1088,25 @@ void cstr_append(cstr *cs, const char *str) {
 
 void cstr_append_i(cstr *cs, const char *str, int len) {
   if (len > 0) {
-    if (cs->size - cs->length < len + 1) {
-      cs->size += len + 1;
+    int required = cs->length + len + 1;
+    if (cs->size < required) {
+      // grow geometrically to keep repeated appends linear
+      int size = cs->size;
+      while (size < required) {
+        size *= 2;
+      }
+      cs->size = size;
       cs->buf = realloc(cs->buf, cs->size);
     }
-    strlcat(cs->buf, str, cs->size);
+    memcpy(cs->buf + cs->length, str, len);
     cs->length += len;
     cs->buf[cs->length] = '\0';
   }
 }
+
+void cstr_shrink(cstr *cs) {
+  if (cs->size > cs->length + 1) {
+    cs->size = cs->length + 1;
+    cs->buf = realloc(cs->buf, cs->size);
+  }
+}
@@ -396,7 +396,8 @@ void hex_dump(const unsigned char *block, int size);
 /**
  * @ingroup str
  *
- * string buffer
+ * string buffer. the capacity doubles as required so that
+ * building a string with repeated appends takes linear time
  */
 typedef struct cstr {
   int size;
@@ -425,6 +426,13 @@ void cstr_append(cstr *cs, const char *str);
  */
 void cstr_append_i(cstr *cs, const char *str, int len);
 
+/**
+ * @ingroup str
+ *
+ * release the unused capacity of the string buffer
+ */
+void cstr_shrink(cstr *cs);
+
 #if defined(__cplusplus)
 }
 #endif
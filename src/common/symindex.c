@@ -0,0 +1,71 @@
+// This file is part of SmallBASIC
+//
+// Hashed lookup of exported symbol names
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#include "common/sys.h"
+#include "common/symindex.h"
+
+//
+// FNV-1a hash of the name
+//
+static uint32_t sym_hash(const char *name) {
+  uint32_t hash = 2166136261u;
+  while (*name) {
+    hash = (hash ^ (byte)*name++) * 16777619u;
+  }
+  return hash;
+}
+
+int sym_index_build(sym_index_t *idx, const char *first, size_t stride, int count) {
+  uint32_t size = 8;
+  while (size < (uint32_t)count * 2) {
+    size <<= 1;
+  }
+  idx->slots = (int32_t *)calloc(size, sizeof(int32_t));
+  idx->mask = size - 1;
+  if (idx->slots == NULL) {
+    return 0;
+  }
+  for (int i = 0; i < count; i++) {
+    const char *name = first + (i * stride);
+    uint32_t slot = sym_hash(name) & idx->mask;
+    while (idx->slots[slot]) {
+      if (strcmp(first + ((idx->slots[slot] - 1) * stride), name) == 0) {
+        // keep the first record having the name
+        break;
+      }
+      slot = (slot + 1) & idx->mask;
+    }
+    if (!idx->slots[slot]) {
+      idx->slots[slot] = i + 1;
+    }
+  }
+  return 1;
+}
+
+int sym_index_find(const sym_index_t *idx, const char *first, size_t stride, const char *name) {
+  int result = -1;
+  if (idx->slots != NULL) {
+    uint32_t slot = sym_hash(name) & idx->mask;
+    while (idx->slots[slot]) {
+      int i = idx->slots[slot] - 1;
+      if (strcmp(first + (i * stride), name) == 0) {
+        result = i;
+        break;
+      }
+      slot = (slot + 1) & idx->mask;
+    }
+  }
+  return result;
+}
+
+void sym_index_free(sym_index_t *idx) {
+  free(idx->slots);
+  idx->slots = NULL;
+  idx->mask = 0;
+}
@@ -0,0 +1,56 @@
+// This file is part of SmallBASIC
+//
+// Hashed lookup of exported symbol names
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+
+#if !defined(SYMINDEX_H)
+#define SYMINDEX_H
+
+#include "common/sys.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * @ingroup exec
+ * @typedef sym_index_t
+ * open addressed hash of the names in a table of fixed size records. the
+ * name is found at the same offset in each record, stride bytes apart.
+ */
+typedef struct sym_index_s {
+  uint32_t mask;   /**< number of slots - 1 */
+  int32_t *slots;  /**< record index + 1, or 0 when empty */
+} sym_index_t;
+
+/**
+ * @ingroup exec
+ *
+ * builds the index for count records starting at the first name
+ *
+ * @return non-zero on success
+ */
+int sym_index_build(sym_index_t *idx, const char *first, size_t stride, int count);
+
+/**
+ * @ingroup exec
+ *
+ * returns the index of the first record having the given name, or -1
+ */
+int sym_index_find(const sym_index_t *idx, const char *first, size_t stride, const char *name);
+
+/**
+ * @ingroup exec
+ *
+ * releases the index
+ */
+void sym_index_free(sym_index_t *idx);
+
+#if defined(__cplusplus)
+}
+#endif
+#endif
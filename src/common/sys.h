@@ -102,6 +102,13 @@ extern "C" {
 #define NULL (void*)0L
 #endif
 
+// interpreter state held separately by each thread running a program
+#if defined(_MSC_VER)
+ #define SB_THREAD __declspec(thread)
+#else
+ #define SB_THREAD __thread
+#endif
+
 /*
  * data-types
  */
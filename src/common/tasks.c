@@ -10,9 +10,9 @@
 #include "common/smbas.h"
 #include "common/tasks.h"
 
-static task_t *tasks; /**< tasks table												@ingroup sys */
-static int task_count; /**< total number of tasks										@ingroup sys */
-static int task_index; /**< current task number										@ingroup sys */
+static SB_THREAD task_t *tasks; /**< tasks table												@ingroup sys */
+static SB_THREAD int task_count; /**< total number of tasks										@ingroup sys */
+static SB_THREAD int task_index; /**< current task number										@ingroup sys */
 
 /**
  *	@ingroup sys
@@ -158,7 +158,7 @@ int activate_task(int tid) {
  */
 int search_task(const char *task_name) {
   for (int i = 0; i < task_count; i++) {
-    if (strcmp(tasks[i].file, task_name) == 0) {
+    if (tasks[i].status != tsk_free && strcmp(tasks[i].file, task_name) == 0) {
       return i;
     }
   }
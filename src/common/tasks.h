@@ -22,11 +22,17 @@ typedef enum {
 
 typedef struct timer_s timer_s;
 struct timer_s {
-  timer_s *next; // next timer
-  long value;    // time for next event
-  long interval; // interval ms
-  bcip_t ip;     // handler location
-  int active;    // whether IP is being invoked
+  uint32_t value;    // time for next event
+  uint32_t interval; // interval ms
+  bcip_t ip;         // handler location
+  int policy;        // TIMER_SKIP, TIMER_CATCHUP or TIMER_DELAY
+};
+
+typedef struct timer_heap_s timer_heap_s;
+struct timer_heap_s {
+  timer_s **timers;  // min-heap ordered by the next event
+  int count;
+  int size;
 };
 
 typedef struct {
@@ -59,7 +65,7 @@ typedef struct {
   bc_lib_rec_t *libtable; /**< import-libraries table                */
   bc_symbol_rec_t *symtable; /**< import-symbols table               */
   unit_sym_t *exptable; /**< export-symbols table                    */
-  timer_s *timer;  /** timer linked list                             */
+  timer_heap_s *timer; /** timers ordered by the next event         */
 } task_executor;
 
 typedef struct {
@@ -135,6 +141,8 @@ typedef struct {
   char errmsg[SB_ERRMSG_SIZE + 1];
   char file[OS_PATHNAME_SIZE + 1];  /**< The program file name (task name) */
   byte *bytecode; /**< BC's memory handle                          */
+  uint32_t bc_mapped; /**< size of the mapped BC, 0 when allocated    */
+  int bc_shared; /**< BC is owned by the embedding context           */
   int bc_type; /**< BC type (1=executable, 2=unit)                 */
   int has_sysvars; /**< true if the task has system-variables      */
 
@@ -145,7 +153,7 @@ typedef struct {
   } sbe;
 } task_t;
 
-EXTERN task_t *ctask; /**< current task pointer  */
+EXTERN SB_THREAD task_t *ctask; /**< current task pointer  */
 
 /**
  *   @ingroup sys
@@ -14,10 +14,22 @@
 #include "common/pproc.h"
 #include "common/scan.h"
 #include "common/units.h"
+#include "common/symindex.h"
 
 // units table
-static unit_t *units;
-static int unit_count = 0;
+static SB_THREAD unit_t *units;
+static SB_THREAD int unit_count = 0;
+
+// export-symbol indexes, kept until unit_mgr_close to be shared by the
+// tasks and runs loading the same unit
+typedef struct unit_index_s {
+  char file[OS_PATHNAME_SIZE + 1];
+  int count;
+  sym_index_t idx;
+} unit_index_t;
+
+static SB_THREAD unit_index_t *unit_index;
+static SB_THREAD int unit_index_count = 0;
 
 /**
  *   initialization
@@ -41,6 +53,12 @@ void unit_mgr_close() {
     free(units);
     units = NULL;
   }
+  for (int i = 0; i < unit_index_count; i++) {
+    sym_index_free(&unit_index[i].idx);
+  }
+  free(unit_index);
+  unit_index = NULL;
+  unit_index_count = 0;
 }
 
 /**
@@ -145,7 +163,7 @@ int open_unit(const char *file, const char *alias) {
   }
 
   // open unit
-  h = open(unitname, O_RDWR | O_BINARY);
+  h = open(unitname, O_RDONLY | O_BINARY);
   if (h == -1) {
     return -1;
   }
@@ -159,10 +177,17 @@ int open_unit(const char *file, const char *alias) {
     return -1;
   }
 
-  // load symbol-table
+  // load symbol-table, mapped in place when possible
   if (u.hdr.sym_count) {
-    u.symbols = (unit_sym_t *)malloc(u.hdr.sym_count * sizeof(unit_sym_t));
-    read(h, u.symbols, u.hdr.sym_count * sizeof(unit_sym_t));
+    uint32_t size = sizeof(unit_file_t) + u.hdr.sym_count * sizeof(unit_sym_t);
+    u.image = sys_map_file(h, size, 0);
+    if (u.image != NULL) {
+      u.image_size = size;
+      u.symbols = (unit_sym_t *)(u.image + sizeof(unit_file_t));
+    } else {
+      u.symbols = (unit_sym_t *)malloc(u.hdr.sym_count * sizeof(unit_sym_t));
+      read(h, u.symbols, u.hdr.sym_count * sizeof(unit_sym_t));
+    }
   }
 
   // setup the rest
@@ -199,7 +224,12 @@ int close_unit(int uid) {
     unit_t *u = &units[uid];
     if (u->status == unit_loaded) {
       u->status = unit_undefined;
-      free(u->symbols);
+      if (u->image != NULL) {
+        sys_unmap_file(u->image, u->image_size);
+        u->image = NULL;
+      } else {
+        free(u->symbols);
+      }
     } else {
       return -2;
     }
@@ -315,3 +345,70 @@ int unit_exec(int lib_id, int index, var_t *ret) {
 
   return (prog_error == 0);
 }
+
+/**
+ * returns the handle of the export index for the unit's task
+ */
+int unit_export_index(int tid) {
+  task_t *task = taskinfo(tid);
+  int count = task->sbe.exec.expcount;
+  if (count == 0) {
+    return -1;
+  }
+
+  int result = -1;
+  for (int i = 0; i < unit_index_count; i++) {
+    if (strcmp(unit_index[i].file, task->file) == 0) {
+      result = i;
+      break;
+    }
+  }
+  if (result == -1) {
+    unit_index_t *index = (unit_index_t *)realloc(unit_index, (unit_index_count + 1) * sizeof(unit_index_t));
+    if (index == NULL) {
+      return -1;
+    }
+    unit_index = index;
+    result = unit_index_count++;
+    strlcpy(unit_index[result].file, task->file, sizeof(unit_index[result].file));
+    unit_index[result].count = 0;
+    unit_index[result].idx.slots = NULL;
+  }
+
+  unit_index_t *index = &unit_index[result];
+  if (index->idx.slots == NULL || index->count != count) {
+    // the unit is new or was rebuilt
+    sym_index_free(&index->idx);
+    index->count = count;
+    sym_index_build(&index->idx, task->sbe.exec.exptable[0].symbol, sizeof(unit_sym_t), count);
+  }
+  return result;
+}
+
+/**
+ * returns the position of the named symbol in the unit task's export table
+ */
+int unit_export_find(int index, int tid, const char *name) {
+  task_t *task = taskinfo(tid);
+  const unit_sym_t *table = task->sbe.exec.exptable;
+  int count = task->sbe.exec.expcount;
+  int result = -1;
+
+  if (index != -1 && unit_index[index].count == count) {
+    result = sym_index_find(&unit_index[index].idx, table[0].symbol, sizeof(unit_sym_t), name);
+  }
+  if (result == -1) {
+    // the index may have been built from an earlier version of the unit
+    for (int i = 0; i < count; i++) {
+      if (strcmp(name, table[i].symbol) == 0) {
+        result = i;
+        break;
+      }
+    }
+    if (result != -1 && index != -1) {
+      sym_index_free(&unit_index[index].idx);
+      sym_index_build(&unit_index[index].idx, table[0].symbol, sizeof(unit_sym_t), count);
+    }
+  }
+  return result;
+}
@@ -81,6 +81,8 @@ typedef struct {
   unit_file_t hdr; /**< data from file */
 
   unit_sym_t *symbols; /**< table of symbols */
+  byte *image; /**< mapped file holding the symbols, or NULL */
+  uint32_t image_size; /**< size of the mapped file */
 } unit_t;
 
 /**
@@ -146,6 +148,29 @@ int import_unit(int uid);
  */
 int unit_exec(int lib_id, int index, var_t *ret);
 
+/**
+ * @ingroup exec
+ *
+ * returns the hashed index of the loaded unit's export-symbols, built
+ * once per unit file and kept across runs
+ *
+ * @param tid the unit's task
+ * @return the index handle or -1 when not available
+ */
+int unit_export_index(int tid);
+
+/**
+ * @ingroup exec
+ *
+ * finds a symbol in the loaded unit's export table
+ *
+ * @param index the handle from unit_export_index
+ * @param tid the unit's task
+ * @param name the symbol name
+ * @return the position in the export table or -1 when not found
+ */
+int unit_export_find(int index, int tid, const char *name);
+
 #if defined(__cplusplus)
 }
 #endif
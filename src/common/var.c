@@ -9,14 +9,27 @@
 
 #include "common/sys.h"
 #include "common/sberr.h"
+#include "common/profile.h"
+#include "common/stats.h"
 
 #define INT_STR_LEN 64
+#define STR_OWNER_GROWN 2
 #define VAR_POOL_SIZE 8192
 
-var_t var_pool[VAR_POOL_SIZE];
-var_t *var_pool_head;
+// each thread running a program has its own pool. threads that never call
+// v_init_pool(), such as the module job workers, allocate with malloc
+static SB_THREAD var_t *var_pool;
+static SB_THREAD var_t *var_pool_head;
 
 void v_init_pool() {
+  if (var_pool == NULL) {
+    var_pool = (var_t *)malloc(sizeof(var_t) * VAR_POOL_SIZE);
+    if (var_pool == NULL) {
+      // v_new falls back to malloc
+      var_pool_head = NULL;
+      return;
+    }
+  }
   for (uint32_t i = 0; i < VAR_POOL_SIZE; i++) {
     v_init(&var_pool[i]);
     var_pool[i].pooled = 1;
@@ -29,6 +42,12 @@ void v_init_pool() {
   var_pool_head = &var_pool[0];
 }
 
+void v_close_pool() {
+  free(var_pool);
+  var_pool = NULL;
+  var_pool_head = NULL;
+}
+
 /*
  * creates and returns a new variable
  */
@@ -37,11 +56,17 @@ var_t *v_new() {
   if (result != NULL) {
     // remove an item from the free-list
     var_pool_head = result->v.pool_next;
+    sb_stats.var_pool_hits++;
   } else {
     // pool exhausted
     result = (var_t *)malloc(sizeof(var_t));
     result->pooled = 0;
+    sb_stats.var_pool_misses++;
+  }
+  if (opt_profile) {
+    profile_allocs++;
   }
+  stats_heap_alloc(sizeof(var_t));
   v_init(result);
   return result;
 }
@@ -50,6 +75,7 @@ void v_pool_free(var_t *var) {
   // insert back into the free list
   var->v.pool_next = var_pool_head;
   var_pool_head = var;
+  sb_stats.var_pool_returns++;
 }
 
 uint32_t v_get_capacity(uint32_t size) {
@@ -65,6 +91,7 @@ void v_alloc_capacity(var_t *var, uint32_t size) {
   if (!v_data(var)) {
     err_memory();
   } else {
+    stats_heap_alloc(sizeof(var_t) * capacity);
     for (uint32_t i = 0; i < capacity; i++) {
       var_t *e = v_elem(var, i);
       e->pooled = 0;
@@ -122,6 +149,7 @@ void v_array_free(var_t *var) {
       v_free(v_elem(var, i));
     }
     free(var->v.a.data);
+    stats_heap_free(sizeof(var_t) * v_size);
   }
 }
 
@@ -129,15 +157,29 @@ void v_init_str(var_t *var, int length) {
   var->type = V_STR;
   var->v.p.ptr = malloc(length + 1);
   var->v.p.ptr[0] = '\0';
+  sb_stats.string_bytes += length + 1;
+  stats_heap_alloc(length + 1);
   var->v.p.length = length + 1;
-  var->v.p.owner = 1;
+  var->v.p.owner = 1 | STR_OWNER_HEAP;
 }
 
 void v_move_str(var_t *var, char *str) {
   var->type = V_STR;
   var->v.p.ptr = str;
   var->v.p.length = strlen(str) + 1;
-  var->v.p.owner = 1;
+  var->v.p.owner = 1 | STR_OWNER_HEAP;
+  stats_heap_alloc(var->v.p.length);
+}
+
+/*
+ * counts a string built outside of the var allocators in sb_stats.heap_bytes
+ */
+void v_heap_str(var_t *var) {
+  if (var->type == V_STR && var->v.p.ptr != NULL &&
+      var->v.p.owner && !(var->v.p.owner & STR_OWNER_HEAP)) {
+    var->v.p.owner |= STR_OWNER_HEAP;
+    stats_heap_alloc(var->v.p.length);
+  }
 }
 
 /*
@@ -238,6 +280,7 @@ void v_resize_array(var_t *v, uint32_t size) {
     } else if (prev_size < size) {
       // resize & copy
       uint32_t capacity = v_get_capacity(size);
+      stats_heap_alloc(sizeof(var_t) * (capacity - v_capacity(v)));
       v_capacity(v) = capacity;
       v_data(v) = (var_t *)realloc(v_data(v), sizeof(var_t) * capacity);
       for (uint32_t i = prev_size; i < capacity; i++) {
@@ -495,7 +538,9 @@ void v_set(var_t *dest, const var_t *src) {
     if (src->v.p.owner) {
       dest->v.p.length = v_strlen(src) + 1;
       dest->v.p.ptr = (char *)malloc(dest->v.p.length);
-      dest->v.p.owner = 1;
+      dest->v.p.owner = 1 | STR_OWNER_HEAP;
+      sb_stats.string_bytes += dest->v.p.length;
+      stats_heap_alloc(dest->v.p.length);
       strcpy(dest->v.p.ptr, src->v.p.ptr);
     } else {
       dest->v.p.length = src->v.p.length;
@@ -710,8 +755,15 @@ void v_strcat(var_t *var, const char *str) {
   }
   if (var->type == V_STR) {
     if (var->v.p.owner) {
-      var->v.p.length = strlen(var->v.p.ptr) + strlen(str) + 1;
+      uint32_t len = strlen(str);
+      if (var->v.p.owner & STR_OWNER_HEAP) {
+        stats_heap_free(var->v.p.length);
+      }
+      var->v.p.length = strlen(var->v.p.ptr) + len + 1;
+      sb_stats.string_bytes += len;
+      stats_heap_alloc(var->v.p.length);
       var->v.p.ptr = realloc(var->v.p.ptr, var->v.p.length);
+      var->v.p.owner = 1 | STR_OWNER_HEAP;
       strcat(var->v.p.ptr, str);
     } else {
       // mutate into owner string
@@ -726,6 +778,62 @@ void v_strcat(var_t *var, const char *str) {
   }
 }
 
+/*
+ * returns the buffer size held by a string built with v_strappend
+ */
+static uint32_t v_strcapacity(uint32_t length) {
+  uint32_t result = INT_STR_LEN;
+  while (result < length) {
+    result <<= 1;
+  }
+  return result;
+}
+
+/*
+ * appends len bytes to the string value. the buffer grows in powers of
+ * two, so the capacity is always derived from the current length.
+ */
+void v_strappend(var_t *var, const char *str, int len) {
+  if (var->type != V_STR) {
+    v_tostr(var);
+  }
+  uint32_t length = var->v.p.ptr == NULL ? 0 : v_strlen(var);
+  uint32_t required = length + len + 1;
+  if (var->v.p.owner & STR_OWNER_HEAP) {
+    // heap_bytes counts the length rather than the capacity
+    stats_heap_free(var->v.p.length);
+  }
+  stats_heap_alloc(required);
+  if ((var->v.p.owner & ~STR_OWNER_HEAP) != STR_OWNER_GROWN) {
+    char *buffer = malloc(v_strcapacity(required));
+    sb_stats.string_bytes += v_strcapacity(required);
+    if (length) {
+      memcpy(buffer, var->v.p.ptr, length);
+    }
+    if (var->v.p.owner) {
+      free(var->v.p.ptr);
+    }
+    var->v.p.ptr = buffer;
+    var->v.p.owner = STR_OWNER_GROWN | STR_OWNER_HEAP;
+  } else if (v_strcapacity(var->v.p.length) < required) {
+    var->v.p.ptr = realloc(var->v.p.ptr, v_strcapacity(required));
+    sb_stats.string_bytes += v_strcapacity(required) - v_strcapacity(var->v.p.length);
+  }
+  memcpy(var->v.p.ptr + length, str, len);
+  var->v.p.ptr[length + len] = '\0';
+  var->v.p.length = required;
+}
+
+/*
+ * releases the unused capacity following v_strappend
+ */
+void v_strshrink(var_t *var) {
+  if (var->type == V_STR && (var->v.p.owner & ~STR_OWNER_HEAP) == STR_OWNER_GROWN) {
+    var->v.p.ptr = realloc(var->v.p.ptr, var->v.p.length);
+    var->v.p.owner = 1 | STR_OWNER_HEAP;
+  }
+}
+
 /*
  * set the value of 'var' to n
  */
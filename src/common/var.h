@@ -82,6 +82,11 @@
 #define SYSVAR_MAXINT       13 /**< system variable, INTMAX    @ingroup var */
 #define SYSVAR_COUNT        14
 
+/*
+ * string owner flag, set when the buffer is counted in sb_stats.heap_bytes
+ */
+#define STR_OWNER_HEAP      0x80
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -195,6 +200,13 @@ typedef struct stknode_s {
  */
 void v_init_pool(void);
 
+/**
+ * @ingroup var
+ *
+ * releases the var pool, later variables are allocated individually
+ */
+void v_close_pool(void);
+
 /**
  * @ingroup var
  *
@@ -202,6 +214,45 @@ void v_init_pool(void);
  */
 void v_pool_free(var_t *var);
 
+/**
+ * @ingroup var
+ *
+ * appends to the string variable, growing the buffer geometrically
+ *
+ * @param var is the variable
+ * @param str the string to append
+ * @param len the number of bytes to append
+ */
+void v_strappend(var_t *var, const char *str, int len);
+
+/**
+ * @ingroup var
+ *
+ * releases the unused capacity of a string built with v_strappend
+ *
+ * @param var is the variable
+ */
+void v_strshrink(var_t *var);
+
+/**
+ * @ingroup var
+ *
+ * counts a string allocated outside of the var allocators in the heap
+ * used by the program
+ *
+ * @param var is the variable
+ */
+void v_heap_str(var_t *var);
+
+/**
+ * @ingroup var
+ *
+ * creates a string builder object
+ *
+ * @param v is the variable
+ */
+void v_create_strbuilder(var_p_t var);
+
 /**
  * < returns the integer value of variable v
  * @ingroup var
@@ -223,6 +274,24 @@ void v_pool_free(var_t *var);
  */
 void v_create_image(var_p_t var);
 
+/**
+ * @ingroup var
+ *
+ * records another variable sharing the image object buffer
+ *
+ * @param v is the copied image variable
+ */
+void v_retain_image(var_p_t var);
+
+/**
+ * @ingroup var
+ *
+ * releases the image object buffer when no longer shared
+ *
+ * @param v is the image variable being freed
+ */
+void v_release_image(var_p_t var);
+
 /**
  * @ingroup var
  *
@@ -33,19 +33,18 @@ void v_eval_func(var_p_t self, var_p_t v_func, var_p_t result) {
     if (code_peek() == kwTYPE_LEVEL_BEGIN) {
       code_skipnext();
     }
-    v_func->v.fn.cb(self, NULL);
+    v_func->v.fn.cb(self, result);
     if (code_peek() == kwTYPE_LEVEL_END) {
       code_skipnext();
     }
   } else {
     // module callback
-    slib_par_t *ptable;
+    slib_par_t ptable[MAX_PARAMS];
+    var_t args[MAX_PARAMS];
     int pcount;
     if (code_peek() == kwTYPE_LEVEL_BEGIN) {
-      ptable = (slib_par_t *)malloc(sizeof(slib_par_t) * MAX_PARAMS);
-      pcount = plugin_build_ptable(ptable, MAX_PARAMS);
+      pcount = plugin_build_ptable(ptable, args, MAX_PARAMS);
     } else {
-      ptable = NULL;
       pcount = 0;
     }
     if (!prog_error) {
@@ -57,10 +56,7 @@ void v_eval_func(var_p_t self, var_p_t v_func, var_p_t result) {
         }
       }
     }
-    if (ptable) {
-      plugin_free_ptable(ptable, pcount);
-      free(ptable);
-    }
+    plugin_free_ptable(ptable, pcount);
   }
 }
 
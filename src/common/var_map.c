@@ -12,10 +12,10 @@
 #include "common/pproc.h"
 #include "common/hashmap.h"
 #include "common/plugins.h"
+#include "common/jobs.h"
 #include "include/var_map.h"
 
 #define BUFFER_GROW_SIZE 64
-#define BUFFER_PADDING   10
 #define TOKEN_GROW_SIZE  16
 #define JSMN_STATIC
 
@@ -175,6 +175,10 @@ void map_free(var_p_t var_p) {
         var_p->v.m.cls_id != -1 &&
         var_p->v.m.id != -1) {
       plugin_free(var_p->v.m.lib_id, var_p->v.m.cls_id, var_p->v.m.id);
+    } else if (var_p->v.m.cls_id == MAP_CLS_IMAGE) {
+      v_release_image(var_p);
+    } else if (var_p->v.m.cls_id == MAP_CLS_JOB) {
+      job_release_handle(var_p);
     }
     hashmap_destroy(var_p);
     v_init(var_p);
@@ -320,6 +324,13 @@ void map_set(var_p_t dest, const var_p_t src) {
     dest->v.m.id = src->v.m.id;
     dest->v.m.lib_id = -1;
     dest->v.m.cls_id = -1;
+    if (src->v.m.lib_id == -1 && src->v.m.cls_id == MAP_CLS_IMAGE) {
+      dest->v.m.cls_id = MAP_CLS_IMAGE;
+      v_retain_image(dest);
+    } else if (src->v.m.lib_id == -1 && src->v.m.cls_id == MAP_CLS_JOB) {
+      dest->v.m.cls_id = MAP_CLS_JOB;
+      job_retain_handle(dest);
+    }
   }
 }
 
@@ -332,56 +343,45 @@ void map_set_int(var_p_t base, const char *name, var_int_t n) {
   }
 }
 
+//
+// Append the string value of the variable
+//
+void map_append_value(cstr *str, var_t *var) {
+  if (var->type == V_STR) {
+    cstr_append_i(str, var->v.p.ptr, v_strlen(var));
+  } else {
+    char *value = v_str(var);
+    cstr_append(str, value);
+    free(value);
+  }
+}
+
 //
 // Helper for map_to_str
 //
 int map_to_str_cb(hashmap_cb *cb, var_p_t v_key, var_p_t v_var) {
-  char *key = v_str(v_key);
-  char *value = v_str(v_var);
-  int required = strlen(cb->buffer) + strlen(key) + strlen(value) + BUFFER_PADDING;
-  if (required >= cb->count) {
-    cb->count = required + BUFFER_GROW_SIZE;
-    cb->buffer = realloc(cb->buffer, cb->count);
-  }
   if (!cb->start) {
-    strcat(cb->buffer, ",");
+    cstr_append_i(cb->str, ",", 1);
   }
   cb->start = 0;
-  strcat(cb->buffer, "\"");
-  strcat(cb->buffer, key);
-  strcat(cb->buffer, "\"");
-  strcat(cb->buffer, ":");
+  cstr_append_i(cb->str, "\"", 1);
+  map_append_value(cb->str, v_key);
+  cstr_append_i(cb->str, "\":", 2);
   if (v_var->type == V_STR) {
-    strcat(cb->buffer, "\"");
+    cstr_append_i(cb->str, "\"", 1);
   }
-  strcat(cb->buffer, value);
+  map_append_value(cb->str, v_var);
   if (v_var->type == V_STR) {
-    strcat(cb->buffer, "\"");
+    cstr_append_i(cb->str, "\"", 1);
   }
-  free(key);
-  free(value);
   return 0;
 }
 
-//
-// Print the array element, growing the buffer as needed
-//
-void array_append_elem(hashmap_cb *cb, var_t *elem) {
-  char *value = v_str(elem);
-  int required = strlen(cb->buffer) + strlen(value) + BUFFER_PADDING;
-  if (required >= cb->count) {
-    cb->count = required + BUFFER_GROW_SIZE;
-    cb->buffer = realloc(cb->buffer, cb->count);
-  }
-  strcat(cb->buffer, value);
-  free(value);
-}
-
 //
 // print the array variable
 //
 void array_to_str(hashmap_cb *cb, var_t *var) {
-  strcpy(cb->buffer, "[");
+  cstr_append_i(cb->str, "[", 1);
   if (v_maxdim(var) == 2) {
     // NxN
     int rows = ABS(v_ubound(var, 0) - v_lbound(var, 0)) + 1;
@@ -390,26 +390,24 @@ void array_to_str(hashmap_cb *cb, var_t *var) {
     for (int i = 0; i < rows; i++) {
       for (int j = 0; j < cols; j++) {
         int pos = i * cols + j;
-        var_t *elem = v_elem(var, pos);
-        array_append_elem(cb, elem);
+        map_append_value(cb->str, v_elem(var, pos));
         if (j != cols - 1) {
-          strcat(cb->buffer, ",");
+          cstr_append_i(cb->str, ",", 1);
         }
       }
       if (i != rows - 1) {
-        strcat(cb->buffer, ";");
+        cstr_append_i(cb->str, ";", 1);
       }
     }
   } else {
     for (int i = 0; i < v_asize(var); i++) {
-      var_t *elem = v_elem(var, i);
-      array_append_elem(cb, elem);
+      map_append_value(cb->str, v_elem(var, i));
       if (i != v_asize(var) - 1) {
-        strcat(cb->buffer, ",");
+        cstr_append_i(cb->str, ",", 1);
       }
     }
   }
-  strcat(cb->buffer, "]");
+  cstr_append_i(cb->str, "]", 1);
 }
 
 //
@@ -417,18 +415,20 @@ void array_to_str(hashmap_cb *cb, var_t *var) {
 //
 char *map_to_str(const var_p_t var_p) {
   hashmap_cb cb;
-  cb.count = BUFFER_GROW_SIZE;
-  cb.buffer = malloc(cb.count);
+  cstr str;
 
+  cstr_init(&str, BUFFER_GROW_SIZE);
+  cb.str = &str;
   if (var_p->type == V_MAP) {
     cb.start = 1;
-    strcpy(cb.buffer, "{");
+    cstr_append_i(&str, "{", 1);
     hashmap_foreach(var_p, map_to_str_cb, &cb);
-    strcat(cb.buffer, "}");
+    cstr_append_i(&str, "}", 1);
   } else if (var_p->type == V_ARRAY) {
     array_to_str(&cb, var_p);
   }
-  return cb.buffer;
+  cstr_shrink(&str);
+  return str.buf;
 }
 
 //
@@ -108,6 +108,47 @@ int sblib_func_getname(int index, char *func_name);
  */
 int sblib_func_exec(int index, int param_count, slib_par_t *params, var_t *retval);
 
+/**
+ * @ingroup modlib
+ *
+ * the most arguments accepted by a fast function
+ */
+#define SBLIB_FAST_ARGS 8
+
+/**
+ * @ingroup modlib
+ *
+ * a fast function receives its arguments as numbers and returns a number
+ */
+typedef double (*sblib_fast_fn)(const double *args);
+
+/**
+ * @ingroup modlib
+ *
+ * optional: returns the fast version of the function 'index', which is
+ * called directly with the evaluated arguments in place of sblib_func_exec.
+ * a fast function has a fixed number of numeric arguments and can't fail.
+ *
+ * @param index the function's index
+ * @param arity receives the number of the arguments, at most SBLIB_FAST_ARGS
+ * @return the function, or NULL to use sblib_func_exec
+ */
+sblib_fast_fn sblib_func_fast(int index, int *arity);
+
+/**
+ * @ingroup modlib
+ *
+ * optional: returns non-zero when the function 'index' may run as a
+ * background job. calling the function then returns a job object at once,
+ * with job.ready() to poll and job.wait() to return the result. the
+ * function runs on a worker thread so it must only read its parameters
+ * and set retval with a number or string.
+ *
+ * @param index the function's index
+ * @return non-zero when the function can run as a job
+ */
+int sblib_func_async(int index);
+
 /**
  * @ingroup modlib
  *
@@ -236,6 +236,22 @@ void osd_setpixel(int x, int y);
  */
 long osd_getpixel(int x, int y);
 
+/**
+ * @ingroup lgraf
+ *
+ * floodfill on the drawing surface, see dev_ffill()
+ *
+ * drivers with direct access to the pixels can use dev_ffill_pixels(),
+ * otherwise return zero to use the generic fill through osd_getpixel()
+ *
+ * @param x the point to start
+ * @param y the point to start
+ * @param fill_color the color to use for fill
+ * @param border_color the color of the border, use -1 for scan-while algorithm
+ * @return non-zero when the fill was handled
+ */
+int osd_ffill(int x, int y, long fill_color, long border_color);
+
 /**
  * @ingroup lgraf
  *
@@ -18,6 +18,12 @@ extern "C" {
 
 #define MAP_TMP_FIELD "\1"
 
+// cls_id for the maps created by v_create_image
+#define MAP_CLS_IMAGE 0x494d4147
+
+// cls_id for the job objects created by job_submit
+#define MAP_CLS_JOB 0x4a4f4253
+
 int map_compare(const var_p_t var_a, const var_p_t var_b);
 int map_is_empty(const var_p_t var_p);
 int map_to_int(const var_p_t var_p);
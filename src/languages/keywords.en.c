@@ -347,6 +347,10 @@ struct func_keyword_s func_table[] = {
 { "FORM",                       kwFORM },
 { "WINDOW",                     kwWINDOW },
 { "TIMESTAMP",                  kwTIMESTAMP },
+{ "NETWAIT",                    kwNETWAIT },
+{ "STRBUILDER",                 kwSTRBUILDER },
+{ "DIRSCAN",                    kwDIRSCAN },
+{ "SYSINFO",                    kwSYSINFO },
 { "", 0 }
 };
 
@@ -408,6 +412,8 @@ struct proc_keyword_s proc_table[] = {
 { "BPUTC",              kwBPUTC },
 { "BLOAD",              kwBLOAD },
 { "BSAVE",              kwBSAVE },
+{ "CSVREAD",            kwCSVREAD },
+{ "CSVWRITE",           kwCSVWRITE },
 { "TIMEHMS",            kwTIMEHMS },
 { "EXPRSEQ",            kwEXPRSEQ },
 { "CALL",               kwCALLCP },
@@ -476,6 +482,7 @@ struct proc_keyword_s proc_table[] = {
 #define LCN_ANTIALIAS           "ANTIALIAS"
 #define LCN_LOAD_MODULES        "LOAD MODULES"
 #define LCN_AUTOLOCAL           "AUTOLOCAL"
+#define LCN_PROFILE             "PROFILE"
 #define LCN_AS_WRS              "AS "
 #define LCN_CONST               "CONST"
 
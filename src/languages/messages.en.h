@@ -225,6 +225,7 @@
 #define ERR_PACK_TOO_FEW        "Need more than %d values to unpack"
 #define ERR_MEMORY              "Out of memory error"
 #define ERR_NETWORK             "Network error"
+#define ERR_SOCKET_SERVER       "NETWAIT: #%d is not an SSVR: server"
 #define ERR_XPM_IMAGE           "Invalid xpm image"
 #define ERR_FILE_NOT_OPEN       "IOError: File not open for reading"
 #define ERR_DIRWALK_NAME        "DIRWALK: name %s/%s too long"
@@ -232,3 +233,7 @@
 #define ERR_DIRWALK_CANT_OPEN   "DIRWALK: can't open %s"
 #define ERR_LINE_LENGTH         "Line length limit exceeded at text: '%s'"
 #define ERR_ABNORMAL_EXIT       "Abnormal exit"
+#define ERR_LIMIT_OPS           "LIMIT: Command limit exceeded"
+#define ERR_LIMIT_HEAP          "LIMIT: Memory limit exceeded"
+#define ERR_LIMIT_STACK         "LIMIT: Stack limit exceeded"
+#define ERR_LIMIT_TIME          "LIMIT: Time limit exceeded"
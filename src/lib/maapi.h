@@ -153,6 +153,14 @@ void maEllipse(int xc, int yc, int rx, int ry, int fill);
  */
 void maArc(int xc, int yc, double r, double start, double end, double aspect);
 
+/**
+ * Flood fills the area containing the given point with the fill color,
+ * stopping at the border color, or when borderColor is -1, filling the
+ * area having the same color as the point.
+ * \returns zero when not supported by the draw target.
+ */
+int maFloodFill(int x, int y, int fillColor, int borderColor);
+
 /**
  * Draws a filled rectangle using the current color.
  * Width and height must be greater than zero.
@@ -172,6 +180,11 @@ void maDrawText(int left, int top, const char *str, int length);
  */
 void maUpdateScreen(void);
 
+/**
+ * Copies the given regions of the back buffer to the physical screen.
+ */
+void maUpdateScreenRegion(const MARect *rects, int count);
+
 /**
  * Returns the size in pixels of Latin-1 text as it would appear on-screen.
  */
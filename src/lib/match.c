@@ -48,6 +48,38 @@
 #define OVECCOUNT 30            /* should be a multiple of 3 */
 #endif
 
+// number of compiled patterns retained by reg_match()
+#define REG_CACHE_SIZE 32
+
+// compiled glob tokens
+#define REG_CHAR 0
+#define REG_ANY  1
+#define REG_SET  2
+#define REG_STAR 3
+#define REG_END  4
+
+typedef struct reg_token_s {
+  byte type;
+  char ch;                      // REG_CHAR
+  uint16_t stars;               // REG_STAR: number of '*' in the run
+  uint16_t min;                 // REG_STAR: number of '?' in the run
+  byte set[32];                 // REG_SET: member bitmap
+} reg_token_t;
+
+typedef struct reg_pattern_s {
+  char *text;
+  uint32_t hash;
+  int mode;                     // opt_usepcre when compiled
+  reg_token_t *tokens;          // NULL when the glob is malformed
+#ifdef USE_PCRE
+  pcre *re;
+  pcre_extra *extra;
+#endif
+} reg_pattern_t;
+
+static SB_THREAD reg_pattern_t *reg_cache[REG_CACHE_SIZE];
+static SB_THREAD int reg_cache_len = 0;
+
 int reg_match_after_star(const char *p, char *t);
 int reg_match_jk(const char *p, char *t);
 
@@ -246,42 +278,294 @@ int reg_match_jk(const char *p, char *t) {
   return reg_match_valid;
 }
 
-/*
- */
-#ifdef USE_PCRE
-int reg_match_pcre(const char *p, char *t)
-{
-  pcre *re;
-  const char *error;
-  int errofs;
+//
+// parses a [..] construct into a member bitmap, returns the position
+// following the closing bracket or NULL when the construct is malformed
+//
+static const char *reg_compile_set(const char *p, byte *set) {
+  int invert = 0;
+  p++;
+  if (*p == '!' || *p == '^') {
+    invert = 1;
+    p++;
+  }
+  if (*p == ']') {
+    return NULL;
+  }
+  memset(set, 0, 32);
+  while (*p != ']') {
+    char range_start, range_end;
+    if (*p == '\\') {
+      p++;
+    }
+    if (*p == '\0') {
+      return NULL;
+    }
+    range_start = range_end = *p;
+    if (*++p == '-') {
+      range_end = *++p;
+      if (range_end == '\0' || range_end == ']') {
+        return NULL;
+      }
+      if (range_end == '\\') {
+        range_end = *++p;
+        if (!range_end) {
+          return NULL;
+        }
+      }
+      p++;
+    }
+    if (range_start > range_end) {
+      char swap = range_start;
+      range_start = range_end;
+      range_end = swap;
+    }
+    // compare as char to match reg_match_jk() on signed char platforms
+    for (int i = 1; i < 256; i++) {
+      char c = (char)i;
+      if (c >= range_start && c <= range_end) {
+        set[i >> 3] |= (1 << (i & 7));
+      }
+    }
+  }
+  if (invert) {
+    for (int i = 0; i < 32; i++) {
+      set[i] = ~set[i];
+    }
+  }
+  set[0] &= ~1;
+  return p + 1;
+}
 
-  re =
-  pcre_compile(p, (opt_usepcre == 2) ? PCRE_CASELESS : 0, &error, &errofs, NULL);
-  if (!re) {
-    rt_raise("REGULAR EXPRESSION SYNTAX ERROR (offset %d) -> %s", error, errofs);
-    return reg_match_bad_pattern;
+//
+// compiles the glob into a token list, returns NULL when the pattern is
+// malformed, leaving reg_match_jk() to report the failure
+//
+static reg_token_t *reg_compile_glob(const char *p) {
+  reg_token_t *tokens = malloc(sizeof(reg_token_t) * (strlen(p) + 1));
+  reg_token_t *tok = tokens;
+  while (*p) {
+    tok->type = REG_CHAR;
+    switch (*p) {
+    case '?':
+      tok->type = REG_ANY;
+      p++;
+      break;
+    case '*':
+      tok->type = REG_STAR;
+      tok->stars = 0;
+      tok->min = 0;
+      for (; *p == '*' || *p == '?'; p++) {
+        if (*p == '*') {
+          tok->stars++;
+        } else {
+          tok->min++;
+        }
+      }
+      break;
+    case '[':
+      tok->type = REG_SET;
+      p = reg_compile_set(p, tok->set);
+      if (p == NULL) {
+        free(tokens);
+        return NULL;
+      }
+      break;
+    case '\\':
+      if (*++p == '\0') {
+        free(tokens);
+        return NULL;
+      }
+      // fallthru
+    default:
+      tok->ch = *p++;
+      break;
+    }
+    tok++;
   }
-  else {
-    int rc;
-    int ovector[OVECCOUNT];
+  tok->type = REG_END;
+  return tokens;
+}
 
-    rc = pcre_exec(re, NULL, t, strlen(t), 0, 0, ovector, OVECCOUNT);
-    if (rc >= 0)
-    return reg_match_valid;
+//
+// matches the text against the compiled glob, backtracking to the most
+// recent star without recursion
+//
+// a DFA isn't built for globs. a star is the only choice point, and since
+// a later star can absorb whatever an earlier one would have matched,
+// only the most recent star is ever retried. each star therefore costs a
+// rescan of the text following it, rather than the state tables that
+// subset construction would add to every cached pattern.
+//
+static int reg_exec_glob(const reg_token_t *tok, const char *t) {
+  const reg_token_t *star_tok = NULL;
+  const char *star_t = NULL;
+
+  for (;;) {
+    int match = 0;
+    switch (tok->type) {
+    case REG_END:
+      if (*t == '\0') {
+        return reg_match_valid;
+      }
+      break;
+    case REG_STAR:
+      if (tok[1].type == REG_END) {
+        // as with reg_match_jk(), a trailing run of stars only matches the
+        // end of the text when it is a single star
+        int len = 0;
+        while (len < tok->min && t[len]) {
+          len++;
+        }
+        if (*t ? len == tok->min : (tok->stars == 1 && tok->min == 0)) {
+          return reg_match_valid;
+        }
+        break;
+      }
+      for (int i = 0; i < tok->min; i++) {
+        if (*t++ == '\0') {
+          return reg_match_abort;
+        }
+      }
+      star_tok = ++tok;
+      if (tok->type == REG_CHAR) {
+        // skip to the first candidate for the literal following the star
+        t = strchr(t, tok->ch);
+        if (t == NULL) {
+          return reg_match_literal_failure;
+        }
+      }
+      star_t = t;
+      continue;
+    case REG_ANY:
+      match = (*t != '\0');
+      break;
+    case REG_SET:
+      match = (*t != '\0' && (tok->set[(byte)*t >> 3] & (1 << ((byte)*t & 7))));
+      break;
+    default:
+      match = (*t != '\0' && *t == tok->ch);
+      break;
+    }
+    if (match) {
+      tok++;
+      t++;
+    } else if (star_tok == NULL || *star_t == '\0') {
+      return reg_match_literal_failure;
+    } else {
+      tok = star_tok;
+      t = ++star_t;
+      if (tok->type == REG_CHAR) {
+        t = star_t = strchr(t, tok->ch);
+        if (t == NULL) {
+          return reg_match_literal_failure;
+        }
+      }
+    }
   }
+}
 
-  return reg_match_literal_failure;
+//
+// releases the compiled pattern
+//
+static void reg_pattern_free(reg_pattern_t *pattern) {
+#ifdef USE_PCRE
+  if (pattern->extra) {
+#ifdef PCRE_STUDY_JIT_COMPILE
+    pcre_free_study(pattern->extra);
+#else
+    pcre_free(pattern->extra);
+#endif
+  }
+  if (pattern->re) {
+    pcre_free(pattern->re);
+  }
+#endif
+  free(pattern->tokens);
+  free(pattern->text);
+  free(pattern);
 }
+
+//
+// returns the compiled pattern from the cache, compiling it on first use
+//
+static reg_pattern_t *reg_compile(const char *p) {
+  uint32_t hash = 5381;
+  for (const char *s = p; *s; s++) {
+    hash = ((hash << 5) + hash) + (byte)*s;
+  }
+  for (int i = 0; i < reg_cache_len; i++) {
+    reg_pattern_t *pattern = reg_cache[i];
+    if (pattern->hash == hash && pattern->mode == opt_usepcre && strcmp(pattern->text, p) == 0) {
+      if (i > 0) {
+        memmove(&reg_cache[1], &reg_cache[0], sizeof(reg_pattern_t *) * i);
+        reg_cache[0] = pattern;
+      }
+      return pattern;
+    }
+  }
+
+  reg_pattern_t *pattern = calloc(1, sizeof(reg_pattern_t));
+  pattern->hash = hash;
+  pattern->mode = opt_usepcre;
+#ifdef USE_PCRE
+  if (opt_usepcre) {
+    const char *error;
+    int errofs;
+    pattern->re = pcre_compile(p, (opt_usepcre == 2) ? PCRE_CASELESS : 0, &error, &errofs, NULL);
+    if (!pattern->re) {
+      rt_raise("REGULAR EXPRESSION SYNTAX ERROR (offset %d) -> %s", errofs, error);
+      free(pattern);
+      return NULL;
+    }
+#ifdef PCRE_STUDY_JIT_COMPILE
+    pattern->extra = pcre_study(pattern->re, PCRE_STUDY_JIT_COMPILE, &error);
+#else
+    pattern->extra = pcre_study(pattern->re, 0, &error);
 #endif
+  } else {
+    pattern->tokens = reg_compile_glob(p);
+  }
+#else
+  pattern->tokens = reg_compile_glob(p);
+#endif
+  pattern->text = strdup(p);
+
+  if (reg_cache_len == REG_CACHE_SIZE) {
+    reg_pattern_free(reg_cache[--reg_cache_len]);
+  }
+  memmove(&reg_cache[1], &reg_cache[0], sizeof(reg_pattern_t *) * reg_cache_len);
+  reg_cache[0] = pattern;
+  reg_cache_len++;
+  return pattern;
+}
 
 /*
  */
 int reg_match(const char *p, char *t) {
+  reg_pattern_t *pattern = reg_compile(p);
+  if (pattern == NULL) {
+    return reg_match_bad_pattern;
+  }
 #ifdef USE_PCRE
-  if (opt_usepcre)
-  return reg_match_pcre(p, t);
+  if (pattern->re) {
+    int ovector[OVECCOUNT];
+    int rc = pcre_exec(pattern->re, pattern->extra, t, strlen(t), 0, 0, ovector, OVECCOUNT);
+    return rc >= 0 ? reg_match_valid : reg_match_literal_failure;
+  }
 #endif
-  return reg_match_jk(p, t);
+  if (pattern->tokens == NULL) {
+    return reg_match_jk(p, t);
+  }
+  return reg_exec_glob(pattern->tokens, t);
+}
+
+/*
+ */
+void reg_match_clear(void) {
+  while (reg_cache_len > 0) {
+    reg_pattern_free(reg_cache[--reg_cache_len]);
+  }
 }
 
 /*----------------------------------------------------------------------------
@@ -345,7 +629,7 @@ int reg_match_after_star(const char *p, char *t) {
      */
 
     if (nextp == *t || nextp == '[')
-      RegMatch = reg_match(p, t);
+      RegMatch = reg_match_jk(p, t);
 
     /*
      * if the end of text is reached then no RegMatch 
@@ -1,3 +1,14 @@
 import example as ex
 ex.libtest(1,2,3,4,5)
 print ex.libfunctest()
+print ex.hypot(3, 4)
+
+' WORK runs as a background job
+job = ex.work(200)
+n = 0
+while not job.ready()
+  n++
+  delay 10
+wend
+print "polled "; iff(n > 0, "while working", "never")
+print job.wait()
@@ -6,6 +6,8 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
+#include <unistd.h>
 #include "var.h"
 #include "module.h"
 
@@ -68,6 +70,44 @@ int func_libtest(int param_count, slib_par_t *params, var_t *retval) {
   return 1; // success
 }
 
+/**
+ * returns the numeric value of a var_t
+ */
+double get_num(var_t *param) {
+  switch (param->type) {
+  case V_INT:
+    return param->v.i;
+  case V_NUM:
+    return param->v.n;
+  }
+  return 0;
+}
+
+/**
+ * a function using the fast calling convention
+ *
+ * returns the length of the hypotenuse
+ */
+double func_hypot(const double *args) {
+  return sqrt(args[0] * args[0] + args[1] * args[1]);
+}
+
+/**
+ * a function able to run as a background job
+ *
+ * sleeps for the given number of milliseconds
+ */
+int func_work(int param_count, slib_par_t *params, var_t *retval) {
+  if (param_count != 1) {
+    v_setstr(retval, "example1: WORK requires 1 parameter");
+    return 0;
+  }
+  int ms = (int)get_num(params[0].var_p);
+  usleep(ms * 1000);
+  v_setreal(retval, ms);
+  return 1;
+}
+
 /**
  *
  * code that required by SB
@@ -85,7 +125,7 @@ int sblib_proc_count(void) {
  * returns the number of the functions
  */
 int sblib_func_count(void) {
-  return 1;
+  return 3;
 }
 
 /**
@@ -109,6 +149,12 @@ int sblib_func_getname(int index, char *proc_name) {
   case 0:
     strcpy(proc_name, "LIBFUNCTEST");
     return 1; // success
+  case 1:
+    strcpy(proc_name, "HYPOT");
+    return 1; // success
+  case 2:
+    strcpy(proc_name, "WORK");
+    return 1; // success
   }
   return 0; // error
 }
@@ -139,8 +185,40 @@ int sblib_func_exec(int index, int param_count, slib_par_t *params, var_t *retva
   case 0:
     success = func_libtest(param_count, params, retval);
     break;
+  case 1:
+    // used when the host doesn't support sblib_func_fast
+    if (param_count == 2) {
+      double args[2] = { get_num(params[0].var_p), get_num(params[1].var_p) };
+      v_setreal(retval, func_hypot(args));
+      success = 1;
+    } else {
+      v_setstr(retval, "example1: HYPOT requires 2 parameters");
+    }
+    break;
+  case 2:
+    success = func_work(param_count, params, retval);
+    break;
   default:
     v_setstr(retval, "example1: function does not exist!");
   }
   return success;
 }
+
+/**
+ * returns the fast version of the 'index' function
+ */
+sblib_fast_fn sblib_func_fast(int index, int *arity) {
+  switch (index) {
+  case 1:
+    *arity = 2;
+    return func_hypot;
+  }
+  return NULL;
+}
+
+/**
+ * returns whether the 'index' function can run as a background job
+ */
+int sblib_func_async(int index) {
+  return index == 2;
+}
@@ -39,10 +39,16 @@ LOCAL_SRC_FILES  :=    \
     $(COMMON)/fmt.c              \
     $(COMMON)/fs_serial.c        \
     $(COMMON)/fs_socket_client.c \
+    $(COMMON)/fs_socket_server.c \
+    $(COMMON)/dirscan.c          \
+    $(COMMON)/profile.c          \
+    $(COMMON)/stats.c            \
+    $(COMMON)/symindex.c         \
     $(COMMON)/fs_stream.c        \
     $(COMMON)/g_line.c           \
     $(COMMON)/geom.c             \
     $(COMMON)/inet.c             \
+    $(COMMON)/jobs.c             \
     $(COMMON)/kw.c               \
     $(COMMON)/pfill.c            \
     $(COMMON)/plot.c             \
@@ -156,27 +156,43 @@ bool Graphics::construct(int fontId) {
   return result;
 }
 
-void Graphics::redraw() {
+//
+// copies the screen to the window, limited to the given bounds when
+// not null. the lock may widen the bounds to cover the content of the
+// previously posted buffer.
+//
+void Graphics::redraw(ARect *bounds) {
   if (_app->window != nullptr && !_paused) {
     ANativeWindow_Buffer buffer;
-    bool locked = ANativeWindow_lock(_app->window, &buffer, nullptr) == 0;
+    bool locked = ANativeWindow_lock(_app->window, &buffer, bounds) == 0;
     if (!locked) {
       trace("Unable to lock window buffer");
     } else {
       if (buffer.format != PIXELFORMAT) {
         ANativeWindow_unlockAndPost(_app->window);
         ANativeWindow_setBuffersGeometry(_app->window, 0, 0, PIXELFORMAT);
+        bounds = nullptr;
         locked = ANativeWindow_lock(_app->window, &buffer, nullptr) == 0;
         trace("Restore format %d", locked);
       }
       if (locked) {
-        void *pixels = buffer.bits;
         int width = MIN(_w, MIN(buffer.width, _screen->_w));
         int height = MIN(_h, MIN(buffer.height, _screen->_h));
-        for (int y = 0; y < height; y++) {
+        int left = 0;
+        int top = 0;
+        if (bounds != nullptr) {
+          left = MAX(0, bounds->left);
+          top = MAX(0, bounds->top);
+          width = MIN(width, bounds->right);
+          height = MIN(height, bounds->bottom);
+        }
+        pixel_t *pixels = (pixel_t *)buffer.bits + (top * buffer.stride);
+        for (int y = top; y < height; y++) {
           pixel_t *line = _screen->getLine(y);
-          memcpy((pixel_t *)pixels, line, width * sizeof(pixel_t));
-          pixels = (pixel_t*)pixels + buffer.stride;
+          if (width > left) {
+            memcpy(pixels + left, line + left, (width - left) * sizeof(pixel_t));
+          }
+          pixels += buffer.stride;
         }
         ANativeWindow_unlockAndPost(_app->window);
       }
@@ -249,3 +265,20 @@ void maUpdateScreen() {
   ((Graphics *)graphics)->redraw();
 }
 
+void maUpdateScreenRegion(const MARect *rects, int count) {
+  if (count > 0) {
+    ARect bounds;
+    bounds.left = rects[0].left;
+    bounds.top = rects[0].top;
+    bounds.right = rects[0].left + rects[0].width;
+    bounds.bottom = rects[0].top + rects[0].height;
+    for (int i = 1; i < count; i++) {
+      bounds.left = MIN(bounds.left, rects[i].left);
+      bounds.top = MIN(bounds.top, rects[i].top);
+      bounds.right = MAX(bounds.right, rects[i].left + rects[i].width);
+      bounds.bottom = MAX(bounds.bottom, rects[i].top + rects[i].height);
+    }
+    ((Graphics *)graphics)->redraw(&bounds);
+  }
+}
+
@@ -23,7 +23,7 @@ struct Graphics : ui::Graphics {
   virtual ~Graphics();
 
   bool construct(int fontId);
-  void redraw();
+  void redraw(ARect *bounds = nullptr);
   bool resize();
   void onPaused(bool paused) { _paused=paused; }
   void setSize(int w, int h) { _w = w; _h = h; }
@@ -0,0 +1,181 @@
+// This file is part of SmallBASIC
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+
+#include "config.h"
+#include <pthread.h>
+#include "common/sbapp.h"
+
+//
+// Runs the test programs on several threads at once, each thread with its
+// own interpreter, comparing the output of every run with the expected
+// output held in the "output" directory beside the program.
+//
+// usage: concurrent_test threads rounds file.bas...
+//
+
+#define MAX_THREADS 64
+
+void console_init();
+void console_set_output(FILE *output);
+
+struct Test {
+  const char *file;
+  char *expected;
+  long length;
+  int runs;
+  int failures;
+};
+
+static Test *tests;
+static int test_count;
+static int rounds;
+static pthread_mutex_t test_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// returns the remaining contents of the file
+//
+static char *read_stream(FILE *fp, long *length) {
+  char *result = nullptr;
+  long start = ftell(fp);
+  if (fseek(fp, 0, SEEK_END) == 0) {
+    long size = ftell(fp) - start;
+    fseek(fp, start, SEEK_SET);
+    result = (char *)malloc(size + 1);
+    if (result != nullptr) {
+      *length = fread(result, 1, size, fp);
+      result[*length] = '\0';
+    }
+  }
+  return result;
+}
+
+//
+// loads the expected output for the test program
+//
+static bool load_expected(Test *test) {
+  char path[OS_PATHNAME_SIZE + 1];
+  const char *name = strrchr(test->file, '/');
+  int dir_len = name == nullptr ? 0 : (name - test->file + 1);
+  name = name == nullptr ? test->file : name + 1;
+  const char *ext = strrchr(name, '.');
+  int name_len = ext == nullptr ? strlen(name) : (ext - name);
+  snprintf(path, sizeof(path), "%.*soutput/%.*s.out", dir_len, test->file, name_len, name);
+
+  FILE *fp = fopen(path, "rb");
+  if (fp != nullptr) {
+    test->expected = read_stream(fp, &test->length);
+    fclose(fp);
+  } else {
+    fprintf(stderr, "failed to open %s\n", path);
+  }
+  return test->expected != nullptr;
+}
+
+//
+// runs the program, returning whether the output was as expected
+//
+static bool run_test(const Test *test) {
+  bool result = false;
+  FILE *output = tmpfile();
+  if (output != nullptr) {
+    console_set_output(output);
+    sbasic_main(test->file);
+    console_set_output(nullptr);
+    fflush(output);
+    rewind(output);
+    long length = 0;
+    char *actual = read_stream(output, &length);
+    result = (actual != nullptr && length == test->length &&
+              memcmp(actual, test->expected, length) == 0);
+    free(actual);
+    fclose(output);
+  }
+  return result;
+}
+
+//
+// each thread starts at a different test, so that different programs
+// are running at the same time
+//
+static void *run_tests(void *arg) {
+  int offset = (int)(intptr_t)arg;
+  console_init();
+  for (int round = 0; round < rounds; round++) {
+    for (int i = 0; i < test_count; i++) {
+      Test *test = &tests[(i + offset) % test_count];
+      bool success = run_test(test);
+      pthread_mutex_lock(&test_mutex);
+      test->runs++;
+      if (!success) {
+        test->failures++;
+      }
+      pthread_mutex_unlock(&test_mutex);
+    }
+  }
+  return nullptr;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    fprintf(stderr, "usage: %s threads rounds file.bas...\n", argv[0]);
+    return 1;
+  }
+
+  int thread_count = atoi(argv[1]);
+  if (thread_count < 1 || thread_count > MAX_THREADS) {
+    thread_count = 1;
+  }
+  rounds = atoi(argv[2]);
+  test_count = argc - 3;
+  tests = (Test *)calloc(test_count, sizeof(Test));
+  if (tests == nullptr) {
+    return 1;
+  }
+  for (int i = 0; i < test_count; i++) {
+    tests[i].file = argv[i + 3];
+    if (!load_expected(&tests[i])) {
+      return 1;
+    }
+  }
+
+  // the host settings are shared by every interpreter
+  opt_command[0] = '\0';
+  opt_modpath[0] = '\0';
+  opt_file_permitted = 1;
+  opt_ide = 0;
+  opt_nosave = 1;
+  opt_quiet = 1;
+  opt_verbose = 0;
+  opt_graphics = 1;
+  os_graphics = 1;
+
+  pthread_t threads[MAX_THREADS];
+  int started = 0;
+  for (int i = 0; i < thread_count; i++) {
+    if (pthread_create(&threads[started], nullptr, run_tests, (void *)(intptr_t)i) == 0) {
+      started++;
+    }
+  }
+  for (int i = 0; i < started; i++) {
+    pthread_join(threads[i], nullptr);
+  }
+
+  int failures = 0;
+  for (int i = 0; i < test_count; i++) {
+    if (tests[i].failures) {
+      fprintf(stdout, "%s ✘ failed %d of %d runs\n", tests[i].file, tests[i].failures, tests[i].runs);
+      failures++;
+    }
+    free(tests[i].expected);
+  }
+  if (!failures) {
+    fprintf(stdout, "concurrent (%d threads) ✓\n", started);
+  }
+  free(tests);
+  return failures ? 1 : 0;
+}
@@ -344,6 +344,7 @@ void dump_bytecode(FILE *output) {
         prog_ip += len;
         break;
         case kwIF:
+        case kwIF_CMP:
         case kwFOR:
         case kwWHILE:
         case kwREPEAT:
@@ -12,9 +12,14 @@
 #include "common/device.h"
 #include "common/plugins.h"
 #include "common/smbas.h"
+#if defined(_HEADLESS)
+#include "platform/console/headless.h"
+#endif
 
 #define WAIT_INTERVAL 5
 
+void reset_image_cache();
+
 typedef void (*settextcolor_fn)(long fg, long bg);
 typedef void (*setpenmode_fn)(int enable);
 typedef int  (*getpen_fn)(int code);
@@ -40,29 +45,30 @@ typedef int  (*textwidth_fn)(const char *str);
 typedef int  (*textheight_fn)(const char *str);
 typedef int  (*init_fn)(const char *prog, int width, int height);
 
-static settextcolor_fn p_settextcolor;
-static setpenmode_fn p_setpenmode;
-static getpen_fn p_getpen;
-static cls_fn p_cls;
-static getx_fn p_getx;
-static gety_fn p_gety;
-static setxy_fn p_setxy;
-static write_fn p_write;
-static events_fn p_events;
-static setcolor_fn p_setcolor;
-static line_fn p_line;
-static ellipse_fn p_ellipse;
-static arc_fn p_arc;
-static setpixel_fn p_setpixel;
-static getpixel_fn p_getpixel;
-static rect_fn p_rect;
-static refresh_fn p_refresh;
-static beep_fn p_beep;
-static sound_fn p_sound;
-static clear_sound_queue_fn p_clear_sound_queue;
-static audio_fn p_audio;
-static textwidth_fn p_textwidth;
-static textheight_fn p_textheight;
+static SB_THREAD settextcolor_fn p_settextcolor;
+static SB_THREAD setpenmode_fn p_setpenmode;
+static SB_THREAD getpen_fn p_getpen;
+static SB_THREAD cls_fn p_cls;
+static SB_THREAD getx_fn p_getx;
+static SB_THREAD gety_fn p_gety;
+static SB_THREAD setxy_fn p_setxy;
+static SB_THREAD write_fn p_write;
+static SB_THREAD events_fn p_events;
+static SB_THREAD setcolor_fn p_setcolor;
+static SB_THREAD line_fn p_line;
+static SB_THREAD ellipse_fn p_ellipse;
+static SB_THREAD arc_fn p_arc;
+static SB_THREAD setpixel_fn p_setpixel;
+static SB_THREAD getpixel_fn p_getpixel;
+static SB_THREAD rect_fn p_rect;
+static SB_THREAD refresh_fn p_refresh;
+static SB_THREAD beep_fn p_beep;
+static SB_THREAD sound_fn p_sound;
+static SB_THREAD clear_sound_queue_fn p_clear_sound_queue;
+static SB_THREAD audio_fn p_audio;
+static SB_THREAD textwidth_fn p_textwidth;
+static SB_THREAD textheight_fn p_textheight;
+static SB_THREAD FILE *p_output;
 
 int get_escape(const char *str, int begin, int end) {
   int result = 0;
@@ -76,11 +82,23 @@ int get_escape(const char *str, int begin, int end) {
   return result;
 }
 
+//
+// the thread's console output, stdout unless replaced by console_set_output
+//
+FILE *console_output() {
+  return p_output != nullptr ? p_output : stdout;
+}
+
+void console_set_output(FILE *output) {
+  p_output = output;
+}
+
 //
 // Console output if vt100 (esc sequences) is not supported
 //
 void default_write(const char *str) {
-  static int column = 0;
+  static SB_THREAD int column = 0;
+  FILE *output = console_output();
   int len = strlen(str);
   if (len) {
     int escape = 0;
@@ -92,14 +110,14 @@ void default_write(const char *str) {
         // move to column
         int escValue = get_escape(str, escape, i);
         while (escValue > column) {
-          putc(' ', stdout);
+          putc(' ', output);
           column++;
         }
         escape = 0;
       } else if (escape && str[i] == 'm') {
         escape = 0;
       } else if (!escape) {
-        putc(str[i], stdout);
+        putc(str[i], output);
         column = (str[i] == '\n') ? 0 : column + 1;
       }
     }
@@ -110,13 +128,37 @@ void default_write(const char *str) {
 // console output if vt100 (esc sequences) is supported
 //
 void vt100_write(const char *str) {
-  printf("%s", str);
+  fputs(str, console_output());
 }
 
 void console_init() {
   p_write = default_write;
 }
 
+
+#if defined(_HEADLESS)
+//
+// draw into the off-screen canvas in place of any plugin
+//
+static void headless_bind() {
+  p_arc = headless_arc;
+  p_cls = headless_cls;
+  p_ellipse = headless_ellipse;
+  p_getpixel = headless_getpixel;
+  p_getx = headless_getx;
+  p_gety = headless_gety;
+  p_line = headless_line;
+  p_rect = headless_rect;
+  p_setcolor = headless_setcolor;
+  p_setpixel = headless_setpixel;
+  p_settextcolor = headless_settextcolor;
+  p_setxy = headless_setxy;
+  p_textheight = headless_textheight;
+  p_textwidth = headless_textwidth;
+  p_write = headless_write;
+}
+#endif
+
 //
 // initialize driver
 //
@@ -146,6 +188,12 @@ int osd_devinit() {
   p_write = (write_fn)plugin_get_func("sblib_write");
 
   init_fn devinit = (init_fn)plugin_get_func("sblib_devinit");
+#if defined(_HEADLESS)
+  if (headless_enabled()) {
+    headless_bind();
+    devinit = headless_devinit;
+  }
+#endif
   if (devinit) {
     devinit(prog_file, opt_pref_width, opt_pref_height);
   }
@@ -160,7 +208,7 @@ int osd_devinit() {
     // Test if output is printed in a terminal. If output is piped into
     // a text file or sbasic is running as a cron job, use
     // default_write without vt100 support
-    if (!isatty(STDOUT_FILENO)) {
+    if (p_output != nullptr || !isatty(STDOUT_FILENO)) {
       p_write = default_write;
       return 1;
     }
@@ -196,6 +244,10 @@ int osd_devinit() {
 // close driver
 //
 int osd_devrestore() {
+  reset_image_cache();
+#if defined(_HEADLESS)
+  headless_devrestore();
+#endif
   return 1;
 }
 
@@ -356,6 +408,17 @@ long osd_getpixel(int x, int y) {
   return result;
 }
 
+//
+// floodfill, otherwise handled by the generic fill using osd_getpixel
+//
+int osd_ffill(int x, int y, long fill_color, long border_color) {
+#if defined(_HEADLESS)
+  return headless_ffill(x, y, fill_color, border_color);
+#else
+  return 0;
+#endif
+}
+
 //
 // draw rectangle (parallelogram)
 //
@@ -465,4 +528,12 @@ void dev_delay(uint32_t timeout) {
 void dev_log_stack(const char *keyword, int type, int line) {}
 void v_create_form(var_p_t var) {}
 void v_create_window(var_p_t var) {}
-void dev_show_page() {}
+
+//
+// SHOWPAGE writes the next frame when rendering off-screen
+//
+void dev_show_page() {
+#if defined(_HEADLESS)
+  headless_show_page();
+#endif
+}
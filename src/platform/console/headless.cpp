@@ -0,0 +1,551 @@
+// This file is part of SmallBASIC
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+
+#include "config.h"
+#include "common/sys.h"
+#include "common/device.h"
+#include "common/smbas.h"
+#include "lib/maapi.h"
+#include "lib/lodepng/lodepng.h"
+#include "ui/graphics.h"
+#include "ui/utils.h"
+#include "platform/console/headless.h"
+
+#define HEADLESS_WIDTH 800
+#define HEADLESS_HEIGHT 600
+#define HEADLESS_FONT_SIZE 15
+#define HEADLESS_TAB_SIZE 8
+#define HEADLESS_CHAR_WIDTH 8
+#define HEADLESS_CHAR_HEIGHT 16
+
+// the same as the ui colors[] table
+static const uint32_t PALETTE[] = {
+  0x000000, 0x000080, 0x008000, 0x008080,
+  0x800000, 0x800080, 0x808000, 0xC0C0C0,
+  0x808080, 0x0000FF, 0x00FF00, 0x00FFFF,
+  0xFF0000, 0xFF00FF, 0xFFFF00, 0xFFFFFF
+};
+
+// monospaced fonts, tried in order when --render does not name a font
+static const char *FONTS[][2] = {
+  {"SourceCodePro-Regular.ttf", "SourceCodePro-Bold.ttf"},
+  {"/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+   "/usr/share/fonts/truetype/dejavu/DejaVuSansMono-Bold.ttf"},
+  {"/usr/share/fonts/TTF/DejaVuSansMono.ttf",
+   "/usr/share/fonts/TTF/DejaVuSansMono-Bold.ttf"},
+  {"/usr/share/fonts/dejavu/DejaVuSansMono.ttf",
+   "/usr/share/fonts/dejavu/DejaVuSansMono-Bold.ttf"},
+  {"/usr/share/fonts/truetype/liberation/LiberationMono-Regular.ttf",
+   "/usr/share/fonts/truetype/liberation/LiberationMono-Bold.ttf"},
+  {"/Library/Fonts/Andale Mono.ttf", "/Library/Fonts/Andale Mono.ttf"},
+  {"c:/Windows/Fonts/consola.ttf", "c:/Windows/Fonts/consolab.ttf"},
+  {nullptr, nullptr}
+};
+
+static bool enabled = false;
+static int renderWidth = HEADLESS_WIDTH;
+static int renderHeight = HEADLESS_HEIGHT;
+static char renderPath[OS_PATHNAME_SIZE + 1];
+static char renderFont[OS_PATHNAME_SIZE + 1];
+
+//
+// Canvas implementation
+//
+Canvas::Canvas() :
+  _w(0),
+  _h(0),
+  _pixels(nullptr),
+  _clip(nullptr) {
+}
+
+Canvas::~Canvas() {
+  delete [] _pixels;
+  delete _clip;
+  _pixels = nullptr;
+  _clip = nullptr;
+}
+
+bool Canvas::create(int w, int h) {
+  _w = w;
+  _h = h;
+  _pixels = new pixel_t[(size_t)w * h]();
+  return _pixels != nullptr;
+}
+
+void Canvas::drawRegion(Canvas *src, const MARect *srcRect, int destX, int destY) {
+  int srcX = srcRect->left;
+  int srcY = srcRect->top;
+  int width = MIN(srcRect->width, src->_w - srcX);
+  int height = MIN(srcRect->height, src->_h - srcY);
+  if (destX < 0) {
+    srcX -= destX;
+    width += destX;
+    destX = 0;
+  }
+  width = MIN(width, _w - destX);
+  for (int y = 0; y < height && destY + y < _h && width > 0; y++) {
+    if (destY + y >= 0) {
+      memcpy(getLine(destY + y) + destX, src->getLine(srcY + y) + srcX, width * sizeof(pixel_t));
+    }
+  }
+}
+
+void Canvas::fillRect(int left, int top, int width, int height, pixel_t drawColor) {
+  int x1 = MAX(left, x());
+  int y1 = MAX(top, y());
+  int x2 = MIN(left + width, MIN(w(), _w));
+  int y2 = MIN(top + height, MIN(h(), _h));
+  for (int posY = y1; posY < y2; posY++) {
+    pixel_t *line = getLine(posY);
+    for (int posX = x1; posX < x2; posX++) {
+      line[posX] = drawColor;
+    }
+  }
+}
+
+void Canvas::setClip(int x, int y, int w, int h) {
+  delete _clip;
+  if (x != 0 || y != 0 || _w != w || _h != h) {
+    _clip = new ARect();
+    _clip->left = x;
+    _clip->top = y;
+    _clip->right = x + w;
+    _clip->bottom = y + h;
+  } else {
+    _clip = nullptr;
+  }
+}
+
+//
+// Graphics with a text cursor, drawing into an off-screen canvas
+//
+struct Headless : ui::Graphics {
+  Headless();
+  ~Headless() override;
+
+  bool construct(const char *prog, int w, int h);
+  void clear();
+  void newLine();
+  void print(const char *str, int len);
+  int  charWidth();
+  int  lineHeight();
+  int  textWidth(const char *str, int len);
+  void writeFrame();
+
+  pixel_t _fg;
+  pixel_t _bg;
+  int _curX;
+  int _curY;
+  int _frame;
+  bool _dirty;
+  char _path[OS_PATHNAME_SIZE + 1];
+
+private:
+  bool loadFonts();
+  bool loadFont(const char *filename, FT_Face &face);
+};
+
+static Headless *headless = nullptr;
+
+//
+// returns the RGB value of an ANSI or RGB colour
+//
+static int ansi_to_rgb(long c) {
+  int result;
+  if (c < 0) {
+    result = -c;
+  } else {
+    result = (c > 15) ? PALETTE[15] : PALETTE[c];
+  }
+  return result;
+}
+
+//
+// returns the file name for the frame, where a %d, or %0Nd, is replaced by the frame number
+//
+static void frame_name(char *name, size_t size, const char *pattern, int frame) {
+  size_t len = 0;
+  bool numbered = false;
+  for (const char *p = pattern; *p && len + 1 < size; p++) {
+    if (*p == '%' && p[1] == '%') {
+      name[len++] = '%';
+      p++;
+    } else if (*p == '%' && !numbered) {
+      const char *end = p + 1;
+      int width = 0;
+      while (isdigit(*end)) {
+        width = (width * 10) + (*end++ - '0');
+      }
+      if (*end == 'd') {
+        int n = snprintf(name + len, size - len, p[1] == '0' ? "%0*d" : "%*d", width, frame);
+        len = MIN(len + MAX(n, 0), size - 1);
+        numbered = true;
+        p = end;
+      } else {
+        name[len++] = *p;
+      }
+    } else {
+      name[len++] = *p;
+    }
+  }
+  name[len] = '\0';
+}
+
+Headless::Headless() : ui::Graphics(),
+  _fg(0),
+  _bg(0),
+  _curX(0),
+  _curY(0),
+  _frame(0),
+  _dirty(false) {
+  _path[0] = '\0';
+}
+
+Headless::~Headless() {
+  if (_font != nullptr) {
+    deleteFont(_font);
+  }
+}
+
+bool Headless::construct(const char *prog, int w, int h) {
+  if (renderPath[0]) {
+    strlcpy(_path, renderPath, sizeof(_path));
+  } else {
+    // the program name with a .png extension
+    strlcpy(_path, prog, sizeof(_path));
+    char *dot = strrchr(_path, '.');
+    char *slash = strrchr(_path, '/');
+    if (dot != nullptr && (slash == nullptr || dot > slash)) {
+      *dot = '\0';
+    }
+    strlcat(_path, ".png", sizeof(_path));
+  }
+
+  if (loadFonts()) {
+    _font = createFont(FONT_STYLE_NORMAL, HEADLESS_FONT_SIZE);
+  } else {
+    fprintf(stderr, "sbasic: no font found, text will not be rendered\n");
+  }
+
+  _screen = new Canvas();
+  bool result = _screen->create(w, h);
+  if (result) {
+    _drawTarget = _screen;
+    _fg = GET_FROM_RGB888(PALETTE[0]);
+    _bg = GET_FROM_RGB888(PALETTE[15]);
+    clear();
+  }
+  return result;
+}
+
+void Headless::clear() {
+  _screen->fillRect(0, 0, _screen->_w, _screen->_h, _bg);
+  _curX = 0;
+  _curY = 0;
+  _dirty = true;
+}
+
+int Headless::charWidth() {
+  return _font != nullptr ? _font->_glyph['W']._w : HEADLESS_CHAR_WIDTH;
+}
+
+int Headless::lineHeight() {
+  return _font != nullptr ? _font->_spacing : HEADLESS_CHAR_HEIGHT;
+}
+
+int Headless::textWidth(const char *str, int len) {
+  return _font != nullptr ? EXTENT_X(getTextSize(str, len)) : len * HEADLESS_CHAR_WIDTH;
+}
+
+//
+// moves to the next line, scrolling the canvas when the cursor reaches the bottom
+//
+void Headless::newLine() {
+  int height = lineHeight();
+  _curX = 0;
+  _curY += height;
+  int overflow = _curY + height - _screen->_h;
+  if (overflow > 0) {
+    int rows = MIN(overflow, _screen->_h);
+    size_t stride = _screen->_w * sizeof(pixel_t);
+    memmove(_screen->getLine(0), _screen->getLine(rows), (_screen->_h - rows) * stride);
+    _screen->fillRect(0, _screen->_h - rows, _screen->_w, rows, _bg);
+    _curY -= rows;
+  }
+}
+
+//
+// draws the text with the background colour at the cursor
+//
+void Headless::print(const char *str, int len) {
+  if (len > 0) {
+    int width = textWidth(str, len);
+    _screen->fillRect(_curX, _curY, width, lineHeight(), _bg);
+    pixel_t color = _drawColor;
+    _drawColor = _fg;
+    drawText(_curX, _curY, str, len);
+    _drawColor = color;
+    _curX += width;
+  }
+}
+
+//
+// saves the canvas as the next frame
+//
+void Headless::writeFrame() {
+  char name[OS_PATHNAME_SIZE + 1];
+  frame_name(name, sizeof(name), _path, ++_frame);
+  // the non-SDL pixel_t holds R, G, B, A in memory order
+  unsigned error = lodepng_encode32_file(name, (const unsigned char *)_screen->_pixels,
+                                         _screen->_w, _screen->_h);
+  if (error) {
+    fprintf(stderr, "sbasic: failed to write %s: %s\n", name, lodepng_error_text(error));
+  }
+  _dirty = false;
+}
+
+bool Headless::loadFonts() {
+  bool result = false;
+  if (!FT_Init_FreeType(&_fontLibrary)) {
+    if (renderFont[0]) {
+      result = loadFont(renderFont, _fontFace) && loadFont(renderFont, _fontFaceB);
+    } else {
+      for (int i = 0; FONTS[i][0] != nullptr && !result; i++) {
+        if (access(FONTS[i][0], R_OK) == 0 && loadFont(FONTS[i][0], _fontFace)) {
+          const char *bold = access(FONTS[i][1], R_OK) == 0 ? FONTS[i][1] : FONTS[i][0];
+          result = loadFont(bold, _fontFaceB);
+        }
+      }
+    }
+  }
+  return result;
+}
+
+bool Headless::loadFont(const char *filename, FT_Face &face) {
+  bool result = !FT_New_Face(_fontLibrary, filename, 0, &face);
+  trace("load font %s = %d\n", filename, result);
+  return result;
+}
+
+bool headless_options(const char *spec) {
+  char size[OS_PATHNAME_SIZE + 1];
+  strlcpy(size, spec != nullptr ? spec : "", sizeof(size));
+  char *path = strchr(size, ',');
+  if (path != nullptr) {
+    *path++ = '\0';
+    char *font = strchr(path, ',');
+    if (font != nullptr) {
+      *font++ = '\0';
+      strlcpy(renderFont, font, sizeof(renderFont));
+    }
+    strlcpy(renderPath, path, sizeof(renderPath));
+  }
+  bool result = true;
+  if (size[0]) {
+    int w, h;
+    char end;
+    if (sscanf(size, "%dx%d%c", &w, &h, &end) == 2 && w > 0 && h > 0) {
+      renderWidth = w;
+      renderHeight = h;
+    } else {
+      result = false;
+    }
+  }
+  enabled = result;
+  return result;
+}
+
+bool headless_enabled() {
+  return enabled;
+}
+
+int headless_devinit(const char *prog, int width, int height) {
+  // OPTION PREDEF GRMODE takes precedence over the --render size
+  if (width <= 0 || height <= 0) {
+    opt_pref_width = renderWidth;
+    opt_pref_height = renderHeight;
+  }
+  delete headless;
+  headless = new Headless();
+  int result = headless->construct(prog, opt_pref_width, opt_pref_height);
+  if (!result) {
+    delete headless;
+    headless = nullptr;
+  }
+  return result;
+}
+
+void headless_devrestore() {
+  if (headless != nullptr) {
+    if (headless->_dirty || headless->_frame == 0) {
+      headless->writeFrame();
+    }
+    delete headless;
+    headless = nullptr;
+  }
+}
+
+void headless_show_page() {
+  if (headless != nullptr && headless->_dirty) {
+    headless->writeFrame();
+  }
+}
+
+void headless_cls() {
+  if (headless != nullptr) {
+    headless->clear();
+  }
+}
+
+int headless_getx() {
+  return headless != nullptr ? headless->_curX : 0;
+}
+
+int headless_gety() {
+  return headless != nullptr ? headless->_curY : 0;
+}
+
+void headless_setxy(int x, int y) {
+  if (headless != nullptr) {
+    headless->_curX = x;
+    headless->_curY = y;
+  }
+}
+
+//
+// prints the text at the cursor, skipping the escape sequences
+//
+void headless_write(const char *str) {
+  if (headless != nullptr) {
+    const char *run = str;
+    for (const char *p = str; ; p++) {
+      bool end = (*p == '\0');
+      if (end || *p == '\n' || *p == '\r' || *p == '\t' || *p == '\a' || *p == '\033') {
+        headless->print(run, p - run);
+        if (end) {
+          break;
+        }
+        switch (*p) {
+        case '\n':
+          headless->newLine();
+          break;
+        case '\r':
+          headless->_curX = 0;
+          break;
+        case '\t': {
+          int tab = headless->charWidth() * HEADLESS_TAB_SIZE;
+          headless->_curX = ((headless->_curX / tab) + 1) * tab;
+          break;
+        }
+        case '\033':
+          if (p[1] == '[') {
+            p += 2;
+            while (*p && !isalpha(*p)) {
+              p++;
+            }
+            if (*p == '\0') {
+              p--;
+            }
+          }
+          break;
+        default:
+          break;
+        }
+        run = p + 1;
+      }
+    }
+    headless->_dirty = true;
+  }
+}
+
+void headless_setcolor(long color) {
+  if (headless != nullptr) {
+    headless->_fg = GET_FROM_RGB888(ansi_to_rgb(color));
+    maSetColor(ansi_to_rgb(color));
+  }
+}
+
+void headless_settextcolor(long fg, long bg) {
+  if (headless != nullptr) {
+    headless_setcolor(fg);
+    headless->_bg = GET_FROM_RGB888(ansi_to_rgb(bg));
+  }
+}
+
+void headless_line(int x1, int y1, int x2, int y2) {
+  if (headless != nullptr) {
+    maLine(x1, y1, x2, y2);
+    headless->_dirty = true;
+  }
+}
+
+void headless_ellipse(int xc, int yc, int xr, int yr, int fill) {
+  if (headless != nullptr) {
+    maEllipse(xc, yc, xr, yr, fill);
+    headless->_dirty = true;
+  }
+}
+
+void headless_arc(int xc, int yc, double r, double as, double ae, double aspect) {
+  if (headless != nullptr) {
+    maArc(xc, yc, r, as, ae, aspect);
+    headless->_dirty = true;
+  }
+}
+
+void headless_setpixel(int x, int y) {
+  if (headless != nullptr) {
+    maPlot(x, y);
+    headless->_dirty = true;
+  }
+}
+
+long headless_getpixel(int x, int y) {
+  long result = 0;
+  if (headless != nullptr) {
+    Canvas *canvas = headless->getDrawTarget();
+    if (x >= 0 && y >= 0 && x < canvas->_w && y < canvas->_h) {
+      uint8_t r, g, b;
+      GET_RGB(canvas->getLine(y)[x], r, g, b);
+      result = -((r << 16) | (g << 8) | b);
+    }
+  }
+  return result;
+}
+
+void headless_rect(int x1, int y1, int x2, int y2, int fill) {
+  if (headless != nullptr) {
+    if (fill) {
+      maFillRect(MIN(x1, x2), MIN(y1, y2), abs(x2 - x1) + 1, abs(y2 - y1) + 1);
+    } else {
+      maLine(x1, y1, x2, y1);
+      maLine(x1, y2, x2, y2);
+      maLine(x1, y1, x1, y2);
+      maLine(x2, y1, x2, y2);
+    }
+    headless->_dirty = true;
+  }
+}
+
+int headless_ffill(int x, int y, long fill_color, long border_color) {
+  int result = 0;
+  if (headless != nullptr) {
+    int border = border_color == -1 ? -1 : ansi_to_rgb(border_color);
+    result = maFloodFill(x, y, ansi_to_rgb(fill_color), border);
+    headless->_dirty = true;
+  }
+  return result;
+}
+
+int headless_textwidth(const char *str) {
+  return headless != nullptr ? headless->textWidth(str, strlen(str)) : 0;
+}
+
+int headless_textheight(const char *str) {
+  return headless != nullptr ? headless->lineHeight() : 0;
+}
@@ -0,0 +1,44 @@
+// This file is part of SmallBASIC
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+
+#ifndef CONSOLE_HEADLESS_H
+#define CONSOLE_HEADLESS_H
+
+//
+// Off-screen rendering for the console version. The graphics commands draw
+// into a canvas using ui/graphics.cpp, which is saved as a PNG file with
+// each SHOWPAGE and when the program ends.
+//
+
+// parses the --render argument: [WxH][,path[,font]]
+bool headless_options(const char *spec);
+
+// whether --render was given
+bool headless_enabled();
+
+int  headless_devinit(const char *prog, int width, int height);
+void headless_devrestore();
+void headless_show_page();
+void headless_cls();
+int  headless_getx();
+int  headless_gety();
+void headless_setxy(int x, int y);
+void headless_write(const char *str);
+void headless_setcolor(long color);
+void headless_settextcolor(long fg, long bg);
+void headless_line(int x1, int y1, int x2, int y2);
+void headless_ellipse(int xc, int yc, int xr, int yr, int fill);
+void headless_arc(int xc, int yc, double r, double as, double ae, double aspect);
+void headless_setpixel(int x, int y);
+long headless_getpixel(int x, int y);
+void headless_rect(int x1, int y1, int x2, int y2, int fill);
+int  headless_ffill(int x, int y, long fill_color, long border_color);
+int  headless_textwidth(const char *str);
+int  headless_textheight(const char *str);
+
+#endif
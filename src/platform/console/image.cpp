@@ -22,6 +22,8 @@
 #include "common/fs_socket_client.h"
 #include "ui/strlib.h"
 #include "ui/rgb.h"
+#include "ui/image_cache.h"
+#include "ui/image_filter.h"
 #include "lib/lodepng/lodepng.h"
 
 extern "C" int xpm_decode32(uint8_t **image, unsigned *width, unsigned *height, const char *const *xpm);
@@ -36,13 +38,30 @@ struct ImageBuffer {
   uint8_t *_image;
   int _width;
   int _height;
+  uint8_t *_source;
+  unsigned _sourceSize;
+  int _refs;
+  ImageBuffer *_bidNext;
+  ImageBuffer *_nameNext;
+  ImageBuffer *_newer;
+  ImageBuffer *_older;
 };
 
-unsigned nextId = 0;
-strlib::List<ImageBuffer *> cache;
+// each interpreter thread keeps its own images
+static SB_THREAD unsigned nextId;
+static SB_THREAD ImageCache<ImageBuffer> *imageCache;
+
+static ImageCache<ImageBuffer> &cache() {
+  if (imageCache == nullptr) {
+    imageCache = new ImageCache<ImageBuffer>(lodepng_decode32, 'R');
+  }
+  return *imageCache;
+}
 
 void reset_image_cache() {
-  cache.removeAll();
+  delete imageCache;
+  imageCache = nullptr;
+  nextId = 0;
 }
 
 ImageBuffer::ImageBuffer() :
@@ -50,7 +69,14 @@ ImageBuffer::ImageBuffer() :
   _filename(nullptr),
   _image(nullptr),
   _width(0),
-  _height(0) {
+  _height(0),
+  _source(nullptr),
+  _sourceSize(0),
+  _refs(0),
+  _bidNext(nullptr),
+  _nameNext(nullptr),
+  _newer(nullptr),
+  _older(nullptr) {
 }
 
 ImageBuffer::ImageBuffer(ImageBuffer &o) :
@@ -58,14 +84,23 @@ ImageBuffer::ImageBuffer(ImageBuffer &o) :
   _filename(o._filename),
   _image(o._image),
   _width(o._width),
-  _height(o._height) {
+  _height(o._height),
+  _source(o._source),
+  _sourceSize(o._sourceSize),
+  _refs(0),
+  _bidNext(nullptr),
+  _nameNext(nullptr),
+  _newer(nullptr),
+  _older(nullptr) {
 }
 
 ImageBuffer::~ImageBuffer() {
   free(_filename);
   free(_image);
+  free(_source);
   _filename = nullptr;
   _image = nullptr;
+  _source = nullptr;
 }
 
 dev_file_t *get_file() {
@@ -97,7 +132,7 @@ ImageBuffer *load_image(int w) {
       result->_height = h;
       result->_filename = nullptr;
       result->_image = image;
-      cache.add(result);
+      cache().add(result);
     }
   }
   return result;
@@ -109,13 +144,7 @@ ImageBuffer *load_image(var_t *var) {
   if (var->type == V_MAP) {
     int bid = map_get_int(var, IMG_BID, -1);
     if (bid != -1) {
-      List_each(ImageBuffer *, it, cache) {
-        ImageBuffer *next = (*it);
-        if (next->_bid == (unsigned)bid) {
-          result = next;
-          break;
-        }
-      }
+      result = cache().get((unsigned)bid);
     }
   } else if (var->type == V_ARRAY && v_maxdim(var) == 2) {
     int h = ABS(v_ubound(var, 0) - v_lbound(var, 0)) + 1;
@@ -137,27 +166,23 @@ ImageBuffer *load_image(var_t *var) {
     result->_height = h;
     result->_filename = nullptr;
     result->_image = image;
-    cache.add(result);
+    cache().add(result);
   }
   return result;
 }
 
 ImageBuffer *load_image(const uint8_t* buffer, int32_t size) {
-  ImageBuffer *result = nullptr;
-  unsigned w, h;
-  uint8_t *image;
-  unsigned error = 0;
-
-  error = lodepng_decode32(&image, &w, &h, buffer, size);
+  ImageBuffer *result = new ImageBuffer();
+  unsigned error = cache().copy(result, buffer, size);
+  if (!error) {
+    error = cache().decode(result);
+  }
   if (!error) {
-    result = new ImageBuffer();
     result->_bid = ++nextId;
-    result->_width = w;
-    result->_height = h;
-    result->_filename = nullptr;
-    result->_image = image;
-    cache.add(result);
+    cache().add(result);
   } else {
+    delete result;
+    result = nullptr;
     err_throw(ERR_IMAGE_LOAD, lodepng_error_text(error));
   }
   return result;
@@ -167,22 +192,13 @@ ImageBuffer *load_image(const uint8_t* buffer, int32_t size) {
 // png = image(#1)
 //
 ImageBuffer *load_image(dev_file_t *filep) {
-  ImageBuffer *result = nullptr;
-  List_each(ImageBuffer *, it, cache) {
-    ImageBuffer *next = (*it);
-    if (next->_filename != nullptr && strcmp(next->_filename, filep->name) == 0) {
-      result = next;
-      break;
-    }
-  }
-
+  ImageBuffer *result = cache().find(filep->name);
   if (result == nullptr) {
-    unsigned w, h;
-    uint8_t *image;
     unsigned error = 0;
     unsigned network_error = 0;
     var_t *var_p;
 
+    result = new ImageBuffer();
     switch (filep->type) {
     case ft_http_client:
       // open "http://localhost/image1.gif" as #1
@@ -191,30 +207,33 @@ ImageBuffer *load_image(dev_file_t *filep) {
       } else {
         var_p = v_new();
         http_read(filep, var_p);
-        error = lodepng_decode32(&image, &w, &h, (uint8_t *)var_p->v.p.ptr, var_p->v.p.length);
+        error = cache().copy(result, (uint8_t *)var_p->v.p.ptr, var_p->v.p.length);
         v_free(var_p);
         v_detach(var_p);
       }
       break;
     case ft_stream:
-      error = lodepng_decode32_file(&image, &w, &h, filep->name);
+      error = cache().read(result, filep->name);
       break;
     default:
       error = 1;
       break;
     }
+    if (!error && !network_error) {
+      error = cache().decode(result);
+    }
     if (network_error) {
+      delete result;
+      result = nullptr;
       err_throw(ERR_IMAGE_LOAD, ERR_NETWORK);
     } else if (error) {
+      delete result;
+      result = nullptr;
       err_throw(ERR_IMAGE_LOAD, lodepng_error_text(error));
     } else {
-      result = new ImageBuffer();
       result->_bid = ++nextId;
-      result->_width = w;
-      result->_height = h;
       result->_filename = strdup(filep->name);
-      result->_image = image;
-      cache.add(result);
+      cache().add(result);
     }
   }
   return result;
@@ -232,7 +251,7 @@ ImageBuffer *load_xpm_image(char **data) {
     result->_height = h;
     result->_filename = nullptr;
     result->_image = image;
-    cache.add(result);
+    cache().add(result);
   } else {
     err_throw(ERR_IMAGE_LOAD, ERR_XPM_IMAGE);
   }
@@ -247,8 +266,11 @@ ImageBuffer *load_xpm_image(char **data) {
 //
 void cmd_image_clip(var_s *self, var_s *) {
   var_int_t left, top, right, bottom;
+  // the arguments may create images, which can trim the cache
+  int count = par_massget("iiii", &left, &top, &right, &bottom);
+  cache().trim();
   ImageBuffer *image = load_image(self);
-  if (par_massget("iiii", &left, &top, &right, &bottom) == 4) {
+  if (count == 4 && image != nullptr) {
     int w = image->_width - (right + left);
     int h = image->_height - (bottom + top);
     int size = w * h * 4;
@@ -256,6 +278,7 @@ void cmd_image_clip(var_s *self, var_s *) {
     if (size > oldSize) {
       err_throw(ERR_PARAM);
     } else if (size != oldSize) {
+      cache().modified(image);
       uint8_t *dst = (uint8_t *)calloc(size, 1);
       uint8_t *src = image->_image;
       for (int y = 0; y < h; y++) {
@@ -291,11 +314,17 @@ void cmd_image_clip(var_s *self, var_s *) {
 // png.filter(use colorToAlpha(x))
 //
 void cmd_image_filter(var_s *self, var_s *) {
+  cache().trim();
   ImageBuffer *image_buffer = load_image(self);
   if (code_peek() == kwUSE && image_buffer != nullptr) {
     code_skipnext();
     bcip_t use_ip = code_getaddr();
     bcip_t exit_ip = code_getaddr();
+    // once modified the pixels can't be evicted, and the reference keeps
+    // the buffer should the callback release the image
+    cache().modified(image_buffer);
+    unsigned bid = image_buffer->_bid;
+    cache().retain(bid);
     int w = image_buffer->_width;
     int h = image_buffer->_height;
     auto image = image_buffer->_image;
@@ -314,12 +343,118 @@ void cmd_image_filter(var_s *self, var_s *) {
         SET_IMAGE_ARGB(image, offs, a, r, g, b);
       }
     }
+    cache().release(bid);
     code_jump(exit_ip);
   } else {
     err_throw(ERR_PARAM);
   }
 }
 
+//
+// Applies the native filter to the image, updating the size when changed
+//
+void image_filter(var_s *self, filter::Op op) {
+  cache().trim();
+  ImageBuffer *image = load_image(self);
+  if (image == nullptr) {
+    err_throw(ERR_PARAM);
+  } else {
+    // the filter arguments are evaluated while the pixels are held, see
+    // cmd_image_filter()
+    cache().modified(image);
+    unsigned bid = image->_bid;
+    cache().retain(bid);
+    filter::Image pixels = {image->_image, (int)image->_width, (int)image->_height};
+    filter::apply(op, pixels);
+    image->_image = pixels._pixels;
+    if (pixels._width != (int)image->_width || pixels._height != (int)image->_height) {
+      image->_width = pixels._width;
+      image->_height = pixels._height;
+      map_set_int(self, IMG_WIDTH, pixels._width);
+      map_set_int(self, IMG_HEIGHT, pixels._height);
+    }
+    cache().release(bid);
+  }
+}
+
+//
+// png.blur(radius)
+//
+void cmd_image_blur(var_s *self, var_s *) {
+  image_filter(self, filter::BLUR);
+}
+
+//
+// png.colorMatrix(matrix)
+//
+void cmd_image_color_matrix(var_s *self, var_s *) {
+  image_filter(self, filter::COLOR_MATRIX);
+}
+
+//
+// png.convolve(kernel [, divisor [, bias]])
+//
+void cmd_image_convolve(var_s *self, var_s *) {
+  image_filter(self, filter::CONVOLVE);
+}
+
+//
+// png.edges()
+//
+void cmd_image_edges(var_s *self, var_s *) {
+  image_filter(self, filter::EDGES);
+}
+
+//
+// Calls the supplied callback function with each row of pixels
+//
+// func invert(x)
+//   for i = 0 to len(x) - 1
+//     x[i] = (x[i] band 0xff000000) bor (0xffffff - (x[i] band 0xffffff))
+//   next
+//   return x
+// end
+// png.filterRows(use invert(x))
+//
+void cmd_image_filter_rows(var_s *self, var_s *) {
+  image_filter(self, filter::ROWS);
+}
+
+//
+// png.lut(table)
+//
+void cmd_image_lut(var_s *self, var_s *) {
+  image_filter(self, filter::LUT);
+}
+
+//
+// png.resize(w, h [, box])
+//
+void cmd_image_resize(var_s *self, var_s *) {
+  image_filter(self, filter::RESIZE);
+}
+
+//
+// png.rotate(degrees)
+//
+void cmd_image_rotate(var_s *self, var_s *) {
+  image_filter(self, filter::ROTATE);
+}
+
+//
+// png.sharpen([amount])
+//
+void cmd_image_sharpen(var_s *self, var_s *) {
+  image_filter(self, filter::SHARPEN);
+}
+
+//
+// png.threshold(level [, low, high])
+//
+void cmd_image_threshold(var_s *self, var_s *) {
+  image_filter(self, filter::THRESHOLD);
+}
+
 //
 // Paste the given image into this image at the given x, y location
 //
@@ -329,8 +464,10 @@ void cmd_image_filter(var_s *self, var_s *) {
 void cmd_image_paste(var_s *self, var_s *) {
   var_int_t x, y;
   var_t *var;
-  ImageBuffer *image = load_image(self);
+  // the arguments may create images, which can trim the cache
   int count = par_massget("Piiii", &var, &x, &y);
+  cache().trim();
+  ImageBuffer *image = load_image(self);
   if (image != nullptr && (count == 1 || count == 3)) {
     ImageBuffer *srcImage = load_image(var);
     if (srcImage == nullptr) {
@@ -340,6 +477,7 @@ void cmd_image_paste(var_s *self, var_s *) {
         x = 0;
         y = 0;
       }
+      cache().modified(image);
       int dw = image->_width;
       int dh = image->_height;
       int sw = srcImage->_width;
@@ -358,6 +496,10 @@ void cmd_image_paste(var_s *self, var_s *) {
           dst[dpos + 3] = src[spos + 3];
         }
       }
+      if (var->type == V_ARRAY) {
+        // the temporary buffer built from the array
+        cache().release(srcImage->_bid);
+      }
     }
   } else {
     err_throw(ERR_PARAM);
@@ -371,25 +513,38 @@ void cmd_image_paste(var_s *self, var_s *) {
 // png.save(#1)
 //
 void cmd_image_save(var_s *self, var_s *) {
-  ImageBuffer *image = load_image(self);
   dev_file_t *filep = nullptr;
   byte code = code_peek();
   int error = -1;
-  var_t *array;
+  var_t *array = nullptr;
   var_t var;
 
+  // the arguments may create images, which can trim the cache
+  v_init(&var);
+  switch (code) {
+  case kwTYPE_SEP:
+    filep = get_file();
+    break;
+  case kwTYPE_VAR:
+    array = par_getvar_ptr();
+    break;
+  default:
+    eval(&var);
+    break;
+  }
+
+  cache().trim();
+  ImageBuffer *image = load_image(self);
   if (!prog_error && image != nullptr) {
     unsigned w = image->_width;
     unsigned h = image->_height;
     switch (code) {
     case kwTYPE_SEP:
-      filep = get_file();
       if (filep != nullptr && filep->open_flags == DEV_FILE_OUTPUT) {
         error = lodepng_encode32_file(filep->name, image->_image, w, h);
       }
       break;
     case kwTYPE_VAR:
-      array = par_getvar_ptr();
       v_tomatrix(array, h, w);
       //     x0   x1   x2    (w=3,h=2)
       // y0  rgba rgba rgba  ypos=0
@@ -408,15 +563,13 @@ void cmd_image_save(var_s *self, var_s *) {
       error = 0;
       break;
     default:
-      v_init(&var);
-      eval(&var);
-      if (var.type == V_STR && !prog_error) {
+      if (var.type == V_STR) {
         error = lodepng_encode32_file(var.v.p.ptr, image->_image, w, h);
       }
-      v_free(&var);
       break;
     }
   }
+  v_free(&var);
   if (error == -1) {
     err_throw(ERR_PARAM);
   } else if (error != 0) {
@@ -434,10 +587,22 @@ void create_image(var_p_t var, ImageBuffer *image) {
     var_p_t value = map_add_var(var, IMG_NAME, 0);
     v_setstr(value, image->_filename);
   }
+  var->v.m.cls_id = MAP_CLS_IMAGE;
+  cache().retain(image->_bid);
+  v_create_func(var, "blur", cmd_image_blur);
   v_create_func(var, "clip", cmd_image_clip);
+  v_create_func(var, "colorMatrix", cmd_image_color_matrix);
+  v_create_func(var, "convolve", cmd_image_convolve);
+  v_create_func(var, "edges", cmd_image_edges);
   v_create_func(var, "filter", cmd_image_filter);
+  v_create_func(var, "filterRows", cmd_image_filter_rows);
+  v_create_func(var, "lut", cmd_image_lut);
   v_create_func(var, "paste", cmd_image_paste);
+  v_create_func(var, "resize", cmd_image_resize);
+  v_create_func(var, "rotate", cmd_image_rotate);
   v_create_func(var, "save", cmd_image_save);
+  v_create_func(var, "sharpen", cmd_image_sharpen);
+  v_create_func(var, "threshold", cmd_image_threshold);
 }
 
 //
@@ -454,6 +619,10 @@ extern "C" void v_create_image(var_p_t var) {
   ImageBuffer *image = nullptr;
   dev_file_t *filep = nullptr;
 
+  // no buffers are held, so the pixels can be evicted
+  cache().trim();
+  v_init(&arg);
+
   byte code = code_peek();
   switch (code) {
   case kwTYPE_SEP:
@@ -468,7 +637,6 @@ extern "C" void v_create_image(var_p_t var) {
     break;
 
   default:
-    v_init(&arg);
     eval(&arg);
     if (arg.type == V_STR && !prog_error) {
       dev_file_t file;
@@ -502,7 +670,6 @@ extern "C" void v_create_image(var_p_t var) {
     } else {
       image = load_image(&arg);
     }
-    v_free(&arg);
     break;
   };
 
@@ -511,5 +678,15 @@ extern "C" void v_create_image(var_p_t var) {
   } else {
     err_throw(ERR_BAD_FILE_HANDLE);
   }
+
+  // free after create_image() since the argument may hold the only reference
+  v_free(&arg);
 }
 
+extern "C" void v_retain_image(var_p_t var) {
+  cache().retain(map_get_int(var, IMG_BID, -1));
+}
+
+extern "C" void v_release_image(var_p_t var) {
+  cache().release(map_get_int(var, IMG_BID, -1));
+}
@@ -12,6 +12,12 @@
 #include <errno.h>
 #include "common/sbapp.h"
 #include "ui/kwp.h"
+#if defined(_HEADLESS)
+#include "platform/console/headless.h"
+#define RENDER_OPTION "r:"
+#else
+#define RENDER_OPTION ""
+#endif
 
 // decompile handling
 extern "C" {
@@ -33,6 +39,14 @@ static struct option OPTIONS[] = {
   {"decompile",      optional_argument, NULL, 's'},
   {"option",         optional_argument, NULL, 'o'},
   {"cmd",            optional_argument, NULL, 'c'},
+  {"profile",        optional_argument, NULL, 'p'},
+  {"stats",          optional_argument, NULL, 't'},
+  {"image-cache",    optional_argument, NULL, 'g'},
+  {"limit",          required_argument, NULL, 'l'},
+  {"optimise",       no_argument,       NULL, 'O'},
+#if defined(_HEADLESS)
+  {"render",         required_argument, NULL, 'r'},
+#endif
   {"stdin",          optional_argument, NULL, '-'},
   {"help",           optional_argument, NULL, 'h'},
   {0, 0, 0, 0}
@@ -235,6 +249,50 @@ void decompile(const char *path) {
   chdir(prev_cwd);
 }
 
+//
+// sets the run limits from name=value pairs, eg ops=1000000,heap=64M,stack=500,time=2000
+//
+bool set_limits(const char *arg) {
+  bool result = true;
+  while (result && *arg) {
+    const char *eq = strchr(arg, '=');
+    char *end = nullptr;
+    if (eq == nullptr) {
+      result = false;
+      break;
+    }
+    uint64_t value = strtoull(eq + 1, &end, 10);
+    switch (*end) {
+    case 'k':
+    case 'K':
+      value <<= 10;
+      end++;
+      break;
+    case 'm':
+    case 'M':
+      value <<= 20;
+      end++;
+      break;
+    }
+    int len = eq - arg;
+    if (end == eq + 1 || (*end != ',' && *end != '\0')) {
+      result = false;
+    } else if (len == 3 && strncmp(arg, "ops", len) == 0) {
+      opt_max_ops = value;
+    } else if (len == 4 && strncmp(arg, "heap", len) == 0) {
+      opt_max_heap = value;
+    } else if (len == 5 && strncmp(arg, "stack", len) == 0) {
+      opt_max_stack = (uint32_t)value;
+    } else if (len == 4 && strncmp(arg, "time", len) == 0) {
+      opt_max_time = (uint32_t)value;
+    } else {
+      result = false;
+    }
+    arg = *end == ',' ? end + 1 : end;
+  }
+  return result;
+}
+
 //
 // process command-line parameters
 //
@@ -242,7 +300,7 @@ bool process_options(int argc, char *argv[], char **runFile, bool *tmpFile, bool
   bool result = true;
   while (result) {
     int option_index = 0;
-    int c = getopt_long(argc, argv, "vkfxim:s:o:c:h::", OPTIONS, &option_index);
+    int c = getopt_long(argc, argv, "vkfxim:s:o:c:p::t::g:l:O" RENDER_OPTION "h::", OPTIONS, &option_index);
     if (c == -1 && !option_index) {
       // no more options
       for (int i = 1; i < argc; i++) {
@@ -313,6 +371,46 @@ bool process_options(int argc, char *argv[], char **runFile, bool *tmpFile, bool
     case 'i':
       *iterate = true;
       break;
+    case 'p':
+      opt_host_profile = 1;
+      if (optarg) {
+        strlcpy(opt_profile_file, optarg, sizeof(opt_profile_file));
+      }
+      break;
+    case 't':
+      opt_stats = 1;
+      if (optarg) {
+        strlcpy(opt_stats_file, optarg, sizeof(opt_stats_file));
+      }
+      break;
+    case 'g':
+      // budget in MB, with an optional disk cache directory
+      if (optarg) {
+        const char *dir = strchr(optarg, ',');
+        opt_image_budget = atoi(optarg);
+        if (dir != nullptr) {
+          strlcpy(opt_image_cache, dir + 1, sizeof(opt_image_cache));
+        }
+      }
+      break;
+    case 'l':
+      if (!set_limits(optarg)) {
+        fprintf(stderr, "invalid limit: %s\n", optarg);
+        result = false;
+      }
+      break;
+    case 'O':
+      opt_optimise = 1;
+      break;
+#if defined(_HEADLESS)
+    case 'r':
+      // [WxH][,path[,font]]
+      if (!headless_options(optarg)) {
+        fprintf(stdout, "sbasic: invalid render size '%s'\n", optarg);
+        result = false;
+      }
+      break;
+#endif
     default:
       show_help();
       result = false;
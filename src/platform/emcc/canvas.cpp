@@ -325,6 +325,11 @@ void maEllipse(int xc, int yc, int rx, int ry, int fill) {
   }
 }
 
+int maFloodFill(int x, int y, int fillColor, int borderColor) {
+  // use the generic fill
+  return 0;
+}
+
 void maLine(int startX, int startY, int endX, int endY) {
   if (drawTarget) {
     draw_line(drawTarget->_id, startX, startY, endX, endY, get_color());
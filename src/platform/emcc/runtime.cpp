@@ -649,3 +649,4 @@ void System::completeKeyword(int index) const {}
 void maHideVirtualKeyboard(void) {}
 void maShowVirtualKeyboard(void) {}
 void maUpdateScreen(void) {}
+void maUpdateScreenRegion(const MARect *rects, int count) {}
@@ -392,6 +392,11 @@ void maEllipse(int xc, int yc, int rx, int ry, int fill) {
   }
 }
 
+int maFloodFill(int x, int y, int fillColor, int borderColor) {
+  // use the generic fill
+  return 0;
+}
+
 void maDrawText(int left, int top, const char *str, int length) {
   if (str && str[0]) {
     graphics->drawText(left, top, str, length);
@@ -478,6 +483,10 @@ void maUpdateScreen(void) {
   ((::GraphicsWidget *)graphics)->redraw();
 }
 
+void maUpdateScreenRegion(const MARect *rects, int count) {
+  maUpdateScreen();
+}
+
 void maShowVirtualKeyboard(void) {
   // not implemented
 }
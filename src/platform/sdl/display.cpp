@@ -157,6 +157,23 @@ void Graphics::redraw() {
   SDL_UpdateWindowSurface(_window);
 }
 
+void Graphics::redraw(const MARect *rects, int count) {
+  auto *areas = new SDL_Rect[count];
+  for (int i = 0; i < count; i++) {
+    areas[i].x = rects[i].left;
+    areas[i].y = rects[i].top;
+    areas[i].w = rects[i].width;
+    areas[i].h = rects[i].height;
+    if (_surface != NULL) {
+      SDL_Surface *src = ((Canvas *)_screen)->_surface;
+      SDL_Rect dstrect = areas[i];
+      SDL_BlitSurface(src, &areas[i], _surface, &dstrect);
+    }
+  }
+  SDL_UpdateWindowSurfaceRects(_window, areas, count);
+  delete [] areas;
+}
+
 void Graphics::resize(int w, int h) {
   logEntered();
   SDL_Surface *surface = SDL_GetWindowSurface(_window);
@@ -191,6 +208,12 @@ void maUpdateScreen(void) {
   ((::Graphics *)graphics)->redraw();
 }
 
+void maUpdateScreenRegion(const MARect *rects, int count) {
+  if (count > 0) {
+    ((::Graphics *)graphics)->redraw(rects, count);
+  }
+}
+
 void maShowVirtualKeyboard(void) {
   // not implemented
 }
@@ -21,6 +21,7 @@ struct Graphics : ui::Graphics {
 
   bool construct(const char *font, const char *boldFont);
   void redraw();
+  void redraw(const MARect *rects, int count);
   void resize(int w, int h);
 
 private:
@@ -44,6 +44,7 @@ static struct option OPTIONS[] = {
   {"edit",        optional_argument, NULL, 'e'},
   {"debug",       optional_argument, NULL, 'd'},
   {"debugPort",   optional_argument, NULL, 'p'},
+  {"image-cache", optional_argument, NULL, 'g'},
   {0, 0, 0, 0}
 };
 
@@ -262,7 +263,7 @@ int main(int argc, char* argv[]) {
 
   while (1) {
     int option_index = 0;
-    int c = getopt_long(argc, argv, "hvkc:f:r:x:n:m:e:d:p:", OPTIONS, &option_index);
+    int c = getopt_long(argc, argv, "hvkc:f:r:x:n:m:e:d:p:g:", OPTIONS, &option_index);
     if (c == -1) {
       // no more options
       if (!option_index) {
@@ -334,6 +335,13 @@ int main(int argc, char* argv[]) {
     case 'p':
       g_debugPort = atoi(optarg);
       break;
+    case 'g':
+      // budget in MB, with an optional disk cache directory
+      opt_image_budget = atoi(optarg);
+      if (strchr(optarg, ',') != NULL) {
+        strlcpy(opt_image_cache, strchr(optarg, ',') + 1, sizeof(opt_image_cache));
+      }
+      break;
     case 'h':
       showHelp();
       exit(1);
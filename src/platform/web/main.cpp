@@ -22,7 +22,6 @@
 
 Canvas g_canvas;
 uint32_t g_start = 0;
-uint32_t g_maxTime = 2000;
 bool g_graphicText = true;
 bool g_noExecute = false;
 bool g_json = false;
@@ -32,6 +31,15 @@ StringList g_cookies;
 String g_path;
 String g_data;
 
+// the screen size, applied on the thread running the program
+int g_width = 1024;
+int g_height = 768;
+
+// the last program served, kept compiled between requests
+sbasic_context_t *g_context = nullptr;
+String g_contextBas;
+time_t g_contextTime = 0;
+
 static struct option OPTIONS[] = {
   {"file-permitted", no_argument,       nullptr, 'f'},
   {"help",           no_argument,       nullptr, 'h'},
@@ -62,8 +70,6 @@ void init() {
   opt_quiet = 1;
   opt_verbose = 0;
   opt_autolocal = 0;
-  os_graf_mx = 1024;
-  os_graf_my = 768;
 }
 
 void show_help() {
@@ -111,6 +117,23 @@ MHD_Result accept_cb(void *cls, const struct sockaddr *addr, socklen_t addrlen)
   return MHD_YES;
 }
 
+// runs the program, reusing the compiled version when unchanged
+void run_bas(const char *bas) {
+  time_t modified = sys_filetime(bas);
+  if (g_context != nullptr && (!g_contextBas.equals(bas, false) || g_contextTime != modified)) {
+    sbasic_destroy(g_context);
+    g_context = nullptr;
+  }
+  if (g_context == nullptr) {
+    g_context = sbasic_create(bas);
+    g_contextBas = bas;
+    g_contextTime = modified;
+  }
+  if (g_context != nullptr) {
+    sbasic_run(g_context);
+  }
+}
+
 MHD_Response *execute(MHD_Connection *connection, const char *bas) {
   const char *width = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "width");
   const char *height = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "height");
@@ -120,11 +143,13 @@ MHD_Response *execute(MHD_Connection *connection, const char *bas) {
   const char *contentType = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_TYPE);
 
   if (width != nullptr) {
-    os_graf_mx = atoi(width);
+    g_width = atoi(width);
   }
   if (height != nullptr) {
-    os_graf_my = atoi(height);
+    g_height = atoi(height);
   }
+  os_graf_mx = g_width;
+  os_graf_my = g_height;
   if (graphicText != nullptr) {
     g_graphicText = atoi(graphicText) > 0;
   }
@@ -139,7 +164,7 @@ MHD_Response *execute(MHD_Connection *connection, const char *bas) {
   g_canvas.setGraphicText(g_graphicText);
   g_canvas.setJSON(g_json || (accept && strncmp(accept, "application/json", 16) == 0));
   g_cookies.removeAll();
-  sbasic_main(bas);
+  run_bas(bas);
   g_connection = nullptr;
   String page = g_canvas.getPage();
   MHD_Response *response = MHD_create_response_from_buffer(page.length(), (void *)page.c_str(), MHD_RESPMEM_MUST_COPY);
@@ -241,6 +266,7 @@ MHD_Result access_cb(void *cls,
 int main(int argc, char **argv) {
   init();
   int port = 8080;
+  opt_max_time = 2000;
   char *runBas = nullptr;
 
   while (1) {
@@ -258,10 +284,10 @@ int main(int argc, char **argv) {
       runBas = optarg;
       break;
     case 'w':
-      os_graf_mx = atoi(optarg);
+      g_width = atoi(optarg);
       break;
     case 'e':
-      os_graf_my = atoi(optarg);
+      g_height = atoi(optarg);
       break;
     case 'c':
       strcpy(opt_command, optarg);
@@ -284,7 +310,7 @@ int main(int argc, char **argv) {
       port = atoi(optarg);
       break;
     case 't':
-      g_maxTime = atoi(optarg);
+      opt_max_time = atoi(optarg);
       break;
     case 'm':
       if (optarg) {
@@ -312,6 +338,8 @@ int main(int argc, char **argv) {
   if (runBas != nullptr) {
     g_canvas.reset();
     g_start = dev_get_millisecond_count();
+    os_graf_mx = g_width;
+    os_graf_my = g_height;
     sbasic_main(runBas);
     puts(g_canvas.getPage().c_str());
   } else {
@@ -329,6 +357,8 @@ int main(int argc, char **argv) {
                      // Sleep to reduce cpu usage.
     }
 
+    // the context belongs to the server's thread, so the program is
+    // released with the process
     MHD_stop_daemon(d);
   }
   free(execBas);
@@ -375,8 +405,10 @@ void osd_cls(void) {
 }
 
 int osd_events(int wait_flag) {
+  // commands are stopped by the opt_max_time limit, this also ends the
+  // loops that wait on events, such as job.wait()
   int result;
-  if (dev_get_millisecond_count() - g_start > g_maxTime) {
+  if (opt_max_time && dev_get_millisecond_count() - g_start > opt_max_time) {
     result = -2;
   } else {
     result = 0;
@@ -493,6 +525,7 @@ int osd_getx() { return 0; }
 int osd_gety() { return 0; }
 int osd_textheight(const char *str) { return 1; }
 long osd_getpixel(int x, int y) { return 0;}
+int osd_ffill(int x, int y, long fill_color, long border_color) { return 0; }
 void osd_beep() {}
 void osd_clear_sound_queue() {}
 void osd_refresh() {}
@@ -502,6 +535,8 @@ void osd_sound(int frq, int ms, int vol, int bgplay) {}
 void osd_ellipse(int xc, int yc, int xr, int yr, int fill) {}
 void osd_arc(int xc, int yc, double r, double as, double ae, double aspect) {}
 void v_create_image(var_p_t var) {}
+void v_retain_image(var_p_t var) {}
+void v_release_image(var_p_t var) {}
 void v_create_form(var_p_t var) {}
 void v_create_window(var_p_t var) {}
 void dev_show_page() {}
@@ -191,7 +191,7 @@ int AnsiWidget::getScreenId(bool back) {
 void AnsiWidget::print(const char *str) {
   unsigned len = (str == nullptr ? 0 : strlen(str));
   if (len) {
-    _back->drawInto();
+    _back->printInto();
 
     int lineHeight = textHeight();
     const char *p = (char *)str;
@@ -46,6 +46,7 @@ struct AnsiWidget {
   void drawLine(int x1, int y1, int x2, int y2);
   void drawRect(int x1, int y1, int x2, int y2);
   void drawRectFilled(int x1, int y1, int x2, int y2);
+  bool floodFill(int x, int y, long fill, long border) { return _back->floodFill(x, y, fill, border); }
   void flush(bool force, bool vscroll=false, int maxPending = MAX_PENDING);
   void flushNow() { if (_front) _front->drawBase(false); }
   int  getBackgroundColor() { return _back->_bg; }
@@ -0,0 +1,226 @@
+// This file is part of SmallBASIC
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+
+#ifndef UI_BLEND
+#define UI_BLEND
+
+#include <stdint.h>
+#include <string.h>
+#include "ui/rgb.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BLEND_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BLEND_NEON
+#endif
+
+//
+// Span kernels for compositing onto a canvas line. The source image bytes
+// (see GET_IMAGE_ARGB) share the channel order of the canvas pixel_t on
+// each platform, so the kernels treat a pixel as four byte lanes with the
+// alpha in the top byte. The destination is always written fully opaque.
+//
+// Each channel is blended as (s * a + d * (255 - a)) / 255, rounded, with
+// the division replaced by (t + 128 + ((t + 128) >> 8)) >> 8.
+//
+namespace blend {
+
+#define BLEND_OPAQUE 0xff000000
+
+// alpha above which a constant opacity replaces the pixel alpha
+#define BLEND_OPACITY_MIN 64
+
+inline uint32_t load(const void *p) {
+  uint32_t result;
+  memcpy(&result, p, sizeof(result));
+  return result;
+}
+
+inline uint8_t channel(uint32_t s, uint32_t d, uint32_t a) {
+  uint32_t t = s * a + d * (255 - a) + 128;
+  return (t + (t >> 8)) >> 8;
+}
+
+inline pixel_t pixel(uint32_t s, uint32_t d, uint32_t a) {
+  uint32_t b0 = channel(s & 0xff, d & 0xff, a);
+  uint32_t b1 = channel((s >> 8) & 0xff, (d >> 8) & 0xff, a);
+  uint32_t b2 = channel((s >> 16) & 0xff, (d >> 16) & 0xff, a);
+  return BLEND_OPAQUE | (b2 << 16) | (b1 << 8) | b0;
+}
+
+//
+// returns the alpha to use for a source pixel, where opacity is the
+// constant alpha from 1..254, or 0 when the pixel alpha applies
+//
+inline uint32_t alpha(uint32_t a, uint32_t opacity) {
+  return (opacity && a > BLEND_OPACITY_MIN) ? opacity : a;
+}
+
+#if defined(BLEND_SSE2)
+//
+// blends four source pixels onto four destination pixels, with the
+// alpha for each pixel held in the low byte of each 32-bit lane
+//
+inline __m128i blend4(__m128i s, __m128i d, __m128i a) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i c255 = _mm_set1_epi16(255);
+  const __m128i c128 = _mm_set1_epi16(128);
+  a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+  __m128i aLo = _mm_unpacklo_epi32(a, a);
+  __m128i aHi = _mm_unpackhi_epi32(a, a);
+
+  __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), aLo),
+                             _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(c255, aLo)));
+  __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), aHi),
+                             _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(c255, aHi)));
+  lo = _mm_add_epi16(lo, c128);
+  hi = _mm_add_epi16(hi, c128);
+  lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+  hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+  return _mm_or_si128(_mm_packus_epi16(lo, hi), _mm_set1_epi32((int)BLEND_OPAQUE));
+}
+
+//
+// stores the four blended pixels, skipping the arithmetic when the
+// pixels are all transparent or all opaque
+//
+inline void store4(pixel_t *dst, __m128i s, __m128i a) {
+  int clear = _mm_movemask_epi8(_mm_cmpeq_epi32(a, _mm_setzero_si128()));
+  if (clear != 0xffff) {
+    int solid = _mm_movemask_epi8(_mm_cmpeq_epi32(a, _mm_set1_epi32(255)));
+    __m128i result;
+    if (solid == 0xffff) {
+      result = _mm_or_si128(s, _mm_set1_epi32((int)BLEND_OPAQUE));
+    } else {
+      result = blend4(s, _mm_loadu_si128((const __m128i *)dst), a);
+    }
+    _mm_storeu_si128((__m128i *)dst, result);
+  }
+}
+#elif defined(BLEND_NEON)
+//
+// blends four source pixels onto four destination pixels, with the
+// alpha for each pixel held in the low byte of each 32-bit lane
+//
+inline uint32x4_t blend4(uint32x4_t s, uint32x4_t d, uint32x4_t a) {
+  uint8x16_t a8 = vreinterpretq_u8_u32(vmulq_n_u32(a, 0x01010101));
+  uint8x16_t ia8 = vmvnq_u8(a8);
+  uint8x16_t s8 = vreinterpretq_u8_u32(s);
+  uint8x16_t d8 = vreinterpretq_u8_u32(d);
+  uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(s8), vget_low_u8(a8)),
+                           vget_low_u8(d8), vget_low_u8(ia8));
+  uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(s8), vget_high_u8(a8)),
+                           vget_high_u8(d8), vget_high_u8(ia8));
+  uint8x16_t result = vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+                                  vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+  return vorrq_u32(vreinterpretq_u32_u8(result), vdupq_n_u32(BLEND_OPAQUE));
+}
+
+//
+// stores the four blended pixels, skipping the arithmetic when the
+// pixels are all transparent or all opaque
+//
+inline void store4(pixel_t *dst, uint32x4_t s, uint32x4_t a) {
+  if (vmaxvq_u32(a) != 0) {
+    uint32x4_t result;
+    if (vminvq_u32(a) == 255) {
+      result = vorrq_u32(s, vdupq_n_u32(BLEND_OPAQUE));
+    } else {
+      result = blend4(s, vld1q_u32(dst), a);
+    }
+    vst1q_u32(dst, result);
+  }
+}
+#endif
+
+//
+// composites a span of source image pixels onto the destination line
+//
+// @param dst the first destination pixel
+// @param src the first source pixel in GET_IMAGE_ARGB layout
+// @param width the number of pixels
+// @param opacity the constant alpha from 1..254, or 0 to use the pixel alpha
+//
+inline void span_rgba(pixel_t *dst, const uint8_t *src, int width, uint32_t opacity) {
+  int x = 0;
+#if defined(BLEND_SSE2)
+  const __m128i limit = _mm_set1_epi32(BLEND_OPACITY_MIN);
+  const __m128i constant = _mm_set1_epi32((int)opacity);
+  for (; x + 4 <= width; x += 4) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(src + x * 4));
+    __m128i a = _mm_srli_epi32(s, 24);
+    if (opacity) {
+      __m128i over = _mm_cmpgt_epi32(a, limit);
+      a = _mm_or_si128(_mm_and_si128(over, constant), _mm_andnot_si128(over, a));
+    }
+    store4(dst + x, s, a);
+  }
+#elif defined(BLEND_NEON)
+  const uint32x4_t limit = vdupq_n_u32(BLEND_OPACITY_MIN);
+  const uint32x4_t constant = vdupq_n_u32(opacity);
+  for (; x + 4 <= width; x += 4) {
+    uint32x4_t s = vreinterpretq_u32_u8(vld1q_u8(src + x * 4));
+    uint32x4_t a = vshrq_n_u32(s, 24);
+    if (opacity) {
+      a = vbslq_u32(vcgtq_u32(a, limit), constant, a);
+    }
+    store4(dst + x, s, a);
+  }
+#endif
+  for (src += x * 4; x < width; x++, src += 4) {
+    uint32_t s = load(src);
+    uint32_t a = alpha(s >> 24, opacity);
+    if (a == 255) {
+      dst[x] = s | BLEND_OPAQUE;
+    } else if (a != 0) {
+      dst[x] = pixel(s, dst[x], a);
+    }
+  }
+}
+
+//
+// composites a span of a solid colour through an 8-bit coverage mask
+//
+// @param dst the first destination pixel
+// @param mask the coverage for each pixel
+// @param width the number of pixels
+// @param color the colour to draw
+//
+inline void span_mask(pixel_t *dst, const uint8_t *mask, int width, pixel_t color) {
+  int x = 0;
+#if defined(BLEND_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i s = _mm_set1_epi32((int)color);
+  for (; x + 4 <= width; x += 4) {
+    __m128i a = _mm_cvtsi32_si128((int)load(mask + x));
+    a = _mm_unpacklo_epi16(_mm_unpacklo_epi8(a, zero), zero);
+    store4(dst + x, s, a);
+  }
+#elif defined(BLEND_NEON)
+  const uint32x4_t s = vdupq_n_u32(color);
+  for (; x + 4 <= width; x += 4) {
+    uint8x8_t m = vreinterpret_u8_u32(vdup_n_u32(load(mask + x)));
+    uint32x4_t a = vmovl_u16(vget_low_u16(vmovl_u8(m)));
+    store4(dst + x, s, a);
+  }
+#endif
+  for (; x < width; x++) {
+    uint32_t a = mask[x];
+    if (a == 255) {
+      dst[x] = color | BLEND_OPAQUE;
+    } else if (a != 0) {
+      dst[x] = pixel(color, dst[x], a);
+    }
+  }
+}
+
+} // namespace blend
+
+#endif
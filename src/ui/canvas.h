@@ -37,8 +37,18 @@ struct Canvas {
   bool _ownerSurface{};
 };
 
+#else
+#if defined(_HEADLESS)
+// the clip rectangle, with the fields from android/rect.h
+struct ARect {
+  int32_t left;
+  int32_t top;
+  int32_t right;
+  int32_t bottom;
+};
 #else
 #include <android/rect.h>
+#endif
 #define MAX_CANVAS_SIZE 20
 
 struct Canvas {
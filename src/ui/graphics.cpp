@@ -10,6 +10,7 @@
 
 #include "ui/graphics.h"
 #include "ui/utils.h"
+#include "ui/blend.h"
 #include <cmath>
 
 #include "common/smbas.h"
@@ -33,48 +34,249 @@ inline double fpart(double x) {
 #define _SWAP(a, b) \
   { __typeof__(a) tmp; tmp = a; (a) = b; (b) = tmp; }
 
+//
+// returns whether the string holds only 7-bit characters
+//
+static inline bool is_ascii(const char *str, int len) {
+  int i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t word;
+    memcpy(&word, str + i, sizeof(word));
+    if (word & 0x8080808080808080ULL) {
+      return false;
+    }
+  }
+  for (; i < len; i++) {
+    if (str[i] & 0x80) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// returns the character at str[i] and advances i. A byte that does not
+// begin a valid UTF-8 sequence is returned as is, so that text holding
+// single byte characters keeps drawing the same glyphs
+//
+static inline uint32_t next_char(const char *str, int len, int &i) {
+  auto *s = (const uint8_t *)str + i;
+  uint32_t result = s[0];
+  int size = 1;
+  if (result >= 0xc2 && result <= 0xf4) {
+    int n = result >= 0xf0 ? 3 : result >= 0xe0 ? 2 : 1;
+    if (i + n < len) {
+      uint32_t code = result & (0x3f >> n);
+      int j = 1;
+      for (; j <= n && (s[j] & 0xc0) == 0x80; j++) {
+        code = (code << 6) | (s[j] & 0x3f);
+      }
+      static const uint32_t min[] = {0, 0x80, 0x800, 0x10000};
+      if (j > n && code >= min[n] && code <= 0x10ffff) {
+        result = code;
+        size = n + 1;
+      }
+    }
+  }
+  i += size;
+  return result;
+}
+
 Font::Font(FT_Face face, int size, bool italic) :
-  _face(face) {
+  _size(size),
+  _fixed(0),
+  _italic(italic),
+  _face(face),
+  _atlas(nullptr) {
   FT_Set_Pixel_Sizes(face, 0, size);
   _spacing = 1 + (FT_MulFix(_face->height, _face->size->metrics.x_scale) / 64);
   _h = (FT_MulFix(_face->ascender, _face->size->metrics.x_scale) / 64) +
        (FT_MulFix(_face->descender, _face->size->metrics.x_scale) / 64);
-  FT_Matrix  matrix;
-  if (italic) {
-    matrix.xx = 0x10000L;
-    matrix.xy = 0.12 * 0x10000L;
-    matrix.yx = 0;
-    matrix.yy = 0x10000L;
-  }
 
+  // render each glyph, then pack the trimmed bitmaps into a single buffer
+  FT_Glyph slots[MAX_GLYPHS];
+  int advance[MAX_GLYPHS];
+  size_t atlasSize = 1;
   for (int i = 0; i < MAX_GLYPHS; i++) {
-    FT_UInt slot = FT_Get_Char_Index(face, i);
-    FT_Error error = FT_Load_Glyph(face, slot, FT_LOAD_TARGET_LIGHT);
-    if (error) {
-      trace("Failed to load %d", i);
+    if (render(i, &slots[i], &advance[i])) {
+      FT_Bitmap *bitmap = &((FT_BitmapGlyph)slots[i])->bitmap;
+      atlasSize += bitmap->width * bitmap->rows;
+    } else {
+      slots[i] = nullptr;
+    }
+  }
+  _atlas = (uint8_t *)malloc(atlasSize);
+  uint8_t *dst = _atlas;
+  for (int i = 0; i < MAX_GLYPHS; i++) {
+    if (slots[i] != nullptr) {
+      if (dst != nullptr) {
+        _glyph[i]._offset = dst - _atlas;
+        dst = copy(slots[i], advance[i], &_glyph[i], dst);
+      }
+      FT_Done_Glyph(slots[i]);
+    }
+  }
+
+  _fixed = _glyph[0]._w;
+  for (int i = 1; i < 0x80 && _fixed; i++) {
+    if (_glyph[i]._w != _fixed) {
+      _fixed = 0;
+    }
+  }
+}
+
+Font::~Font() {
+  for (auto &extra : _extra) {
+    free(extra._bitmap);
+  }
+  free(_atlas);
+}
+
+//
+// returns the glyph and its bitmap, loading characters beyond the atlas on first use
+//
+const Glyph *Font::glyph(uint32_t code, const uint8_t **bitmap) {
+  const Glyph *result;
+  if (code < MAX_GLYPHS) {
+    result = &_glyph[code];
+    *bitmap = _atlas + result->_offset;
+  } else {
+    ExtraGlyph &extra = _extra[code % MAX_EXTRA_GLYPHS];
+    if (extra._code != code) {
+      free(extra._bitmap);
+      extra._code = code;
+      extra._bitmap = nullptr;
+      extra._glyph = Glyph();
+
+      // the face is shared with the other sizes
+      FT_Set_Pixel_Sizes(_face, 0, _size);
+      FT_Glyph slot;
+      int advance;
+      if (render(code, &slot, &advance)) {
+        FT_Bitmap *ftBitmap = &((FT_BitmapGlyph)slot)->bitmap;
+        extra._bitmap = (uint8_t *)malloc(ftBitmap->width * ftBitmap->rows + 1);
+        if (extra._bitmap != nullptr) {
+          copy(slot, advance, &extra._glyph, extra._bitmap);
+        }
+        FT_Done_Glyph(slot);
+      }
+    }
+    result = &extra._glyph;
+    *bitmap = extra._bitmap;
+  }
+  return result;
+}
+
+//
+// returns the width of the text, remembering recent strings holding UTF-8 characters
+//
+int Font::textWidth(const char *str, int len) {
+  int result = 0;
+  if (is_ascii(str, len)) {
+    if (_fixed) {
+      result = len * _fixed;
+    } else {
+      for (int i = 0; i < len; i++) {
+        result += _glyph[(uint8_t)str[i]]._w;
+      }
     }
-    error = FT_Get_Glyph(face->glyph, &_glyph[i]._slot);
-    if (error) {
-      trace("Failed to get glyph %d", i);
+  } else {
+    Layout *layout = nullptr;
+    uint32_t hash = 2166136261u;
+    if (len <= MAX_LAYOUT_LEN) {
+      for (int i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)str[i]) * 16777619u;
+      }
+      layout = &_layout[hash % MAX_LAYOUTS];
     }
-    if (italic) {
-      FT_Glyph_Transform(_glyph[i]._slot, &matrix, nullptr );
+    if (layout != nullptr && layout->_hash == hash && layout->_len == len &&
+        memcmp(layout->_str, str, len) == 0) {
+      result = layout->_width;
+    } else {
+      const uint8_t *bitmap;
+      for (int i = 0; i < len;) {
+        result += glyph(next_char(str, len, i), &bitmap)->_w;
+      }
+      if (layout != nullptr) {
+        layout->_hash = hash;
+        layout->_len = len;
+        layout->_width = result;
+        memcpy(layout->_str, str, len);
+      }
+    }
+  }
+  return result;
+}
+
+//
+// loads the character as an anti-aliased bitmap
+//
+bool Font::render(uint32_t code, FT_Glyph *slot, int *advance) {
+  bool result = false;
+  FT_UInt index = FT_Get_Char_Index(_face, code);
+  if (FT_Load_Glyph(_face, index, FT_LOAD_TARGET_LIGHT)) {
+    trace("Failed to load %d", code);
+  } else if (FT_Get_Glyph(_face->glyph, slot)) {
+    trace("Failed to get glyph %d", code);
+  } else {
+    if (_italic) {
+      FT_Matrix matrix;
+      matrix.xx = 0x10000L;
+      matrix.xy = 0.12 * 0x10000L;
+      matrix.yx = 0;
+      matrix.yy = 0x10000L;
+      FT_Glyph_Transform(*slot, &matrix, nullptr);
     }
     FT_Vector origin;
     origin.x = 0;
     origin.y = 0;
-    error = FT_Glyph_To_Bitmap(&_glyph[i]._slot, FT_RENDER_MODE_LIGHT, &origin, 1);
-    if (error) {
-      trace("Failed to get bitmap %d", i);
+    if (FT_Glyph_To_Bitmap(slot, FT_RENDER_MODE_LIGHT, &origin, 1)) {
+      trace("Failed to get bitmap %d", code);
+      FT_Done_Glyph(*slot);
+    } else {
+      *advance = (int)(_face->glyph->metrics.horiAdvance / 64);
+      result = true;
     }
-    _glyph[i]._w = (int)(face->glyph->metrics.horiAdvance / 64);
   }
+  return result;
 }
 
-Font::~Font() {
-  for (auto & i : _glyph) {
-    FT_Done_Glyph(i._slot);
+//
+// copies the inked rectangle of the bitmap to dst, returning the next free byte
+//
+uint8_t *Font::copy(FT_Glyph slot, int advance, Glyph *glyph, uint8_t *dst) {
+  auto bitmapGlyph = (FT_BitmapGlyph)slot;
+  FT_Bitmap *bitmap = &bitmapGlyph->bitmap;
+  int x0 = bitmap->width;
+  int x1 = 0;
+  int y0 = bitmap->rows;
+  int y1 = 0;
+  for (int y = 0; y < (int)bitmap->rows; y++) {
+    const uint8_t *line = bitmap->buffer + y * bitmap->pitch;
+    for (int x = 0; x < (int)bitmap->width; x++) {
+      if (line[x]) {
+        x0 = MIN(x0, x);
+        x1 = MAX(x1, x + 1);
+        y0 = MIN(y0, y);
+        y1 = y + 1;
+      }
+    }
   }
+  glyph->_w = advance;
+  if (x0 < x1) {
+    glyph->_left = bitmapGlyph->left + x0;
+    glyph->_top = bitmapGlyph->top - y0;
+    glyph->_width = x1 - x0;
+    glyph->_rows = y1 - y0;
+    for (int y = y0; y < y1; y++) {
+      memcpy(dst, bitmap->buffer + y * bitmap->pitch + x0, glyph->_width);
+      dst += glyph->_width;
+    }
+  } else {
+    glyph->_width = 0;
+    glyph->_rows = 0;
+  }
+  return dst;
 }
 
 //
@@ -272,99 +474,87 @@ void Graphics::drawLine(int startX, int startY, int endX, int endY) {
 }
 
 void Graphics::drawPixel(int posX, int posY) {
-  pixel_t *line = _drawTarget->getLine(posY);
-  line[posX] = _drawColor;
+  if (posX >= _drawTarget->x()
+      && posY >= _drawTarget->y()
+      && posX < _drawTarget->w()
+      && posY < _drawTarget->h()) {
+    pixel_t *line = _drawTarget->getLine(posY);
+    line[posX] = _drawColor;
+  }
 }
 
 void Graphics::drawRGB(const MAPoint2d *dstPoint, const void *src,
                        const MARect *srcRect, int opacity, int stride) {
-  auto *image = (uint8_t *)src;
-  float op = opacity / 100.0f;
-  int top = srcRect->top;
-  int left = srcRect->left;
-  int width = srcRect->width;
-  int height = srcRect->height;
-
-  for (int y = 0; y < height; y += 1) {
-    int dY = dstPoint->y + y;
-    if (dY >= _drawTarget->y() &&
-        dY <  _drawTarget->h()) {
-      int imgPos = (left + ((y + top) * stride)) * 4;
-      pixel_t *line = _drawTarget->getLine(dY);
-      for (int x = 0; x < width; x += 1) {
-        int dX = dstPoint->x + x;
-        if (dX >= _drawTarget->x() &&
-            dX <  _drawTarget->w()) {
-          // get RGBA components
-          uint8_t a, r, g, b;
-          GET_IMAGE_ARGB(image, imgPos + x * 4, a, r, g, b);
-          uint8_t dR, dG, dB;
-          GET_RGB(line[dX], dR, dG, dB);
-          if (opacity > 0 && opacity < 100 && a > 64) {
-            dR = (op * r) + ((1 - op) * dR);
-            dG = (op * g) + ((1 - op) * dG);
-            dB = (op * b) + ((1 - op) * dB);
-          } else {
-            dR = dR + ((r - dR) * a / 255);
-            dG = dG + ((g - dG) * a / 255);
-            dB = dB + ((b - dB) * a / 255);
-          }
-          line[dX] = GET_RGB_PX(dR, dG, dB);
-        }
-      }
+  // clip the destination once, then composite whole spans
+  int x0 = MAX(dstPoint->x, _drawTarget->x());
+  int y0 = MAX(dstPoint->y, _drawTarget->y());
+  int x1 = MIN(dstPoint->x + srcRect->width, _drawTarget->w());
+  int y1 = MIN(dstPoint->y + srcRect->height, _drawTarget->h());
+  if (x0 < x1 && y0 < y1) {
+    uint32_t alpha = 0;
+    if (opacity > 0 && opacity < 100) {
+      alpha = (opacity * 255 + 50) / 100;
+    }
+    auto *image = (const uint8_t *)src;
+    int left = srcRect->left + x0 - dstPoint->x;
+    int top = srcRect->top + y0 - dstPoint->y;
+    for (int y = y0; y < y1; y++) {
+      const uint8_t *imgLine = image + (left + ((y - y0 + top) * stride)) * 4;
+      blend::span_rgba(_drawTarget->getLine(y) + x0, imgLine, x1 - x0, alpha);
     }
   }
 }
 
-void Graphics::drawChar(FT_Bitmap *bitmap, FT_Int x, FT_Int y) {
-  FT_Int xMax = x + bitmap->width;
-  FT_Int yMax = y + bitmap->rows;
-
-  uint8_t sR, sG, sB;
-  GET_RGB(_drawColor, sR, sG, sB);
-
-  int dtX = _drawTarget->x();
-  int dtY = _drawTarget->y();
-  int dtW = _drawTarget->w();
-  int dtH = _drawTarget->h();
-
-  for (FT_Int j = y, q = 0; j < yMax; j++, q++) {
-    if (j >= dtY && j < dtH) {
-      pixel_t *line = _drawTarget->getLine(j);
-      for (FT_Int i = x, p = 0; i < xMax; i++, p++) {
-        if (i >= dtX && i < dtW) {
-          uint8_t a = bitmap->buffer[q * bitmap->width + p];
-          if (a == 255) {
-            line[i] = _drawColor;
-          } else {
-            // blend drawColor to the background
-            uint8_t dR, dG, dB;
-            GET_RGB(line[i], dR, dG, dB);
-            dR = dR + ((sR - dR) * a / 255);
-            dG = dG + ((sG - dG) * a / 255);
-            dB = dB + ((sB - dB) * a / 255);
-            line[i] = GET_RGB_PX(dR, dG, dB);
-          }
-        }
+void Graphics::drawText(int left, int top, const char *str, int len) {
+  if (_drawTarget && _font) {
+    int baseline = top + _font->_h + ((_font->_spacing - _font->_h) / 2);
+    int clipX0 = _drawTarget->x();
+    int clipY0 = _drawTarget->y();
+    int clipX1 = _drawTarget->w();
+    int clipY1 = _drawTarget->h();
+    int penX = left;
+
+    // stop once the pen passes the clip, allowing for glyphs that overhang to the left
+    for (int i = 0; i < len && penX - _font->_spacing < clipX1;) {
+      uint32_t code = (uint8_t)str[i];
+      if (code < 0x80) {
+        i++;
+      } else {
+        code = next_char(str, len, i);
+      }
+      const uint8_t *bitmap;
+      const Glyph *glyph = _font->glyph(code, &bitmap);
+      int x = penX + glyph->_left;
+      int y = baseline - glyph->_top;
+      int x0 = MAX(x, clipX0);
+      int y0 = MAX(y, clipY0);
+      int x1 = MIN(x + glyph->_width, clipX1);
+      int y1 = MIN(y + glyph->_rows, clipY1);
+      for (int j = y0; j < y1; j++) {
+        const uint8_t *mask = bitmap + (j - y) * glyph->_width + (x0 - x);
+        blend::span_mask(_drawTarget->getLine(j) + x0, mask, x1 - x0, _drawColor);
       }
+      penX += glyph->_w;
     }
   }
 }
 
-void Graphics::drawText(int left, int top, const char *str, int len) {
-  if (_drawTarget && _font) {
-    FT_Vector pen;
-    pen.x = left;
-    pen.y = top + _font->_h + ((_font->_spacing - _font->_h) / 2);
-    for (int i = 0; i < len; i++) {
-      uint8_t ch = str[i];
-      auto glyph = (FT_BitmapGlyph)_font->_glyph[ch]._slot;
-      drawChar(&glyph->bitmap,
-               pen.x + glyph->left,
-               pen.y - glyph->top);
-      pen.x += _font->_glyph[ch]._w;
-    }
+bool Graphics::floodFill(int x, int y, int fillColor, int borderColor) {
+  bool result;
+  if (_drawTarget && _drawTarget->_pixels) {
+    // clip to both the canvas and the VIEW port
+    int x1 = MAX(_drawTarget->x(), dev_Vx1);
+    int y1 = MAX(_drawTarget->y(), dev_Vy1);
+    int x2 = MIN(MIN(_drawTarget->w(), _drawTarget->_w) - 1, dev_Vx2);
+    int y2 = MIN(MIN(_drawTarget->h(), _drawTarget->_h) - 1, dev_Vy2);
+    dev_ffill_pixels(_drawTarget->_pixels, _drawTarget->_w, x1, y1, x2, y2, x, y,
+                     GET_FROM_RGB888(fillColor), GET_FROM_RGB888(borderColor),
+                     0x00ffffff, borderColor == -1);
+    result = true;
+  } else {
+    result = false;
   }
+  return result;
 }
 
 void Graphics::getImageData(Canvas *canvas, uint8_t *image, const MARect *srcRect, int stride) {
@@ -415,10 +605,7 @@ MAExtent Graphics::getTextSize(const char *str, int len) {
   int width = 0;
   int height = 0;
   if (_font) {
-    for (int i = 0; i < len; i++) {
-      uint8_t ch = str[i];
-      width += _font->_glyph[ch]._w;
-    }
+    width = _font->textWidth(str, len);
     height = _font->_spacing;
   }
   return (MAExtent)((width << 16) + height);
@@ -631,6 +818,10 @@ void maEllipse(int xc, int yc, int rx, int ry, int fill) {
   }
 }
 
+int maFloodFill(int x, int y, int fillColor, int borderColor) {
+  return graphics->floodFill(x, y, fillColor, borderColor);
+}
+
 void maDrawText(int left, int top, const char *str, int length) {
   if (str && str[0]) {
     graphics->drawText(left, top, str, length);
@@ -20,22 +20,64 @@
 
 #define MAX_GLYPHS 256
 
+// glyphs above MAX_GLYPHS, loaded when first drawn
+#define MAX_EXTRA_GLYPHS 128
+
+// recently measured strings
+#define MAX_LAYOUTS 64
+#define MAX_LAYOUT_LEN 48
+
 using namespace strlib;
 
 namespace ui {
 
+//
+// a glyph bitmap, trimmed to the inked rows and held in the font atlas
+//
 struct Glyph {
-  FT_Glyph _slot;
+  uint32_t _offset;
+  int16_t _left;
+  int16_t _top;
+  uint16_t _width;
+  uint16_t _rows;
   int _w;
 };
 
+struct ExtraGlyph {
+  uint32_t _code;
+  Glyph _glyph;
+  uint8_t *_bitmap;
+};
+
+struct Layout {
+  uint32_t _hash;
+  int _len;
+  int _width;
+  char _str[MAX_LAYOUT_LEN];
+};
+
 struct Font {
   Font(FT_Face face, int size, bool italic);
   virtual ~Font();
+
+  const Glyph *glyph(uint32_t code, const uint8_t **bitmap);
+  int textWidth(const char *str, int len);
+
   int _h;
   int _spacing;
+  int _size;
+  // the advance when every printable ASCII glyph has the same width
+  int _fixed;
+  bool _italic;
   FT_Face _face;
   Glyph _glyph[MAX_GLYPHS]{};
+  uint8_t *_atlas;
+  ExtraGlyph _extra[MAX_EXTRA_GLYPHS]{};
+  Layout _layout[MAX_LAYOUTS]{};
+
+private:
+  bool render(uint32_t code, FT_Glyph *slot, int *advance);
+  uint8_t *copy(FT_Glyph slot, int advance, Glyph *glyph, uint8_t *dst);
 };
 
 struct Graphics {
@@ -54,6 +96,7 @@ struct Graphics {
   void drawRGB(const MAPoint2d *dstPoint, const void *src,
                const MARect *srcRect, int opacity, int bytesPerLine);
   void drawText(int left, int top, const char *str, int len);
+  bool floodFill(int x, int y, int fillColor, int borderColor);
   pixel_t getDrawColor() { return _drawColor; }
   Canvas *getDrawTarget() { return _drawTarget; }
   void getImageData(Canvas *canvas, uint8_t *image, 
@@ -68,7 +111,6 @@ struct Graphics {
   MAHandle setDrawTarget(MAHandle maHandle);
 
 protected:
-  void drawChar(FT_Bitmap *bitmap, FT_Int x, FT_Int y);
   void aaLine(int x0, int y0, int x1, int y1);
   void aaPlot(int x, int y, double c);
   void aaPlotX8(int xc, int yc, int x, int y, double c, bool fill);
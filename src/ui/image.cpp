@@ -14,6 +14,8 @@
 #include "lib/maapi.h"
 #include "lib/lodepng/lodepng.h"
 #include "ui/image.h"
+#include "ui/image_cache.h"
+#include "ui/image_filter.h"
 #include "ui/system.h"
 #include "ui/rgb.h"
 
@@ -28,9 +30,18 @@
 #define IMG_ID "ID"
 #define IMG_BID "BID"
 
+// the pixel layout after decode_png, distinguishing the disk cache entries
+#if defined(_SDL)
+#define IMG_FORMAT 'A'
+#else
+#define IMG_FORMAT 'R'
+#endif
+
+unsigned decode_png(unsigned char **image, unsigned *w, unsigned *h, const unsigned char *buffer, size_t size);
+
 extern System *g_system;
 unsigned nextId = 0;
-strlib::List<ImageBuffer *> buffers;
+ImageCache<ImageBuffer> buffers(decode_png, IMG_FORMAT);
 
 extern "C" int xpm_decode32(uint8_t **image, unsigned *width, unsigned *height, const char *const *xpm);
 
@@ -43,7 +54,14 @@ ImageBuffer::ImageBuffer() :
   _image(nullptr),
   _bid(0),
   _width(0),
-  _height(0) {
+  _height(0),
+  _source(nullptr),
+  _sourceSize(0),
+  _refs(0),
+  _bidNext(nullptr),
+  _nameNext(nullptr),
+  _newer(nullptr),
+  _older(nullptr) {
 }
 
 ImageBuffer::ImageBuffer(ImageBuffer &o) = default;
@@ -51,8 +69,10 @@ ImageBuffer::ImageBuffer(ImageBuffer &o) = default;
 ImageBuffer::~ImageBuffer() {
   free(_filename);
   free(_image);
+  free(_source);
   _filename = nullptr;
   _image = nullptr;
+  _source = nullptr;
 }
 
 ImageDisplay::ImageDisplay() :
@@ -71,7 +91,15 @@ ImageDisplay::ImageDisplay(ImageDisplay &o) :
   copyImage(o);
 }
 
+ImageDisplay::~ImageDisplay() {
+  buffers.release(_bid);
+}
+
 void ImageDisplay::copyImage(ImageDisplay &o) {
+  if (_bid != o._bid) {
+    buffers.retain(o._bid);
+    buffers.release(_bid);
+  }
   _x = o._x;
   _y = o._y;
   _offsetLeft = o._offsetLeft;
@@ -85,8 +113,19 @@ void ImageDisplay::copyImage(ImageDisplay &o) {
   _buffer = o._buffer;
 }
 
+//
+// shares the buffer, which remains available while the image is displayed
+//
+void ImageDisplay::setBuffer(ImageBuffer *buffer) {
+  unsigned bid = buffer != nullptr ? buffer->_bid : 0;
+  buffers.retain(bid);
+  buffers.release(_bid);
+  _bid = bid;
+  _buffer = buffer;
+}
+
 void ImageDisplay::draw(int x, int y, int w, int h, int cw) {
-  if (_buffer != nullptr) {
+  if (_buffer != nullptr && buffers.load(_buffer)) {
     MAPoint2d dstPoint;
     MARect srcRect;
 
@@ -133,14 +172,6 @@ unsigned decode_png(unsigned char **image, unsigned *w, unsigned *h, const unsig
   return error;
 }
 
-unsigned decode_png_file(unsigned char **image, unsigned *w, unsigned *h, const char *filename) {
-  unsigned error = lodepng_decode32_file(image, w, h, filename);
-  if (!error) {
-    to_argb(*image, *w, *h);
-  }
-  return error;
-}
-
 unsigned encode_png_file(const char *filename, const unsigned char *image, unsigned w, unsigned h) {
   unsigned result;
 #if defined(_SDL)
@@ -200,15 +231,7 @@ uint8_t *get_image_data(int x, int y, int w, int h) {
 }
 
 ImageBuffer *get_image(unsigned bid) {
-  ImageBuffer *result = nullptr;
-  List_each(ImageBuffer *, it, buffers) {
-    ImageBuffer *next = (*it);
-    if (next->_bid == (unsigned)bid) {
-      result = next;
-      break;
-    }
-  }
-  return result;
+  return buffers.get(bid);
 }
 
 ImageBuffer *load_image(var_int_t x) {
@@ -278,42 +301,30 @@ ImageBuffer *load_image(var_t *var) {
 }
 
 ImageBuffer *load_image(const unsigned char *buffer, int32_t size) {
-  ImageBuffer *result = nullptr;
-  unsigned w, h;
-  unsigned char *image;
-
-  unsigned error = decode_png(&image, &w, &h, buffer, size);
+  ImageBuffer *result = new ImageBuffer();
+  unsigned error = buffers.copy(result, buffer, size);
+  if (!error) {
+    error = buffers.decode(result);
+  }
   if (!error) {
-    result = new ImageBuffer();
     result->_bid = ++nextId;
-    result->_width = w;
-    result->_height = h;
-    result->_filename = nullptr;
-    result->_image = image;
     buffers.add(result);
   } else {
+    delete result;
+    result = nullptr;
     err_throw(ERR_IMAGE_LOAD, lodepng_error_text(error));
   }
   return result;
 }
 
 ImageBuffer *load_image(dev_file_t *filep) {
-  ImageBuffer *result = nullptr;
-  List_each(ImageBuffer *, it, buffers) {
-    ImageBuffer *next = (*it);
-    if (next->_filename != nullptr && strcmp(next->_filename, filep->name) == 0) {
-      result = next;
-      break;
-    }
-  }
-
+  ImageBuffer *result = buffers.find(filep->name);
   if (result == nullptr) {
-    unsigned w, h;
-    unsigned char *image;
     unsigned error = 0;
     unsigned network_error = 0;
     var_t *var_p;
 
+    result = new ImageBuffer();
     switch (filep->type) {
     case ft_http_client:
       // open "http://localhost/image1.gif" as #1
@@ -322,29 +333,32 @@ ImageBuffer *load_image(dev_file_t *filep) {
       } else {
         var_p = v_new();
         http_read(filep, var_p);
-        error = decode_png(&image, &w, &h, (unsigned char *)var_p->v.p.ptr, var_p->v.p.length);
+        error = buffers.copy(result, (unsigned char *)var_p->v.p.ptr, var_p->v.p.length);
         v_free(var_p);
         v_detach(var_p);
       }
       break;
     case ft_stream:
-      error = decode_png_file(&image, &w, &h, filep->name);
+      error = buffers.read(result, filep->name);
       break;
     default:
       error = 1;
       break;
     }
+    if (!error && !network_error) {
+      error = buffers.decode(result);
+    }
     if (network_error) {
+      delete result;
+      result = nullptr;
       err_throw(ERR_IMAGE_LOAD, ERR_NETWORK);
     } else if (error) {
+      delete result;
+      result = nullptr;
       err_throw(ERR_IMAGE_LOAD, lodepng_error_text(error));
     } else {
-      result = new ImageBuffer();
       result->_bid = ++nextId;
-      result->_width = w;
-      result->_height = h;
       result->_filename = strdup(filep->name);
-      result->_image = image;
       buffers.add(result);
     }
   }
@@ -371,19 +385,13 @@ ImageBuffer *load_xpm_image(char **data) {
 }
 
 void get_image_display(var_s *self, ImageDisplay *image) {
-  image->_bid = map_get_int(self, IMG_BID, -1);
-
-  List_each(ImageBuffer *, it, buffers) {
-    ImageBuffer *next = (*it);
-    if (next->_bid == image->_bid) {
-      image->_buffer = next;
-      break;
-    }
-  }
-
   var_int_t x, y, z, op;
+  // the arguments may create images, which can trim the cache
   int count = par_massget("iiii", &x, &y, &z, &op);
 
+  buffers.trim();
+  image->setBuffer(get_image(map_get_int(self, IMG_BID, -1)));
+
   if (prog_error || image->_buffer == nullptr || count == 1 || count > 4) {
     err_throw(ERR_PARAM);
   } else {
@@ -445,6 +453,7 @@ void cmd_image_draw(var_s *self, var_s *) {
 // png.hide()
 //
 void cmd_image_hide(var_s *self, var_s *) {
+  buffers.trim();
   int id = map_get_int(self, IMG_ID, -1);
   g_system->getOutput()->removeImage(id);
 }
@@ -458,34 +467,46 @@ void cmd_image_hide(var_s *self, var_s *) {
 // file = "abc.png" : png.save(file)
 //
 void cmd_image_save(var_s *self, var_s *) {
-  unsigned id = map_get_int(self, IMG_BID, -1);
-  ImageBuffer *image = get_image(id);
-  dev_file_t *file;
-  var_t *var;
+  dev_file_t *file = nullptr;
+  var_t *var = nullptr;
   var_t str;
   bool saved = false;
+
+  // the arguments may create images, which can trim the cache
+  byte code = code_peek();
+  v_init(&str);
+  switch (code) {
+  case kwTYPE_SEP:
+    file = eval_filep();
+    break;
+  case kwTYPE_STR:
+    par_getstr(&str);
+    break;
+  default:
+    var = par_getvar_ptr();
+    break;
+  }
+
+  buffers.trim();
+  unsigned id = map_get_int(self, IMG_BID, -1);
+  ImageBuffer *image = get_image(id);
   if (!prog_error && image != nullptr) {
     unsigned w = image->_width;
     unsigned h = image->_height;
-    switch (code_peek()) {
+    switch (code) {
     case kwTYPE_SEP:
-      file = eval_filep();
       if (file != nullptr && file->open_flags == DEV_FILE_OUTPUT &&
           !encode_png_file(file->name, image->_image, w, h)) {
         saved = true;
       }
       break;
     case kwTYPE_STR:
-      par_getstr(&str);
-      if (!prog_error &&
-          !encode_png_file(str.v.p.ptr, image->_image, w, h)) {
+      if (!encode_png_file(str.v.p.ptr, image->_image, w, h)) {
         saved = true;
-      }      
-      v_free(&str);
+      }
       break;
     default:
-      var = par_getvar_ptr();
-      if (var->type == V_STR && !prog_error &&
+      if (var->type == V_STR &&
           !encode_png_file(var->v.p.ptr, image->_image, w, h)) {
         saved = true;
       } else if (!prog_error) {
@@ -523,6 +544,7 @@ void cmd_image_save(var_s *self, var_s *) {
       }    
     }
   }
+  v_free(&str);
   if (!saved) {
     err_throw(ERR_IMAGE_SAVE);
   }
@@ -536,6 +558,7 @@ void cmd_image_save(var_s *self, var_s *) {
 // png.clip(10, 10, 10, 10)
 //
 void cmd_image_clip(var_s *self, var_s *) {
+  buffers.trim();
   if (self->type == V_MAP) {
     int bid = map_get_int(self, IMG_BID, -1);
     if (bid != -1) {
@@ -557,6 +580,104 @@ void cmd_image_clip(var_s *self, var_s *) {
   }
 }
 
+//
+// Applies the native filter to the image, updating the size when changed
+//
+void image_filter(var_s *self, filter::Op op) {
+  buffers.trim();
+  ImageBuffer *image = nullptr;
+  if (self->type == V_MAP) {
+    int bid = map_get_int(self, IMG_BID, -1);
+    image = bid == -1 ? nullptr : get_image((unsigned)bid);
+  }
+  if (image == nullptr) {
+    err_throw(ERR_PARAM);
+  } else {
+    buffers.modified(image);
+    filter::Image pixels = {image->_image, (int)image->_width, (int)image->_height};
+    filter::apply(op, pixels);
+    image->_image = pixels._pixels;
+    if (pixels._width != (int)image->_width || pixels._height != (int)image->_height) {
+      image->_width = pixels._width;
+      image->_height = pixels._height;
+      map_set_int(self, IMG_OFFSET_LEFT, 0);
+      map_set_int(self, IMG_OFFSET_TOP, 0);
+      map_set_int(self, IMG_WIDTH, pixels._width);
+      map_set_int(self, IMG_HEIGHT, pixels._height);
+    }
+  }
+}
+
+//
+// png.blur(radius)
+//
+void cmd_image_blur(var_s *self, var_s *) {
+  image_filter(self, filter::BLUR);
+}
+
+//
+// png.colorMatrix(matrix)
+//
+void cmd_image_color_matrix(var_s *self, var_s *) {
+  image_filter(self, filter::COLOR_MATRIX);
+}
+
+//
+// png.convolve(kernel [, divisor [, bias]])
+//
+void cmd_image_convolve(var_s *self, var_s *) {
+  image_filter(self, filter::CONVOLVE);
+}
+
+//
+// png.edges()
+//
+void cmd_image_edges(var_s *self, var_s *) {
+  image_filter(self, filter::EDGES);
+}
+
+//
+// png.filterRows(use f(x)), where x is an array of the pixels in each row
+//
+void cmd_image_filter_rows(var_s *self, var_s *) {
+  image_filter(self, filter::ROWS);
+}
+
+//
+// png.lut(table)
+//
+void cmd_image_lut(var_s *self, var_s *) {
+  image_filter(self, filter::LUT);
+}
+
+//
+// png.resize(w, h [, box])
+//
+void cmd_image_resize(var_s *self, var_s *) {
+  image_filter(self, filter::RESIZE);
+}
+
+//
+// png.rotate(degrees)
+//
+void cmd_image_rotate(var_s *self, var_s *) {
+  image_filter(self, filter::ROTATE);
+}
+
+//
+// png.sharpen([amount])
+//
+void cmd_image_sharpen(var_s *self, var_s *) {
+  image_filter(self, filter::SHARPEN);
+}
+
+//
+// png.threshold(level [, low, high])
+//
+void cmd_image_threshold(var_s *self, var_s *) {
+  image_filter(self, filter::THRESHOLD);
+}
+
 void create_image(var_p_t var, ImageBuffer *image) {
   map_init(var);
   map_add_var(var, IMG_X, 0);
@@ -569,11 +690,23 @@ void create_image(var_p_t var, ImageBuffer *image) {
   map_add_var(var, IMG_WIDTH, image->_width);
   map_add_var(var, IMG_HEIGHT, image->_height);
   map_add_var(var, IMG_BID, image->_bid);
+  var->v.m.cls_id = MAP_CLS_IMAGE;
+  buffers.retain(image->_bid);
   v_create_func(var, "draw", cmd_image_draw);
   v_create_func(var, "hide", cmd_image_hide);
   v_create_func(var, "save", cmd_image_save);
   v_create_func(var, "show", cmd_image_show);
   v_create_func(var, "clip", cmd_image_clip);
+  v_create_func(var, "blur", cmd_image_blur);
+  v_create_func(var, "colorMatrix", cmd_image_color_matrix);
+  v_create_func(var, "convolve", cmd_image_convolve);
+  v_create_func(var, "edges", cmd_image_edges);
+  v_create_func(var, "filterRows", cmd_image_filter_rows);
+  v_create_func(var, "lut", cmd_image_lut);
+  v_create_func(var, "resize", cmd_image_resize);
+  v_create_func(var, "rotate", cmd_image_rotate);
+  v_create_func(var, "sharpen", cmd_image_sharpen);
+  v_create_func(var, "threshold", cmd_image_threshold);
 }
 
 // loads an image for the form image input type
@@ -586,8 +719,7 @@ ImageDisplay *create_display_image(var_p_t var, const char *name) {
     ImageBuffer *buffer = load_image(&file);
     if (buffer != nullptr) {
       result = new ImageDisplay();
-      result->_buffer = buffer;
-      result->_bid = buffer->_bid;
+      result->setBuffer(buffer);
       result->_width = buffer->_width;
       result->_height = buffer->_height;
       result->_zIndex = 0;
@@ -651,6 +783,10 @@ extern "C" void v_create_image(var_p_t var) {
   ImageBuffer *image = nullptr;
   dev_file_t *filep = nullptr;
 
+  // no buffers are held, so the pixels can be evicted
+  buffers.trim();
+  v_init(&arg);
+
   byte code = code_peek();
   switch (code) {
   case kwTYPE_SEP:
@@ -665,7 +801,6 @@ extern "C" void v_create_image(var_p_t var) {
     break;
 
   default:
-    v_init(&arg);
     eval(&arg);
     if (arg.type == V_STR && !prog_error) {
       dev_file_t file;
@@ -699,7 +834,6 @@ extern "C" void v_create_image(var_p_t var) {
     } else {
       image = load_image(&arg);
     }
-    v_free(&arg);
     break;
   };
 
@@ -708,4 +842,15 @@ extern "C" void v_create_image(var_p_t var) {
   } else {
     err_throw(ERR_BAD_FILE_HANDLE);
   }
+
+  // free after create_image() since the argument may hold the only reference
+  v_free(&arg);
+}
+
+extern "C" void v_retain_image(var_p_t var) {
+  buffers.retain(map_get_int(var, IMG_BID, -1));
+}
+
+extern "C" void v_release_image(var_p_t var) {
+  buffers.release(map_get_int(var, IMG_BID, -1));
 }
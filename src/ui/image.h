@@ -22,15 +22,23 @@ struct ImageBuffer {
   unsigned _bid;
   unsigned _width;
   unsigned _height;
+  unsigned char *_source;
+  unsigned _sourceSize;
+  int _refs;
+  ImageBuffer *_bidNext;
+  ImageBuffer *_nameNext;
+  ImageBuffer *_newer;
+  ImageBuffer *_older;
 };
 
 struct ImageDisplay : public Shape {
   ImageDisplay();
   ImageDisplay(ImageDisplay &imageDisplay);
-  virtual ~ImageDisplay() {}
+  virtual ~ImageDisplay();
 
   void copyImage(ImageDisplay &imageDisplay);
   void draw(int x, int y, int bw, int bh, int cw);
+  void setBuffer(ImageBuffer *buffer);
 
   int _offsetLeft;
   int _offsetTop;
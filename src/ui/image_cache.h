@@ -0,0 +1,440 @@
+// This file is part of SmallBASIC
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+
+#ifndef UI_IMAGE_CACHE
+#define UI_IMAGE_CACHE
+
+#include "common/smbas.h"
+
+// initial number of hash buckets
+#define IMAGE_CACHE_INIT 64
+
+// default budget in MB for the pixels that can be decoded again
+#define IMAGE_CACHE_BUDGET 256
+
+// lodepng error codes
+#define IMAGE_ERR_FILE 78
+#define IMAGE_ERR_MEMORY 83
+
+// disk cache file signature
+#define IMAGE_CACHE_MAGIC 0x31494253
+
+typedef unsigned (*ImageDecoder)(unsigned char **image, unsigned *w, unsigned *h,
+                                 const unsigned char *buffer, size_t size);
+
+//
+// Image buffers indexed by the buffer id (BID) stored in the BASIC image
+// variable, and by file name. The buffer counts the variables and displays
+// sharing it, and is deleted when the last one is released.
+//
+// Buffers holding their encoded _source bytes form an LRU list. trim()
+// drops the pixels of the least recently used until the total is within
+// the budget, and get() decodes them again on demand. Since trim() may
+// free pixels it is only called before any buffer pointers are held.
+//
+// When opt_image_cache names a directory, the decoded pixels are also
+// written there keyed by a hash of the encoded bytes, so repeated loads
+// of the same image skip the decoder.
+//
+// T requires the fields: _bid, _filename, _image, _width, _height, _source,
+// _sourceSize, _refs, _bidNext, _nameNext, _newer and _older.
+//
+template<typename T>
+struct ImageCache {
+  ImageCache(ImageDecoder decoder, uint32_t format) :
+    _decoder(decoder),
+    _bids(nullptr),
+    _names(nullptr),
+    _newest(nullptr),
+    _oldest(nullptr),
+    _size(0),
+    _count(0),
+    _used(0),
+    _format(format) {
+  }
+
+  ~ImageCache() {
+    removeAll();
+  }
+
+  //
+  // adds a newly decoded buffer
+  //
+  void add(T *buffer) {
+    if (_count < _size || resize(_size ? _size * 2 : IMAGE_CACHE_INIT)) {
+      insert(buffer);
+      _count++;
+      if (buffer->_source != nullptr) {
+        _used += bytes(buffer);
+        link(buffer);
+      }
+    }
+  }
+
+  //
+  // returns the buffer with the given id, decoding the pixels again when
+  // they were evicted
+  //
+  T *get(unsigned bid) {
+    T *result = lookup(bid);
+    if (result != nullptr && !load(result)) {
+      result = nullptr;
+    }
+    return result;
+  }
+
+  //
+  // returns the buffer previously loaded from the given file
+  //
+  T *find(const char *filename) {
+    T *result = nullptr;
+    if (_size) {
+      for (T *next = _names[hash(filename) & (_size - 1)]; next != nullptr; next = next->_nameNext) {
+        if (strcmp(next->_filename, filename) == 0) {
+          result = next;
+          break;
+        }
+      }
+    }
+    if (result != nullptr && !load(result)) {
+      result = nullptr;
+    }
+    return result;
+  }
+
+  //
+  // ensures the pixels are available, and marks the buffer as recently used
+  //
+  bool load(T *buffer) {
+    bool result = true;
+    if (buffer->_image == nullptr) {
+      if (buffer->_source == nullptr || decode(buffer) != 0) {
+        result = false;
+      } else {
+        _used += bytes(buffer);
+        link(buffer);
+      }
+    } else if (buffer->_source != nullptr && buffer != _newest) {
+      unlink(buffer);
+      link(buffer);
+    }
+    return result;
+  }
+
+  //
+  // called before the pixels are changed in place, after which the
+  // buffer can no longer be decoded again
+  //
+  void modified(T *buffer) {
+    if (buffer->_source != nullptr) {
+      if (buffer->_image != nullptr) {
+        _used -= bytes(buffer);
+        unlink(buffer);
+      }
+      free(buffer->_source);
+      buffer->_source = nullptr;
+      buffer->_sourceSize = 0;
+    }
+  }
+
+  //
+  // records another variable or display sharing the buffer
+  //
+  void retain(unsigned bid) {
+    T *buffer = lookup(bid);
+    if (buffer != nullptr) {
+      buffer->_refs++;
+    }
+  }
+
+  //
+  // deletes the buffer once it is no longer shared
+  //
+  void release(unsigned bid) {
+    T *buffer = lookup(bid);
+    if (buffer != nullptr && --buffer->_refs <= 0) {
+      remove(buffer);
+      delete buffer;
+    }
+  }
+
+  //
+  // evicts the least recently used pixels until within the budget
+  //
+  void trim() {
+    size_t budget = (size_t)(opt_image_budget > 0 ? opt_image_budget : IMAGE_CACHE_BUDGET) << 20;
+    while (_used > budget && _oldest != nullptr) {
+      T *buffer = _oldest;
+      _used -= bytes(buffer);
+      unlink(buffer);
+      free(buffer->_image);
+      buffer->_image = nullptr;
+    }
+  }
+
+  void removeAll() {
+    for (unsigned i = 0; i < _size; i++) {
+      T *next = _bids[i];
+      while (next != nullptr) {
+        T *buffer = next;
+        next = next->_bidNext;
+        delete buffer;
+      }
+    }
+    free(_bids);
+    free(_names);
+    _bids = nullptr;
+    _names = nullptr;
+    _newest = nullptr;
+    _oldest = nullptr;
+    _size = 0;
+    _count = 0;
+    _used = 0;
+  }
+
+  //
+  // reads the encoded image file into the buffer source
+  //
+  unsigned read(T *buffer, const char *filename) {
+    unsigned result = IMAGE_ERR_FILE;
+    FILE *fp = fopen(filename, "rb");
+    if (fp != nullptr) {
+      long size = (fseek(fp, 0, SEEK_END) == 0) ? ftell(fp) : -1;
+      if (size > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        buffer->_source = (unsigned char *)malloc(size);
+        if (buffer->_source == nullptr) {
+          result = IMAGE_ERR_MEMORY;
+        } else if (fread(buffer->_source, 1, size, fp) == (size_t)size) {
+          buffer->_sourceSize = size;
+          result = 0;
+        }
+      }
+      fclose(fp);
+    }
+    return result;
+  }
+
+  //
+  // copies the encoded image into the buffer source
+  //
+  unsigned copy(T *buffer, const unsigned char *source, size_t size) {
+    unsigned result = IMAGE_ERR_MEMORY;
+    buffer->_source = (unsigned char *)malloc(size);
+    if (buffer->_source != nullptr) {
+      memcpy(buffer->_source, source, size);
+      buffer->_sourceSize = size;
+      result = 0;
+    }
+    return result;
+  }
+
+  //
+  // decodes the buffer source, using the disk cache when enabled
+  //
+  unsigned decode(T *buffer) {
+    unsigned char *image = nullptr;
+    unsigned w, h;
+    unsigned result;
+    char path[OS_PATHNAME_SIZE + 1];
+    bool cached = opt_image_cache[0] && cachePath(buffer, path, sizeof(path));
+    if (cached && cacheRead(path, &image, &w, &h)) {
+      result = 0;
+    } else {
+      result = _decoder(&image, &w, &h, buffer->_source, buffer->_sourceSize);
+      if (!result && cached) {
+        cacheWrite(path, image, w, h);
+      }
+    }
+    if (!result && buffer->_width && ((unsigned)buffer->_width != w || (unsigned)buffer->_height != h)) {
+      // the cached pixels do not match the earlier decode
+      free(image);
+      result = IMAGE_ERR_FILE;
+    } else if (!result) {
+      buffer->_image = image;
+      buffer->_width = w;
+      buffer->_height = h;
+    }
+    return result;
+  }
+
+private:
+  static size_t bytes(T *buffer) {
+    return (size_t)buffer->_width * buffer->_height * 4;
+  }
+
+  // FNV-1a
+  static uint32_t hash(const char *s) {
+    uint32_t result = 2166136261u;
+    while (*s) {
+      result = (result ^ (uint8_t)*s++) * 16777619u;
+    }
+    return result;
+  }
+
+  T *lookup(unsigned bid) {
+    T *result = nullptr;
+    if (_size) {
+      for (T *next = _bids[bid & (_size - 1)]; next != nullptr; next = next->_bidNext) {
+        if (next->_bid == bid) {
+          result = next;
+          break;
+        }
+      }
+    }
+    return result;
+  }
+
+  void insert(T *buffer) {
+    T **bucket = &_bids[buffer->_bid & (_size - 1)];
+    buffer->_bidNext = *bucket;
+    *bucket = buffer;
+    if (buffer->_filename != nullptr) {
+      bucket = &_names[hash(buffer->_filename) & (_size - 1)];
+      buffer->_nameNext = *bucket;
+      *bucket = buffer;
+    }
+  }
+
+  void remove(T *buffer) {
+    T **next = &_bids[buffer->_bid & (_size - 1)];
+    while (*next != buffer) {
+      next = &(*next)->_bidNext;
+    }
+    *next = buffer->_bidNext;
+    if (buffer->_filename != nullptr) {
+      next = &_names[hash(buffer->_filename) & (_size - 1)];
+      while (*next != buffer) {
+        next = &(*next)->_nameNext;
+      }
+      *next = buffer->_nameNext;
+    }
+    if (buffer->_source != nullptr && buffer->_image != nullptr) {
+      _used -= bytes(buffer);
+      unlink(buffer);
+    }
+    _count--;
+  }
+
+  bool resize(unsigned size) {
+    T **bids = (T **)calloc(size, sizeof(T *));
+    T **names = (T **)calloc(size, sizeof(T *));
+    bool result = (bids != nullptr && names != nullptr);
+    if (result) {
+      T **oldBids = _bids;
+      unsigned oldSize = _size;
+      free(_names);
+      _bids = bids;
+      _names = names;
+      _size = size;
+      for (unsigned i = 0; i < oldSize; i++) {
+        T *next = oldBids[i];
+        while (next != nullptr) {
+          T *buffer = next;
+          next = next->_bidNext;
+          insert(buffer);
+        }
+      }
+      free(oldBids);
+    } else {
+      free(bids);
+      free(names);
+    }
+    return result;
+  }
+
+  // adds the buffer as the most recently used
+  void link(T *buffer) {
+    buffer->_older = _newest;
+    buffer->_newer = nullptr;
+    if (_newest != nullptr) {
+      _newest->_newer = buffer;
+    } else {
+      _oldest = buffer;
+    }
+    _newest = buffer;
+  }
+
+  void unlink(T *buffer) {
+    if (buffer->_newer != nullptr) {
+      buffer->_newer->_older = buffer->_older;
+    } else {
+      _newest = buffer->_older;
+    }
+    if (buffer->_older != nullptr) {
+      buffer->_older->_newer = buffer->_newer;
+    } else {
+      _oldest = buffer->_newer;
+    }
+    buffer->_newer = nullptr;
+    buffer->_older = nullptr;
+  }
+
+  //
+  // builds the disk cache file name from a hash of the encoded bytes
+  //
+  bool cachePath(T *buffer, char *path, size_t size) {
+    uint64_t h = 14695981039346656037ull ^ _format;
+    for (size_t i = 0; i < buffer->_sourceSize; i++) {
+      h = (h ^ buffer->_source[i]) * 1099511628211ull;
+    }
+    int len = snprintf(path, size, "%s/%08x%08x.sbi", opt_image_cache,
+                       (uint32_t)(h >> 32), (uint32_t)h);
+    return len > 0 && (size_t)len < size;
+  }
+
+  bool cacheRead(const char *path, unsigned char **image, unsigned *w, unsigned *h) {
+    bool result = false;
+    FILE *fp = fopen(path, "rb");
+    if (fp != nullptr) {
+      uint32_t header[4];
+      if (fread(header, sizeof(header), 1, fp) == 1 &&
+          header[0] == IMAGE_CACHE_MAGIC && header[1] == _format) {
+        size_t size = (size_t)header[2] * header[3] * 4;
+        *image = (unsigned char *)malloc(size);
+        if (*image != nullptr && fread(*image, 1, size, fp) == size) {
+          *w = header[2];
+          *h = header[3];
+          result = true;
+        } else {
+          free(*image);
+          *image = nullptr;
+        }
+      }
+      fclose(fp);
+    }
+    return result;
+  }
+
+  // writes to a temporary file so other readers never see a partial image
+  void cacheWrite(const char *path, const unsigned char *image, unsigned w, unsigned h) {
+    char tmp[OS_PATHNAME_SIZE + 16];
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    FILE *fp = fopen(tmp, "wb");
+    if (fp != nullptr) {
+      uint32_t header[4] = {IMAGE_CACHE_MAGIC, _format, w, h};
+      size_t size = (size_t)w * h * 4;
+      bool written = (fwrite(header, sizeof(header), 1, fp) == 1 &&
+                      fwrite(image, 1, size, fp) == size);
+      if (fclose(fp) != 0 || !written || rename(tmp, path) != 0) {
+        ::remove(tmp);
+      }
+    }
+  }
+
+  ImageDecoder _decoder;
+  T **_bids;
+  T **_names;
+  T *_newest;
+  T *_oldest;
+  unsigned _size;
+  unsigned _count;
+  size_t _used;
+  uint32_t _format;
+};
+
+#endif
@@ -0,0 +1,900 @@
+// This file is part of SmallBASIC
+//
+// Copyright(C) 2026 Chris Warren-Smith.
+//
+// This program is distributed under the terms of the GPL v2.0 or later
+// Download the GNU Public License (GPL) from www.gnu.org
+//
+
+#ifndef UI_IMAGE_FILTER
+#define UI_IMAGE_FILTER
+
+#include <math.h>
+#include "common/pproc.h"
+#include "ui/rgb.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FILTER_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FILTER_NEON
+#endif
+
+#if defined(_UnixOS) && !defined(_Win32) && !defined(__EMSCRIPTEN__)
+#define USE_FILTER_THREADS 1
+#include <pthread.h>
+#endif
+
+// the most threads and the least pixels per thread
+#define FILTER_MAX_THREADS 8
+#define FILTER_MIN_PIXELS 65536
+
+// the largest convolution kernel and blur radius
+#define FILTER_MAX_KERNEL 15
+#define FILTER_MAX_RADIUS 64
+
+//
+// Native image methods. The pixels are four bytes with alpha in byte 3,
+// while the order of the colour bytes follows SET_IMAGE_ARGB. Convolution
+// weights are fixed point, and each tap is added across a whole row with
+// the accumulate() kernel. Large images are split into bands of rows that
+// are processed by separate threads.
+//
+namespace filter {
+
+enum Op {
+  BLUR,
+  SHARPEN,
+  EDGES,
+  CONVOLVE,
+  COLOR_MATRIX,
+  THRESHOLD,
+  RESIZE,
+  ROTATE,
+  LUT,
+  ROWS
+};
+
+struct Image {
+  uint8_t *_pixels;
+  int _width;
+  int _height;
+};
+
+// a kernel with taps rows by cols, scaled by 1 << shift
+struct Kernel {
+  int32_t _taps[FILTER_MAX_KERNEL * FILTER_MAX_KERNEL];
+  int _rows;
+  int _cols;
+  int _shift;
+  int _bias;
+  bool _alpha;
+};
+
+typedef void (*RowFn)(void *job, int y1, int y2);
+
+struct Band {
+  RowFn _fn;
+  void *_job;
+  int _y1;
+  int _y2;
+};
+
+inline int imin(long a, long b) {
+  return (int)(a < b ? a : b);
+}
+
+inline int imax(long a, long b) {
+  return (int)(a > b ? a : b);
+}
+
+inline uint8_t clamp(int32_t n) {
+  return n < 0 ? 0 : n > 255 ? 255 : n;
+}
+
+//
+// returns the channel held in each byte of a pixel: 0=r, 1=g, 2=b, 3=a
+//
+inline void channels(uint8_t *index) {
+  SET_IMAGE_ARGB(index, 0, 3, 0, 1, 2);
+}
+
+//
+// adds weight * src[i] to acc[i] for n bytes
+//
+inline void accumulate(int32_t *acc, const uint8_t *src, int n, int32_t weight) {
+  int i = 0;
+#if defined(FILTER_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i w = _mm_set1_epi32(weight & 0xffff);
+  for (; i + 16 <= n; i += 16) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i lo = _mm_unpacklo_epi8(s, zero);
+    __m128i hi = _mm_unpackhi_epi8(s, zero);
+    // (s, 0) pairs multiplied by (w, 0) pairs give s * w in each lane
+    __m128i p0 = _mm_madd_epi16(_mm_unpacklo_epi16(lo, zero), w);
+    __m128i p1 = _mm_madd_epi16(_mm_unpackhi_epi16(lo, zero), w);
+    __m128i p2 = _mm_madd_epi16(_mm_unpacklo_epi16(hi, zero), w);
+    __m128i p3 = _mm_madd_epi16(_mm_unpackhi_epi16(hi, zero), w);
+    __m128i *a = (__m128i *)(acc + i);
+    _mm_storeu_si128(a + 0, _mm_add_epi32(_mm_loadu_si128(a + 0), p0));
+    _mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), p1));
+    _mm_storeu_si128(a + 2, _mm_add_epi32(_mm_loadu_si128(a + 2), p2));
+    _mm_storeu_si128(a + 3, _mm_add_epi32(_mm_loadu_si128(a + 3), p3));
+  }
+#elif defined(FILTER_NEON)
+  const int16x4_t w = vdup_n_s16((int16_t)weight);
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t s = vld1q_u8(src + i);
+    int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(s)));
+    int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(s)));
+    vst1q_s32(acc + i + 0, vmlal_s16(vld1q_s32(acc + i + 0), vget_low_s16(lo), w));
+    vst1q_s32(acc + i + 4, vmlal_s16(vld1q_s32(acc + i + 4), vget_high_s16(lo), w));
+    vst1q_s32(acc + i + 8, vmlal_s16(vld1q_s32(acc + i + 8), vget_low_s16(hi), w));
+    vst1q_s32(acc + i + 12, vmlal_s16(vld1q_s32(acc + i + 12), vget_high_s16(hi), w));
+  }
+#endif
+  for (; i < n; i++) {
+    acc[i] += weight * src[i];
+  }
+}
+
+//
+// stores the accumulated row, keeping the alpha from src unless filtered
+//
+inline void store(uint8_t *dst, const int32_t *acc, const uint8_t *src, int n, const Kernel &k) {
+  int32_t round = (1 << k._shift) >> 1;
+  for (int i = 0; i < n; i++) {
+    dst[i] = clamp(((acc[i] + round) >> k._shift) + k._bias);
+  }
+  if (!k._alpha) {
+    for (int i = 3; i < n; i += 4) {
+      dst[i] = src[i];
+    }
+  }
+}
+
+inline void *band_run(void *arg) {
+  Band *band = (Band *)arg;
+  band->_fn(band->_job, band->_y1, band->_y2);
+  return nullptr;
+}
+
+//
+// calls fn for the rows 0 to h, split into bands across the available cpus
+//
+inline void rows(RowFn fn, void *job, int w, int h) {
+#if defined(USE_FILTER_THREADS)
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  long size = (long)w * h / FILTER_MIN_PIXELS;
+  int threads = imax(1, imin(imin(FILTER_MAX_THREADS, imin(cpus, size)), h));
+  pthread_t ids[FILTER_MAX_THREADS];
+  Band bands[FILTER_MAX_THREADS];
+  bool started[FILTER_MAX_THREADS];
+  for (int i = 0; i < threads; i++) {
+    bands[i]._fn = fn;
+    bands[i]._job = job;
+    bands[i]._y1 = (int)((int64_t)h * i / threads);
+    bands[i]._y2 = (int)((int64_t)h * (i + 1) / threads);
+    started[i] = i > 0 && pthread_create(&ids[i], nullptr, band_run, &bands[i]) == 0;
+  }
+  // the first band, and any band without a thread, runs on this thread
+  for (int i = 0; i < threads; i++) {
+    if (!started[i]) {
+      band_run(&bands[i]);
+    }
+  }
+  for (int i = 1; i < threads; i++) {
+    if (started[i]) {
+      pthread_join(ids[i], nullptr);
+    }
+  }
+#else
+  fn(job, 0, h);
+#endif
+}
+
+//
+// converts the weights to fixed point, with the largest shift that keeps
+// each weight within 16 bits
+//
+inline void set_weights(Kernel &k, const double *weights, double divisor) {
+  double largest = 0;
+  int n = k._rows * k._cols;
+  for (int i = 0; i < n; i++) {
+    largest = fmax(largest, fabs(weights[i] / divisor));
+  }
+  k._shift = 14;
+  while (k._shift > 0 && largest * (1 << k._shift) > 32767) {
+    k._shift--;
+  }
+  for (int i = 0; i < n; i++) {
+    k._taps[i] = (int32_t)lround(weights[i] / divisor * (1 << k._shift));
+  }
+}
+
+struct ConvolveJob {
+  const Kernel *_kernel;
+  const uint8_t *_src;
+  uint8_t *_dst;
+  int _width;
+  int _height;
+};
+
+//
+// applies the kernel to the rows y1 to y2, with the edge pixels repeated
+//
+inline void convolve_rows(void *arg, int y1, int y2) {
+  ConvolveJob *job = (ConvolveJob *)arg;
+  const Kernel &k = *job->_kernel;
+  int w = job->_width;
+  int h = job->_height;
+  int n = w * 4;
+  int rx = k._cols / 2;
+  int ry = k._rows / 2;
+  int32_t *acc = (int32_t *)malloc(n * sizeof(int32_t));
+  uint8_t *line = (uint8_t *)malloc((w + rx * 2) * 4);
+  if (acc != nullptr && line != nullptr) {
+    for (int y = y1; y < y2; y++) {
+      memset(acc, 0, n * sizeof(int32_t));
+      for (int ky = 0; ky < k._rows; ky++) {
+        int sy = imin(imax(y + ky - ry, 0), h - 1);
+        const uint8_t *src = job->_src + (size_t)sy * n;
+        if (rx) {
+          // pad the row with copies of the edge pixels
+          for (int x = 0; x < rx; x++) {
+            memcpy(line + x * 4, src, 4);
+            memcpy(line + (rx + w + x) * 4, src + n - 4, 4);
+          }
+          memcpy(line + rx * 4, src, n);
+          src = line;
+        }
+        for (int kx = 0; kx < k._cols; kx++) {
+          int32_t weight = k._taps[ky * k._cols + kx];
+          if (weight) {
+            accumulate(acc, src + kx * 4, n, weight);
+          }
+        }
+      }
+      store(job->_dst + (size_t)y * n, acc, job->_src + (size_t)y * n, n, k);
+    }
+  }
+  free(acc);
+  free(line);
+}
+
+//
+// applies the kernel to the image
+//
+inline bool convolve(Image &image, const Kernel &k) {
+  size_t size = (size_t)image._width * image._height * 4;
+  uint8_t *dst = (uint8_t *)malloc(size);
+  bool result = dst != nullptr;
+  if (result) {
+    ConvolveJob job = {&k, image._pixels, dst, image._width, image._height};
+    rows(convolve_rows, &job, image._width, image._height);
+    memcpy(image._pixels, dst, size);
+    free(dst);
+  }
+  return result;
+}
+
+//
+// gaussian blur, as a horizontal then a vertical pass of the same kernel
+//
+inline bool blur(Image &image, int radius) {
+  double weights[FILTER_MAX_RADIUS * 2 + 1];
+  double sigma = fmax(radius / 2.0, 0.5);
+  double sum = 0;
+  int taps = radius * 2 + 1;
+  for (int i = 0; i < taps; i++) {
+    double d = i - radius;
+    weights[i] = exp(-(d * d) / (2 * sigma * sigma));
+    sum += weights[i];
+  }
+  bool result = true;
+  for (int pass = 0; pass < 2 && result; pass++) {
+    Kernel *k = (Kernel *)malloc(sizeof(Kernel));
+    result = k != nullptr;
+    if (result) {
+      k->_rows = pass ? taps : 1;
+      k->_cols = pass ? 1 : taps;
+      k->_bias = 0;
+      k->_alpha = true;
+      set_weights(*k, weights, sum);
+      result = convolve(image, *k);
+      free(k);
+    }
+  }
+  return result;
+}
+
+struct PixelJob {
+  Image *_image;
+  uint8_t _channel[4];
+  const float *_matrix;
+  int _cols;
+  int _level;
+  uint8_t _low[4];
+  uint8_t _high[4];
+  const uint8_t (*_lut)[256];
+  const uint8_t *_luma;
+  uint8_t *_dst;
+};
+
+//
+// returns the luma of the pixel using the Rec. 601 weights
+//
+inline int luma(const uint8_t *px, const uint8_t *channel) {
+  static const int weights[4] = {77, 150, 29, 0};
+  return (px[0] * weights[channel[0]] + px[1] * weights[channel[1]] +
+          px[2] * weights[channel[2]] + px[3] * weights[channel[3]]) >> 8;
+}
+
+inline void luma_rows(void *arg, int y1, int y2) {
+  PixelJob *job = (PixelJob *)arg;
+  int w = job->_image->_width;
+  for (int y = y1; y < y2; y++) {
+    const uint8_t *px = job->_image->_pixels + (size_t)y * w * 4;
+    uint8_t *dst = job->_dst + (size_t)y * w;
+    for (int x = 0; x < w; x++, px += 4) {
+      dst[x] = luma(px, job->_channel);
+    }
+  }
+}
+
+//
+// sobel gradient magnitude of the luma, keeping the alpha
+//
+inline void edge_rows(void *arg, int y1, int y2) {
+  PixelJob *job = (PixelJob *)arg;
+  int w = job->_image->_width;
+  int h = job->_image->_height;
+  for (int y = y1; y < y2; y++) {
+    const uint8_t *up = job->_luma + (size_t)imax(y - 1, 0) * w;
+    const uint8_t *mid = job->_luma + (size_t)y * w;
+    const uint8_t *down = job->_luma + (size_t)imin(y + 1, h - 1) * w;
+    uint8_t *px = job->_image->_pixels + (size_t)y * w * 4;
+    for (int x = 0; x < w; x++, px += 4) {
+      int l = imax(x - 1, 0);
+      int r = imin(x + 1, w - 1);
+      int gx = (up[r] + 2 * mid[r] + down[r]) - (up[l] + 2 * mid[l] + down[l]);
+      int gy = (down[l] + 2 * down[x] + down[r]) - (up[l] + 2 * up[x] + up[r]);
+      uint8_t g = clamp((int32_t)sqrtf((float)(gx * gx + gy * gy)));
+      for (int c = 0; c < 4; c++) {
+        if (job->_channel[c] != 3) {
+          px[c] = g;
+        }
+      }
+    }
+  }
+}
+
+inline bool edges(Image &image) {
+  PixelJob job;
+  job._image = &image;
+  job._dst = (uint8_t *)malloc((size_t)image._width * image._height);
+  channels(job._channel);
+  bool result = job._dst != nullptr;
+  if (result) {
+    rows(luma_rows, &job, image._width, image._height);
+    job._luma = job._dst;
+    rows(edge_rows, &job, image._width, image._height);
+    free(job._dst);
+  }
+  return result;
+}
+
+//
+// each colour is the sum of the row of weights applied to r, g, b (a) and 1
+//
+inline void matrix_rows(void *arg, int y1, int y2) {
+  PixelJob *job = (PixelJob *)arg;
+  int w = job->_image->_width;
+  int outputs = job->_cols == 5 ? 4 : 3;
+  for (int y = y1; y < y2; y++) {
+    uint8_t *px = job->_image->_pixels + (size_t)y * w * 4;
+    for (int x = 0; x < w; x++, px += 4) {
+      float in[5];
+      for (int c = 0; c < 4; c++) {
+        in[job->_channel[c]] = px[c];
+      }
+      if (job->_cols == 4) {
+        in[3] = 1;
+      } else {
+        in[4] = 1;
+      }
+      for (int c = 0; c < 4; c++) {
+        int channel = job->_channel[c];
+        if (channel < outputs) {
+          const float *m = job->_matrix + channel * job->_cols;
+          float sum = 0;
+          for (int i = 0; i < job->_cols; i++) {
+            sum += m[i] * in[i];
+          }
+          px[c] = clamp((int32_t)lrintf(sum));
+        }
+      }
+    }
+  }
+}
+
+inline void threshold_rows(void *arg, int y1, int y2) {
+  PixelJob *job = (PixelJob *)arg;
+  int w = job->_image->_width;
+  for (int y = y1; y < y2; y++) {
+    uint8_t *px = job->_image->_pixels + (size_t)y * w * 4;
+    for (int x = 0; x < w; x++, px += 4) {
+      const uint8_t *color = luma(px, job->_channel) >= job->_level ? job->_high : job->_low;
+      for (int c = 0; c < 4; c++) {
+        if (job->_channel[c] != 3) {
+          px[c] = color[c];
+        }
+      }
+    }
+  }
+}
+
+inline void lut_rows(void *arg, int y1, int y2) {
+  PixelJob *job = (PixelJob *)arg;
+  int w = job->_image->_width;
+  for (int y = y1; y < y2; y++) {
+    uint8_t *px = job->_image->_pixels + (size_t)y * w * 4;
+    for (int x = 0; x < w; x++, px += 4) {
+      px[0] = job->_lut[job->_channel[0]][px[0]];
+      px[1] = job->_lut[job->_channel[1]][px[1]];
+      px[2] = job->_lut[job->_channel[2]][px[2]];
+      px[3] = job->_lut[job->_channel[3]][px[3]];
+    }
+  }
+}
+
+struct ResizeJob {
+  const uint8_t *_src;
+  uint8_t *_dst;
+  int _width;
+  int _height;
+  int _newWidth;
+  int _newHeight;
+  // bilinear source columns with 8-bit fractions
+  int *_x0;
+  int *_fx;
+  double _cos;
+  double _sin;
+};
+
+//
+// samples the source at the 16.16 fixed point position
+//
+inline void bilinear(const uint8_t *src, int w, int h, int32_t sx, int32_t sy, uint8_t *dst) {
+  int x0 = imax(sx >> 16, 0);
+  int y0 = imax(sy >> 16, 0);
+  int x1 = imin(x0 + 1, w - 1);
+  int y1 = imin(y0 + 1, h - 1);
+  int fx = sx < 0 ? 0 : (sx >> 8) & 0xff;
+  int fy = sy < 0 ? 0 : (sy >> 8) & 0xff;
+  x0 = imin(x0, w - 1);
+  y0 = imin(y0, h - 1);
+  const uint8_t *p00 = src + ((size_t)y0 * w + x0) * 4;
+  const uint8_t *p01 = src + ((size_t)y0 * w + x1) * 4;
+  const uint8_t *p10 = src + ((size_t)y1 * w + x0) * 4;
+  const uint8_t *p11 = src + ((size_t)y1 * w + x1) * 4;
+  for (int c = 0; c < 4; c++) {
+    int top = p00[c] * (256 - fx) + p01[c] * fx;
+    int bottom = p10[c] * (256 - fx) + p11[c] * fx;
+    dst[c] = (top * (256 - fy) + bottom * fy + 32768) >> 16;
+  }
+}
+
+inline void bilinear_rows(void *arg, int y1, int y2) {
+  ResizeJob *job = (ResizeJob *)arg;
+  int w = job->_width;
+  int h = job->_height;
+  for (int y = y1; y < y2; y++) {
+    double fy = (y + 0.5) * h / job->_newHeight - 0.5;
+    int32_t sy = (int32_t)lround(fy * 65536);
+    uint8_t *dst = job->_dst + (size_t)y * job->_newWidth * 4;
+    for (int x = 0; x < job->_newWidth; x++, dst += 4) {
+      bilinear(job->_src, w, h, (job->_x0[x] << 16) | (job->_fx[x] << 8), sy, dst);
+    }
+  }
+}
+
+//
+// averages the source pixels covered by each destination pixel
+//
+inline void box_rows(void *arg, int y1, int y2) {
+  ResizeJob *job = (ResizeJob *)arg;
+  int w = job->_width;
+  int h = job->_height;
+  for (int y = y1; y < y2; y++) {
+    int sy1 = (int)((int64_t)y * h / job->_newHeight);
+    int sy2 = imax(sy1 + 1, (int)((int64_t)(y + 1) * h / job->_newHeight));
+    uint8_t *dst = job->_dst + (size_t)y * job->_newWidth * 4;
+    for (int x = 0; x < job->_newWidth; x++, dst += 4) {
+      int sx1 = (int)((int64_t)x * w / job->_newWidth);
+      int sx2 = imax(sx1 + 1, (int)((int64_t)(x + 1) * w / job->_newWidth));
+      uint32_t sum[4] = {0, 0, 0, 0};
+      for (int sy = sy1; sy < sy2; sy++) {
+        const uint8_t *src = job->_src + ((size_t)sy * w + sx1) * 4;
+        for (int sx = sx1; sx < sx2; sx++, src += 4) {
+          sum[0] += src[0];
+          sum[1] += src[1];
+          sum[2] += src[2];
+          sum[3] += src[3];
+        }
+      }
+      uint32_t count = (sy2 - sy1) * (sx2 - sx1);
+      for (int c = 0; c < 4; c++) {
+        dst[c] = (sum[c] + count / 2) / count;
+      }
+    }
+  }
+}
+
+inline bool resize(Image &image, int width, int height, bool box) {
+  ResizeJob job;
+  job._src = image._pixels;
+  job._width = image._width;
+  job._height = image._height;
+  job._newWidth = width;
+  job._newHeight = height;
+  job._dst = (uint8_t *)malloc((size_t)width * height * 4);
+  job._x0 = (int *)malloc(width * sizeof(int));
+  job._fx = (int *)malloc(width * sizeof(int));
+  bool result = job._dst != nullptr && job._x0 != nullptr && job._fx != nullptr;
+  if (result) {
+    for (int x = 0; x < width; x++) {
+      double fx = fmax((x + 0.5) * image._width / width - 0.5, 0.0);
+      job._x0[x] = (int)fx;
+      job._fx[x] = (int)((fx - (int)fx) * 256);
+    }
+    rows(box ? box_rows : bilinear_rows, &job, width, height);
+    free(image._pixels);
+    image._pixels = job._dst;
+    image._width = width;
+    image._height = height;
+  } else {
+    free(job._dst);
+  }
+  free(job._x0);
+  free(job._fx);
+  return result;
+}
+
+//
+// maps each destination pixel back into the source, leaving the
+// pixels outside the source transparent
+//
+inline void rotate_rows(void *arg, int y1, int y2) {
+  ResizeJob *job = (ResizeJob *)arg;
+  int w = job->_width;
+  int h = job->_height;
+  double cx = job->_newWidth / 2.0;
+  double cy = job->_newHeight / 2.0;
+  for (int y = y1; y < y2; y++) {
+    uint8_t *dst = job->_dst + (size_t)y * job->_newWidth * 4;
+    double dy = y + 0.5 - cy;
+    for (int x = 0; x < job->_newWidth; x++, dst += 4) {
+      double dx = x + 0.5 - cx;
+      double fx = dx * job->_cos + dy * job->_sin + w / 2.0 - 0.5;
+      double fy = dy * job->_cos - dx * job->_sin + h / 2.0 - 0.5;
+      if (fx <= -1 || fy <= -1 || fx >= w || fy >= h) {
+        memset(dst, 0, 4);
+      } else {
+        bilinear(job->_src, w, h, (int32_t)lround(fx * 65536), (int32_t)lround(fy * 65536), dst);
+      }
+    }
+  }
+}
+
+//
+// rotates clockwise by the given degrees, exactly for right angles
+//
+inline bool rotate(Image &image, double degrees) {
+  int w = image._width;
+  int h = image._height;
+  degrees = fmod(degrees, 360);
+  if (degrees < 0) {
+    degrees += 360;
+  }
+  int turns = (fmod(degrees, 90) == 0) ? (int)(degrees / 90) : -1;
+  if (turns == 0) {
+    return true;
+  }
+
+  ResizeJob job;
+  double radians = degrees * M_PI / 180;
+  job._src = image._pixels;
+  job._width = w;
+  job._height = h;
+  job._cos = cos(radians);
+  job._sin = sin(radians);
+  if (turns == 1 || turns == 3) {
+    job._newWidth = h;
+    job._newHeight = w;
+  } else if (turns == 2) {
+    job._newWidth = w;
+    job._newHeight = h;
+  } else {
+    job._newWidth = (int)ceil(fabs(w * job._cos) + fabs(h * job._sin) - 1e-6);
+    job._newHeight = (int)ceil(fabs(w * job._sin) + fabs(h * job._cos) - 1e-6);
+  }
+  job._dst = (uint8_t *)malloc((size_t)job._newWidth * job._newHeight * 4);
+  bool result = job._dst != nullptr;
+  if (result) {
+    if (turns > 0) {
+      const uint32_t *src = (const uint32_t *)image._pixels;
+      uint32_t *dst = (uint32_t *)job._dst;
+      for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+          int dx = turns == 1 ? h - 1 - y : turns == 2 ? w - 1 - x : y;
+          int dy = turns == 1 ? x : turns == 2 ? h - 1 - y : w - 1 - x;
+          dst[(size_t)dy * job._newWidth + dx] = src[(size_t)y * w + x];
+        }
+      }
+    } else {
+      rows(rotate_rows, &job, job._newWidth, job._newHeight);
+    }
+    free(image._pixels);
+    image._pixels = job._dst;
+    image._width = job._newWidth;
+    image._height = job._newHeight;
+  }
+  return result;
+}
+
+//
+// returns the numbers held in a 1D or 2D array, or nullptr
+//
+inline double *get_numbers(var_t *array, int *rows, int *cols) {
+  double *result = nullptr;
+  if (array->type == V_ARRAY && v_asize(array) > 0) {
+    int count = v_asize(array);
+    if (v_maxdim(array) == 2) {
+      *rows = v_ubound(array, 0) - v_lbound(array, 0) + 1;
+      *cols = v_ubound(array, 1) - v_lbound(array, 1) + 1;
+    } else {
+      *rows = 1;
+      *cols = count;
+    }
+    result = (double *)malloc(count * sizeof(double));
+    for (int i = 0; result != nullptr && i < count; i++) {
+      var_t *elem = v_elem(array, i);
+      if (elem->type == V_ARRAY) {
+        // array of arrays, eg [[1,2],[3,4]]
+        free(result);
+        result = nullptr;
+      } else {
+        result[i] = v_getreal(elem);
+      }
+    }
+  }
+  return result;
+}
+
+//
+// returns an array argument, evaluating expressions like [1,2;3,4]
+//
+inline double *par_numbers(var_t *arg, int *rows, int *cols) {
+  double *result = nullptr;
+  v_init(arg);
+  eval(arg);
+  if (!prog_error) {
+    result = get_numbers(arg, rows, cols);
+    if (result == nullptr) {
+      err_throw(ERR_PARAM);
+    }
+  }
+  return result;
+}
+
+//
+// returns the image colour in pixel byte order
+//
+inline void get_color(var_int_t c, const uint8_t *channel, uint8_t *color) {
+  uint8_t argb[4];
+  v_get_argb(c, argb[3], argb[0], argb[1], argb[2]);
+  for (int i = 0; i < 4; i++) {
+    color[i] = argb[channel[i]];
+  }
+}
+
+//
+// png.filterRows(use f(x)), calls f once per row with an array of pixels
+//
+inline void filter_rows(Image &image) {
+  if (code_peek() != kwUSE) {
+    err_throw(ERR_PARAM);
+  } else {
+    code_skipnext();
+    bcip_t use_ip = code_getaddr();
+    bcip_t exit_ip = code_getaddr();
+    int w = image._width;
+    var_t var;
+    v_init(&var);
+    for (int y = 0; y < image._height && !prog_error; y++) {
+      uint8_t *line = image._pixels + (size_t)y * w * 4;
+      v_toarray1(&var, w);
+      for (int x = 0; x < w; x++) {
+        uint8_t a, r, g, b;
+        GET_IMAGE_ARGB(line, x * 4, a, r, g, b);
+        v_setint(v_elem(&var, x), v_get_argb_px(a, r, g, b));
+      }
+      exec_usefunc(&var, use_ip);
+      if (var.type == V_ARRAY && !prog_error) {
+        int n = imin((int)v_asize(&var), w);
+        for (int x = 0; x < n; x++) {
+          uint8_t a, r, g, b;
+          v_get_argb(v_getint(v_elem(&var, x)), a, r, g, b);
+          SET_IMAGE_ARGB(line, x * 4, a, r, g, b);
+        }
+      }
+    }
+    v_free(&var);
+    code_jump(exit_ip);
+  }
+}
+
+//
+// reads the arguments for the filter then applies it to the image
+//
+inline void apply(Op op, Image &image) {
+  var_int_t n1 = 0, n2 = 0, n3 = 0;
+  var_num_t f1 = 0;
+  double *numbers = nullptr;
+  int rows = 0, cols = 0;
+  bool ok = true;
+  var_t arg;
+  v_init(&arg);
+
+  Kernel *k = (Kernel *)calloc(1, sizeof(Kernel));
+  PixelJob job;
+  job._image = &image;
+  channels(job._channel);
+
+  switch (op) {
+  case BLUR:
+    n1 = 1;
+    par_massget("i", &n1);
+    if (!prog_error) {
+      ok = n1 < 1 || blur(image, imin((int)n1, FILTER_MAX_RADIUS));
+    }
+    break;
+
+  case SHARPEN:
+    f1 = 1;
+    par_massget("f", &f1);
+    if (!prog_error && k != nullptr) {
+      double weights[9] = {0, -f1, 0, -f1, 1 + 4 * f1, -f1, 0, -f1, 0};
+      k->_rows = k->_cols = 3;
+      set_weights(*k, weights, 1);
+      ok = convolve(image, *k);
+    }
+    break;
+
+  case EDGES:
+    ok = edges(image);
+    break;
+
+  case CONVOLVE:
+    // png.convolve(kernel [, divisor [, bias]])
+    numbers = par_numbers(&arg, &rows, &cols);
+    if (numbers != nullptr && (rows % 2 == 0 || cols % 2 == 0 ||
+                               rows > FILTER_MAX_KERNEL || cols > FILTER_MAX_KERNEL)) {
+      err_throw(ERR_PARAM);
+    } else if (numbers != nullptr && k != nullptr) {
+      double sum = 0;
+      for (int i = 0; i < rows * cols; i++) {
+        sum += numbers[i];
+      }
+      f1 = sum != 0 ? sum : 1;
+      if (code_peek() == kwTYPE_SEP) {
+        par_getcomma();
+        par_massget("Fi", &f1, &n1);
+      }
+      if (!prog_error && f1 != 0) {
+        k->_rows = rows;
+        k->_cols = cols;
+        k->_bias = n1;
+        set_weights(*k, numbers, f1);
+        ok = convolve(image, *k);
+      } else if (!prog_error) {
+        err_throw(ERR_PARAM);
+      }
+    }
+    break;
+
+  case COLOR_MATRIX:
+    // png.colorMatrix(m), with 3 rows of r,g,b,offset or 4 rows of r,g,b,a,offset
+    numbers = par_numbers(&arg, &rows, &cols);
+    if (numbers != nullptr) {
+      int count = rows * cols;
+      if (count != 12 && count != 20) {
+        err_throw(ERR_PARAM);
+      } else {
+        float matrix[20];
+        for (int i = 0; i < count; i++) {
+          matrix[i] = numbers[i];
+        }
+        job._matrix = matrix;
+        job._cols = count == 12 ? 4 : 5;
+        filter::rows(matrix_rows, &job, image._width, image._height);
+      }
+    }
+    break;
+
+  case THRESHOLD:
+    // png.threshold(level [, low-color, high-color])
+    // defaults to black and white
+    n2 = 0;
+    n3 = -0xffffff;
+    if (par_massget("Iii", &n1, &n2, &n3) > 0) {
+      job._level = n1;
+      get_color(n2, job._channel, job._low);
+      get_color(n3, job._channel, job._high);
+      filter::rows(threshold_rows, &job, image._width, image._height);
+    }
+    break;
+
+  case RESIZE:
+    // png.resize(w, h [, box])
+    if (par_massget("IIi", &n1, &n2, &n3) > 0) {
+      if (n1 < 1 || n2 < 1 || n1 * n2 > INT_MAX / 4) {
+        err_throw(ERR_PARAM);
+      } else {
+        ok = resize(image, n1, n2, n3 != 0);
+      }
+    }
+    break;
+
+  case ROTATE:
+    if (par_massget("F", &f1) > 0) {
+      ok = rotate(image, f1);
+    }
+    break;
+
+  case LUT:
+    // png.lut(table), with 256 values for r,g,b or 3 or 4 rows of 256 values
+    numbers = par_numbers(&arg, &rows, &cols);
+    if (numbers != nullptr) {
+      if (cols != 256 || rows > 4) {
+        err_throw(ERR_PARAM);
+      } else {
+        uint8_t (*table)[256] = (uint8_t (*)[256])malloc(4 * 256);
+        ok = table != nullptr;
+        if (ok) {
+          for (int c = 0; c < 4; c++) {
+            for (int i = 0; i < 256; i++) {
+              if (c == 3 && rows < 4) {
+                table[c][i] = i;
+              } else {
+                table[c][i] = clamp((int32_t)numbers[(rows == 1 ? 0 : c) * 256 + i]);
+              }
+            }
+          }
+          job._lut = table;
+          filter::rows(lut_rows, &job, image._width, image._height);
+          free(table);
+        }
+      }
+    }
+    break;
+
+  case ROWS:
+    filter_rows(image);
+    break;
+  }
+
+  if (!ok || k == nullptr) {
+    err_memory();
+  }
+  free(k);
+  free(numbers);
+  v_free(&arg);
+}
+
+} // namespace filter
+
+#endif
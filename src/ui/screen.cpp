@@ -7,6 +7,8 @@
 //
 
 #include <cstring>
+#include <climits>
+#include <cmath>
 
 #include "ui/screen.h"
 
@@ -21,6 +23,9 @@
       rect->_y <= _scrollY + _height) \
     rect->draw(_x + rect->_x, _y + rect->_y - _scrollY, w(), h(), _charWidth)
 
+// the screen last copied onto the display
+static Screen *presented = nullptr;
+
 int compareZIndex(const void *p1, const void *p2) {
   auto **i1 = (ImageDisplay **)p1;
   auto **i2 = (ImageDisplay **)p2;
@@ -32,6 +37,71 @@ bool Shape::isFullScreen() const {
   return _width == EXTENT_X(screenSize) && _height == EXTENT_Y(screenSize);
 }
 
+// whether the rectangles overlap or share an edge
+static bool touches(const MARect &r1, const MARect &r2) {
+  return (r1.left <= r2.left + r2.width &&
+          r2.left <= r1.left + r1.width &&
+          r1.top <= r2.top + r2.height &&
+          r2.top <= r1.top + r1.height);
+}
+
+// whether the rectangles overlap
+static bool intersects(const MARect &r1, const MARect &r2) {
+  return (r1.left < r2.left + r2.width &&
+          r2.left < r1.left + r1.width &&
+          r1.top < r2.top + r2.height &&
+          r2.top < r1.top + r1.height);
+}
+
+// the rectangle containing both rectangles
+static MARect bounds(const MARect &r1, const MARect &r2) {
+  MARect result;
+  result.left = MIN(r1.left, r2.left);
+  result.top = MIN(r1.top, r2.top);
+  result.width = MAX(r1.left + r1.width, r2.left + r2.width) - result.left;
+  result.height = MAX(r1.top + r1.height, r2.top + r2.height) - result.top;
+  return result;
+}
+
+// records the changed region, merging any touching regions
+void Damage::add(int x, int y, int w, int h) {
+  if (!_full && w > 0 && h > 0) {
+    MARect rc;
+    rc.left = x;
+    rc.top = y;
+    rc.width = w;
+    rc.height = h;
+
+    int i = 0;
+    while (i < _count) {
+      if (touches(_rects[i], rc)) {
+        rc = bounds(rc, _rects[i]);
+        _rects[i] = _rects[--_count];
+        i = 0;
+      } else {
+        i++;
+      }
+    }
+
+    if (_count == MAX_DAMAGE) {
+      // merge with the region that grows the least
+      int best = 0;
+      int bestGrowth = INT_MAX;
+      for (i = 0; i < _count; i++) {
+        MARect merged = bounds(rc, _rects[i]);
+        int growth = (merged.width * merged.height) - (_rects[i].width * _rects[i].height);
+        if (growth < bestGrowth) {
+          bestGrowth = growth;
+          best = i;
+        }
+      }
+      rc = bounds(rc, _rects[best]);
+      _rects[best] = _rects[--_count];
+    }
+    _rects[_count++] = rc;
+  }
+}
+
 Screen::Screen(int x, int y, int width, int height, int fontSize) :
   Shape(x, y, width, height),
   _font(0),
@@ -50,6 +120,9 @@ Screen::Screen(int x, int y, int width, int height, int fontSize) :
 }
 
 Screen::~Screen() {
+  if (presented == this) {
+    presented = nullptr;
+  }
   if (_font) {
     maFontDelete(_font);
   }
@@ -489,7 +562,8 @@ GraphicScreen::GraphicScreen(int width, int height, int fontSize) :
   _imageHeight(height),
   _curYSaved(0),
   _curXSaved(0),
-  _tabSize(40) {  // tab size in pixels (160/32 = 5)
+  _tabSize(40),   // tab size in pixels (160/32 = 5)
+  _presentedScrollY(0) {
 }
 
 GraphicScreen::~GraphicScreen() {
@@ -528,37 +602,57 @@ void GraphicScreen::clear() {
 }
 
 void GraphicScreen::drawArc(int xc, int yc, double r, double start, double end, double aspect) {
-  drawInto();
+  int rx = (int)fabs(r) + 2;
+  int ry = (int)fabs(r * aspect) + 2;
+  drawInto(xc - rx, yc - ry, rx * 2 + 1, ry * 2 + 1);
   maArc(xc, yc, r, start, end, aspect);
 }
 
 void GraphicScreen::drawBase(bool vscroll, bool update) {
-  MARect srcRect;
-  MAPoint2d dstPoint;
-  srcRect.left = 0;
-  srcRect.top = _scrollY;
-  srcRect.width = _width;
-  srcRect.height = _height;
-  dstPoint.x = _x;
-  dstPoint.y = _y;
+  MARect rects[MAX_DAMAGE];
+  int count = (update && !vscroll) ? getDamage(rects) : -1;
   MAHandle currentHandle = maSetDrawTarget(HANDLE_SCREEN);
-  maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
-
-  drawOverlay(vscroll);
-  _dirty = 0;
-  if (update) {
-    maUpdateScreen();
+  if (count == -1) {
+    MARect srcRect;
+    MAPoint2d dstPoint;
+    srcRect.left = 0;
+    srcRect.top = _scrollY;
+    srcRect.width = _width;
+    srcRect.height = _height;
+    dstPoint.x = _x;
+    dstPoint.y = _y;
+    maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+    drawOverlay(vscroll);
+    if (update) {
+      maUpdateScreen();
+    }
+  } else {
+    // copy and present only the changed regions
+    for (int i = 0; i < count; i++) {
+      MARect srcRect = rects[i];
+      MAPoint2d dstPoint;
+      srcRect.left -= _x;
+      srcRect.top += _scrollY - _y;
+      dstPoint.x = rects[i].left;
+      dstPoint.y = rects[i].top;
+      maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+    }
+    maUpdateScreenRegion(rects, count);
   }
+  _dirty = 0;
+  _damage.clear();
+  _presentedScrollY = _scrollY;
+  presented = this;
   maSetDrawTarget(currentHandle);
 }
 
 void GraphicScreen::drawEllipse(int xc, int yc, int rx, int ry, int fill) {
-  drawInto();
+  drawInto(xc - rx - 2, yc - ry - 2, rx * 2 + 5, ry * 2 + 5);
   maEllipse(xc, yc, rx, ry, fill);
 }
 
 void GraphicScreen::drawImage(ImageDisplay &image) {
-  drawInto();
+  drawInto(image._x, image._y, image._width, image._height);
   image.draw(image._x, image._y, image._width, image._height, 0);
 }
 
@@ -567,13 +661,21 @@ void GraphicScreen::drawInto(bool background) {
   Screen::drawInto(background);
 }
 
+// prepares to draw into the given region of the image
+void GraphicScreen::drawInto(int x, int y, int w, int h) {
+  maSetDrawTarget(_image);
+  maSetColor(_fg);
+  addDamage(x, y, w, h);
+}
+
 void GraphicScreen::drawLine(int x1, int y1, int x2, int y2) {
-  drawInto();
+  // allow for antialiasing
+  drawInto(MIN(x1, x2) - 1, MIN(y1, y2) - 1, abs(x2 - x1) + 3, abs(y2 - y1) + 3);
   maLine(x1, y1, x2, y2);
 }
 
 void GraphicScreen::drawRect(int x1, int y1, int x2, int y2) {
-  drawInto();
+  drawInto(MIN(x1, x2), MIN(y1, y2), abs(x2 - x1) + 1, abs(y2 - y1) + 1);
   maLine(x1, y1, x2, y1); // top
   maLine(x1, y2, x2, y2); // bottom
   maLine(x1, y1, x1, y2); // left
@@ -581,10 +683,51 @@ void GraphicScreen::drawRect(int x1, int y1, int x2, int y2) {
 }
 
 void GraphicScreen::drawRectFilled(int x1, int y1, int x2, int y2) {
-  drawInto();
+  drawInto(MIN(x1, x2), MIN(y1, y2), abs(x2 - x1) + 1, abs(y2 - y1) + 1);
   maFillRect(x1, y1, x2 - x1, y2 - y1);
 }
 
+// fills the area directly on the screen image
+bool GraphicScreen::floodFill(int x, int y, long fill, long border) {
+  // the extent of the fill is unknown
+  drawInto();
+  return maFloodFill(x, y, ansiToMosync(fill), border == -1 ? -1 : ansiToMosync(border));
+}
+
+// returns the changed regions in screen coordinates, or -1 when
+// the whole screen needs to be drawn
+int GraphicScreen::getDamage(MARect *rects) {
+  int result = -1;
+  if (!_damage._full && _damage._count > 0 && presented == this &&
+      _presentedScrollY == _scrollY && _label.empty()) {
+    int area = 0;
+    int limit = _width * _height * DAMAGE_FULL_PERCENT / 100;
+    result = 0;
+    for (int i = 0; i < _damage._count && result != -1; i++) {
+      // clip to the visible part of the image
+      const MARect &damage = _damage._rects[i];
+      int x1 = MAX(damage.left, 0);
+      int y1 = MAX(damage.top - _scrollY, 0);
+      int x2 = MIN(damage.left + damage.width, _width);
+      int y2 = MIN(damage.top + damage.height - _scrollY, _height);
+      if (x1 < x2 && y1 < y2) {
+        MARect &rc = rects[result];
+        rc.left = _x + x1;
+        rc.top = _y + y1;
+        rc.width = x2 - x1;
+        rc.height = y2 - y1;
+        area += rc.width * rc.height;
+        if (area > limit || overlayIntersects(rc)) {
+          result = -1;
+        } else {
+          result++;
+        }
+      }
+    }
+  }
+  return result;
+}
+
 // returns the color of the pixel at the given xy location
 int GraphicScreen::getPixel(int x, int y) {
   MARect rc;
@@ -619,6 +762,7 @@ void GraphicScreen::imageAppend(MAHandle newImage) {
 
   maSetDrawTarget(newImage);
   maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+  setDirty();
 
   // clear the new segment
   maSetColor(_bg);
@@ -649,6 +793,7 @@ void GraphicScreen::imageScroll() {
 
     maSetDrawTarget(newImage);
     maDrawImageRegion(_image, &srcRect, &dstPoint, TRANS_NONE);
+    setDirty();
 
     // clear the new segment
     maSetColor(_bg);
@@ -696,6 +841,46 @@ void GraphicScreen::newLine(int lineHeight) {
   }
 }
 
+// whether any shapes drawn over the image intersect the screen rectangle
+bool GraphicScreen::overlayIntersects(const MARect &rc) {
+  bool result = false;
+  List_each(Shape *, it, _shapes) {
+    Shape *shape = (*it);
+    MARect bounds = {_x + shape->_x, _y + shape->_y - _scrollY, shape->_width, shape->_height};
+    if (intersects(rc, bounds)) {
+      result = true;
+      break;
+    }
+  }
+  if (!result) {
+    List_each(ImageDisplay *, it, _images) {
+      ImageDisplay *image = (*it);
+      MARect bounds = {_x + image->_x, _y + image->_y - _scrollY, image->_width, image->_height};
+      if (intersects(rc, bounds)) {
+        result = true;
+        break;
+      }
+    }
+  }
+  if (!result) {
+    List_each(FormInput *, it, _inputs) {
+      FormInput *input = (*it);
+      MARect bounds = {_x + input->_x, _y + input->_y - _scrollY, input->_width, input->_height};
+      if (intersects(rc, bounds)) {
+        result = true;
+        break;
+      }
+    }
+  }
+  if (!result) {
+    // the menu dots in the bottom right corner
+    MARect bounds = {_x + _width - (_charWidth * 2), _y + _height - (_charHeight * 2),
+                     _charWidth * 2, _charHeight * 2};
+    result = intersects(rc, bounds);
+  }
+  return result;
+}
+
 int GraphicScreen::print(const char *p, int lineHeight, bool allChars) {
   if (_curX + _charWidth >= _width - 1) {
     newLine(lineHeight);
@@ -716,9 +901,16 @@ int GraphicScreen::print(const char *p, int lineHeight, bool allChars) {
     maLine(cx, _curY + lineHeight - 2, _curX, _curY + lineHeight - 2);
   }
 
+  addDamage(cx, _curY, _curX - cx, lineHeight);
   return numChars;
 }
 
+// prepares for print(), which records the damaged region
+void GraphicScreen::printInto() {
+  maSetDrawTarget(_image);
+  maSetColor(_fg);
+}
+
 // reset the current drawing variables
 void GraphicScreen::reset(int fontSize) {
   Screen::reset(fontSize);
@@ -776,6 +968,7 @@ void GraphicScreen::resize(int newWidth, int newHeight, int oldWidth,
   _scrollY = 0;
   _width = newWidth;
   _height = newHeight;
+  setDirty();
   if (!fullscreen) {
     drawBase(false);
   }
@@ -792,6 +985,7 @@ bool GraphicScreen::setGraphicsRendition(const char c, int escValue, int lineHei
   case 'K':
     maSetColor(_bg);            // \e[K - clear to eol
     maFillRect(_curX, _curY, _width - _curX, lineHeight);
+    addDamage(_curX, _curY, _width - _curX, lineHeight);
     break;
   case 'G':                    // move to column
     _curX = escValue * _charWidth;
@@ -901,7 +1095,7 @@ bool GraphicScreen::setGraphicsRendition(const char c, int escValue, int lineHei
 }
 
 void GraphicScreen::setPixel(int x, int y, int c) {
-  drawInto();
+  drawInto(x, y, 1, 1);
   maSetColor(ansiToMosync(c));
   maPlot(x, y);
 }
@@ -1056,6 +1250,8 @@ void TextScreen::drawBase(bool vscroll, bool update) {
   // draw the base components
   drawOverlay(vscroll);
   _dirty = 0;
+  _damage.clear();
+  presented = this;
   maUpdateScreen();
   maSetDrawTarget(currentHandle);
 }
@@ -23,6 +23,20 @@ using namespace strlib;
 #define LINE_SPACING 0
 #define INITXY 2
 #define NO_COLOR -1
+#define MAX_DAMAGE 8
+#define DAMAGE_FULL_PERCENT 50
+
+// regions of the screen image changed since the last flush
+struct Damage {
+  Damage() : _count(0), _full(false) {}
+
+  void add(int x, int y, int w, int h);
+  void clear() { _count = 0; _full = false; }
+
+  MARect _rects[MAX_DAMAGE];
+  int _count;
+  bool _full;
+};
 
 struct Screen : public Shape {
   Screen(int x, int y, int width, int height, int fontSize);
@@ -36,9 +50,11 @@ struct Screen : public Shape {
   virtual void drawEllipse(int xc, int yc, int rx, int ry, int fill) = 0;
   virtual void drawImage(ImageDisplay &image) = 0;
   virtual void drawInto(bool background=false);
+  virtual void printInto() { drawInto(); }
   virtual void drawLine(int x1, int y1, int x2, int y2) = 0;
   virtual void drawRect(int x1, int y1, int x2, int y2) = 0;
   virtual void drawRectFilled(int x1, int y1, int x2, int y2) = 0;
+  virtual bool floodFill(int x, int y, long fill, long border) = 0;
   virtual void newLine(int lineHeight) = 0;
   virtual int  getPixel(int x, int y) = 0;
   virtual int  print(const char *p, int lineHeight, bool allChars=false);
@@ -51,6 +67,7 @@ struct Screen : public Shape {
   virtual int  getMaxHScroll() = 0;
 
   void add(Shape *button);
+  void addDamage(int x, int y, int w, int h) { _damage.add(x, y, w, h); setDirtyTime(); }
   void addImage(ImageDisplay &image);
   int  ansiToMosync(long c);
   void drawLabel();
@@ -73,7 +90,8 @@ struct Screen : public Shape {
   void replaceFont(int type = FONT_TYPE_MONOSPACE);
   void resetScroll() { _scrollX = 0; _scrollY = 0; }
   void setColor(long color);
-  void setDirty() { if (!_dirty) { _dirty = maGetMilliSecondCount(); } }
+  void setDirty() { _damage._full = true; setDirtyTime(); }
+  void setDirtyTime() { if (!_dirty) { _dirty = maGetMilliSecondCount(); } }
   void setFont(bool bold, bool italic, int size);
   void selectFont() { if (_font != -1) maFontSetCurrent(_font); }
   void setScroll(int x, int y) { _scrollX = x; _scrollY = y; }
@@ -92,6 +110,7 @@ struct Screen : public Shape {
   int _curY;
   int _dirty;
   int _linePadding;
+  Damage _damage;
   String _label;
   strlib::List<Shape *> _shapes;
   strlib::List<FormInput *> _inputs;
@@ -110,14 +129,19 @@ struct GraphicScreen : public Screen {
   void drawEllipse(int xc, int yc, int rx, int ry, int fill);
   void drawImage(ImageDisplay &image);
   void drawInto(bool background=false);
+  void drawInto(int x, int y, int w, int h);
   void drawLine(int x1, int y1, int x2, int y2);
   void drawRect(int x1, int y1, int x2, int y2);
   void drawRectFilled(int x1, int y1, int x2, int y2);
+  bool floodFill(int x, int y, long fill, long border);
+  int  getDamage(MARect *rects);
   int  getPixel(int x, int y);
   void imageScroll();
   void imageAppend(MAHandle newImage);
   void newLine(int lineHeight);
+  bool overlayIntersects(const MARect &rc);
   int  print(const char *p, int lineHeight, bool allChars=false);
+  void printInto();
   void reset(int fontSize);
   bool setGraphicsRendition(const char c, int escValue, int lineHeight);
   void setPixel(int x, int y, int c);
@@ -136,6 +160,7 @@ struct GraphicScreen : public Screen {
   int _curYSaved;
   int _curXSaved;
   int _tabSize;
+  int _presentedScrollY;
 };
 
 struct TextSeg {
@@ -334,6 +359,7 @@ struct TextScreen : public Screen {
   void drawText(const char *text, int len, int x, int lineHeight);
   void drawRect(int x1, int y1, int x2, int y2);
   void drawRectFilled(int x1, int y1, int x2, int y2);
+  bool floodFill(int x, int y, long fill, long border) { return false; }
   int  getPixel(int x, int y) { return 0; }
   void inset(int x, int y, int w, int h, Screen *over);
   void newLine(int lineHeight);
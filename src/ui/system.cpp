@@ -1386,6 +1386,10 @@ long osd_getpixel(int x, int y) {
   return g_system->getOutput()->getPixel(x, y);
 }
 
+int osd_ffill(int x, int y, long fill_color, long border_color) {
+  return g_system->getOutput()->floodFill(x, y, fill_color, border_color);
+}
+
 int osd_getx(void) {
   return g_system->getOutput()->getX();
 }
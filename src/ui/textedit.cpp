@@ -64,6 +64,7 @@ int textedit_move_to_word_next(EditBuffer *str, int c) {
 #pragma GCC diagnostic pop
 
 #define GROW_SIZE 128
+#define LINE_INDEX_SIZE 64
 #define LINE_BUFFER_SIZE 200
 #define INDENT_LEVEL 2
 #define HELP_WIDTH 22
@@ -350,24 +351,36 @@ EditBuffer::EditBuffer(TextEditInput *in, const char *text) :
   _buffer(nullptr),
   _len(0),
   _size(0),
-  _lines(-1),
+  _lines(1),
+  _lineStart(nullptr),
+  _rowStart(nullptr),
+  _lineSize(0),
+  _rowsValid(0),
+  _rowChars(0),
   _in(in) {
+  _lineSize = LINE_INDEX_SIZE;
+  _lineStart = (int *)malloc(_lineSize * sizeof(int));
+  _rowStart = (int *)malloc((_lineSize + 1) * sizeof(int));
+  _lineStart[0] = 0;
   if (text != nullptr && text[0]) {
     _len = strlen(text);
     _size = _len + 1;
     _buffer = (char *)malloc(_size);
     memcpy(_buffer, text, _len);
     _buffer[_len] = '\0';
-    convertTabs();
+    convertTabs(0, _len);
+    updateLines(0, 0, _len);
   }
 }
 
 EditBuffer::~EditBuffer() {
   clear();
+  free(_lineStart);
+  free(_rowStart);
 }
 
-void EditBuffer::convertTabs() {
-  for (int i = 0; i < _len; i++) {
+void EditBuffer::convertTabs(int start, int end) {
+  for (int i = start; i < end; i++) {
     if (_buffer[i] == '\t') {
       _buffer[i] = ' ';
     }
@@ -378,26 +391,12 @@ void EditBuffer::clear() {
   free(_buffer);
   _buffer = nullptr;
   _len = _size = 0;
-  _lines = -1;
-}
-
-int EditBuffer::countNewlines(const char *text, int num) {
-  int result = 0;
-  for (int i = 0; i < num; i++) {
-    if (text[i] == '\n') {
-      result++;
-    }
-  }
-  return result;
+  _lines = 1;
+  _rowsValid = 0;
 }
 
 int EditBuffer::deleteChars(int pos, int num) {
-  if (num > 1) {
-    _lines -= countNewlines(_buffer + pos, num);
-  } else if (_buffer[pos] == '\n') {
-    _lines--;
-  }
-
+  int removed = MIN(num, _len - pos);
   if (_len - (pos + num) > 0) {
     memmove(&_buffer[pos], &_buffer[pos + num], _len - (pos + num));
   }
@@ -407,6 +406,9 @@ int EditBuffer::deleteChars(int pos, int num) {
     _len = 0;
   }
   _buffer[_len] = '\0';
+  if (removed > 0) {
+    updateLines(pos, removed, 0);
+  }
   _in->setDirty(true);
   return 1;
 }
@@ -440,20 +442,197 @@ int EditBuffer::insertChars(int pos, const char *text, int num) {
   _len += num;
   _buffer[_len] = '\0';
   _in->setDirty(true);
-  convertTabs();
-  if (num > 1) {
-    _lines += countNewlines(text, num);
-  } else if (text[0] == '\n') {
-    _lines++;
-  }
+  convertTabs(pos, pos + num);
+  updateLines(pos, 0, num);
   return 1;
 }
 
-int EditBuffer::lineCount() {
-  if (_lines < 0) {
-    _lines = 1 + countNewlines(_buffer, _len);
+//
+// returns the number of characters in the line, excluding the line break
+//
+int EditBuffer::lineLength(int line) const {
+  int start = _lineStart[line];
+  int end = line + 1 < _lines ? _lineStart[line + 1] : _len;
+  if (end > start && line + 1 < _lines) {
+    if (_buffer[end - 1] == '\n' && end - 1 > start && _buffer[end - 2] == '\r') {
+      end -= 2;
+    } else {
+      end--;
+    }
+  }
+  return end - start;
+}
+
+//
+// returns the line holding the character at pos
+//
+int EditBuffer::lineOf(int pos) const {
+  int lo = 0;
+  int hi = _lines - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (_lineStart[mid] <= pos) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+//
+// returns the line holding the given row
+//
+int EditBuffer::lineOfRow(int row, int rowChars) {
+  firstRow(_lines, rowChars);
+  int lo = 0;
+  int hi = _lines - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (_rowStart[mid] <= row) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+//
+// returns the number of rows in the line, matching TextEditInput::layout()
+//
+int EditBuffer::lineRows(int line, int rowChars) const {
+  int len = lineLength(line);
+  int result;
+  if (len == 0) {
+    // the final line has no rows unless it holds some text
+    result = line + 1 < _lines ? 1 : 0;
+  } else {
+    result = (len + rowChars - 1) / rowChars;
+  }
+  return result;
+}
+
+//
+// returns the first row of the line, or the total rows when line is _lines
+//
+int EditBuffer::firstRow(int line, int rowChars) {
+  if (rowChars != _rowChars) {
+    _rowChars = rowChars;
+    _rowsValid = 0;
+  }
+  if (_rowsValid == 0) {
+    _rowStart[0] = 0;
+    _rowsValid = 1;
+  }
+  for (; _rowsValid <= line; _rowsValid++) {
+    int prev = _rowsValid - 1;
+    _rowStart[_rowsValid] = _rowStart[prev] + lineRows(prev, rowChars);
+  }
+  return _rowStart[line];
+}
+
+//
+// returns the position after the row starting at offset
+//
+int EditBuffer::rowEnd(int offset, int rowChars, bool excludeBreak) const {
+  int line = lineOf(offset);
+  int start = _lineStart[line];
+  int len = lineLength(line);
+  int lastRow = len == 0 ? 0 : (len - 1) / rowChars;
+  int result;
+  if ((offset - start) / rowChars < lastRow) {
+    result = offset + rowChars;
+  } else if (excludeBreak) {
+    result = start + len;
+  } else {
+    result = line + 1 < _lines ? _lineStart[line + 1] : _len;
+  }
+  return result;
+}
+
+//
+// returns the row holding the character at pos, along with the column
+//
+int EditBuffer::rowOf(int pos, int rowChars, int *col) {
+  int line = lineOf(pos);
+  if (line > 0 && pos == _len && _buffer[pos - 1] == '\r') {
+    // like layout(), the cursor stays on the row ending with a lone "\r"
+    line--;
+  }
+  int offset = pos - _lineStart[line];
+  int len = lineLength(line);
+  int row = len == 0 ? 0 : MIN(offset / rowChars, (len - 1) / rowChars);
+  if (col != nullptr) {
+    *col = offset - (row * rowChars);
+  }
+  return firstRow(line, rowChars) + row;
+}
+
+//
+// returns the position of the first character in the row, or -1 when the row does not exist
+//
+int EditBuffer::rowOffset(int row, int rowChars) {
+  int result;
+  if (row < 0 || row >= rowCount(rowChars)) {
+    result = -1;
+  } else {
+    int line = lineOfRow(row, rowChars);
+    result = _lineStart[line] + (row - _rowStart[line]) * rowChars;
+  }
+  return result;
+}
+
+//
+// updates the line index after the characters from pos were replaced. A line
+// break is "\r\n", "\n" or a lone "\r", so the lines are rescanned from the line
+// before the change, through to the end of the inserted text
+//
+void EditBuffer::updateLines(int pos, int removed, int inserted) {
+  int first = MAX(lineOf(pos) - 1, 0);
+  int scanEnd = pos + inserted;
+
+  // the unchanged lines following the edit
+  int tail = first + 1;
+  while (tail < _lines && _lineStart[tail] <= pos + removed) {
+    tail++;
+  }
+  int tailCount = _lines - tail;
+
+  int count = 0;
+  for (int i = _lineStart[first]; i < scanEnd; i++) {
+    if (_buffer[i] == '\n' || (_buffer[i] == '\r' && _buffer[i + 1] != '\n')) {
+      count++;
+    }
+  }
+
+  int lines = first + 1 + count + tailCount;
+  if (lines > _lineSize) {
+    _lineSize = lines + (lines / 2);
+    _lineStart = (int *)realloc(_lineStart, _lineSize * sizeof(int));
+    _rowStart = (int *)realloc(_rowStart, (_lineSize + 1) * sizeof(int));
+  }
+
+  int delta = inserted - removed;
+  int next = first + 1 + count;
+  if (tailCount > 0 && next != tail) {
+    memmove(&_lineStart[next], &_lineStart[tail], tailCount * sizeof(int));
+  }
+  if (delta != 0) {
+    for (int i = next; i < lines; i++) {
+      _lineStart[i] += delta;
+    }
+  }
+
+  int line = first + 1;
+  for (int i = _lineStart[first]; i < scanEnd; i++) {
+    if (_buffer[i] == '\n' || (_buffer[i] == '\r' && _buffer[i + 1] != '\n')) {
+      _lineStart[line++] = i + 1;
+    }
   }
-  return _lines;
+
+  _lines = lines;
+  _rowsValid = MIN(_rowsValid, first + 1);
 }
 
 char *EditBuffer::textRange(int start, int end) const {
@@ -578,17 +757,20 @@ void TextEditInput::draw(int x, int y, int w, int h, int chw) {
   SyntaxState syntax = kReset;
   StbTexteditRow r;
   int len = _buf._len;
-  int i = 0;
   int baseY = 0;
   int cursorX = x;
   int cursorY = y;
   int cursorMatchX = x;
   int cursorMatchY = y;
-  int row = 0;
-  int line = 0;
   int selectStart = MIN(_state.select_start, _state.select_end);
   int selectEnd = MAX(_state.select_start, _state.select_end);
 
+  // begin with the line holding the first visible row
+  int rowChars = getRowChars();
+  int line = _buf.lineOfRow(_scroll, rowChars);
+  int row = _buf.firstRow(line, rowChars);
+  int i = _buf.lineOffset(line);
+
   maSetColor(_theme->_background);
   maFillRect(x, y, _width, _height);
   maSetColor(_theme->_color);
@@ -992,15 +1174,11 @@ int TextEditInput::getSelectionRow() {
   int result;
   if (_state.select_start != _state.select_end) {
     int pos = MIN(_state.select_start, _state.select_end);
-    int len = _buf._len;
-    result = 0;
-    StbTexteditRow r;
-    for (int i = 0; i < len; i += r.num_chars) {
-      layout(&r, i);
-      if (pos >= i && pos < i + r.num_chars) {
-        break;
-      }
-      result++;
+    int rowChars = getRowChars();
+    if (pos < _buf._len) {
+      result = _buf.rowOf(pos, rowChars, nullptr);
+    } else {
+      result = _buf.rowCount(rowChars);
     }
   } else {
     result = 0;
@@ -1081,14 +1259,9 @@ void TextEditInput::setCursorPos(int pos) {
 }
 
 void TextEditInput::setCursorRow(int row) {
-  int len = _buf._len;
-  StbTexteditRow r;
-  for (int i = 0, nextRow = 0; i < len; i += r.num_chars, nextRow++) {
-    layout(&r, i);
-    if (row == nextRow) {
-      _state.cursor = i;
-      break;
-    }
+  int pos = _buf.rowOffset(row, getRowChars());
+  if (pos != -1) {
+    _state.cursor = pos;
   }
   _cursorRow = row;
   _matchingBrace = -1;
@@ -1183,12 +1356,12 @@ void TextEditInput::layout(StbTexteditRow *row, int start) const {
   int i = start;
   int len = _buf._len;
   int x1 = 0;
-  int x2 = _width - _charWidth - _marginWidth;
+  int rowChars = getRowChars();
   int numChars = 0;
 
   // advance to newline or rectangle edge
   while (i < len
-         && x1 < x2
+         && numChars < rowChars
          && _buf._buffer[i] != '\r'
          && _buf._buffer[i] != '\n') {
     x1 += _charWidth;
@@ -1513,30 +1686,8 @@ int TextEditInput::getCompletions(StringList *list, int max) {
 }
 
 int TextEditInput::getCursorRow() {
-  StbTexteditRow r;
-  int len = _buf._len;
-  int row = 0;
-  int i;
-
-  for (i = 0; i < len;) {
-    layout(&r, i);
-    if (_state.cursor == i + r.num_chars &&
-        _buf._buffer[i + r.num_chars - 1] == STB_TEXTEDIT_NEWLINE) {
-      // at end of line
-      row++;
-      _cursorCol = 0;
-      break;
-    } else if (_state.cursor >= i && _state.cursor < i + r.num_chars) {
-      // within line
-      _cursorCol = _state.cursor - i;
-      break;
-    }
-    i += r.num_chars;
-    if (i < len) {
-      row++;
-    }
-  }
-  return row;
+  int pos = MAX(0, MIN(_state.cursor, _buf._len));
+  return _buf.rowOf(pos, getRowChars(), &_cursorCol);
 }
 
 uint32_t TextEditInput::getHash(const char *str, int offs, int &count) {
@@ -1624,6 +1775,14 @@ int TextEditInput::getLineChars(StbTexteditRow *row, int pos) const {
   return numChars;
 }
 
+//
+// returns the number of characters before layout() wraps to the next row
+//
+int TextEditInput::getRowChars() const {
+  int width = _width - _charWidth - _marginWidth;
+  return (width > 0 && _charWidth > 0) ? (width + _charWidth - 1) / _charWidth : 1;
+}
+
 char *TextEditInput::getSelection(int *start, int *end) {
   char *result;
 
@@ -1747,38 +1906,27 @@ void TextEditInput::lineNavigate(bool arrowDown) {
 }
 
 char *TextEditInput::lineText(int pos) {
-  StbTexteditRow r;
-  int len = _buf._len;
   int start = 0;
   int end = 0;
-  for (int i = 0; i < len; i += r.num_chars) {
-    layout(&r, i);
-    if (pos >= i && pos < i + r.num_chars) {
-      start = i;
-      end = i + getLineChars(&r, i);
-      break;
-    }
+  if (pos >= 0 && pos < _buf._len) {
+    int rowChars = getRowChars();
+    int col;
+    _buf.rowOf(pos, rowChars, &col);
+    start = pos - col;
+    end = _buf.rowEnd(start, rowChars, true);
   }
   return _buf.textRange(start, end);
 }
 
 int TextEditInput::linePos(int pos, bool end, bool excludeBreak) {
-  StbTexteditRow r;
-  int len = _buf._len;
   int start = 0;
-  for (int i = 0; i < len; i += r.num_chars) {
-    layout(&r, i);
-    if (pos >= i && pos < i + r.num_chars) {
-      if (end) {
-        if (excludeBreak) {
-          start = i + getLineChars(&r, i);
-        } else {
-          start = i + r.num_chars;
-        }
-      } else {
-        start = i;
-      }
-      break;
+  if (pos >= 0 && pos < _buf._len) {
+    int rowChars = getRowChars();
+    int col;
+    _buf.rowOf(pos, rowChars, &col);
+    start = pos - col;
+    if (end) {
+      start = _buf.rowEnd(start, rowChars, excludeBreak);
     }
   }
   return start;
@@ -1811,21 +1959,15 @@ void TextEditInput::pageNavigate(bool pageDown, bool shift) {
     nextRow = 0;
   }
 
-  StbTexteditRow r;
-  int len = _buf._len;
-  int row = 0;
+  int rowChars = getRowChars();
+  int rows = _buf.rowCount(rowChars);
+  int row = MIN(nextRow, rows - 1);
   int i = 0;
-  int count = 0;
-
-  for (; i < len && row != nextRow; i += r.num_chars, row++) {
-    layout(&r, i);
-    count += r.num_chars;
-  }
-
-  if (count == _buf._len) {
-    // at end
-    row--;
-    i -= r.num_chars;
+  if (row < 0) {
+    row = 0;
+  } else {
+    // when past the end, the start of the last row
+    i = _buf.rowOffset(row, rowChars);
   }
 
   if (shift) {
@@ -37,11 +37,20 @@ struct StackTraceNode {
 
 typedef strlib::List<StackTraceNode *> StackTrace;
 
+//
+// The text with an index of the line starts, updated around each edit, and
+// the first row of each line when wrapped at a given number of characters
+//
 struct EditBuffer {
   char *_buffer;
   int _len;
   int _size;
   int _lines;
+  int *_lineStart;
+  int *_rowStart;
+  int _lineSize;
+  int _rowsValid;
+  int _rowChars;
   TextEditInput *_in;
 
   EditBuffer(TextEditInput *in, const char *text);
@@ -50,14 +59,26 @@ struct EditBuffer {
   void append(const char *text, int len) { insertChars(_len, text, len); }
   void append(const char *text) { insertChars(_len, text, strlen(text)); }
   void clear();
-  void convertTabs();
-  int  countNewlines(const char *text, int num);
+  void convertTabs(int start, int end);
   int  deleteChars(int pos, int num);
   char getChar(int pos) const;
   int  insertChars(int pos, const char *text, int num);
-  int  lineCount();
+  int  lineCount() const { return _lines; }
+  int  lineLength(int line) const;
+  int  lineOf(int pos) const;
+  int  lineOfRow(int row, int rowChars);
+  int  lineOffset(int line) const { return _lineStart[line]; }
+  int  firstRow(int line, int rowChars);
   void removeTrailingSpaces(STB_TexteditState *state);
+  int  rowCount(int rowChars) { return firstRow(_lines, rowChars); }
+  int  rowEnd(int offset, int rowChars, bool excludeBreak) const;
+  int  rowOf(int pos, int rowChars, int *col);
+  int  rowOffset(int row, int rowChars);
   char *textRange(int start, int end) const;
+
+private:
+  int  lineRows(int line, int rowChars) const;
+  void updateLines(int pos, int removed, int inserted);
 };
 
 struct TextEditInput : public FormEditInput {
@@ -138,6 +159,7 @@ protected:
   uint32_t getHash(const char *str, int offs, int &count);
   int  getIndent(char *spaces, int len, int pos);
   int  getLineChars(StbTexteditRow *row, int pos) const;
+  int  getRowChars() const;
   char *getSelection(int *start, int *end);
   void gotoNextMarker();
   void killWord();
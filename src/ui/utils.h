@@ -34,6 +34,8 @@
 #elif defined(_SDL) || defined(_FLTK) || defined(_EMCC)
  void appLog(const char *format, ...);
  #define deviceLog(...) appLog(__VA_ARGS__)
+#elif defined(_HEADLESS)
+ #define deviceLog(...) fprintf(stderr, __VA_ARGS__)
 #endif
 
 #if defined(_DEBUG)